@@ -0,0 +1,14 @@
+#ifndef DOUBLE_SCAN_H
+#define DOUBLE_SCAN_H
+
+/// @brief Reads decimal floating-point literal [+-]digits[.digits][(e|E)[+-]digits]
+/// @details Value is rounded correctly, the same way as strtod does it. Most literals are
+/// converted with one or two integer multiplications (Clinger and Eisel-Lemire algorithms),
+/// strtod is called only for the cases they can't decide (more than 19 significant digits,
+/// huge exponents, subnormals, inf and nan).
+/// @param [in]string string to read from, leading spaces are not skipped
+/// @param [out]value read value, not changed if there is no literal
+/// @return pointer to the first char after the literal, string if there is no literal
+const char* DoubleScan(const char* string, double* value);
+
+#endif
@@ -13,12 +13,12 @@
 #undef PRINT_ERR
 
 #ifndef NDEBUG
-    #define PRINT_ERR(X) Log(HTML_RED_HEAD_BEGIN "\n"                                \
+    #define PRINT_ERR(X) LOG_ERROR(HTML_RED_HEAD_BEGIN "\n"                          \
                              X "Error occured in file %s in func %s in line %d\n"    \
                              HTML_HEAD_END "\n",                                     \
                              ErrorInfo.fileWithError, ErrorInfo.funcWithError, ErrorInfo.lineWithError)
 #else
-    #define PRINT_ERR(X) Log(HTML_RED_HEAD_BEGIN "\n" (X) "\n" HTML_HEAD_END "\n")
+    #define PRINT_ERR(X) LOG_ERROR(HTML_RED_HEAD_BEGIN "\n" (X) "\n" HTML_HEAD_END "\n")
 #endif
 
 //---------------
@@ -61,6 +61,22 @@ void LogStardardErrors()
             LOG_ERR("Memory allocation error.\n");
             break;
 
+        case Errors::FILE_OPENING_ERR:
+            LOG_ERR("File opening error.\n");
+            break;
+
+        case Errors::GETTING_FILE_SIZE_ERR:
+            LOG_ERR("Getting file size error.\n");
+            break;
+
+        case Errors::PRINTING_TO_FILE_ERR:
+            LOG_ERR("Printing to file error.\n");
+            break;
+
+        case Errors::FILE_MAPPING_ERR:
+            LOG_ERR("File mapping error.\n");
+            break;
+
         case Errors::NO_ERR:
         default:
             break;
@@ -94,6 +110,10 @@ bool HasError()
             return false;
         
         case Errors::MEMORY_ALLOCATION_ERR:
+        case Errors::FILE_OPENING_ERR:
+        case Errors::GETTING_FILE_SIZE_ERR:
+        case Errors::PRINTING_TO_FILE_ERR:
+        case Errors::FILE_MAPPING_ERR:
         default:
             return true;
     }
@@ -22,7 +22,8 @@ enum class Errors
 
     FILE_OPENING_ERR,
     GETTING_FILE_SIZE_ERR,
-    PRINTING_TO_FILE_ERR
+    PRINTING_TO_FILE_ERR,
+    FILE_MAPPING_ERR
 };
 
 //-----------------------------------------------------------------------------------------------
@@ -60,7 +61,7 @@ struct ErrorInfoType
     /// \param [in]ERROR Errors enum with error occurred in program
     #define UPDATE_ERR(ERROR) UpdateError((ERROR), __FILE__, __func__, __LINE__)
 
-    #define LOG_ERR(X) Log(HTML_RED_HEAD_BEGIN "\n" X "\n" HTML_HEAD_END "\n")
+    #define LOG_ERR(X) LOG_ERROR(HTML_RED_HEAD_BEGIN "\n" X "\n" HTML_HEAD_END "\n")
 
 #else
 
@@ -6,10 +6,42 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <atomic>
 
 #include "Log.h"
 
-static int LOG_FILE;
+//---------------------------------------------------------------------------------------
+
+// Single producer (owner thread) single consumer (writer thread) ring of chars.
+// head and tail only grow, position in data is counter % LogRingCapacity.
+struct LogRingType
+{
+    char* data;
+
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+
+    LogRingType* next;
+};
+
+static const size_t LogRingCapacity    = 1 << 16;
+static const size_t LogMessageMaxSize  = 1024;
+static const long   LogWriterSleepTime = 2000000; // ns
+
+static int LOG_FILE = -1;
+
+static std::atomic<LogLevel> LOG_LEVEL{LogLevel::DEBUG};
+static std::atomic<bool>     LOG_BACKTRACE{false};
+
+static std::atomic<LogRingType*> LogRings{nullptr};
+static thread_local LogRingType* LogThreadRing = nullptr;
+
+static pthread_t         LogWriter;
+static std::atomic<bool> LogWriterRunning{false};
+static std::atomic<bool> LogWriterStop{false};
 
 static inline void PrintSeparator();
 static void LogClose();
@@ -17,6 +49,19 @@ static void LogClose();
 static inline size_t Min(size_t a, size_t b);
 static int TryOpenFile(const char* name);
 
+static inline bool LogLevelEnabled(const LogLevel level);
+
+static ssize_t LogPrint (const char* format, ...) __attribute__((format(printf, 1, 2)));
+static ssize_t LogVPrint(const char* format, va_list args);
+static void    LogPush  (const char* text, size_t length);
+static void    LogBacktrace(const char* header);
+
+static LogRingType* LogGetThreadRing();
+static void* LogWriterThread(void*);
+static size_t LogDrainRings();
+
+//---------------------------------------------------------------------------------------
+
 void LogOpen(const char* argv0)
 {
     assert(argv0);
@@ -25,15 +70,19 @@ void LogOpen(const char* argv0)
     if (LOG_FILE == -1)
         return;
 
+    LogWriterStop.store(false);
+    if (pthread_create(&LogWriter, nullptr, LogWriterThread, nullptr) == 0)
+        LogWriterRunning.store(true, std::memory_order_release);
+
     time_t timeInSeconds = time(nullptr);
 
-    Log("<pre>\n\n");
+    LogPrint("<pre>\n\n");
 
-    Log(HTML_RED_HEAD_BEGIN "\n" 
-        "Log file was opened by program %s, compiled %s at %s. "
-        "Opening time: %s"
-        HTML_HEAD_END "\n", 
-        argv0, __DATE__, __TIME__, ctime(&timeInSeconds));
+    LogPrint(HTML_RED_HEAD_BEGIN "\n"
+             "Log file was opened by program %s, compiled %s at %s. "
+             "Opening time: %s"
+             HTML_HEAD_END "\n",
+             argv0, __DATE__, __TIME__, ctime(&timeInSeconds));
 
     atexit(LogClose);
 }
@@ -42,87 +91,337 @@ static void LogClose()
 {
     if (LOG_FILE == -1)
         return;
+
+    if (LogWriterRunning.load(std::memory_order_acquire))
+    {
+        LogWriterStop.store(true, std::memory_order_release);
+        pthread_join(LogWriter, nullptr);
+        LogWriterRunning.store(false, std::memory_order_release);
+    }
+
     time_t timeInSeconds = time(nullptr);
 
-    Log("\n" HTML_RED_HEAD_BEGIN "\n"
-        "Log file was closed by program compiled %s at %s. "
-        "Closing time: %s"
-        HTML_HEAD_END "\n",
-        __DATE__, __TIME__, ctime(&timeInSeconds));
+    LogPrint("\n" HTML_RED_HEAD_BEGIN "\n"
+             "Log file was closed by program compiled %s at %s. "
+             "Closing time: %s"
+             HTML_HEAD_END "\n",
+             __DATE__, __TIME__, ctime(&timeInSeconds));
 
     PrintSeparator();
 
-    Log("</pre>\n");
+    LogPrint("</pre>\n");
 
     close(LOG_FILE);
     LOG_FILE = -1;
 }
 
+//---------------------------------------------------------------------------------------
+
+void LogSetLevel(const LogLevel level)
+{
+    LOG_LEVEL.store(level, std::memory_order_relaxed);
+}
+
+LogLevel LogGetLevel()
+{
+    return LOG_LEVEL.load(std::memory_order_relaxed);
+}
+
+void LogSetBacktrace(const bool enabled)
+{
+    LOG_BACKTRACE.store(enabled, std::memory_order_relaxed);
+}
+
+static inline bool LogLevelEnabled(const LogLevel level)
+{
+    return (int)level >= LOG_MIN_LEVEL && level >= LOG_LEVEL.load(std::memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------------------------
+
+void LogFlush()
+{
+    if (!LogWriterRunning.load(std::memory_order_acquire))
+        return;
+
+    for (LogRingType* ring = LogRings.load(std::memory_order_acquire); ring; ring = ring->next)
+    {
+        size_t head = ring->head.load(std::memory_order_acquire);
+
+        while (ring->tail.load(std::memory_order_acquire) < head)
+            sched_yield();
+    }
+}
+
+//---------------------------------------------------------------------------------------
+
 void LogBegin(const char* fileName, const char* funcName, const int line)
 {
     assert(fileName);
     assert(funcName);
 
-    if (LOG_FILE == -1)
+    if (LOG_FILE == -1 || !LogLevelEnabled(LogLevel::DEBUG))
         return;
 
-    time_t timeInSeconds = time(nullptr);     
+    time_t timeInSeconds = time(nullptr);
 
-    Log("\n-----------------------\n\n"                            
-        HTML_GREEN_HEAD_BEGIN "\n"                                 
-        "New log called %s"                                        
-        "Called from file: %s, from function: %s, from line: %d\n" 
-        HTML_HEAD_END "\n\n\n",                                    
-        ctime(&timeInSeconds), fileName, funcName, line);                                 
+    LogPrint("\n-----------------------\n\n"
+             HTML_GREEN_HEAD_BEGIN "\n"
+             "New log called %s"
+             "Called from file: %s, from function: %s, from line: %d\n"
+             HTML_HEAD_END "\n\n\n",
+             ctime(&timeInSeconds), fileName, funcName, line);
 
-    static const size_t buffSize = 128;
-    static void* buffer[buffSize];
-    int numb = backtrace(buffer, buffSize);
-    Log("Functions calling stack on beginning:\n");
-    backtrace_symbols_fd(buffer, numb, LOG_FILE);
+    LogBacktrace("Functions calling stack on beginning:\n");
 }
 
 ssize_t Log(const char* format, ...)
 {
     assert(format);
 
+    if (!LogLevelEnabled(LogLevel::DEBUG))
+        return 0;
+
     va_list args = {};
 
     va_start(args, format);
+    ssize_t numberOfChars = LogVPrint(format, args);
+    va_end(args);
 
-    static const size_t BufSize = 1024;
-    static char buf[BufSize];
+    return numberOfChars;
+}
 
-    size_t numberOfChars = (size_t) vsnprintf(buf, BufSize, format, args);
+ssize_t LogMessage(const LogLevel level, const char* format, ...)
+{
+    assert(format);
+
+    if (!LogLevelEnabled(level))
+        return 0;
+
+    va_list args = {};
 
+    va_start(args, format);
+    ssize_t numberOfChars = LogVPrint(format, args);
     va_end(args);
 
-    numberOfChars = Min(numberOfChars, BufSize);
-    
-    return write(LOG_FILE, buf, numberOfChars * sizeof(char));
+    return numberOfChars;
+}
+
+ssize_t LogText(const char* text, const size_t length)
+{
+    assert(text);
+
+    if (LOG_FILE == -1 || !LogLevelEnabled(LogLevel::DEBUG))
+        return 0;
+
+    LogPush(text, length);
+
+    return (ssize_t)length;
 }
 
 void LogEnd(const char* fileName, const char* funcName, const int line)
 {
+    if (LOG_FILE == -1 || !LogLevelEnabled(LogLevel::DEBUG))
+        return;
+
+    LogBacktrace("Functions calling stack on ending:\n");
+
+    time_t timeInSeconds = time(nullptr);
+    LogPrint("\n" HTML_GREEN_HEAD_BEGIN "\n"
+             "Logging ended %s"
+             "Ended in file: %s, function: %s, line: %d\n"
+             HTML_HEAD_END "\n\n"
+             "-----------------------\n\n\n",
+             ctime(&timeInSeconds), fileName, funcName, line);
+}
+
+//---------------------------------------------------------------------------------------
+
+static ssize_t LogPrint(const char* format, ...)
+{
+    assert(format);
+
+    va_list args = {};
+
+    va_start(args, format);
+    ssize_t numberOfChars = LogVPrint(format, args);
+    va_end(args);
+
+    return numberOfChars;
+}
+
+static ssize_t LogVPrint(const char* format, va_list args)
+{
+    assert(format);
+
+    if (LOG_FILE == -1)
+        return 0;
+
+    char buf[LogMessageMaxSize];
+
+    int numberOfChars = vsnprintf(buf, LogMessageMaxSize, format, args);
+
+    if (numberOfChars <= 0)
+        return 0;
+
+    size_t length = Min((size_t)numberOfChars, LogMessageMaxSize - 1);
+
+    LogPush(buf, length);
+
+    return (ssize_t)length;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void LogPush(const char* text, size_t length)
+{
+    assert(text);
+
+    LogRingType* ring = nullptr;
+    if (LogWriterRunning.load(std::memory_order_acquire))
+        ring = LogGetThreadRing();
+
+    if (ring == nullptr)
+    {
+        write(LOG_FILE, text, length * sizeof(char));
+        return;
+    }
+
+    while (length > 0)
+    {
+        size_t head = ring->head.load(std::memory_order_relaxed);
+        size_t freeSpace = LogRingCapacity - (head - ring->tail.load(std::memory_order_acquire));
+
+        //messages are not split unless they are longer than the ring,
+        //so the writer never interleaves parts of them with other threads' messages
+        size_t chunkSize = Min(length, LogRingCapacity);
+        if (freeSpace < chunkSize)
+        {
+            sched_yield();
+            continue;
+        }
+
+        size_t position  = head % LogRingCapacity;
+        size_t firstPart = Min(chunkSize, LogRingCapacity - position);
+
+        memcpy(ring->data + position, text, firstPart);
+        memcpy(ring->data, text + firstPart, chunkSize - firstPart);
+
+        ring->head.store(head + chunkSize, std::memory_order_release);
+
+        text   += chunkSize;
+        length -= chunkSize;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+
+static void LogBacktrace(const char* header)
+{
+    assert(header);
+
+    if (!LOG_BACKTRACE.load(std::memory_order_relaxed))
+        return;
+
     static const size_t buffSize = 128;
-    static void* buffer[buffSize];
+    void* buffer[buffSize];
     int numb = backtrace(buffer, buffSize);
-    
-    Log("Functions calling stack on ending:\n");
-    backtrace_symbols_fd(buffer, numb, LOG_FILE);
 
-    time_t timeInSeconds = time(nullptr);  
-    Log("\n" HTML_GREEN_HEAD_BEGIN "\n"                       
-        "Logging ended %s"                                    
-        "Ended in file: %s, function: %s, line: %d\n"         
-        HTML_HEAD_END "\n\n"                                  
-        "-----------------------\n\n\n",                      
-        ctime(&timeInSeconds), fileName, funcName, line);                                 
+    LogPrint("%s", header);
+
+    char** symbols = backtrace_symbols(buffer, numb);
+    if (symbols == nullptr)
+        return;
+
+    for (int i = 0; i < numb; ++i)
+        LogPrint("%s\n", symbols[i]);
+
+    free(symbols);
 }
 
+//---------------------------------------------------------------------------------------
+
+static LogRingType* LogGetThreadRing()
+{
+    if (LogThreadRing)
+        return LogThreadRing;
+
+    LogRingType* ring = (LogRingType*)calloc(1, sizeof(*ring));
+    if (ring == nullptr)
+        return nullptr;
+
+    ring->data = (char*)calloc(LogRingCapacity, sizeof(*ring->data));
+    if (ring->data == nullptr)
+    {
+        free(ring);
+        return nullptr;
+    }
+
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->tail.store(0, std::memory_order_relaxed);
+
+    //rings are never freed, writer thread may be reading them until exit
+    ring->next = LogRings.load(std::memory_order_relaxed);
+    while (!LogRings.compare_exchange_weak(ring->next, ring, std::memory_order_release,
+                                                             std::memory_order_relaxed))
+        ;
+
+    LogThreadRing = ring;
+    return ring;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void* LogWriterThread(void*)
+{
+    while (true)
+    {
+        bool stop = LogWriterStop.load(std::memory_order_acquire);
+
+        if (LogDrainRings() > 0)
+            continue;
+
+        if (stop)
+            break;
+
+        const timespec sleepTime = {0, LogWriterSleepTime};
+        nanosleep(&sleepTime, nullptr);
+    }
+
+    return nullptr;
+}
+
+static size_t LogDrainRings()
+{
+    size_t drained = 0;
+
+    for (LogRingType* ring = LogRings.load(std::memory_order_acquire); ring; ring = ring->next)
+    {
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t size = ring->head.load(std::memory_order_acquire) - tail;
+
+        if (size == 0)
+            continue;
+
+        size_t position  = tail % LogRingCapacity;
+        size_t firstPart = Min(size, LogRingCapacity - position);
+
+        iovec parts[2] = {{ring->data + position, firstPart}, {ring->data, size - firstPart}};
+
+        writev(LOG_FILE, parts, size == firstPart ? 1 : 2);
+
+        ring->tail.store(tail + size, std::memory_order_release);
+        drained += size;
+    }
+
+    return drained;
+}
+
+//---------------------------------------------------------------------------------------
+
 static inline void PrintSeparator()
 {
-    Log("\n\n---------------------------------------------------------------------------\n\n");
+    LogPrint("\n\n---------------------------------------------------------------------------\n\n");
 }
 
 static inline size_t Min(size_t a, size_t b)
@@ -144,6 +443,6 @@ static int TryOpenFile(const char* name)
         creat(fileName, 0666);
         LOG_FILE = open(fileName, O_WRONLY | O_APPEND);
     }
-    
+
     return LOG_FILE;
 }
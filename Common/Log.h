@@ -3,34 +3,101 @@
 
 #include <time.h>
 #include <stdio.h>
+#include <sys/types.h>
 
 #include "Colors.h"
 
-/// @brief Opens log file with name argv0
+#define LOG_LEVEL_DEBUG   0
+#define LOG_LEVEL_INFO    1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_ERROR   3
+
+/// @brief Messages with level less than LOG_MIN_LEVEL are removed at compile time
+#ifndef LOG_MIN_LEVEL
+    #ifdef _DEBUG
+        #define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+    #else
+        #define LOG_MIN_LEVEL LOG_LEVEL_INFO
+    #endif
+#endif
+
+/// @brief Log message levels
+enum class LogLevel
+{
+    DEBUG   = LOG_LEVEL_DEBUG,
+    INFO    = LOG_LEVEL_INFO,
+    WARNING = LOG_LEVEL_WARNING,
+    ERROR   = LOG_LEVEL_ERROR,
+};
+
+/// @brief Opens log file with name argv0 and starts background writer thread
+/// @details Messages are put in per-thread ring buffers and written to the file by the writer thread.
 /// @param [in]argv0 log file name (usually argv[0])
 void LogOpen(const char* argv0);
 
+/// @brief Sets run-time log level, messages with smaller level are skipped before formatting
+/// @param [in]level minimal level of messages to log
+void LogSetLevel(const LogLevel level);
+
+/// @brief Returns run-time log level
+/// @return minimal level of messages to log
+LogLevel LogGetLevel();
+
+/// @brief Turns on or off functions calling stack printing in LogBegin() and LogEnd(). Off by default
+/// @param [in]enabled true to print calling stack
+void LogSetBacktrace(const bool enabled);
+
+/// @brief Waits until all messages logged before the call are written to the file
+void LogFlush();
+
 /// @brief Begins new logging part
 /// @param [in]fileName file from which logging is called
 /// @param [in]funcName function from which logging is called
-/// @param [in]line line from which logging is called 
+/// @param [in]line line from which logging is called
 void LogBegin(const char* fileName, const char* funcName, const int line);
 
 /// @brief LogBegin with __FILE__, __func__, __LINE__
 #define LOG_BEGIN() LogBegin(__FILE__, __func__, __LINE__)
 
-/// @brief Prints string to log file
+/// @brief Prints string to log file with debug level
+/// @param [in]format string format as in printf
+/// @param [in]params as in printf
+/// @return number of chars put in log
+ssize_t Log(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+/// @brief Prints string to log file with given level
+/// @param [in]level message level
 /// @param [in]format string format as in printf
 /// @param [in]params as in printf
-ssize_t Log(const char* format, ...);
+/// @return number of chars put in log
+ssize_t LogMessage(const LogLevel level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+/// @brief Writes text to log file as is with debug level
+/// @param [in]text text to write, doesn't have to be '\0'-terminated
+/// @param [in]length number of chars to write
+/// @return number of chars put in log
+ssize_t LogText(const char* text, const size_t length);
 
 /// @brief Ends logging part
 /// @param [in]fileName file from which logging is called
 /// @param [in]funcName function from which logging is called
-/// @param [in]line line from which logging is called 
+/// @param [in]line line from which logging is called
 void LogEnd(const char* fileName, const char* funcName, const int line);
 
 /// @brief LogEnd with __FILE__, __func__, __LINE__
 #define LOG_END() LogEnd(__FILE__, __func__, __LINE__);
 
+/// @brief LogMessage that is removed at compile time if LEVEL is less than LOG_MIN_LEVEL
+#define LOG_MESSAGE(LEVEL, ...)                                 \
+do                                                              \
+{                                                               \
+    if ((int)(LEVEL) >= LOG_MIN_LEVEL)                          \
+        LogMessage((LEVEL), __VA_ARGS__);                       \
+} while (0)
+
+#define LOG_DEBUG(...)   LOG_MESSAGE(LogLevel::DEBUG,   __VA_ARGS__)
+#define LOG_INFO(...)    LOG_MESSAGE(LogLevel::INFO,    __VA_ARGS__)
+#define LOG_WARNING(...) LOG_MESSAGE(LogLevel::WARNING, __VA_ARGS__)
+#define LOG_ERROR(...)   LOG_MESSAGE(LogLevel::ERROR,   __VA_ARGS__)
+
 #endif
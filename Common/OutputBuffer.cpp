@@ -0,0 +1,229 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <charconv>
+
+#include "OutputBuffer.h"
+
+static const size_t OutputBufferMinCapacity = 256;
+static const size_t OutputBufferDoubleMaxLen = 32;
+
+static bool OutputBufferReserve(OutputBufferType* buffer, const size_t length);
+static void OutputBufferFlushIfFull(OutputBufferType* buffer);
+
+//---------------------------------------------------------------------------------------
+
+bool OutputBufferCtor(OutputBufferType* buffer, FILE* sink, size_t flushSize)
+{
+    assert(buffer);
+
+    buffer->data      = (char*)calloc(OutputBufferMinCapacity, sizeof(*buffer->data));
+    buffer->size      = 0;
+    buffer->capacity  = OutputBufferMinCapacity;
+
+    buffer->sink      = sink;
+    buffer->flushSize = sink == nullptr ? 0 : flushSize;
+    buffer->maxSize   = 0;
+
+    buffer->failed    = buffer->data == nullptr;
+
+    if (buffer->failed)
+        buffer->capacity = 0;
+
+    return !buffer->failed;
+}
+
+//---------------------------------------------------------------------------------------
+
+void OutputBufferDtor(OutputBufferType* buffer)
+{
+    assert(buffer);
+
+    free(buffer->data);
+
+    buffer->data     = nullptr;
+    buffer->size     = 0;
+    buffer->capacity = 0;
+    buffer->sink     = nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+
+bool OutputBufferFlush(OutputBufferType* buffer)
+{
+    assert(buffer);
+
+    if (buffer->sink != nullptr && buffer->size > 0 &&
+        fwrite(buffer->data, sizeof(*buffer->data), buffer->size, buffer->sink) != buffer->size)
+        buffer->failed = true;
+
+    OutputBufferClear(buffer);
+
+    return !buffer->failed;
+}
+
+//---------------------------------------------------------------------------------------
+
+void OutputBufferClear(OutputBufferType* buffer)
+{
+    assert(buffer);
+
+    buffer->size = 0;
+
+    if (buffer->data)
+        buffer->data[0] = '\0';
+}
+
+//---------------------------------------------------------------------------------------
+
+void OutputBufferPutChar(OutputBufferType* buffer, const char c)
+{
+    assert(buffer);
+
+    if (!OutputBufferReserve(buffer, 1))
+        return;
+
+    buffer->data[buffer->size++] = c;
+    buffer->data[buffer->size]   = '\0';
+
+    OutputBufferFlushIfFull(buffer);
+}
+
+//---------------------------------------------------------------------------------------
+
+void OutputBufferPutString(OutputBufferType* buffer, const char* string)
+{
+    assert(string);
+
+    OutputBufferPutString(buffer, string, strlen(string));
+}
+
+//---------------------------------------------------------------------------------------
+
+void OutputBufferPutString(OutputBufferType* buffer, const char* string, const size_t length)
+{
+    assert(buffer);
+    assert(string);
+
+    if (!OutputBufferReserve(buffer, length))
+        return;
+
+    memcpy(buffer->data + buffer->size, string, length);
+    buffer->size += length;
+    buffer->data[buffer->size] = '\0';
+
+    OutputBufferFlushIfFull(buffer);
+}
+
+//---------------------------------------------------------------------------------------
+
+void OutputBufferPutDouble(OutputBufferType* buffer, const double value, const int precision)
+{
+    assert(buffer);
+    assert(precision >= 0);
+
+    //number is made on the stack, so maxSize is checked with its real length
+    char  number[OutputBufferDoubleMaxLen] = {};
+    char* end = number + OutputBufferDoubleMaxLen;
+
+    std::to_chars_result result = precision == 0 ? 
+                                  std::to_chars(number, end, value) :
+                                  std::to_chars(number, end, value, std::chars_format::general, precision);
+
+    if (result.ec != std::errc())
+    {
+        buffer->failed = true;
+        return;
+    }
+
+    OutputBufferPutString(buffer, number, (size_t)(result.ptr - number));
+}
+
+//---------------------------------------------------------------------------------------
+
+void OutputBufferPrintf(OutputBufferType* buffer, const char* format, ...)
+{
+    assert(buffer);
+    assert(format);
+
+    if (buffer->failed)
+        return;
+
+    va_list args = {};
+
+    va_start(args, format);
+    int length = vsnprintf(buffer->data + buffer->size, buffer->capacity - buffer->size,
+                           format, args);
+    va_end(args);
+
+    if (length < 0 || (buffer->maxSize != 0 && buffer->size + (size_t)length > buffer->maxSize))
+    {
+        buffer->failed = true;
+        buffer->data[buffer->size] = '\0';
+        return;
+    }
+
+    if ((size_t)length >= buffer->capacity - buffer->size)
+    {
+        if (!OutputBufferReserve(buffer, (size_t)length))
+        {
+            buffer->data[buffer->size] = '\0';
+            return;
+        }
+
+        va_start(args, format);
+        vsnprintf(buffer->data + buffer->size, buffer->capacity - buffer->size, format, args);
+        va_end(args);
+    }
+
+    buffer->size += (size_t)length;
+
+    OutputBufferFlushIfFull(buffer);
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool OutputBufferReserve(OutputBufferType* buffer, const size_t length)
+{
+    assert(buffer);
+
+    if (buffer->failed)
+        return false;
+
+    if (buffer->maxSize != 0 && buffer->size + length > buffer->maxSize)
+    {
+        buffer->failed = true;
+        return false;
+    }
+
+    if (buffer->size + length < buffer->capacity)
+        return true;
+
+    size_t newCapacity = buffer->capacity * 2;
+    while (newCapacity <= buffer->size + length)
+        newCapacity *= 2;
+
+    char* newData = (char*)realloc(buffer->data, newCapacity * sizeof(*newData));
+
+    if (newData == nullptr)
+    {
+        buffer->failed = true;
+        return false;
+    }
+
+    buffer->data     = newData;
+    buffer->capacity = newCapacity;
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void OutputBufferFlushIfFull(OutputBufferType* buffer)
+{
+    assert(buffer);
+
+    if (buffer->flushSize != 0 && buffer->size >= buffer->flushSize)
+        OutputBufferFlush(buffer);
+}
@@ -0,0 +1,72 @@
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/// @brief Growable in-memory text buffer.
+/// @details Text is accumulated in memory and written to the sink with one fwrite
+/// on OutputBufferFlush() (or when the buffer reaches flushSize, if sink is not nullptr).
+struct OutputBufferType
+{
+    char*  data;            ///< buffer, always '\0'-terminated
+    size_t size;            ///< number of chars in buffer without '\0'
+    size_t capacity;
+
+    FILE*  sink;            ///< stream to flush to, nullptr for pure in-memory buffer
+    size_t flushSize;       ///< size on which buffer is flushed to sink automatically, 0 - never
+    size_t maxSize;         ///< appending beyond this size fails the buffer, 0 - unlimited
+
+    bool   failed;          ///< memory allocation, writing or appending beyond maxSize failed
+};
+
+/// @brief Constructor
+/// @param [out]buffer buffer to construct
+/// @param [in]sink stream to flush to, nullptr for pure in-memory buffer
+/// @param [in]flushSize size on which buffer is flushed automatically, 0 - only on OutputBufferFlush()
+/// @return false if memory allocation failed
+bool OutputBufferCtor(OutputBufferType* buffer, FILE* sink = nullptr, size_t flushSize = 0);
+
+/// @brief Destructor, doesn't flush
+/// @param [out]buffer buffer to destruct
+void OutputBufferDtor(OutputBufferType* buffer);
+
+/// @brief Writes buffer to the sink with one fwrite and empties it
+/// @param [in]buffer buffer to flush
+/// @return false if writing failed
+bool OutputBufferFlush(OutputBufferType* buffer);
+
+/// @brief Empties buffer without writing
+/// @param [in]buffer buffer to clear
+void OutputBufferClear(OutputBufferType* buffer);
+
+/// @brief Appends char to the buffer
+/// @param [in]buffer buffer
+/// @param [in]c char to append
+void OutputBufferPutChar(OutputBufferType* buffer, const char c);
+
+/// @brief Appends string to the buffer
+/// @param [in]buffer buffer
+/// @param [in]string string to append
+void OutputBufferPutString(OutputBufferType* buffer, const char* string);
+
+/// @brief Appends length chars of the string to the buffer
+/// @param [in]buffer buffer
+/// @param [in]string string to append
+/// @param [in]length number of chars to append
+void OutputBufferPutString(OutputBufferType* buffer, const char* string, const size_t length);
+
+/// @brief Appends double without printf machinery
+/// @param [in]buffer buffer
+/// @param [in]value value to append
+/// @param [in]precision number of significant digits as in "%.*lg", 0 - shortest round-trip representation
+void OutputBufferPutDouble(OutputBufferType* buffer, const double value, const int precision = 0);
+
+/// @brief Appends formatted string to the buffer
+/// @param [in]buffer buffer
+/// @param [in]format string format as in printf
+/// @param [in]params as in printf
+void OutputBufferPrintf(OutputBufferType* buffer, const char* format, ...)
+                                                  __attribute__((format(printf, 2, 3)));
+
+#endif
@@ -1,14 +1,42 @@
+#include <assert.h>
+
 #include "DSL.h"
+#include "MathExpressionSimplifyRules.h"
+
+static ExpressionTokenType* ExpressionTokenCreateFolded(const ExpressionOperationId operation,
+                                                        ExpressionTokenType* left,
+                                                        ExpressionTokenType* right);
 
 #define GENERATE_OPERATION_CMD(NAME, ...)                                                       \
     ExpressionTokenType* _##NAME(ExpressionTokenType* left,                                     \
                                     ExpressionTokenType* right)                                 \
     {                                                                                           \
-        return ExpressionTokenCreate(ExpressionTokenValueСreate(ExpressionOperationId::NAME),   \
-                                   ExpressionTokenValueTypeof::OPERATION,                       \
-                                   left, right);                                                \
+        return ExpressionTokenCreateFolded(ExpressionOperationId::NAME, left, right);           \
     }
 
 #include "Operations.h"
 
-#undef GENERATE_OPERATION_CMD 
+#undef GENERATE_OPERATION_CMD
+
+//---------------------------------------------------------------------------------------
+
+// Same rules as in ExpressionSimplify, but applied before the token is allocated,
+// so x * 0, 1 * u, u ^ 1, 2 - 1 and so on never get into the tree.
+static ExpressionTokenType* ExpressionTokenCreateFolded(const ExpressionOperationId operation,
+                                                        ExpressionTokenType* left,
+                                                        ExpressionTokenType* right)
+{
+    ExpressionSimplifyRuleResult rule = ExpressionSimplifyRuleFind(operation, left, right);
+
+    if (rule == ExpressionSimplifyRuleResult::NO_RULE)
+        return ExpressionTokenCreate(ExpressionTokenValueСreate(operation), OP_TYPE_CNST,
+                                     left, right);
+
+    ExpressionTokenType* foldedToken = ExpressionSimplifyRuleCreateToken(rule, operation,
+                                                                         left, right);
+    assert(foldedToken);
+
+    ExpressionSimplifyRuleDeleteUnused(rule, left, right);
+
+    return foldedToken;
+}
@@ -0,0 +1,75 @@
+#ifndef GENERATE_EGRAPH_RULE
+#define GENERATE_EGRAPH_RULE(...)
+#endif
+
+//GENERATE_EGRAPH_RULE(LEFT_PATTERN, RIGHT_PATTERN)
+
+//Patterns are written in prefix form with long operation names from Operations.h,
+//?a ... ?h are pattern variables, numbers match classes with the same constant value.
+//Rules are one-directional, equalities that should work both ways are written twice.
+//Right side has to be defined wherever the left one is, so identities true only for
+//positive arguments like ln(a^b) = b ln(a) are not allowed.
+
+//----------------------------Algebra-------------------------------
+
+GENERATE_EGRAPH_RULE("(add ?a ?b)",                     "(add ?b ?a)")
+GENERATE_EGRAPH_RULE("(mul ?a ?b)",                     "(mul ?b ?a)")
+GENERATE_EGRAPH_RULE("(add (add ?a ?b) ?c)",            "(add ?a (add ?b ?c))")
+GENERATE_EGRAPH_RULE("(add ?a (add ?b ?c))",            "(add (add ?a ?b) ?c)")
+GENERATE_EGRAPH_RULE("(mul (mul ?a ?b) ?c)",            "(mul ?a (mul ?b ?c))")
+GENERATE_EGRAPH_RULE("(mul ?a (mul ?b ?c))",            "(mul (mul ?a ?b) ?c)")
+
+GENERATE_EGRAPH_RULE("(add ?a 0)",                      "?a")
+GENERATE_EGRAPH_RULE("(sub ?a 0)",                      "?a")
+GENERATE_EGRAPH_RULE("(sub ?a ?a)",                     "0")
+GENERATE_EGRAPH_RULE("(mul ?a 1)",                      "?a")
+GENERATE_EGRAPH_RULE("(mul ?a 0)",                      "0")
+GENERATE_EGRAPH_RULE("(div ?a 1)",                      "?a")
+GENERATE_EGRAPH_RULE("(div 0 ?a)",                      "0")
+GENERATE_EGRAPH_RULE("(pow ?a 1)",                      "?a")
+GENERATE_EGRAPH_RULE("(pow ?a 0)",                      "1")
+GENERATE_EGRAPH_RULE("(pow 1 ?a)",                      "1")
+
+GENERATE_EGRAPH_RULE("(unary_sub ?a)",                  "(mul -1 ?a)")
+GENERATE_EGRAPH_RULE("(sub ?a ?b)",                     "(add ?a (mul -1 ?b))")
+GENERATE_EGRAPH_RULE("(add ?a (mul -1 ?b))",            "(sub ?a ?b)")
+GENERATE_EGRAPH_RULE("(div ?a ?b)",                     "(mul ?a (pow ?b -1))")
+GENERATE_EGRAPH_RULE("(mul ?a (pow ?b -1))",            "(div ?a ?b)")
+
+GENERATE_EGRAPH_RULE("(add ?a ?a)",                     "(mul 2 ?a)")
+GENERATE_EGRAPH_RULE("(add (mul ?b ?a) ?a)",            "(mul (add ?b 1) ?a)")
+GENERATE_EGRAPH_RULE("(add (mul ?b ?a) (mul ?c ?a))",   "(mul (add ?b ?c) ?a)")
+GENERATE_EGRAPH_RULE("(mul ?a (add ?b ?c))",            "(add (mul ?a ?b) (mul ?a ?c))")
+
+GENERATE_EGRAPH_RULE("(mul ?a ?a)",                     "(pow ?a 2)")
+GENERATE_EGRAPH_RULE("(pow ?a 2)",                      "(mul ?a ?a)")
+GENERATE_EGRAPH_RULE("(mul (pow ?a ?b) ?a)",            "(pow ?a (add ?b 1))")
+GENERATE_EGRAPH_RULE("(mul (pow ?a ?b) (pow ?a ?c))",   "(pow ?a (add ?b ?c))")
+
+GENERATE_EGRAPH_RULE("(mul ?a (div ?b ?c))",            "(div (mul ?a ?b) ?c)")
+GENERATE_EGRAPH_RULE("(div ?a (div ?b ?c))",            "(div (mul ?a ?c) ?b)")
+GENERATE_EGRAPH_RULE("(div (div ?a ?b) ?c)",            "(div ?a (mul ?b ?c))")
+
+//-----------------------------Logarithms--------------------------------
+
+GENERATE_EGRAPH_RULE("(log ?a ?b)",                     "(div (ln ?b) (ln ?a))")
+GENERATE_EGRAPH_RULE("(div (ln ?b) (ln ?a))",           "(log ?a ?b)")
+
+//-----------------------------Trigonometry------------------------------
+
+GENERATE_EGRAPH_RULE("(add (pow (sin ?a) 2) (pow (cos ?a) 2))", "1")
+GENERATE_EGRAPH_RULE("(sub 1 (pow (sin ?a) 2))",        "(pow (cos ?a) 2)")
+GENERATE_EGRAPH_RULE("(sub 1 (pow (cos ?a) 2))",        "(pow (sin ?a) 2)")
+GENERATE_EGRAPH_RULE("(add 1 (pow (tan ?a) 2))",        "(div 1 (pow (cos ?a) 2))")
+GENERATE_EGRAPH_RULE("(add 1 (pow (cot ?a) 2))",        "(div 1 (pow (sin ?a) 2))")
+
+GENERATE_EGRAPH_RULE("(div (sin ?a) (cos ?a))",         "(tan ?a)")
+GENERATE_EGRAPH_RULE("(div (cos ?a) (sin ?a))",         "(cot ?a)")
+GENERATE_EGRAPH_RULE("(div 1 (tan ?a))",                "(cot ?a)")
+GENERATE_EGRAPH_RULE("(div 1 (cot ?a))",                "(tan ?a)")
+GENERATE_EGRAPH_RULE("(mul (tan ?a) (cos ?a))",         "(sin ?a)")
+GENERATE_EGRAPH_RULE("(mul (cot ?a) (sin ?a))",         "(cos ?a)")
+GENERATE_EGRAPH_RULE("(mul (sin ?a) (cos ?a))",         "(div (sin (mul 2 ?a)) 2)")
+
+GENERATE_EGRAPH_RULE("(sin (mul -1 ?a))",               "(mul -1 (sin ?a))")
+GENERATE_EGRAPH_RULE("(cos (mul -1 ?a))",               "(cos ?a)")
@@ -0,0 +1,810 @@
+#include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "MathExpressionCache.h"
+#include "MathExpressionInOut.h"
+#include "Vector/HashFuncs.h"
+#include "MathExpressionTokensStack.h"
+
+//---------------------------------------------------------------------------------------
+
+// Every cache entry is one file <hash>.expr in the cache dir. File contains the key 
+// (operation header + canonical prefix form of the input tree) followed by the result 
+// tree in the same prefix form and terminating '\0'. In the canonical form operands of 
+// sums and products are ordered by the hashes of their subtrees, so x + y + z and z + y + x
+// share the entry. Key is compared on load, so hash collisions are harmless. Writers create temporary file and rename() it, so readers 
+// never see partially written entries.
+// Results depend on the rules of the build, so the key starts with the cache version and
+// the hash of the operations table: entries made by other builds are never found.
+// The directory is scanned for eviction only when the size counted from the stores of this 
+// process exceeds the limit, the scan finds the real size with the entries of other processes.
+
+struct ExpressionCacheType
+{
+    char*  cacheDir;
+    size_t maxCacheSize;
+
+    size_t cacheSize;
+    bool   isCacheSizeKnown;
+};
+
+static ExpressionCacheType CACHE = {};
+
+// hash of the canonical form of the subtree and its nodes count, kept in post-order;
+// for sums and products operandsSum is the sum of the hashes of the whole chain operands
+struct ExpressionCacheSubtreeType
+{
+    HashType hash;
+    HashType operandsSum;
+    size_t   size;
+};
+
+typedef VectorType<ExpressionCacheSubtreeType> ExpressionCacheSubtreesType;
+
+struct ExpressionCacheOperandType
+{
+    const ExpressionTokenType* token;
+    size_t   subtreeEnd;
+    HashType hash;
+};
+
+struct ExpressionCacheFileType
+{
+    char*  fileName;
+    size_t size;
+    time_t lastUseTime;
+};
+
+static const char*  CacheFileSuffix       = ".expr";
+static const char*  CacheTmpFileMark      = ".tmp.";
+static const time_t CacheTmpFileLifeTime  = 10 * 60;
+
+// must be increased after changes of simplification rules or of the entry format
+static const int    CacheVersion          = 2;
+
+static char* ExpressionCacheCreateKey(const ExpressionType* expression,
+                                      const ExpressionCacheOperation operation,
+                                      const int n, const double x,
+                                      size_t* keyLength);
+static char* ExpressionCacheCreateFileName(const char* key, const size_t keyLength);
+static char* ExpressionCacheCreatePath(const char* format, ...) 
+                                                        __attribute__((format(printf, 1, 2)));
+
+static void  ExpressionCacheSerialize(const ExpressionTokenType* token, FILE* outStream);
+static void  ExpressionCacheSerializeValue(const ExpressionTokenType* token, FILE* outStream);
+static void  ExpressionCacheSerializeCanonical(const ExpressionTokenType* token,
+                                               const ExpressionCacheSubtreesType* subtrees,
+                                               const size_t subtreeEnd, FILE* outStream,
+                                               bool* failed);
+static void  ExpressionCacheHashSubtrees(const ExpressionTokenType* token,
+                                         ExpressionCacheSubtreesType* subtrees,
+                                         bool* failed);
+static void  ExpressionCacheHashToken(const ExpressionTokenType* token,
+                                      ExpressionCacheSubtreesType* subtrees,
+                                      const size_t subtreeStart, const size_t leftEnd,
+                                      bool* failed);
+static bool  ExpressionCacheIsCommutative(const ExpressionTokenType* token);
+static int   ExpressionCacheOperandsCmp(const void* a, const void* b);
+static const char* ExpressionCacheGetOperationName(const ExpressionCacheOperation operation);
+static HashType    ExpressionCacheGetRulesHash();
+
+static void  ExpressionCacheEvict();
+static int   ExpressionCacheFilesCmp(const void* a, const void* b);
+static bool  StringHasSuffix(const char* string, const char* suffix);
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionCacheOpen(const char* cacheDir, const size_t maxCacheSize)
+{
+    assert(cacheDir);
+
+    ExpressionCacheClose();
+
+    if (mkdir(cacheDir, 0755) != 0 && errno != EEXIST)
+        return ExpressionErrors::CACHE_ERR;
+
+    CACHE.cacheDir     = strdup(cacheDir);
+    CACHE.maxCacheSize = maxCacheSize;
+
+    if (CACHE.cacheDir == nullptr)
+        return ExpressionErrors::MEM_ERR;
+
+    return ExpressionErrors::NO_ERR;
+}
+
+void ExpressionCacheClose()
+{
+    free(CACHE.cacheDir);
+
+    CACHE.cacheDir         = nullptr;
+    CACHE.maxCacheSize     = 0;
+    CACHE.cacheSize        = 0;
+    CACHE.isCacheSizeKnown = false;
+}
+
+//---------------------------------------------------------------------------------------
+
+bool ExpressionCacheLoad(const ExpressionType* expression,
+                         const ExpressionCacheOperation operation,
+                         const int n, const double x,
+                         ExpressionType* result)
+{
+    assert(expression);
+    assert(result);
+
+    if (CACHE.cacheDir == nullptr)
+        return false;
+
+    size_t keyLength = 0;
+    char* key = ExpressionCacheCreateKey(expression, operation, n, x, &keyLength);
+
+    if (key == nullptr)
+        return false;
+
+    char* fileName = ExpressionCacheCreateFileName(key, keyLength);
+    bool  loaded   = false;
+
+    bool  broken   = false;
+
+    int fileDescriptor = fileName ? open(fileName, O_RDONLY) : -1;
+
+    if (fileDescriptor != -1)
+    {
+        struct stat fileStats = {};
+
+        if (fstat(fileDescriptor, &fileStats) == 0 && (size_t)fileStats.st_size > keyLength)
+        {
+            const size_t fileSize = (size_t)fileStats.st_size;
+            void* mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+
+            if (mapping != MAP_FAILED)
+            {
+                const char* data = (const char*)mapping;
+
+                if (data[fileSize - 1] == '\0' && memcmp(data, key, keyLength) == 0)
+                {
+                    ExpressionCtor(result);
+                    ExpressionCopyVariables(result, expression);
+
+                    loaded = ExpressionReadPrefixFormat(result, data + keyLength) == 
+                                                                   ExpressionErrors::NO_ERR;
+
+                    if (!loaded)
+                    {
+                        ExpressionDtor(result);
+                        broken = true;
+                    }
+                }
+
+                munmap(mapping, fileSize);
+            }
+        }
+
+        close(fileDescriptor);
+
+        // updating last use time for eviction
+        if (loaded)
+            utimensat(AT_FDCWD, fileName, nullptr, 0);
+
+        // damaged entry would be read again and again otherwise, it's computed and stored anew
+        if (broken)
+            unlink(fileName);
+    }
+
+    free(fileName);
+    free(key);
+
+    return loaded;
+}
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionCacheStore(const ExpressionType* expression,
+                                      const ExpressionCacheOperation operation,
+                                      const int n, const double x,
+                                      const ExpressionType* result)
+{
+    assert(expression);
+    assert(result);
+
+    if (CACHE.cacheDir == nullptr)
+        return ExpressionErrors::NO_ERR;
+
+    size_t keyLength = 0;
+    char* key = ExpressionCacheCreateKey(expression, operation, n, x, &keyLength);
+
+    if (key == nullptr)
+        return ExpressionErrors::MEM_ERR;
+
+    char* fileName = ExpressionCacheCreateFileName(key, keyLength);
+
+    if (fileName == nullptr)
+    {
+        free(key);
+        return ExpressionErrors::MEM_ERR;
+    }
+
+    static unsigned long long tmpFileIndex = 0;
+
+    char* tmpFileName = ExpressionCacheCreatePath("%s%s%ld.%llu", fileName, CacheTmpFileMark,
+                                                          (long)getpid(), tmpFileIndex++);
+    if (tmpFileName == nullptr)
+    {
+        free(fileName);
+        free(key);
+        return ExpressionErrors::MEM_ERR;
+    }
+
+    ExpressionErrors err = ExpressionErrors::NO_ERR;
+    long fileSize = 0;
+    FILE* outStream = fopen(tmpFileName, "w");
+
+    if (outStream == nullptr)
+        err = ExpressionErrors::CACHE_ERR;
+    else
+    {
+        fwrite(key, sizeof(*key), keyLength, outStream);
+        ExpressionCacheSerialize(result->root, outStream);
+        fputc('\0', outStream);
+
+        fileSize = ftell(outStream);
+        bool writeFailed = ferror(outStream) || fileSize < 0;
+
+        if (fclose(outStream) != 0 || writeFailed || rename(tmpFileName, fileName) != 0)
+        {
+            unlink(tmpFileName);
+            err = ExpressionErrors::CACHE_ERR;
+        }
+    }
+
+    free(tmpFileName);
+    free(fileName);
+    free(key);
+
+    if (err != ExpressionErrors::NO_ERR)
+        return err;
+
+    // replaced entry is counted twice, it is fixed by the next scan
+    CACHE.cacheSize += (size_t)fileSize;
+
+    if (!CACHE.isCacheSizeKnown || CACHE.cacheSize > CACHE.maxCacheSize)
+        ExpressionCacheEvict();
+
+    return err;
+}
+
+//---------------------------------------------------------------------------------------
+
+static char* ExpressionCacheCreateKey(const ExpressionType* expression,
+                                      const ExpressionCacheOperation operation,
+                                      const int n, const double x,
+                                      size_t* keyLength)
+{
+    assert(expression);
+    assert(keyLength);
+
+    ExpressionCacheSubtreesType subtrees = {};
+    VectorCtor(&subtrees);
+
+    bool failed = false;
+    ExpressionCacheHashSubtrees(expression->root, &subtrees, &failed);
+
+    char* key = nullptr;
+    FILE* keyStream = failed ? nullptr : open_memstream(&key, keyLength);
+
+    if (keyStream == nullptr)
+    {
+        VectorDtor(&subtrees);
+        return nullptr;
+    }
+
+    fprintf(keyStream, "v%d %016llx\n", CacheVersion, 
+                                        (unsigned long long)ExpressionCacheGetRulesHash());
+    fprintf(keyStream, "%s %d %.17lg\n", ExpressionCacheGetOperationName(operation), n, x);
+    ExpressionCacheSerializeCanonical(expression->root, &subtrees, subtrees.size, keyStream,
+                                                                                  &failed);
+    fprintf(keyStream, "\n");
+
+    fclose(keyStream);
+
+    VectorDtor(&subtrees);
+
+    if (failed)
+    {
+        free(key);
+        return nullptr;
+    }
+
+    return key;
+}
+
+static char* ExpressionCacheCreateFileName(const char* key, const size_t keyLength)
+{
+    assert(key);
+
+    HashType hash = MurmurHash(key, keyLength);
+
+    return ExpressionCacheCreatePath("%s/%016llx%s", CACHE.cacheDir, 
+                                     (unsigned long long)hash, CacheFileSuffix);
+}
+
+// path is allocated with its exact length, so long cache dirs are never cut
+static char* ExpressionCacheCreatePath(const char* format, ...)
+{
+    assert(format);
+
+    va_list args;
+
+    va_start(args, format);
+    int length = vsnprintf(nullptr, 0, format, args);
+    va_end(args);
+
+    if (length < 0)
+        return nullptr;
+
+    char* path = (char*)calloc((size_t)length + 1, sizeof(*path));
+    if (path == nullptr)
+        return nullptr;
+
+    va_start(args, format);
+    int printed = vsnprintf(path, (size_t)length + 1, format, args);
+    va_end(args);
+
+    if (printed != length)
+    {
+        free(path);
+        return nullptr;
+    }
+
+    return path;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void ExpressionCacheSerialize(const ExpressionTokenType* token, FILE* outStream)
+{
+    assert(outStream);
+
+    if (token == nullptr)
+    {
+        fprintf(outStream, "nil ");
+        return;
+    }
+
+    fprintf(outStream, "(");
+
+    ExpressionCacheSerializeValue(token, outStream);
+
+    ExpressionCacheSerialize(token->left,  outStream);
+    ExpressionCacheSerialize(token->right, outStream);
+
+    fprintf(outStream, ")");
+}
+
+// subtreeEnd - index after the token in the post-order subtrees array
+// failed is set if some operands could not be collected, the key is not usable then
+static void ExpressionCacheSerializeCanonical(const ExpressionTokenType* token,
+                                              const ExpressionCacheSubtreesType* subtrees,
+                                              const size_t subtreeEnd, FILE* outStream,
+                                              bool* failed)
+{
+    assert(subtrees);
+    assert(outStream);
+    assert(failed);
+
+    if (token == nullptr)
+    {
+        fprintf(outStream, "nil ");
+        return;
+    }
+
+    assert(subtreeEnd > 0);
+
+    size_t rightEnd = subtreeEnd - 1;
+    size_t leftEnd  = rightEnd - (token->right ? subtrees->data[rightEnd - 1].size : 0);
+
+    if (!ExpressionCacheIsCommutative(token))
+    {
+        fprintf(outStream, "(");
+
+        ExpressionCacheSerializeValue(token, outStream);
+
+        ExpressionCacheSerializeCanonical(token->left,  subtrees, leftEnd,  outStream, failed);
+        ExpressionCacheSerializeCanonical(token->right, subtrees, rightEnd, outStream, failed);
+
+        fprintf(outStream, ")");
+
+        return;
+    }
+
+    // chain a + (b + c) + d is written as ((a + b) + c) + d with operands sorted by hashes
+    VectorType<ExpressionCacheOperandType> operands = {};
+    VectorCtor(&operands);
+
+    VectorType<ExpressionCacheOperandType, TOKENS_STACK_INLINE_CAPACITY> stack = {};
+    VectorCtor(&stack);
+
+    if (VectorPush(&stack, ExpressionCacheOperandType{token->right, rightEnd, 0}) != 
+                                                                VectorErrors::VECTOR_NO_ERR ||
+        VectorPush(&stack, ExpressionCacheOperandType{token->left,  leftEnd,  0}) !=
+                                                                VectorErrors::VECTOR_NO_ERR)
+        *failed = true;
+
+    while (!VectorIsEmpty(&stack) && !*failed)
+    {
+        ExpressionCacheOperandType operand = TokensStackPop(&stack);
+        const ExpressionTokenType* son     = operand.token;
+
+        if (ExpressionCacheIsCommutative(son) && 
+            son->value.operation == token->value.operation)
+        {
+            size_t sonRightEnd = operand.subtreeEnd - 1;
+            size_t sonLeftEnd  = sonRightEnd - subtrees->data[sonRightEnd - 1].size;
+
+            if (VectorPush(&stack, ExpressionCacheOperandType{son->right, sonRightEnd, 0}) != 
+                                                                VectorErrors::VECTOR_NO_ERR ||
+                VectorPush(&stack, ExpressionCacheOperandType{son->left,  sonLeftEnd,  0}) !=
+                                                                VectorErrors::VECTOR_NO_ERR)
+                *failed = true;
+
+            continue;
+        }
+
+        operand.hash = subtrees->data[operand.subtreeEnd - 1].hash;
+
+        if (VectorPush(&operands, operand) != VectorErrors::VECTOR_NO_ERR)
+            *failed = true;
+    }
+
+    qsort(operands.data, operands.size, sizeof(*operands.data), ExpressionCacheOperandsCmp);
+
+    for (size_t i = 1; i < operands.size; ++i)
+    {
+        fprintf(outStream, "(");
+        ExpressionCacheSerializeValue(token, outStream);
+    }
+
+    for (size_t i = 0; i < operands.size; ++i)
+    {
+        ExpressionCacheSerializeCanonical(operands.data[i].token, subtrees,
+                                          operands.data[i].subtreeEnd, outStream, failed);
+        if (i > 0)
+            fprintf(outStream, ")");
+    }
+
+    VectorDtor(&stack);
+    VectorDtor(&operands);
+}
+
+static void ExpressionCacheSerializeValue(const ExpressionTokenType* token, FILE* outStream)
+{
+    assert(token);
+    assert(outStream);
+
+    switch (token->valueType)
+    {
+        case ExpressionTokenValueTypeof::VALUE:
+            fprintf(outStream, "%.17lg ", token->value.value);
+            break;
+
+        case ExpressionTokenValueTypeof::VARIABLE:
+            fprintf(outStream, "%s ", token->value.varPtr->variableName);
+            break;
+
+        case ExpressionTokenValueTypeof::OPERATION:
+            fprintf(outStream, "%s ", ExpressionOperationGetLongName(token->value.operation));
+            break;
+
+        default:
+            break;
+    }
+}
+
+// pushes the subtrees of the token in post-order
+static void ExpressionCacheHashSubtrees(const ExpressionTokenType* token,
+                                        ExpressionCacheSubtreesType* subtrees,
+                                        bool* failed)
+{
+    assert(subtrees);
+    assert(failed);
+
+    if (token == nullptr)
+        return;
+
+    // stage - how many sons of the token are already hashed
+    struct HashFrameType
+    {
+        const ExpressionTokenType* token;
+        int    stage;
+        size_t subtreeStart;
+        size_t leftEnd;
+    };
+
+    TokensStackType<HashFrameType> stack;
+    VectorCtor(&stack);
+
+    if (VectorPush(&stack, HashFrameType{token, 0, subtrees->size, 0}) != 
+                                                                VectorErrors::VECTOR_NO_ERR)
+        *failed = true;
+
+    while (!VectorIsEmpty(&stack) && !*failed)
+    {
+        HashFrameType* frame = TokensStackTop(&stack);
+
+        if (frame->stage < 2)
+        {
+            const ExpressionTokenType* son = frame->stage == 0 ? frame->token->left : 
+                                                                 frame->token->right;
+            if (frame->stage == 1)
+                frame->leftEnd = subtrees->size;
+
+            frame->stage++;
+
+            if (son != nullptr && 
+                VectorPush(&stack, HashFrameType{son, 0, subtrees->size, 0}) != 
+                                                                VectorErrors::VECTOR_NO_ERR)
+                *failed = true;
+
+            continue;
+        }
+
+        HashFrameType done = TokensStackPop(&stack);
+
+        ExpressionCacheHashToken(done.token, subtrees, done.subtreeStart, done.leftEnd, failed);
+    }
+
+    VectorDtor(&stack);
+}
+
+// sons of the token are the last pushed subtrees, left one ends at leftEnd
+static void ExpressionCacheHashToken(const ExpressionTokenType* token,
+                                     ExpressionCacheSubtreesType* subtrees,
+                                     const size_t subtreeStart, const size_t leftEnd,
+                                     bool* failed)
+{
+    assert(token);
+    assert(subtrees);
+    assert(failed);
+
+    size_t rightEnd = subtrees->size;
+
+    // value type, value hash and hashes of the sons
+    HashType data[4] = {(HashType)token->valueType, 0,
+                        token->left  ? subtrees->data[leftEnd  - 1].hash : 0,
+                        token->right ? subtrees->data[rightEnd - 1].hash : 0};
+
+    HashType operandsSum = 0;
+
+    switch (token->valueType)
+    {
+        case ExpressionTokenValueTypeof::VALUE:
+            data[1] = MurmurHash(&token->value.value, sizeof(token->value.value));
+            break;
+
+        case ExpressionTokenValueTypeof::VARIABLE:
+            data[1] = MurmurHash(token->value.varPtr->variableName, 
+                                 strlen(token->value.varPtr->variableName));
+            break;
+
+        case ExpressionTokenValueTypeof::OPERATION:
+            data[1] = (HashType)token->value.operation;
+            break;
+
+        default:
+            break;
+    }
+
+    // sum of the operands hashes doesn't depend on their order and grouping in the chain
+    if (ExpressionCacheIsCommutative(token))
+    {
+        const ExpressionTokenType* sons[2] = {token->left, token->right};
+        const size_t           sonsEnds[2] = {leftEnd, rightEnd};
+
+        for (size_t i = 0; i < 2; ++i)
+        {
+            const ExpressionCacheSubtreeType* son = &subtrees->data[sonsEnds[i] - 1];
+
+            if (ExpressionCacheIsCommutative(sons[i]) &&
+                sons[i]->value.operation == token->value.operation)
+                operandsSum += son->operandsSum;
+            else
+                operandsSum += son->hash;
+        }
+
+        data[2] = operandsSum;
+        data[3] = 0;
+    }
+
+    HashType hash = MurmurHash(data, sizeof(data));
+
+    if (VectorPush(subtrees, ExpressionCacheSubtreeType{hash, operandsSum, 
+                                            subtrees->size - subtreeStart + 1}) != 
+                                                                VectorErrors::VECTOR_NO_ERR)
+        *failed = true;
+}
+
+static bool ExpressionCacheIsCommutative(const ExpressionTokenType* token)
+{
+    return token && token->valueType == ExpressionTokenValueTypeof::OPERATION &&
+           token->left && token->right &&
+           (token->value.operation == ExpressionOperationId::ADD ||
+            token->value.operation == ExpressionOperationId::MUL);
+}
+
+static int ExpressionCacheOperandsCmp(const void* a, const void* b)
+{
+    assert(a);
+    assert(b);
+
+    const ExpressionCacheOperandType* operand1 = (const ExpressionCacheOperandType*)a;
+    const ExpressionCacheOperandType* operand2 = (const ExpressionCacheOperandType*)b;
+
+    if (operand1->hash < operand2->hash) return -1;
+    if (operand1->hash > operand2->hash) return  1;
+
+    return 0;
+}
+
+static const char* ExpressionCacheGetOperationName(const ExpressionCacheOperation operation)
+{
+    switch (operation)
+    {
+        case ExpressionCacheOperation::DIFFERENTIATE:
+            return "DIFFERENTIATE";
+        case ExpressionCacheOperation::TAYLOR:
+            return "TAYLOR";
+
+        default:
+            break;
+    }
+
+    return "UNKNOWN";
+}
+
+static HashType ExpressionCacheGetRulesHash()
+{
+    #define GENERATE_OPERATION_CMD(NAME, v1, v2, v3, v4, v5, v6, v7, CALC_CODE, DIFF_CODE, ...) \
+        #NAME #CALC_CODE #DIFF_CODE
+
+    static const char rules[] = 
+    #include "Operations.h"
+    ;
+
+    #undef GENERATE_OPERATION_CMD
+
+    static const HashType rulesHash = MurmurHash(rules, sizeof(rules) - 1);
+
+    return rulesHash;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void ExpressionCacheEvict()
+{
+    DIR* dir = opendir(CACHE.cacheDir);
+
+    if (dir == nullptr)
+        return;
+
+    size_t filesCapacity = 64;
+    size_t filesCount    = 0;
+    ExpressionCacheFileType* files = (ExpressionCacheFileType*)calloc(filesCapacity, 
+                                                                      sizeof(*files));
+
+    size_t cacheSize = 0;
+    time_t curTime   = time(nullptr);
+
+    struct dirent* dirEntry = nullptr;
+    while (files && (dirEntry = readdir(dir)) != nullptr)
+    {
+        bool isCacheFile = StringHasSuffix(dirEntry->d_name, CacheFileSuffix);
+        bool isTmpFile   = strstr(dirEntry->d_name, CacheTmpFileMark) != nullptr;
+
+        if (!isCacheFile && !isTmpFile)
+            continue;
+
+        char* fileName = ExpressionCacheCreatePath("%s/%s", CACHE.cacheDir, dirEntry->d_name);
+        if (fileName == nullptr)
+            continue;
+
+        struct stat fileStats = {};
+        if (stat(fileName, &fileStats) != 0)
+        {
+            free(fileName);
+            continue;
+        }
+
+        // temporary files left by crashed writers
+        if (isTmpFile)
+        {
+            if (curTime - fileStats.st_mtime > CacheTmpFileLifeTime)
+                unlink(fileName);
+
+            free(fileName);
+            continue;
+        }
+
+        if (filesCount >= filesCapacity)
+        {
+            filesCapacity *= 2;
+            ExpressionCacheFileType* tmp = (ExpressionCacheFileType*)realloc(files, 
+                                                         filesCapacity * sizeof(*files));
+            if (tmp == nullptr)
+            {
+                free(fileName);
+                break;
+            }
+
+            files = tmp;
+        }
+
+        files[filesCount].fileName    = fileName;
+        files[filesCount].size        = (size_t)fileStats.st_size;
+        files[filesCount].lastUseTime = fileStats.st_mtime;
+
+        cacheSize += files[filesCount].size;
+        filesCount++;
+    }
+
+    closedir(dir);
+
+    if (files == nullptr)
+        return;
+
+    if (cacheSize > CACHE.maxCacheSize)
+    {
+        qsort(files, filesCount, sizeof(*files), ExpressionCacheFilesCmp);
+
+        for (size_t i = 0; i < filesCount && cacheSize > CACHE.maxCacheSize; ++i)
+        {
+            // someone else could have already removed it
+            if (files[i].fileName && unlink(files[i].fileName) != 0 && errno != ENOENT)
+                continue;
+
+            cacheSize -= files[i].size;
+        }
+    }
+
+    CACHE.cacheSize        = cacheSize;
+    CACHE.isCacheSizeKnown = true;
+
+    for (size_t i = 0; i < filesCount; ++i)
+        free(files[i].fileName);
+
+    free(files);
+}
+
+static int ExpressionCacheFilesCmp(const void* a, const void* b)
+{
+    assert(a);
+    assert(b);
+
+    const ExpressionCacheFileType* file1 = (const ExpressionCacheFileType*)a;
+    const ExpressionCacheFileType* file2 = (const ExpressionCacheFileType*)b;
+
+    if (file1->lastUseTime < file2->lastUseTime) return -1;
+    if (file1->lastUseTime > file2->lastUseTime) return  1;
+
+    return 0;
+}
+
+static bool StringHasSuffix(const char* string, const char* suffix)
+{
+    assert(string);
+    assert(suffix);
+
+    size_t stringLength = strlen(string);
+    size_t suffixLength = strlen(suffix);
+
+    return stringLength >= suffixLength && 
+           strcmp(string + stringLength - suffixLength, suffix) == 0;
+}
@@ -0,0 +1,26 @@
+#ifndef MATH_EXPRESSION_CACHE_H
+#define MATH_EXPRESSION_CACHE_H
+
+#include "MathExpressionsMain.h"
+
+enum class ExpressionCacheOperation
+{
+    DIFFERENTIATE,
+    TAYLOR,
+};
+
+ExpressionErrors ExpressionCacheOpen(const char* cacheDir, 
+                                     const size_t maxCacheSize = 64 * 1024 * 1024);
+void             ExpressionCacheClose();
+
+bool             ExpressionCacheLoad (const ExpressionType* expression,
+                                      const ExpressionCacheOperation operation,
+                                      const int n, const double x,
+                                      ExpressionType* result);
+
+ExpressionErrors ExpressionCacheStore(const ExpressionType* expression,
+                                      const ExpressionCacheOperation operation,
+                                      const int n, const double x,
+                                      const ExpressionType* result);
+
+#endif
@@ -5,6 +5,10 @@
 #include "MathExpressionInOut.h"
 #include "Common/DoubleFuncs.h"
 #include "MathExpressionTexDump.h"
+#include "MathExpressionCache.h"
+#include "MathExpressionSimplifyRules.h"
+#include "MathExpressionPolynomial.h"
+#include "MathExpressionTokensStack.h"
 
 #include "DSL.h"
 
@@ -12,74 +16,47 @@
 
 static double ExpressionCalculate(const ExpressionTokenType* token);
 
-static double CalculateUsingOperation(const ExpressionOperationId operation, 
-                                      const double val1, const double val2 = NAN);
-
 
 //--------------------DSL-----------------------------
 
-#define D(TOKEN) ExpressionDifferentiate(TOKEN, outTex, arr)
+#define D(TOKEN) ExpressionDiffTakeSon(token, TOKEN, leftDiff, rightDiff)
 
 //-------------------Differentiate---------------
 
+static const char* const DIFF_STEP_STRING = "Let's take the derivative of: ";
+
 static ExpressionTokenType* ExpressionDifferentiate(const ExpressionTokenType* token,
                                                     FILE* outTex, 
                                                     LatexReplacementArrType* arr);
-static ExpressionTokenType* ExpressionDiffOperation(const ExpressionTokenType* token,
+static ExpressionTokenType* ExpressionDiffLeaf     (const ExpressionTokenType* token,
                                                     FILE* outTex, 
                                                     LatexReplacementArrType* arr);
+static ExpressionTokenType* ExpressionDiffOperation(const ExpressionTokenType* token,
+                                                    ExpressionTokenType** leftDiff,
+                                                    ExpressionTokenType** rightDiff);
+
+static bool ExpressionDiffNeedSon(const ExpressionTokenType* token, 
+                                  const ExpressionTokenType* son);
+static inline ExpressionTokenType* ExpressionDiffTakeSon(const ExpressionTokenType* token,
+                                                         const ExpressionTokenType* son,
+                                                         ExpressionTokenType** leftDiff,
+                                                         ExpressionTokenType** rightDiff);
 
 //--------------------------------Simplify-------------------------------------------
 
-static ExpressionTokenType* ExpressionSimplifyConstants (ExpressionTokenType* token,
-                                                         int* simplifiesCount,
-                                                         bool* haveVariables,
-                                                         FILE* outTex,
-                                                         LatexReplacementArrType* arr);
-
-static ExpressionTokenType* ExpressionSimplifyNeutralTokens(ExpressionTokenType* token, 
-                                                            int* simplifiesCount,
-                                                            FILE* outTex,
-                                                            LatexReplacementArrType* arr);
-
-static inline ExpressionTokenType* ExpressionSimplifyAdd(ExpressionTokenType* token,   
-                                                         int* simplifiesCount,
-                                                         FILE* outTex,
-                                                         LatexReplacementArrType* arr);
-static inline ExpressionTokenType* ExpressionSimplifySub(ExpressionTokenType* token,   
-                                                          int* simplifiesCount,
-                                                          FILE* outTex,
-                                                          LatexReplacementArrType* arr);
-static inline ExpressionTokenType* ExpressionSimplifyMul(ExpressionTokenType* token,   
-                                                          int* simplifiesCount,
-                                                          FILE* outTex,
-                                                          LatexReplacementArrType* arr);
-static inline ExpressionTokenType* ExpressionSimplifyDiv(ExpressionTokenType* token,   
-                                                          int* simplifiesCount,
-                                                          FILE* outTex,
-                                                          LatexReplacementArrType* arr);
-static inline ExpressionTokenType* ExpressionSimplifyPow(ExpressionTokenType* token,   
-                                                          int* simplifiesCount,
-                                                          FILE* outTex,
-                                                          LatexReplacementArrType* arr);
-static inline ExpressionTokenType* ExpressionSimplifyLog(ExpressionTokenType* token,   
-                                                          int* simplifiesCount,
-                                                          FILE* outTex,
-                                                          LatexReplacementArrType* arr);
-
-static inline ExpressionTokenType* ExpressionSimplifyReturnLeftToken(
-                                                                ExpressionTokenType* token,
-                                                                FILE* outTex,
-                                                                LatexReplacementArrType* arr);
-static inline ExpressionTokenType* ExpressionSimplifyReturnRightToken(
-                                                                ExpressionTokenType* token,
-                                                                FILE* outTex,
-                                                                LatexReplacementArrType* arr);
-static inline ExpressionTokenType* ExpressionSimplifyReturnConstToken(
-                                                                ExpressionTokenType* token,
-                                                                double value,
-                                                                FILE* outTex,
-                                                                LatexReplacementArrType* arr);
+static ExpressionErrors     ExpressionSimplifyToken(ExpressionTokenType** tokenPtr,
+                                                    int* simplifiesCount,
+                                                    FILE* outTex,
+                                                    LatexReplacementArrType* arr);
+static ExpressionTokenType* ExpressionSimplifyOperation(ExpressionTokenType* token,
+                                                        int* simplifiesCount,
+                                                        FILE* outTex,
+                                                        LatexReplacementArrType* arr);
+
+static inline const char* ExpressionSimplifyRuleGetTexString(
+                                                const ExpressionSimplifyRuleResult rule);
+static inline bool ExpressionTokenIsChild(const ExpressionTokenType* token,
+                                          const ExpressionTokenType* child);
 
 //---------------------------------------------------------------------------------------
 
@@ -103,23 +80,74 @@ double ExpressionCalculate(const ExpressionType* expression)
 
 static double ExpressionCalculate(const ExpressionTokenType* token)
 {
-    if (token == nullptr)
-        return NAN;
-    
-    if (IS_VAL(token))
-        return VAL(token);
+    // operations on the path to the current token wait in the stack with values of left sons
+    struct CalculateFrameType
+    {
+        const ExpressionTokenType* token;
+        double leftValue;
+        bool   rightStarted;
+    };
 
-    if (IS_VAR(token))
-        return token->value.varPtr->variableValue;
+    TokensStackType<CalculateFrameType> stack;
+    VectorCtor(&stack);
 
-    double firstVal  = ExpressionCalculate(L(token));
-    double secondVal = ExpressionCalculate(R(token));
-    
-    return CalculateUsingOperation(OP(token), firstVal, secondVal);
+    double value = NAN;
+
+    while (true)
+    {
+        while (token != nullptr && IS_OP(token))
+        {
+            if (VectorPush(&stack, CalculateFrameType{token, NAN, false}) != 
+                                                            VectorErrors::VECTOR_NO_ERR)
+            {
+                VectorDtor(&stack);
+                return NAN;
+            }
+
+            token = L(token);
+        }
+
+        if (token == nullptr)
+            value = NAN;
+        else if (IS_VAL(token))
+            value = VAL(token);
+        else
+            value = token->value.varPtr->variableValue;
+
+        token = nullptr;
+
+        while (!VectorIsEmpty(&stack))
+        {
+            CalculateFrameType* frame = TokensStackTop(&stack);
+
+            if (!frame->rightStarted && R(frame->token) != nullptr)
+            {
+                frame->leftValue    = value;
+                frame->rightStarted = true;
+
+                token = R(frame->token);
+                break;
+            }
+
+            if (frame->rightStarted)
+                value = ExpressionOperationCalculate(OP(frame->token), frame->leftValue, value);
+            else
+                value = ExpressionOperationCalculate(OP(frame->token), value, NAN);
+
+            TokensStackPop(&stack);
+        }
+
+        if (token == nullptr)
+            break;
+    }
+
+    VectorDtor(&stack);
+
+    return value;
 }
 
-static double CalculateUsingOperation(const ExpressionOperationId operation, 
-                                      const double val1, const double val2)
+double ExpressionOperationCalculate(const ExpressionOperationId operation, 
+                                    const double val1, const double val2)
 {
     #define GENERATE_OPERATION_CMD(NAME, v1, v2, v3, v4, v5, v6, v7, CALCULATE_CODE, ...)   \
         case ExpressionOperationId::NAME:                                                   \
@@ -148,6 +176,14 @@ ExpressionType ExpressionDifferentiate(const ExpressionType* expression,
 {
     assert(expression);
 
+    ExpressionType diffExpression = {};
+
+    // tex dump needs every step, so cached result is useless there
+    if (outTex == nullptr && 
+        ExpressionCacheLoad(expression, ExpressionCacheOperation::DIFFERENTIATE, 1, 0,
+                                                                          &diffExpression))
+        return diffExpression;
+
     LatexReplacementArrType replacementsArr = {};
     ExpressionLatexReplacementArrayCtor(&replacementsArr);
 
@@ -156,14 +192,16 @@ ExpressionType ExpressionDifferentiate(const ExpressionType* expression,
             "According to the legend, the ancient Ruses were able to defeat the Raptors "
             "by taking this derivative \\cite{Ruses}:", &replacementsArr);
 
+    ExpressionTraceBegin(outTex);
     ExpressionTokenType* diffRootToken = ExpressionDifferentiate(expression->root, 
                                                                  outTex, &replacementsArr);
-    ExpressionType diffExpression = {};
+    ExpressionTraceEnd();
     ExpressionCtor(&diffExpression);
 
     diffExpression.root = diffRootToken;
 
     ExpressionCopyVariables(&diffExpression, expression);
+    ExpressionRebindVariables(&diffExpression, &expression->variables);
 
     if (outTex)
     {
@@ -177,7 +215,11 @@ ExpressionType ExpressionDifferentiate(const ExpressionType* expression,
 
     ExpressionLatexReplacementArrayDtor(&replacementsArr);
 
-    ExpressionSimplify(&diffExpression, outTex);
+    // derivative that is not simplified or not taken at all is not cached
+    if (ExpressionSimplify(&diffExpression, outTex) == ExpressionErrors::NO_ERR &&
+        diffExpression.root != nullptr)
+        ExpressionCacheStore(expression, ExpressionCacheOperation::DIFFERENTIATE, 1, 0, 
+                                                                         &diffExpression);
 
     return diffExpression;
 }
@@ -187,471 +229,441 @@ static ExpressionTokenType* ExpressionDifferentiate(const ExpressionTokenType* t
 {
     assert(token);
 
-    ExpressionTokenValue val = {};
-    ExpressionTokenType* diffToken = nullptr;
+    if (!IS_OP(token))
+        return ExpressionDiffLeaf(token, outTex, arr);
 
-    switch(token->valueType)
+    // sons are differentiated before their parent, frame keeps their derivatives.
+    // stage - how many sons are already differentiated
+    struct DiffFrameType
     {
-        case ExpressionTokenValueTypeof::VALUE:
-            val.value = 0;
-            diffToken =  ExpressionTokenCreate(val, ExpressionTokenValueTypeof::VALUE);
-            break;
-        case ExpressionTokenValueTypeof::VARIABLE:
-            val.value = 1;
-            diffToken =  ExpressionTokenCreate(val, ExpressionTokenValueTypeof::VALUE);
-            break;
+        const ExpressionTokenType* token;
 
-        case ExpressionTokenValueTypeof::OPERATION:
-            diffToken = ExpressionDiffOperation(token, outTex, arr);
-            break;
+        ExpressionTokenType* leftDiff;
+        ExpressionTokenType* rightDiff;
 
-        default:
-            break;
-    }
+        int stage;
+    };
 
-    TokenPrintDifferenceToTex(token, diffToken, outTex, "Let's take the derivative of: ", arr);
+    TokensStackType<DiffFrameType> stack;
+    VectorCtor(&stack);
 
-    return diffToken;  
-}
+    if (VectorPush(&stack, DiffFrameType{token, nullptr, nullptr, 0}) != 
+                                                            VectorErrors::VECTOR_NO_ERR)
+    {
+        VectorDtor(&stack);
+        return nullptr;
+    }
 
-//---------------------------------------------------------------------------------------
+    ExpressionTraceEnter();
 
-static ExpressionTokenType* ExpressionDiffOperation(const ExpressionTokenType* token,
-                                                    FILE* outTex, LatexReplacementArrType* arr)
-{
-    assert(token->valueType == ExpressionTokenValueTypeof::OPERATION);
-
-    #define GENERATE_OPERATION_CMD(NAME, v1, v2, v3, v4, v5, v6, v7, v8, DIFF_CODE, ...)\
-        case ExpressionOperationId::NAME:                                               \
-        {                                                                               \
-            DIFF_CODE;                                                                  \
-            break;                                                                      \
-        }
+    ExpressionTokenType* diffToken = nullptr;
 
-    switch(token->value.operation)
+    while (true)
     {
-        //THERE IS RECURSION TO ExpressionDifferentiate inside include
-        #include "Operations.h"
+        DiffFrameType* frame = TokensStackTop(&stack);
+        token = frame->token;
 
-        default:
-            break;
-    }
-    
-    #undef GENERATE_OPERATION_CMD
+        if (frame->stage < 2)
+        {
+            const ExpressionTokenType* son = frame->stage == 0 ? L(token) : R(token);
+            frame->stage++;
 
-    return nullptr;
-}
+            if (son == nullptr || !ExpressionDiffNeedSon(token, son))
+                continue;
 
-//---------------------------------------------------------------------------------------
+            if (IS_OP(son))
+            {
+                if (VectorPush(&stack, DiffFrameType{son, nullptr, nullptr, 0}) != 
+                                                            VectorErrors::VECTOR_NO_ERR)
+                    break;
 
-void ExpressionSimplify(ExpressionType* expression,
-                        FILE* outTex)
-{
-    assert(expression);
+                ExpressionTraceEnter();
+                continue;
+            }
 
-    int simplifiesCount = 0;
+            // leaves don't need their own frames
+            diffToken = ExpressionDiffLeaf(son, outTex, arr);
+        }
+        else
+        {
+            diffToken = ExpressionDiffOperation(token, &frame->leftDiff, &frame->rightDiff);
 
-    LatexReplacementArrType replacementsArr = {};
-    ExpressionLatexReplacementArrayCtor(&replacementsArr);
+            // derivatives of sons that were not used by DIFF_CODE
+            if (frame->leftDiff)  ExpressionDtor(frame->leftDiff);
+            if (frame->rightDiff) ExpressionDtor(frame->rightDiff);
 
-    do
-    {
-        simplifiesCount = 0;
-        expression->root = ExpressionSimplifyConstants(expression->root, &simplifiesCount, 
-                                                       nullptr, outTex, &replacementsArr);
-        expression->root = ExpressionSimplifyNeutralTokens(expression->root, &simplifiesCount,
-                                                           outTex, &replacementsArr);
-    } while (simplifiesCount != 0);
+            TokenPrintDifferenceToTex(token, diffToken, outTex, DIFF_STEP_STRING, arr);
+            ExpressionTraceLeave();
 
-    if (outTex) 
-        ExpressionPrintTex(expression, outTex, "Final expression after simplifications:", 
-                                                                         &replacementsArr);
+            TokensStackPop(&stack);
 
-    ExpressionLatexReplacementArrayDtor(&replacementsArr);
-}
+            if (VectorIsEmpty(&stack))
+                break;
 
-static ExpressionTokenType* ExpressionSimplifyConstants (ExpressionTokenType* token,
-                                                         int* simplifiesCount,
-                                                         bool* haveVariables,
-                                                         FILE* outTex,
-                                                         LatexReplacementArrType* arr)
-{
-    assert(simplifiesCount);
+            frame = TokensStackTop(&stack);
+        }
 
-    if (token == nullptr || IS_VAL(token))
-    {
-        if (haveVariables != nullptr)
-            *haveVariables = false;
-        
-        return token;
+        if (frame->stage == 1)
+            frame->leftDiff  = diffToken;
+        else
+            frame->rightDiff = diffToken;
     }
 
-    if (IS_VAR(token))
+    // stack is left not empty only if it couldn't grow, derivatives made so far are freed
+    while (!VectorIsEmpty(&stack))
     {
-        if (haveVariables != nullptr)
-            *haveVariables = true;
+        DiffFrameType frame = TokensStackPop(&stack);
 
-        return token;
-    }
+        if (frame.leftDiff)  ExpressionDtor(frame.leftDiff);
+        if (frame.rightDiff) ExpressionDtor(frame.rightDiff);
 
-    bool leftTokenHaveVariables  = false;
-    bool rightTokenHaveVariables = false;
-    ExpressionTokenType* left  = ExpressionSimplifyConstants(L(token),  
-                                                             simplifiesCount,
-                                                             &leftTokenHaveVariables,
-                                                             outTex, arr);
-    ExpressionTokenType* right = ExpressionSimplifyConstants(R(token), 
-                                                             simplifiesCount,
-                                                             &rightTokenHaveVariables,
-                                                             outTex, arr);
-
-    if (L(token) != left)
-    {
-        ExpressionTokenDtor(L(token));
-        token->left = left;
-    }
+        ExpressionTraceLeave();
 
-    if (R(token) != right)
-    {
-        ExpressionTokenDtor(R(token));
-        token->right = right;
+        diffToken = nullptr;
     }
 
-    bool tokenHaveVariables = leftTokenHaveVariables | rightTokenHaveVariables;
+    VectorDtor(&stack);
 
-    if (haveVariables != nullptr) *haveVariables = tokenHaveVariables;
+    return diffToken;  
+}
 
-    if (!tokenHaveVariables)
-    {
-        (*simplifiesCount)++;
-        
-        double leftVal = NAN, rightVal = NAN;
+//---------------------------------------------------------------------------------------
 
-        assert(L(token));
+static ExpressionTokenType* ExpressionDiffLeaf(const ExpressionTokenType* token,
+                                               FILE* outTex, LatexReplacementArrType* arr)
+{
+    assert(token);
+    assert(!IS_OP(token));
 
-        leftVal = L_VAL(token);
-        if (R(token)) rightVal = R_VAL(token);
+    ExpressionTraceEnter();
 
-        ExpressionTokenType* simplifiedToken = CRT_NUM(
-                                    CalculateUsingOperation(OP(token), leftVal, rightVal));
+    ExpressionTokenType* diffToken = CRT_NUM(IS_VAR(token) ? 1 : 0);
 
-        TokenPrintDifferenceToTex(token, simplifiedToken, outTex, 
-                                  "Let's simplify this expression: ", arr); 
+    TokenPrintDifferenceToTex(token, diffToken, outTex, DIFF_STEP_STRING, arr);
 
-        return simplifiedToken;
-    }
-    return token;
+    ExpressionTraceLeave();
+
+    return diffToken;
 }
 
 //---------------------------------------------------------------------------------------
 
-static inline void TokenPrintDifferenceToTex(const ExpressionTokenType* prevToken, 
-                                            const ExpressionTokenType* newToken, FILE* outTex, 
-                                            const char* stringToPrint,
-                                            LatexReplacementArrType* arr)
-{ 
-    assert(prevToken);
-    assert(newToken);
+static ExpressionTokenType* ExpressionDiffOperation(const ExpressionTokenType* token,
+                                                    ExpressionTokenType** leftDiff,
+                                                    ExpressionTokenType** rightDiff)
+{
+    assert(token->valueType == ExpressionTokenValueTypeof::OPERATION);
 
-    if (outTex)
-    {
-        ExpressionTokenPrintTexWithTrollString(prevToken, outTex, stringToPrint, arr);
-        ExpressionTokenPrintTexWithTrollString(newToken,  outTex,       nullptr, arr);
-    }
-}
+    #define GENERATE_OPERATION_CMD(NAME, v1, v2, v3, v4, v5, v6, v7, v8, DIFF_CODE, ...)\
+        case ExpressionOperationId::NAME:                                               \
+        {                                                                               \
+            DIFF_CODE;                                                                  \
+            break;                                                                      \
+        }
 
-static ExpressionTokenType* ExpressionSimplifyNeutralTokens(ExpressionTokenType* token, 
-                                                            int* simplifiesCount,
-                                                            FILE* outTex,
-                                                            LatexReplacementArrType* arr)
-{
-    if (token == nullptr || !IS_OP(token))
-        return token;
-    
-    ExpressionTokenType* left  = ExpressionSimplifyNeutralTokens(L(token), simplifiesCount,
-                                                                 outTex, arr);
-    ExpressionTokenType* right = ExpressionSimplifyNeutralTokens(R(token), simplifiesCount,
-                                                                 outTex, arr);
-    
-    if (L(token) != left)
+    switch(token->value.operation)
     {
-        ExpressionTokenDtor(L(token));
-        token->left = left;        
-    }
+        //D() takes derivatives of sons calculated by ExpressionDifferentiate
+        #include "Operations.h"
 
-    if (R(token) != right)
-    {
-        ExpressionTokenDtor(R(token));
-        token->right = right;
+        default:
+            break;
     }
-
-    if (left == nullptr || right == nullptr)
-        return token;
     
-    assert(IS_OP(token));
+    #undef GENERATE_OPERATION_CMD
 
-    if (IS_VAR(right) && IS_VAR(left) && VAR(left) == VAR(right))
-        return ExpressionSimplifyReturnConstToken(token, 0, outTex, arr);
+    return nullptr;
+}
 
-    if (!IS_VAL(left) && !IS_VAL(right))
-        return token;
+//---------------------------------------------------------------------------------------
+
+// has to agree with DIFF_CODE in Operations.h: son is differentiated only if D() is called on it
+static bool ExpressionDiffNeedSon(const ExpressionTokenType* token, 
+                                  const ExpressionTokenType* son)
+{
+    assert(token);
+    assert(IS_OP(token));
+    assert(son);
 
-    assert(L(token) == left);
-    assert(R(token) == right);
     switch (OP(token))
     {
+        case ExpressionOperationId::POW:
+            return ExpressionTokenContainVariable(son);
+
         case ExpressionOperationId::ADD:
-            return ExpressionSimplifyAdd(token, simplifiesCount, outTex, arr);
         case ExpressionOperationId::SUB:
-            return ExpressionSimplifySub(token, simplifiesCount, outTex, arr);
+        case ExpressionOperationId::UNARY_SUB:
         case ExpressionOperationId::MUL:
-            return ExpressionSimplifyMul(token, simplifiesCount, outTex, arr);
         case ExpressionOperationId::DIV:
-            return ExpressionSimplifyDiv(token, simplifiesCount, outTex, arr);
-        
-        case ExpressionOperationId::POW:
-            return ExpressionSimplifyPow(token, simplifiesCount, outTex, arr);
         case ExpressionOperationId::LOG:
-            return ExpressionSimplifyLog(token, simplifiesCount, outTex, arr);
-        
+        case ExpressionOperationId::LN:
+        case ExpressionOperationId::SIN:
+        case ExpressionOperationId::COS:
+        case ExpressionOperationId::TAN:
+        case ExpressionOperationId::COT:
+        case ExpressionOperationId::ARCSIN:
+        case ExpressionOperationId::ARCCOS:
+        case ExpressionOperationId::ARCTAN:
+        case ExpressionOperationId::ARCCOT:
         default:
-            break;
+            return true;
     }
+}
 
-    return token;
+static inline ExpressionTokenType* ExpressionDiffTakeSon(const ExpressionTokenType* token,
+                                                         const ExpressionTokenType* son,
+                                                         ExpressionTokenType** leftDiff,
+                                                         ExpressionTokenType** rightDiff)
+{
+    assert(token);
+    assert(son == L(token) || son == R(token));
+
+    ExpressionTokenType** diffPtr = son == L(token) ? leftDiff : rightDiff;
+    ExpressionTokenType*  diff    = *diffPtr;
+
+    //derivative of each son is calculated once, so it can be taken once
+    assert(diff);
+    *diffPtr = nullptr;
+
+    return diff;
 }
 
 //---------------------------------------------------------------------------------------
 
-#define CHECK()                 \
-do                              \
-{                               \
-    assert(simplifiesCount);    \
-    assert(token);              \
-    assert(L(token));           \
-    assert(R(token));           \
-} while (0)
+ExpressionErrors ExpressionSimplify(ExpressionType* expression,
+                                    FILE* outTex)
+{
+    assert(expression);
 
+    int simplifiesCount = 0;
+    ExpressionErrors err = ExpressionErrors::NO_ERR;
 
-static inline ExpressionTokenType* ExpressionSimplifyAdd(ExpressionTokenType* token,   
-                                                         int* simplifiesCount,
-                                                         FILE* outTex,
-                                                         LatexReplacementArrType* arr)
-{
-    CHECK();
+    LatexReplacementArrType replacementsArr = {};
+    ExpressionLatexReplacementArrayCtor(&replacementsArr);
 
-    if (R_IS_VAL(token) && DoubleEqual(R_VAL(token), 0))
+    ExpressionTraceBegin(outTex);
+    do
     {
-        (*simplifiesCount)++;
-        return ExpressionSimplifyReturnLeftToken(token, outTex, arr);
-    }
+        simplifiesCount = 0;
+        err = ExpressionSimplifyToken(&expression->root, &simplifiesCount,
+                                      outTex, &replacementsArr);
+    } while (simplifiesCount != 0 && err == ExpressionErrors::NO_ERR);
+    ExpressionTraceEnd();
 
-    if (L_IS_VAL(token) && DoubleEqual(L_VAL(token), 0))
+    if (err != ExpressionErrors::NO_ERR)
     {
-        (*simplifiesCount)++;
-        return ExpressionSimplifyReturnRightToken(token, outTex, arr);
+        ExpressionLatexReplacementArrayDtor(&replacementsArr);
+        return err;
     }
 
-    return token;
-}
-
-static inline ExpressionTokenType* ExpressionSimplifySub(ExpressionTokenType* token,   
-                                                          int* simplifiesCount,
-                                                         FILE* outTex,
-                                                          LatexReplacementArrType* arr)
-{
-    CHECK();
-
-    if (R_IS_VAL(token) && DoubleEqual(R_VAL(token), 0))
-    {    
-        (*simplifiesCount)++;
-        return ExpressionSimplifyReturnLeftToken(token, outTex, arr);
-    }
+    bool normalized = false;
+    err = ExpressionPolynomialNormalize(expression, &normalized);
 
-    if (L_IS_VAL(token) && DoubleEqual(L_VAL(token), 0))
+    if (normalized)
     {
-        (*simplifiesCount)++;
-
-        ExpressionTokenDtor(L(token));
-        token->left = nullptr;
+        // normalized subtrees are freed, so their replacements can't be used anymore
+        ExpressionLatexReplacementArrayDtor(&replacementsArr);
+        ExpressionLatexReplacementArrayCtor(&replacementsArr);
+    }
 
-        ExpressionTokenType* simpledToken = _MUL(CRT_NUM(-1), R(token));
-        token->right = nullptr;
+    if (outTex) 
+        ExpressionPrintTex(expression, outTex, "Final expression after simplifications:", 
+                                                                         &replacementsArr);
 
-        return simpledToken;
-    }
+    ExpressionLatexReplacementArrayDtor(&replacementsArr);
 
-    return token;
+    return err;
 }
 
-static inline ExpressionTokenType* ExpressionSimplifyMul(ExpressionTokenType* token,   
-                                                          int* simplifiesCount,
-                                                          FILE* outTex,
-                                                          LatexReplacementArrType* arr)
+static ExpressionErrors ExpressionSimplifyToken(ExpressionTokenType** tokenPtr,
+                                                int* simplifiesCount,
+                                                FILE* outTex,
+                                                LatexReplacementArrType* arr)
 {
-    CHECK();
+    assert(tokenPtr);
+    assert(simplifiesCount);
 
-    if (R_IS_VAL(token) && DoubleEqual(R_VAL(token), 0))
-    {
-        (*simplifiesCount)++;
-        return ExpressionSimplifyReturnConstToken(token, 0, outTex, arr);
-    }
+    ExpressionTokenType* token = *tokenPtr;
 
-    if (L_IS_VAL(token) && DoubleEqual(L_VAL(token), 0))
-    {
-        (*simplifiesCount)++;
-        return ExpressionSimplifyReturnConstToken(token, 0, outTex, arr);
-    }
+    if (token == nullptr || !IS_OP(token))
+        return ExpressionErrors::NO_ERR;
 
-    if (R_IS_VAL(token) && DoubleEqual(R_VAL(token), 1))
+    // sons are simplified before their parent and replaced in it right after that
+    struct SimplifyFrameType
     {
-        (*simplifiesCount)++;
-        return ExpressionSimplifyReturnLeftToken(token, outTex, arr);
-    }
+        ExpressionTokenType* token;
 
-    if (L_IS_VAL(token) && DoubleEqual(L_VAL(token), 1))
+        int prevSimplifiesCount;
+        int stage;
+    };
+
+    TokensStackType<SimplifyFrameType> stack;
+    VectorCtor(&stack);
+
+    if (VectorPush(&stack, SimplifyFrameType{token, *simplifiesCount, 0}) != 
+                                                            VectorErrors::VECTOR_NO_ERR)
     {
-        (*simplifiesCount)++;
-        return ExpressionSimplifyReturnRightToken(token, outTex, arr);
+        VectorDtor(&stack);
+        return ExpressionErrors::MEM_ERR;
     }
 
-    return token;
-}
+    ExpressionTraceEnter();
 
-static inline ExpressionTokenType* ExpressionSimplifyDiv(ExpressionTokenType* token,   
-                                                         int* simplifiesCount,
-                                                         FILE* outTex,
-                                                          LatexReplacementArrType* arr)
-{
-    CHECK();
+    ExpressionErrors err = ExpressionErrors::NO_ERR;
 
-    if (L_IS_VAL(token) && DoubleEqual(L_VAL(token), 0))
+    while (true)
     {
-        (*simplifiesCount)++;
-        return ExpressionSimplifyReturnConstToken(token, 0, outTex, arr);
-    }
+        SimplifyFrameType* frame = TokensStackTop(&stack);
+        token = frame->token;
+
+        if (frame->stage < 2)
+        {
+            ExpressionTokenType* son = frame->stage == 0 ? L(token) : R(token);
+            frame->stage++;
+
+            if (son != nullptr && IS_OP(son))
+            {
+                if (VectorPush(&stack, SimplifyFrameType{son, *simplifiesCount, 0}) != 
+                                                            VectorErrors::VECTOR_NO_ERR)
+                {
+                    err = ExpressionErrors::MEM_ERR;
+                    break;
+                }
+
+                ExpressionTraceEnter();
+            }
+
+            continue;
+        }
 
-    if (R_IS_VAL(token) && DoubleEqual(R_VAL(token), 1))
-    {
-        (*simplifiesCount)++;
-        return ExpressionSimplifyReturnLeftToken(token, outTex, arr);
-    }
+        if (*simplifiesCount != frame->prevSimplifiesCount)
+            token->texLen = 0;
 
-    return token;
-}
+        token = ExpressionSimplifyOperation(token, simplifiesCount, outTex, arr);
 
-static inline ExpressionTokenType* ExpressionSimplifyPow(ExpressionTokenType* token,   
-                                                          int* simplifiesCount,
-                                                         FILE* outTex,
-                                                          LatexReplacementArrType* arr)
-{
-    CHECK();
+        TokensStackPop(&stack);
 
-    if (R_IS_VAL(token) && DoubleEqual(R_VAL(token), 0))
-    {
-        (*simplifiesCount)++;
-        return ExpressionSimplifyReturnConstToken(token, 1, outTex, arr);
-    }
+        if (VectorIsEmpty(&stack))
+            break;
 
-    if (L_IS_VAL(token) && DoubleEqual(L_VAL(token), 0))
-    {
-        (*simplifiesCount)++;
-        return ExpressionSimplifyReturnConstToken(token, 0, outTex, arr);
-    }
+        frame = TokensStackTop(&stack);
 
-    if (R_IS_VAL(token) && DoubleEqual(R_VAL(token), 1))
-    {
-        (*simplifiesCount)++;
-        return ExpressionSimplifyReturnLeftToken(token, outTex, arr);
+        if (frame->stage == 1)
+            frame->token->left  = token;
+        else
+            frame->token->right = token;
     }
 
-    if (L_IS_VAL(token) && DoubleEqual(L_VAL(token), 1))
+    // sons are replaced in the tree right after simplification, 
+    // so unfinished frames only leave their tokens not simplified and the root is the same
+    if (err != ExpressionErrors::NO_ERR)
     {
-        (*simplifiesCount)++;
-        return ExpressionSimplifyReturnConstToken(token, 1, outTex, arr);
+        token = stack.data[0].token;
+
+        for (size_t i = 0; i < stack.size; ++i)
+            ExpressionTraceLeave();
     }
 
-    return token;
+    VectorDtor(&stack);
+
+    *tokenPtr = token;
+
+    return err;
 }
 
-static inline ExpressionTokenType* ExpressionSimplifyLog(ExpressionTokenType* token,   
-                                                          int* simplifiesCount,
-                                                         FILE* outTex,
-                                                          LatexReplacementArrType* arr)
+// sons of the token have to be already simplified
+static ExpressionTokenType* ExpressionSimplifyOperation(ExpressionTokenType* token,
+                                                        int* simplifiesCount,
+                                                        FILE* outTex,
+                                                        LatexReplacementArrType* arr)
 {
-    CHECK();
+    assert(token);
+    assert(simplifiesCount);
 
-    if (R_IS_VAL(token) && DoubleEqual(R_VAL(token), 1))
+    ExpressionSimplifyRuleResult rule = ExpressionSimplifyRuleFind(OP(token), L(token), R(token));
+
+    if (rule == ExpressionSimplifyRuleResult::NO_RULE)
     {
-        (*simplifiesCount)++;
-        return ExpressionSimplifyReturnConstToken(token, 0, outTex, arr);
+        ExpressionTraceLeave();
+        return token;
     }
 
-    return token;
-}
-
-#undef CHECK
-//---------------------------------------------------------------------------------------
+    (*simplifiesCount)++;
 
-static inline ExpressionTokenType* ExpressionSimplifyReturnLeftToken(ExpressionTokenType* token,
-                                                                     FILE* outTex,
-                                                                    LatexReplacementArrType* arr)
-{
-    assert(token);
+    ExpressionTokenType* simplifiedToken = ExpressionSimplifyRuleCreateToken(rule, OP(token),
+                                                                             L(token), R(token));
+    assert(simplifiedToken);
 
-    TokenPrintDifferenceToTex(token, L(token), outTex, 
-                                    "Slozhno ne ponyat, chto delat s etim:", arr);
+    TokenPrintDifferenceToTex(token, simplifiedToken, outTex, 
+                              ExpressionSimplifyRuleGetTexString(rule), arr);
+    ExpressionTraceLeave();
 
-    ExpressionTokenDtor(token->right);
+    if (arr)
+    {
+        // freed tokens' addresses may be reused, so their replacements have to be forgotten
+        ExpressionLatexReplacementRemove(arr, token, false);
 
-    ExpressionTokenType* left = L(token);
+        if (!ExpressionTokenIsChild(simplifiedToken, L(token)))
+            ExpressionLatexReplacementRemove(arr, L(token));
+        if (!ExpressionTokenIsChild(simplifiedToken, R(token)))
+            ExpressionLatexReplacementRemove(arr, R(token));
+    }
 
-    token->left  = nullptr;
-    token->right = nullptr;
+    ExpressionSimplifyRuleDeleteUnused(rule, L(token), R(token));
+    ExpressionTokenDtor(token);
 
-    return left;
+    return simplifiedToken;
 }
 
-static inline ExpressionTokenType* ExpressionSimplifyReturnRightToken(
-                                                                ExpressionTokenType* token,
-                                                                FILE* outTex,
-                                                                LatexReplacementArrType* arr)
+static inline bool ExpressionTokenIsChild(const ExpressionTokenType* token,
+                                          const ExpressionTokenType* child)
 {
     assert(token);
 
-    TokenPrintDifferenceToTex(token, R(token), outTex, 
-                        "Avtor ne smog perevesti na english(", arr);
+    return child == token || child == token->left || child == token->right;
+}
 
-    ExpressionTokenDtor(token->left);
+//---------------------------------------------------------------------------------------
 
-    ExpressionTokenType* right = R(token);
-    
-    token->left  = nullptr;
-    token->right = nullptr;
+static inline const char* ExpressionSimplifyRuleGetTexString(
+                                                const ExpressionSimplifyRuleResult rule)
+{
+    switch (rule)
+    {
+        case ExpressionSimplifyRuleResult::CALCULATE:
+            return "Let's simplify this expression: ";
+        case ExpressionSimplifyRuleResult::RETURN_LEFT:
+            return "Slozhno ne ponyat, chto delat s etim:";
+        case ExpressionSimplifyRuleResult::RETURN_RIGHT:
+            return "Avtor ne smog perevesti na english(";
+
+        case ExpressionSimplifyRuleResult::RETURN_ZERO:
+        case ExpressionSimplifyRuleResult::RETURN_ONE:
+        case ExpressionSimplifyRuleResult::NEGATE_RIGHT:
+            return "Let's use the theorem ..."
+                   "(The author doesn't know how this theorem is called in English, "
+                   "you are left to guess for yourself)";
+
+        case ExpressionSimplifyRuleResult::NO_RULE:
+        default:
+            break;
+    }
 
-    return right;
+    return nullptr;
 }
 
-static inline ExpressionTokenType* ExpressionSimplifyReturnConstToken(
-                                                                ExpressionTokenType* token,
-                                                                double value,
-                                                                FILE* outTex,
-                                                                LatexReplacementArrType* arr)
-{
-    ExpressionTokenType* constToken = CRT_NUM(value);
-    
-    TokenPrintDifferenceToTex(token, constToken, outTex,
-                        "Let's use the theorem ..."
-                        "(The author doesn't know how this theorem is called in English, "
-                        "you are left to guess for yourself)", arr);
-    
-    ExpressionTokenDtor(R(token));
-    ExpressionTokenDtor(L(token));
+//---------------------------------------------------------------------------------------
 
-    token->left  = nullptr;
-    token->right = nullptr;
+static inline void TokenPrintDifferenceToTex(const ExpressionTokenType* prevToken, 
+                                            const ExpressionTokenType* newToken, FILE* outTex, 
+                                            const char* stringToPrint,
+                                            LatexReplacementArrType* arr)
+{ 
+    assert(prevToken);
+    assert(newToken);
 
-    return CRT_NUM(value);
+    if (outTex)
+        ExpressionTraceStep(prevToken, newToken, stringToPrint, arr);
 }
 
 //---------------------------------------------------------------------------------------
@@ -660,16 +672,38 @@ static bool ExpressionTokenContainVariable(const ExpressionTokenType* token)
 {
     if (token == nullptr)
         return false;
-    
-    if (IS_VAR(token))
-        return true;
 
-    bool containVariable  = ExpressionTokenContainVariable(L(token));
+    TokensStackType<const ExpressionTokenType*> stack;
+    VectorCtor(&stack);
 
-    if (containVariable)
-        return containVariable;
-    
-    containVariable = ExpressionTokenContainVariable(R(token));
+    bool containVariable = false;
+
+    while (true)
+    {
+        if (IS_VAR(token))
+        {
+            containVariable = true;
+            break;
+        }
+
+        // son is differentiated in vain if variable is not found but never left without derivative
+        if (R(token) != nullptr && 
+            VectorPush(&stack, (const ExpressionTokenType*) R(token)) != 
+                                                            VectorErrors::VECTOR_NO_ERR)
+        {
+            containVariable = true;
+            break;
+        }
+
+        if (L(token) != nullptr)
+            token = L(token);
+        else if (!VectorIsEmpty(&stack))
+            token = TokensStackPop(&stack);
+        else
+            break;
+    }
+
+    VectorDtor(&stack);
 
     return containVariable;
 }
@@ -682,10 +716,14 @@ ExpressionType ExpressionTaylor(const ExpressionType* expression, const int n, c
     assert(expression->variables.size == 1);
     assert(n >= 0);
 
+    ExpressionType taylorSeries = {};
+
+    if (ExpressionCacheLoad(expression, ExpressionCacheOperation::TAYLOR, n, x, &taylorSeries))
+        return taylorSeries;
+
     ExpressionType tmpDiffExpr  = ExpressionCopy(expression);
-    ExpressionVariableSet(&tmpDiffExpr, tmpDiffExpr.variables.data[0].variableName, x);
+    tmpDiffExpr.variables.data[0].variableValue = x;
 
-    ExpressionType taylorSeries = {};
     ExpressionCtor(&taylorSeries);
     ExpressionCopyVariables(&taylorSeries, expression);
 
@@ -709,7 +747,8 @@ ExpressionType ExpressionTaylor(const ExpressionType* expression, const int n, c
     ExpressionTokenDtor(xToken);
     xToken = nullptr;
 
-    ExpressionSimplify(&taylorSeries);
+    if (ExpressionSimplify(&taylorSeries) == ExpressionErrors::NO_ERR)
+        ExpressionCacheStore(expression, ExpressionCacheOperation::TAYLOR, n, x, &taylorSeries);
 
     return taylorSeries;
 }
@@ -756,13 +795,14 @@ ExpressionType ExpressionSubTwoExpressions(const ExpressionType* expr1,
     assert(expr2);
 
 
-    ExpressionTokenType* root = _SUB(expr1->root, expr2->root);
+    ExpressionTokenType* root = _SUB(C(expr1->root), C(expr2->root));
 
     ExpressionType subExpr = {};
     ExpressionCtor(&subExpr);
     subExpr.root = root;
 
     ExpressionCopyVariables(&subExpr, expr1);
+    ExpressionRebindVariables(&subExpr, &expr1->variables);
 
     return subExpr;
 }
@@ -4,11 +4,13 @@
 #include "MathExpressionsMain.h"
 
 double ExpressionCalculate(const ExpressionType* expression);
+double ExpressionOperationCalculate(const ExpressionOperationId operation, 
+                                    const double val1, const double val2 = NAN);
 
 ExpressionType ExpressionSubTwoExpressions(const ExpressionType* expr1, 
                                            const ExpressionType* expr2);
 
-void ExpressionSimplify(ExpressionType* expression, FILE* outTex = nullptr);
+ExpressionErrors ExpressionSimplify(ExpressionType* expression, FILE* outTex = nullptr);
 
 ExpressionType ExpressionDifferentiate(const ExpressionType* expression,
                                                FILE* outTex = nullptr);
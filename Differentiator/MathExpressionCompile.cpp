@@ -0,0 +1,840 @@
+#include <assert.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MathExpressionCompile.h"
+#include "MathExpressionTokensStack.h"
+#include "FastInput/InputOutput.h"
+#include "Common/DoubleFuncs.h"
+#include "Vector/HashFuncs.h"
+#include "Vector/Vector.h"
+
+#include "DSL.h"
+
+//---------------------------------------------------------------------------------------
+
+// Operation token is exported as temporary "const double t<index> = <left> op <right>;",
+// equal subtrees get the same temporary. Temporaries are created in post-order,
+// so every temporary is declared before it is used.
+
+// operand of the operation: number, variable or temporary (OPERATION)
+struct ExportOperandType
+{
+    ExpressionTokenValueTypeof valueType;
+
+    double value;
+    size_t index;       // index of the variable or temporary
+};
+
+struct ExportTemporaryType
+{
+    ExpressionOperationId operation;
+
+    ExportOperandType left;
+    ExportOperandType right;
+    bool hasRight;
+
+    HashType hash;
+};
+
+struct ExportStorageType
+{
+    VectorType<ExportTemporaryType> temporaries;
+
+    size_t* slots;          // open addressing table, index of the temporary + 1, 0 - empty
+    size_t  slotsCapacity;  // power of two
+
+    bool*   variableIsUsed;
+    size_t  variablesCount;
+};
+
+// stage - how many sons of the token are already exported
+struct ExportFrameType
+{
+    const ExpressionTokenType* token;
+    int stage;
+};
+
+static const size_t EXPORT_MIN_SLOTS_CAPACITY = 64;
+
+static const char* const COMPILED_FUNC_NAME       = "ExpressionCompiledFunc";
+static const char* const COMPILED_BATCH_FUNC_NAME = "ExpressionCompiledBatchFunc";
+
+static const char* const COMPILE_DEFAULT_CACHE_DIR = "CompiledExpressions";
+static const char* const COMPILE_DEFAULT_COMPILER  = "cc";
+
+// no contraction to fma, so compiled functions round the same way as ExpressionCalculate
+#if defined(__x86_64__) || defined(__i386__)
+static const char* const COMPILE_DEFAULT_FLAGS = "-O3 -march=native -ffp-contract=off -fopenmp-simd";
+#else
+static const char* const COMPILE_DEFAULT_FLAGS = "-O3 -mcpu=native -ffp-contract=off -fopenmp-simd";
+#endif
+
+static const size_t COMPILE_MAX_PATH_LENGTH    = 512;
+static const size_t COMPILE_MAX_COMMAND_LENGTH = 2048;
+
+static ExpressionErrors ExportStorageCtor(ExportStorageType* storage, 
+                                          const ExpressionType* expression);
+static void             ExportStorageDtor(ExportStorageType* storage);
+
+static ExpressionErrors ExportTokens(ExportStorageType* storage, 
+                                     const ExpressionTokenType* root,
+                                     const ExpressionVariablesArrayType* varsArr,
+                                     ExportOperandType* result);
+
+static ExportOperandType ExportLeaf(ExportStorageType* storage, const ExpressionTokenType* token,
+                                    const ExpressionVariablesArrayType* varsArr);
+
+static ExpressionErrors ExportTemporaryFindOrAdd(ExportStorageType* storage, 
+                                                 const ExportTemporaryType* temporary,
+                                                 size_t* index);
+static ExpressionErrors ExportSlotsGrow(ExportStorageType* storage);
+static HashType         ExportTemporaryHash (const ExportTemporaryType* temporary);
+static bool             ExportTemporaryEqual(const ExportTemporaryType* temporary1, 
+                                             const ExportTemporaryType* temporary2);
+static bool             ExportOperandEqual  (const ExportOperandType* operand1,
+                                             const ExportOperandType* operand2);
+
+static void ExportPrintPrelude   (OutputBufferType* outBuffer);
+static void ExportPrintVariables (const ExportStorageType* storage, 
+                                  const ExpressionVariablesArrayType* varsArr,
+                                  const bool isBatch, OutputBufferType* outBuffer);
+static void ExportPrintTemporaries(const ExportStorageType* storage, const char* indent,
+                                   OutputBufferType* outBuffer);
+static void ExportPrintOperand   (const ExportOperandType* operand, OutputBufferType* outBuffer);
+
+static bool ExpressionCompiledIsCached(const char* sourceName, const OutputBufferType* source);
+static ExpressionErrors ExpressionCompileSource(const char* sourceName, const char* libraryName,
+                                                const OutputBufferType* source,
+                                                const ExpressionCompileParamsType* params);
+static ExpressionErrors ExpressionCompiledLoad(const char* libraryName, 
+                                               ExpressionCompiledType* compiled);
+static bool             ExpressionCompiledLoadSymbol(void* library, const char* name, 
+                                                     void* funcPtr);
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionExportC(const ExpressionType* expression, FILE* outStream)
+{
+    assert(expression);
+    assert(outStream);
+
+    OutputBufferType outBuffer = {};
+
+    if (!OutputBufferCtor(&outBuffer, outStream))
+        return ExpressionErrors::MEM_ERR;
+
+    ExpressionErrors err = ExpressionExportC(expression, &outBuffer);
+
+    if (!OutputBufferFlush(&outBuffer) && err == ExpressionErrors::NO_ERR)
+        err = ExpressionErrors::READING_ERR;
+
+    OutputBufferDtor(&outBuffer);
+
+    return err;
+}
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionExportC(const ExpressionType* expression, OutputBufferType* outBuffer)
+{
+    assert(expression);
+    assert(expression->root);
+    assert(outBuffer);
+
+    ExportStorageType storage = {};
+    ExpressionErrors err = ExportStorageCtor(&storage, expression);
+
+    ExportOperandType result = {};
+
+    if (err == ExpressionErrors::NO_ERR)
+        err = ExportTokens(&storage, expression->root, &expression->variables, &result);
+
+    if (err != ExpressionErrors::NO_ERR)
+    {
+        ExportStorageDtor(&storage);
+        return err;
+    }
+
+    ExportPrintPrelude(outBuffer);
+
+    OutputBufferPrintf(outBuffer, "double %s(const double* variables)\n{\n", COMPILED_FUNC_NAME);
+
+    ExportPrintVariables (&storage, &expression->variables, false, outBuffer);
+    ExportPrintTemporaries(&storage, "    ", outBuffer);
+
+    OutputBufferPutString(outBuffer, "    return ");
+    ExportPrintOperand(&result, outBuffer);
+    OutputBufferPutString(outBuffer, ";\n}\n\n");
+
+    OutputBufferPrintf(outBuffer, "void %s(const double* const* variables, double* results, "
+                                  "size_t count)\n{\n", COMPILED_BATCH_FUNC_NAME);
+
+    ExportPrintVariables(&storage, &expression->variables, true, outBuffer);
+
+    OutputBufferPutString(outBuffer, "    #pragma omp simd\n"
+                                     "    for (size_t i = 0; i < count; ++i)\n"
+                                     "    {\n");
+
+    for (size_t i = 0; i < storage.variablesCount; ++i)
+    {
+        if (storage.variableIsUsed[i])
+            OutputBufferPrintf(outBuffer, "        const double v%zu = variables%zu[i];\n", i, i);
+    }
+
+    ExportPrintTemporaries(&storage, "        ", outBuffer);
+
+    OutputBufferPutString(outBuffer, "        results[i] = ");
+    ExportPrintOperand(&result, outBuffer);
+    OutputBufferPutString(outBuffer, ";\n    }\n}\n");
+
+    ExportStorageDtor(&storage);
+
+    return outBuffer->failed ? ExpressionErrors::MEM_ERR : ExpressionErrors::NO_ERR;
+}
+
+//---------------------------------------------------------------------------------------
+
+static ExpressionErrors ExportStorageCtor(ExportStorageType* storage, 
+                                          const ExpressionType* expression)
+{
+    assert(storage);
+    assert(expression);
+
+    if (VectorCtor(&storage->temporaries) != VectorErrors::VECTOR_NO_ERR)
+        return ExpressionErrors::MEM_ERR;
+
+    storage->slotsCapacity  = EXPORT_MIN_SLOTS_CAPACITY;
+    storage->slots          = (size_t*)calloc(storage->slotsCapacity, sizeof(*storage->slots));
+
+    storage->variablesCount = expression->variables.size;
+    storage->variableIsUsed = (bool*)calloc(storage->variablesCount + 1, 
+                                            sizeof(*storage->variableIsUsed));
+
+    if (storage->slots == nullptr || storage->variableIsUsed == nullptr)
+        return ExpressionErrors::MEM_ERR;
+
+    return ExpressionErrors::NO_ERR;
+}
+
+static void ExportStorageDtor(ExportStorageType* storage)
+{
+    assert(storage);
+
+    VectorDtor(&storage->temporaries);
+
+    free(storage->slots);
+    free(storage->variableIsUsed);
+
+    storage->slots          = nullptr;
+    storage->slotsCapacity  = 0;
+    storage->variableIsUsed = nullptr;
+    storage->variablesCount = 0;
+}
+
+//---------------------------------------------------------------------------------------
+
+static ExpressionErrors ExportTokens(ExportStorageType* storage, 
+                                     const ExpressionTokenType* root,
+                                     const ExpressionVariablesArrayType* varsArr,
+                                     ExportOperandType* result)
+{
+    assert(storage);
+    assert(root);
+    assert(varsArr);
+    assert(result);
+
+    if (!IS_OP(root))
+    {
+        *result = ExportLeaf(storage, root, varsArr);
+        return ExpressionErrors::NO_ERR;
+    }
+
+    ExpressionErrors err = ExpressionErrors::NO_ERR;
+
+    TokensStackType<ExportFrameType> stack;
+    VectorCtor(&stack);
+
+    // exported sons wait for their parent in the operands stack
+    TokensStackType<ExportOperandType> operands;
+    VectorCtor(&operands);
+
+    if (VectorPush(&stack, ExportFrameType{root, 0}) != VectorErrors::VECTOR_NO_ERR)
+        err = ExpressionErrors::MEM_ERR;
+
+    while (!VectorIsEmpty(&stack) && err == ExpressionErrors::NO_ERR)
+    {
+        ExportFrameType* frame = TokensStackTop(&stack);
+        const ExpressionTokenType* token = frame->token;
+
+        if (frame->stage < 2)
+        {
+            const ExpressionTokenType* son = frame->stage == 0 ? L(token) : R(token);
+            frame->stage++;
+
+            if (son == nullptr)
+                continue;
+
+            VectorErrors pushErr = IS_OP(son) ? 
+                                   VectorPush(&stack,    ExportFrameType{son, 0}) :
+                                   VectorPush(&operands, ExportLeaf(storage, son, varsArr));
+
+            if (pushErr != VectorErrors::VECTOR_NO_ERR)
+                err = ExpressionErrors::MEM_ERR;
+
+            continue;
+        }
+
+        TokensStackPop(&stack);
+
+        ExportTemporaryType temporary = {};
+        temporary.operation = OP(token);
+        temporary.hasRight  = R(token) != nullptr;
+
+        if (temporary.hasRight)
+            temporary.right = TokensStackPop(&operands);
+
+        temporary.left = TokensStackPop(&operands);
+
+        size_t index = 0;
+        err = ExportTemporaryFindOrAdd(storage, &temporary, &index);
+
+        if (err == ExpressionErrors::NO_ERR &&
+            VectorPush(&operands, ExportOperandType{ExpressionTokenValueTypeof::OPERATION, 
+                                                    0, index}) != VectorErrors::VECTOR_NO_ERR)
+            err = ExpressionErrors::MEM_ERR;
+    }
+
+    if (err == ExpressionErrors::NO_ERR)
+        *result = TokensStackPop(&operands);
+
+    VectorDtor(&operands);
+    VectorDtor(&stack);
+
+    return err;
+}
+
+static ExportOperandType ExportLeaf(ExportStorageType* storage, const ExpressionTokenType* token,
+                                    const ExpressionVariablesArrayType* varsArr)
+{
+    assert(storage);
+    assert(token);
+    assert(varsArr);
+
+    if (IS_VAL(token))
+        return ExportOperandType{ExpressionTokenValueTypeof::VALUE, VAL(token), 0};
+
+    assert(IS_VAR(token));
+
+    size_t index = (size_t)(token->value.varPtr - varsArr->data);
+    assert(index < storage->variablesCount);
+
+    storage->variableIsUsed[index] = true;
+
+    return ExportOperandType{ExpressionTokenValueTypeof::VARIABLE, 0, index};
+}
+
+//---------------------------------------------------------------------------------------
+
+static ExpressionErrors ExportTemporaryFindOrAdd(ExportStorageType* storage, 
+                                                 const ExportTemporaryType* temporary,
+                                                 size_t* index)
+{
+    assert(storage);
+    assert(temporary);
+    assert(index);
+
+    HashType hash = ExportTemporaryHash(temporary);
+    size_t mask   = storage->slotsCapacity - 1;
+
+    for (size_t slot = hash & mask; storage->slots[slot] != 0; slot = (slot + 1) & mask)
+    {
+        const ExportTemporaryType* candidate = storage->temporaries.data + 
+                                               storage->slots[slot] - 1;
+
+        if (candidate->hash == hash && ExportTemporaryEqual(candidate, temporary))
+        {
+            *index = storage->slots[slot] - 1;
+            return ExpressionErrors::NO_ERR;
+        }
+    }
+
+    ExportTemporaryType newTemporary = *temporary;
+    newTemporary.hash = hash;
+
+    if (VectorPush(&storage->temporaries, newTemporary) != VectorErrors::VECTOR_NO_ERR)
+        return ExpressionErrors::MEM_ERR;
+
+    *index = storage->temporaries.size - 1;
+
+    // load factor is kept under 1/2
+    if (2 * storage->temporaries.size > storage->slotsCapacity)
+        return ExportSlotsGrow(storage);
+
+    size_t slot = hash & mask;
+    while (storage->slots[slot] != 0)
+        slot = (slot + 1) & mask;
+
+    storage->slots[slot] = *index + 1;
+
+    return ExpressionErrors::NO_ERR;
+}
+
+// rebuilds the table twice as big with all temporaries
+static ExpressionErrors ExportSlotsGrow(ExportStorageType* storage)
+{
+    assert(storage);
+
+    size_t  newCapacity = 2 * storage->slotsCapacity;
+    size_t* newSlots    = (size_t*)calloc(newCapacity, sizeof(*newSlots));
+
+    if (newSlots == nullptr)
+        return ExpressionErrors::MEM_ERR;
+
+    for (size_t i = 0; i < storage->temporaries.size; ++i)
+    {
+        size_t slot = storage->temporaries.data[i].hash & (newCapacity - 1);
+
+        while (newSlots[slot] != 0)
+            slot = (slot + 1) & (newCapacity - 1);
+
+        newSlots[slot] = i + 1;
+    }
+
+    free(storage->slots);
+
+    storage->slots         = newSlots;
+    storage->slotsCapacity = newCapacity;
+
+    return ExpressionErrors::NO_ERR;
+}
+
+static HashType ExportTemporaryHash(const ExportTemporaryType* temporary)
+{
+    assert(temporary);
+
+    // hashing only meaningful fields, padding of the struct is not initialized
+    struct
+    {
+        double   leftValue;
+        double   rightValue;
+        uint64_t leftIndex;
+        uint64_t rightIndex;
+        int      operation;
+        int      leftValueType;
+        int      rightValueType;
+        int      hasRight;
+    } key = 
+    {
+        temporary->left.value,  temporary->right.value, 
+        temporary->left.index,  temporary->right.index,
+        (int)temporary->operation, 
+        (int)temporary->left.valueType, (int)temporary->right.valueType,
+        (int)temporary->hasRight,
+    };
+
+    return MurmurHash(&key, sizeof(key));
+}
+
+static bool ExportTemporaryEqual(const ExportTemporaryType* temporary1, 
+                                 const ExportTemporaryType* temporary2)
+{
+    assert(temporary1);
+    assert(temporary2);
+
+    return temporary1->operation == temporary2->operation &&
+           temporary1->hasRight  == temporary2->hasRight  &&
+           ExportOperandEqual(&temporary1->left, &temporary2->left) &&
+           (!temporary1->hasRight || ExportOperandEqual(&temporary1->right, &temporary2->right));
+}
+
+static bool ExportOperandEqual(const ExportOperandType* operand1, 
+                               const ExportOperandType* operand2)
+{
+    assert(operand1);
+    assert(operand2);
+
+    if (operand1->valueType != operand2->valueType)
+        return false;
+
+    // numbers are equal only if they are printed the same
+    if (operand1->valueType == ExpressionTokenValueTypeof::VALUE)
+        return memcmp(&operand1->value, &operand2->value, sizeof(operand1->value)) == 0;
+
+    return operand1->index == operand2->index;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void ExportPrintPrelude(OutputBufferType* outBuffer)
+{
+    assert(outBuffer);
+
+    OutputBufferPutString(outBuffer, 
+        "#include <math.h>\n"
+        "#include <stddef.h>\n"
+        "\n"
+        "static inline double ExpressionLog(const double base, const double x)\n"
+        "{\n"
+        "    return log(x) / log(base);\n"
+        "}\n"
+        "\n"
+        "static inline double ExpressionCot(const double x)\n"
+        "{\n"
+        "    return 1 / tan(x);\n"
+        "}\n"
+        "\n"
+        "static inline double ExpressionArccot(const double x)\n"
+        "{\n");
+
+    // the same pi as in ExpressionCalculate, so compiled function gives the same values
+    OutputBufferPrintf(outBuffer, "    return %.17g / 2 - atan(x);\n", PI);
+
+    OutputBufferPutString(outBuffer, "}\n\n");
+}
+
+static void ExportPrintVariables(const ExportStorageType* storage, 
+                                 const ExpressionVariablesArrayType* varsArr,
+                                 const bool isBatch, OutputBufferType* outBuffer)
+{
+    assert(storage);
+    assert(varsArr);
+    assert(outBuffer);
+
+    for (size_t i = 0; i < storage->variablesCount; ++i)
+    {
+        if (!storage->variableIsUsed[i])
+            continue;
+
+        if (isBatch)
+            OutputBufferPrintf(outBuffer, "    const double* const variables%zu = variables[%zu];", 
+                                                                                            i, i);
+        else
+            OutputBufferPrintf(outBuffer, "    const double v%zu = variables[%zu];", i, i);
+
+        OutputBufferPrintf(outBuffer, " // %s\n", varsArr->data[i].variableName);
+    }
+}
+
+static void ExportPrintTemporaries(const ExportStorageType* storage, const char* indent,
+                                   OutputBufferType* outBuffer)
+{
+    assert(storage);
+    assert(indent);
+    assert(outBuffer);
+
+    for (size_t i = 0; i < storage->temporaries.size; ++i)
+    {
+        const ExportTemporaryType* temporary = storage->temporaries.data + i;
+
+        OutputBufferPrintf(outBuffer, "%sconst double t%zu = ", indent, i);
+
+        #define GENERATE_OPERATION_CMD(NAME, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11,    \
+                                       v12, v13, v14, v15, C_NAME, C_FORMAT, ...)               \
+            case ExpressionOperationId::NAME:                                                   \
+                if (ExpressionOperationFormat::C_FORMAT == ExpressionOperationFormat::INFIX)    \
+                {                                                                               \
+                    ExportPrintOperand(&temporary->left, outBuffer);                            \
+                    OutputBufferPutString(outBuffer, " " C_NAME " ");                           \
+                    ExportPrintOperand(&temporary->right, outBuffer);                           \
+                    break;                                                                      \
+                }                                                                               \
+                                                                                                \
+                OutputBufferPutString(outBuffer, C_NAME "(");                                   \
+                ExportPrintOperand(&temporary->left, outBuffer);                                \
+                                                                                                \
+                if (temporary->hasRight)                                                        \
+                {                                                                               \
+                    OutputBufferPutString(outBuffer, ", ");                                     \
+                    ExportPrintOperand(&temporary->right, outBuffer);                           \
+                }                                                                               \
+                                                                                                \
+                OutputBufferPutChar(outBuffer, ')');                                            \
+                break;
+
+        switch (temporary->operation)
+        {
+            #include "Operations.h"
+
+            default:
+                assert(0 && "unknown operation");
+                break;
+        }
+
+        #undef GENERATE_OPERATION_CMD
+
+        OutputBufferPutString(outBuffer, ";\n");
+    }
+}
+
+static void ExportPrintOperand(const ExportOperandType* operand, OutputBufferType* outBuffer)
+{
+    assert(operand);
+    assert(outBuffer);
+
+    switch (operand->valueType)
+    {
+        case ExpressionTokenValueTypeof::VALUE:
+        {
+            if (isnan(operand->value))
+            {
+                OutputBufferPutString(outBuffer, "NAN");
+                break;
+            }
+
+            if (isinf(operand->value))
+            {
+                OutputBufferPutString(outBuffer, operand->value > 0 ? "INFINITY" : "(-INFINITY)");
+                break;
+            }
+
+            static const size_t maxValueLength = 32;
+            char valueString[maxValueLength] = "";
+
+            snprintf(valueString, maxValueLength, "%.17g", operand->value);
+
+            // literal without point is integer in C
+            const char* suffix = strpbrk(valueString, ".e") ? "" : ".0";
+
+            if (signbit(operand->value))
+                OutputBufferPrintf(outBuffer, "(%s%s)", valueString, suffix);
+            else
+                OutputBufferPrintf(outBuffer, "%s%s", valueString, suffix);
+
+            break;
+        }
+
+        case ExpressionTokenValueTypeof::VARIABLE:
+            OutputBufferPrintf(outBuffer, "v%zu", operand->index);
+            break;
+
+        case ExpressionTokenValueTypeof::OPERATION:
+            OutputBufferPrintf(outBuffer, "t%zu", operand->index);
+            break;
+
+        default:
+            break;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionCompile(const ExpressionType* expression,
+                                   ExpressionCompiledType* compiled,
+                                   const ExpressionCompileParamsType* params)
+{
+    assert(expression);
+    assert(compiled);
+
+    ExpressionCompileParamsType usedParams = {};
+
+    if (params != nullptr)
+        usedParams = *params;
+
+    if (usedParams.compiler == nullptr)
+        usedParams.compiler = getenv("CC") ? getenv("CC") : COMPILE_DEFAULT_COMPILER;
+    if (usedParams.flags == nullptr)
+        usedParams.flags    = COMPILE_DEFAULT_FLAGS;
+    if (usedParams.cacheDir == nullptr)
+        usedParams.cacheDir = COMPILE_DEFAULT_CACHE_DIR;
+
+    if (mkdir(usedParams.cacheDir, 0755) != 0 && errno != EEXIST)
+        return ExpressionErrors::COMPILE_ERR;
+
+    OutputBufferType source = {};
+
+    if (!OutputBufferCtor(&source))
+        return ExpressionErrors::MEM_ERR;
+
+    // compiler and flags are part of the source, so they are a part of the cache key too
+    OutputBufferPrintf(&source, "// %s %s\n", usedParams.compiler, usedParams.flags);
+
+    ExpressionErrors err = ExpressionExportC(expression, &source);
+
+    if (err != ExpressionErrors::NO_ERR)
+    {
+        OutputBufferDtor(&source);
+        return err;
+    }
+
+    HashType hash = MurmurHash(source.data, source.size);
+
+    static char sourceName [COMPILE_MAX_PATH_LENGTH] = "";
+    static char libraryName[COMPILE_MAX_PATH_LENGTH] = "";
+
+    int sourceNameLength  = snprintf(sourceName,  COMPILE_MAX_PATH_LENGTH, "%s/%016llx.c",
+                                     usedParams.cacheDir, (unsigned long long)hash);
+    int libraryNameLength = snprintf(libraryName, COMPILE_MAX_PATH_LENGTH, "%s/%016llx.so",
+                                     usedParams.cacheDir, (unsigned long long)hash);
+
+    // cut names would point to some other files
+    if (sourceNameLength  < 0 || (size_t)sourceNameLength  >= COMPILE_MAX_PATH_LENGTH ||
+        libraryNameLength < 0 || (size_t)libraryNameLength >= COMPILE_MAX_PATH_LENGTH)
+    {
+        OutputBufferDtor(&source);
+        return ExpressionErrors::COMPILE_ERR;
+    }
+
+    if (!ExpressionCompiledIsCached(sourceName, &source))
+        err = ExpressionCompileSource(sourceName, libraryName, &source, &usedParams);
+
+    if (err == ExpressionErrors::NO_ERR)
+        err = ExpressionCompiledLoad(libraryName, compiled);
+
+    OutputBufferDtor(&source);
+
+    return err;
+}
+
+void ExpressionCompiledDtor(ExpressionCompiledType* compiled)
+{
+    assert(compiled);
+
+    if (compiled->library)
+        dlclose(compiled->library);
+
+    compiled->library   = nullptr;
+    compiled->func      = nullptr;
+    compiled->batchFunc = nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+
+// source is kept next to the library and compared on load, so hash collisions are harmless
+static bool ExpressionCompiledIsCached(const char* sourceName, const OutputBufferType* source)
+{
+    assert(sourceName);
+    assert(source);
+
+    FILE* inStream = fopen(sourceName, "rb");
+
+    if (inStream == nullptr)
+        return false;
+
+    MappedTextType cachedSource = {};
+    bool isCached = MappedTextCtor(&cachedSource, inStream) == 0 &&
+                    cachedSource.textSz == source->size &&
+                    memcmp(cachedSource.text, source->data, source->size) == 0;
+
+    MappedTextDtor(&cachedSource);
+    fclose(inStream);
+
+    return isCached;
+}
+
+// Compiler writes to temporary files that are renamed then, library is renamed first,
+// so the source in the cache always has its library.
+static ExpressionErrors ExpressionCompileSource(const char* sourceName, const char* libraryName,
+                                                const OutputBufferType* source,
+                                                const ExpressionCompileParamsType* params)
+{
+    assert(sourceName);
+    assert(libraryName);
+    assert(source);
+    assert(params);
+
+    static unsigned long long tmpFileIndex = 0;
+
+    static char tmpSourceName [COMPILE_MAX_PATH_LENGTH]    = "";
+    static char tmpLibraryName[COMPILE_MAX_PATH_LENGTH]    = "";
+    static char command       [COMPILE_MAX_COMMAND_LENGTH] = "";
+
+    int tmpSourceNameLength  = snprintf(tmpSourceName,  COMPILE_MAX_PATH_LENGTH, 
+                                        "%s.tmp.%ld.%llu.c",  libraryName,
+                                        (long)getpid(), tmpFileIndex);
+    int tmpLibraryNameLength = snprintf(tmpLibraryName, COMPILE_MAX_PATH_LENGTH, 
+                                        "%s.tmp.%ld.%llu.so", libraryName,
+                                        (long)getpid(), tmpFileIndex);
+    tmpFileIndex++;
+
+    if (tmpSourceNameLength  < 0 || (size_t)tmpSourceNameLength  >= COMPILE_MAX_PATH_LENGTH ||
+        tmpLibraryNameLength < 0 || (size_t)tmpLibraryNameLength >= COMPILE_MAX_PATH_LENGTH)
+        return ExpressionErrors::COMPILE_ERR;
+
+    FILE* outStream = fopen(tmpSourceName, "w");
+
+    if (outStream == nullptr)
+        return ExpressionErrors::COMPILE_ERR;
+
+    bool writeFailed = fwrite(source->data, sizeof(*source->data), source->size, outStream) 
+                                                                            != source->size;
+
+    if (fclose(outStream) != 0 || writeFailed)
+    {
+        unlink(tmpSourceName);
+        return ExpressionErrors::COMPILE_ERR;
+    }
+
+    int commandLength = snprintf(command, COMPILE_MAX_COMMAND_LENGTH, 
+                                 "%s %s -fPIC -shared -o '%s' '%s' -lm",
+                                 params->compiler, params->flags, tmpLibraryName, tmpSourceName);
+
+    // cut command could even run without the output file or with the half of the flags
+    if (commandLength < 0 || (size_t)commandLength >= COMPILE_MAX_COMMAND_LENGTH)
+    {
+        unlink(tmpSourceName);
+        return ExpressionErrors::COMPILE_ERR;
+    }
+
+    ExpressionErrors err = ExpressionErrors::NO_ERR;
+
+    if (system(command) != 0 || rename(tmpLibraryName, libraryName) != 0 ||
+                                rename(tmpSourceName,  sourceName)  != 0)
+        err = ExpressionErrors::COMPILE_ERR;
+
+    unlink(tmpLibraryName);
+    unlink(tmpSourceName);
+
+    return err;
+}
+
+static ExpressionErrors ExpressionCompiledLoad(const char* libraryName, 
+                                               ExpressionCompiledType* compiled)
+{
+    assert(libraryName);
+    assert(compiled);
+
+    // library of the other expression has the same names, so they are kept local
+    void* library = dlopen(libraryName, RTLD_NOW | RTLD_LOCAL);
+
+    if (library == nullptr)
+        return ExpressionErrors::COMPILE_ERR;
+
+    ExpressionCompiledType loaded = {};
+    loaded.library = library;
+
+    if (!ExpressionCompiledLoadSymbol(library, COMPILED_FUNC_NAME,       &loaded.func) ||
+        !ExpressionCompiledLoadSymbol(library, COMPILED_BATCH_FUNC_NAME, &loaded.batchFunc))
+    {
+        dlclose(library);
+        return ExpressionErrors::COMPILE_ERR;
+    }
+
+    *compiled = loaded;
+
+    return ExpressionErrors::NO_ERR;
+}
+
+// function pointers are copied from void* as bytes, casting them is only conditionally supported
+static bool ExpressionCompiledLoadSymbol(void* library, const char* name, void* funcPtr)
+{
+    assert(library);
+    assert(name);
+    assert(funcPtr);
+
+    void* symbol = dlsym(library, name);
+
+    if (symbol == nullptr)
+        return false;
+
+    static_assert(sizeof(symbol) == sizeof(ExpressionCompiledFuncType*), 
+                  "function pointers differ from data pointers");
+
+    memcpy(funcPtr, &symbol, sizeof(symbol));
+
+    return true;
+}
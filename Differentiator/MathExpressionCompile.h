@@ -0,0 +1,46 @@
+#ifndef MATH_EXPRESSION_COMPILE_H
+#define MATH_EXPRESSION_COMPILE_H
+
+#include <stdio.h>
+
+#include "MathExpressionsMain.h"
+#include "Common/OutputBuffer.h"
+
+// Expression exported to C and compiled ahead of time to a shared object by the installed
+// compiler. Variables are passed by their indices in expression's variables array.
+
+// variables[i] - value of the i-th variable
+typedef double (ExpressionCompiledFuncType)(const double* variables);
+
+// results[j] - value in the j-th point, variables[i][j] - value of the i-th variable in it.
+// Arrays of variables that are not used in the expression are not read.
+typedef void (ExpressionCompiledBatchFuncType)(const double* const* variables, double* results,
+                                               size_t count);
+
+struct ExpressionCompiledType
+{
+    void* library;
+
+    ExpressionCompiledFuncType*      func;
+    ExpressionCompiledBatchFuncType* batchFunc;
+};
+
+struct ExpressionCompileParamsType
+{
+    const char* compiler;       // nullptr - $CC or cc
+    const char* flags;          // nullptr - optimization for the current machine
+    const char* cacheDir;       // nullptr - "CompiledExpressions"
+};
+
+// C source of both functions, common subexpressions are calculated once
+ExpressionErrors ExpressionExportC(const ExpressionType* expression, OutputBufferType* outBuffer);
+ExpressionErrors ExpressionExportC(const ExpressionType* expression, FILE* outStream = stdout);
+
+// Shared objects are cached in cacheDir by hash of the source,
+// so every expression is compiled once
+ExpressionErrors ExpressionCompile(const ExpressionType* expression,
+                                   ExpressionCompiledType* compiled,
+                                   const ExpressionCompileParamsType* params = nullptr);
+void             ExpressionCompiledDtor(ExpressionCompiledType* compiled);
+
+#endif
@@ -0,0 +1,1033 @@
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "MathExpressionEGraph.h"
+#include "MathExpressionCalculations.h"
+#include "MathExpressionTexDump.h"
+#include "Common/DoubleFuncs.h"
+#include "Vector/HashFuncs.h"
+
+#include "DSL.h"
+
+static const size_t EGRAPH_NONE             = (size_t)-1;
+static const size_t EGRAPH_MAX_PATTERN_VARS = 8;
+static const double EGRAPH_NODE_COST        = 1e-3;
+
+static const ExpressionEGraphParamsType EGraphDefaultParams =
+{
+    20000,      // maxNodes
+    16,         // maxIterations
+    0.2,        // maxTime
+    ExpressionEGraphCostModel::EVALUATION,
+};
+
+//---------------------------------------------------------------------------------------
+
+enum class EGraphPatternTypeof
+{
+    VARIABLE,
+    VALUE,
+    OPERATION,
+};
+
+struct EGraphPatternType
+{
+    EGraphPatternTypeof type;
+
+    double                value;
+    ExpressionOperationId operation;
+    size_t                varId;
+
+    size_t left;
+    size_t right;
+};
+
+struct EGraphPatternPoolType
+{
+    EGraphPatternType* data;
+
+    size_t size;
+    size_t capacity;
+};
+
+struct EGraphRuleType
+{
+    const char* leftString;
+    const char* rightString;
+
+    size_t left;
+    size_t right;
+};
+
+#define GENERATE_EGRAPH_RULE(LEFT, RIGHT) {LEFT, RIGHT, EGRAPH_NONE, EGRAPH_NONE},
+
+static EGraphRuleType EGraphRules[] =
+{
+    #include "EGraphRules.h"
+};
+
+#undef GENERATE_EGRAPH_RULE
+
+static const size_t EGraphRulesCount = sizeof(EGraphRules) / sizeof(*EGraphRules);
+
+static EGraphPatternPoolType EGraphPatterns = {};
+
+//---------------------------------------------------------------------------------------
+
+// class data is valid only in the node which is the representative of the class,
+// node i always starts its own class i, so the class list starts with the representative
+struct EGraphNodeType
+{
+    ExpressionTokenValue       value;
+    ExpressionTokenValueTypeof valueType;
+
+    size_t left;
+    size_t right;
+
+    bool isDuplicate;
+    size_t nextInClass;
+
+    size_t parent;
+    size_t lastInClass;
+
+    bool   hasConst;
+    double constValue;
+
+    double cost;
+    size_t bestNode;
+};
+
+struct EGraphType
+{
+    EGraphNodeType* nodes;
+
+    size_t size;
+    size_t capacity;
+
+    size_t* table;
+    size_t  tableCapacity;
+
+    ExpressionEGraphCostModel costModel;
+
+    bool memError;
+};
+
+struct EGraphMatchType
+{
+    size_t classId;
+    size_t vars[EGRAPH_MAX_PATTERN_VARS];
+};
+
+struct EGraphMatchArrType
+{
+    EGraphMatchType* data;
+
+    size_t size;
+    size_t capacity;
+};
+
+struct EGraphNodeKeyType
+{
+    uint64_t valueType;
+    uint64_t value;
+    uint64_t left;
+    uint64_t right;
+};
+
+//---------------------------------------------------------------------------------------
+
+static ExpressionErrors EGraphRulesInit();
+static size_t           EGraphPatternParse(const char** string);
+
+static ExpressionErrors EGraphCtor(EGraphType* graph, ExpressionEGraphCostModel costModel);
+static void             EGraphDtor(EGraphType* graph);
+
+static size_t EGraphFind (EGraphType* graph, size_t classId);
+static bool   EGraphUnion(EGraphType* graph, size_t first, size_t second);
+
+static size_t EGraphAddNode (EGraphType* graph, ExpressionTokenValue value,
+                                                ExpressionTokenValueTypeof valueType,
+                                                size_t left, size_t right);
+static size_t EGraphAddToken(EGraphType* graph, const ExpressionTokenType* token);
+
+static EGraphNodeKeyType EGraphNodeGetKey(EGraphType* graph, size_t nodeId);
+static size_t*           EGraphTableFind (EGraphType* graph, const EGraphNodeKeyType* key);
+static void              EGraphTableFill (EGraphType* graph, bool mergeDuplicates,
+                                                             bool* merged);
+
+static bool EGraphRebuild(EGraphType* graph);
+static bool EGraphFoldConstants(EGraphType* graph);
+static bool EGraphOperationInDomain(ExpressionOperationId operation, double val1, double val2);
+
+static void   EGraphMatch(EGraphType* graph, size_t patternId, size_t classId,
+                          const EGraphMatchType* match, EGraphMatchArrType* matches);
+static void   EGraphMatchPush(EGraphType* graph, EGraphMatchArrType* matches,
+                              const EGraphMatchType* match);
+static size_t EGraphInstantiate(EGraphType* graph, size_t patternId,
+                                const EGraphMatchType* match);
+
+static void EGraphSaturate(EGraphType* graph, const ExpressionEGraphParamsType* params);
+
+static ExpressionTokenType* EGraphExtract   (EGraphType* graph, size_t rootClass);
+static ExpressionTokenType* EGraphBuildToken(EGraphType* graph, size_t classId);
+static double               EGraphNodeCost  (const EGraphType* graph, const EGraphNodeType* node,
+                                             double leftCost, double rightCost);
+static double               EGraphOperationEvalCost(ExpressionOperationId operation);
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionEGraphOptimize(ExpressionType* expression,
+                                          const ExpressionEGraphParamsType* params)
+{
+    assert(expression);
+
+    if (expression->root == nullptr)
+        return ExpressionErrors::NO_ERR;
+
+    if (params == nullptr)
+        params = &EGraphDefaultParams;
+
+    ExpressionErrors err = EGraphRulesInit();
+    if (err != ExpressionErrors::NO_ERR)
+        return err;
+
+    EGraphType graph = {};
+    err = EGraphCtor(&graph, params->costModel);
+    if (err != ExpressionErrors::NO_ERR)
+        return err;
+
+    size_t rootClass = EGraphAddToken(&graph, expression->root);
+    EGraphRebuild(&graph);
+
+    EGraphSaturate(&graph, params);
+
+    ExpressionTokenType* optimizedRoot = nullptr;
+    if (!graph.memError)
+        optimizedRoot = EGraphExtract(&graph, rootClass);
+
+    bool memError = graph.memError;
+    EGraphDtor(&graph);
+
+    if (memError || optimizedRoot == nullptr)
+    {
+        ExpressionDtor(optimizedRoot);
+        return ExpressionErrors::MEM_ERR;
+    }
+
+    ExpressionDtor(expression->root);
+    expression->root = optimizedRoot;
+
+    return ExpressionErrors::NO_ERR;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void EGraphSaturate(EGraphType* graph, const ExpressionEGraphParamsType* params)
+{
+    assert(graph);
+    assert(params);
+
+    clock_t startTime = clock();
+
+    #define BUDGET_EXCEEDED()                                                           \
+        (graph->memError || graph->size >= params->maxNodes ||                          \
+         (double)(clock() - startTime) / CLOCKS_PER_SEC > params->maxTime)
+
+    for (size_t iteration = 0; iteration < params->maxIterations; ++iteration)
+    {
+        size_t prevSize = graph->size;
+        bool   changed  = false;
+
+        for (size_t ruleId = 0; ruleId < EGraphRulesCount && !BUDGET_EXCEEDED(); ++ruleId)
+        {
+            EGraphMatchArrType matches = {};
+
+            for (size_t classId = 0; classId < graph->size; ++classId)
+            {
+                if (graph->nodes[classId].parent != classId)
+                    continue;
+
+                EGraphMatchType match = {};
+                match.classId = classId;
+                for (size_t i = 0; i < EGRAPH_MAX_PATTERN_VARS; ++i)
+                    match.vars[i] = EGRAPH_NONE;
+
+                EGraphMatch(graph, EGraphRules[ruleId].left, classId, &match, &matches);
+            }
+
+            for (size_t i = 0; i < matches.size && !BUDGET_EXCEEDED(); ++i)
+            {
+                size_t rightClass = EGraphInstantiate(graph, EGraphRules[ruleId].right,
+                                                      &matches.data[i]);
+
+                if (rightClass != EGRAPH_NONE)
+                    changed |= EGraphUnion(graph, matches.data[i].classId, rightClass);
+            }
+
+            free(matches.data);
+        }
+
+        changed |= EGraphRebuild(graph);
+
+        if (BUDGET_EXCEEDED() || (!changed && graph->size == prevSize))
+            break;
+    }
+
+    #undef BUDGET_EXCEEDED
+}
+
+//---------------------------------------------------------------------------------------
+
+static ExpressionErrors EGraphRulesInit()
+{
+    if (EGraphPatterns.data != nullptr)
+        return ExpressionErrors::NO_ERR;
+
+    static const size_t startCapacity = 256;
+
+    EGraphPatterns.data     = (EGraphPatternType*) calloc(startCapacity,
+                                                          sizeof(*EGraphPatterns.data));
+    EGraphPatterns.capacity = startCapacity;
+    EGraphPatterns.size     = 0;
+
+    if (EGraphPatterns.data == nullptr)
+        return ExpressionErrors::MEM_ERR;
+
+    for (size_t i = 0; i < EGraphRulesCount; ++i)
+    {
+        const char* string = EGraphRules[i].leftString;
+        EGraphRules[i].left  = EGraphPatternParse(&string);
+
+        string = EGraphRules[i].rightString;
+        EGraphRules[i].right = EGraphPatternParse(&string);
+
+        if (EGraphRules[i].left == EGRAPH_NONE || EGraphRules[i].right == EGRAPH_NONE)
+            return ExpressionErrors::MEM_ERR;
+    }
+
+    return ExpressionErrors::NO_ERR;
+}
+
+static size_t EGraphPatternParse(const char** string)
+{
+    assert(string);
+    assert(*string);
+
+    const char* stringPtr = *string;
+    while (*stringPtr == ' ')
+        stringPtr++;
+
+    EGraphPatternType pattern = {};
+    pattern.left  = EGRAPH_NONE;
+    pattern.right = EGRAPH_NONE;
+
+    if (*stringPtr == '(')
+    {
+        char operationName[32] = "";
+        int  shift = 0;
+        sscanf(stringPtr + 1, "%31[^ ()]%n", operationName, &shift);
+
+        int operationId = ExpressionOperationGetId(operationName);
+        assert(operationId != -1);
+
+        pattern.type      = EGraphPatternTypeof::OPERATION;
+        pattern.operation = (ExpressionOperationId) operationId;
+
+        stringPtr += shift + 1;
+        pattern.left = EGraphPatternParse(&stringPtr);
+        if (!ExpressionOperationIsUnary(pattern.operation))
+            pattern.right = EGraphPatternParse(&stringPtr);
+
+        while (*stringPtr == ' ')
+            stringPtr++;
+
+        assert(*stringPtr == ')');
+        stringPtr++;
+    }
+    else if (*stringPtr == '?')
+    {
+        pattern.type  = EGraphPatternTypeof::VARIABLE;
+        pattern.varId = (size_t)(stringPtr[1] - 'a');
+        assert(pattern.varId < EGRAPH_MAX_PATTERN_VARS);
+
+        stringPtr += 2;
+    }
+    else
+    {
+        char* valueEnd = nullptr;
+        pattern.type  = EGraphPatternTypeof::VALUE;
+        pattern.value = strtod(stringPtr, &valueEnd);
+        assert(valueEnd != stringPtr);
+
+        stringPtr = valueEnd;
+    }
+
+    *string = stringPtr;
+
+    if (EGraphPatterns.size == EGraphPatterns.capacity)
+    {
+        size_t newCapacity = EGraphPatterns.capacity * 2;
+        EGraphPatternType* newData = (EGraphPatternType*) realloc(EGraphPatterns.data,
+                                                        newCapacity * sizeof(*newData));
+        if (newData == nullptr)
+            return EGRAPH_NONE;
+
+        EGraphPatterns.data     = newData;
+        EGraphPatterns.capacity = newCapacity;
+    }
+
+    EGraphPatterns.data[EGraphPatterns.size] = pattern;
+
+    return EGraphPatterns.size++;
+}
+
+//---------------------------------------------------------------------------------------
+
+static ExpressionErrors EGraphCtor(EGraphType* graph, ExpressionEGraphCostModel costModel)
+{
+    assert(graph);
+
+    static const size_t startCapacity = 256;
+
+    graph->nodes         = (EGraphNodeType*) calloc(startCapacity, sizeof(*graph->nodes));
+    graph->capacity      = startCapacity;
+    graph->size          = 0;
+
+    graph->table         = (size_t*) calloc(2 * startCapacity, sizeof(*graph->table));
+    graph->tableCapacity = 2 * startCapacity;
+
+    graph->costModel = costModel;
+    graph->memError  = false;
+
+    if (graph->nodes == nullptr || graph->table == nullptr)
+    {
+        EGraphDtor(graph);
+        return ExpressionErrors::MEM_ERR;
+    }
+
+    return ExpressionErrors::NO_ERR;
+}
+
+static void EGraphDtor(EGraphType* graph)
+{
+    assert(graph);
+
+    free(graph->nodes);
+    free(graph->table);
+
+    graph->nodes         = nullptr;
+    graph->table         = nullptr;
+    graph->size          = 0;
+    graph->capacity      = 0;
+    graph->tableCapacity = 0;
+}
+
+//---------------------------------------------------------------------------------------
+
+static size_t EGraphFind(EGraphType* graph, size_t classId)
+{
+    assert(graph);
+    assert(classId < graph->size);
+
+    while (graph->nodes[classId].parent != classId)
+    {
+        size_t grandParent = graph->nodes[graph->nodes[classId].parent].parent;
+
+        graph->nodes[classId].parent = grandParent;
+        classId = grandParent;
+    }
+
+    return classId;
+}
+
+static bool EGraphUnion(EGraphType* graph, size_t first, size_t second)
+{
+    assert(graph);
+
+    first  = EGraphFind(graph, first);
+    second = EGraphFind(graph, second);
+
+    if (first == second)
+        return false;
+
+    if (second < first)
+    {
+        size_t tmp = first;
+        first  = second;
+        second = tmp;
+    }
+
+    EGraphNodeType* root  = &graph->nodes[first];
+    EGraphNodeType* child = &graph->nodes[second];
+
+    child->parent = first;
+
+    graph->nodes[root->lastInClass].nextInClass = second;
+    root->lastInClass = child->lastInClass;
+
+    if (!root->hasConst && child->hasConst)
+    {
+        root->hasConst   = true;
+        root->constValue = child->constValue;
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+
+static size_t EGraphAddToken(EGraphType* graph, const ExpressionTokenType* token)
+{
+    assert(graph);
+
+    if (token == nullptr)
+        return EGRAPH_NONE;
+
+    size_t left  = EGraphAddToken(graph, token->left);
+    size_t right = EGraphAddToken(graph, token->right);
+
+    return EGraphAddNode(graph, token->value, token->valueType, left, right);
+}
+
+static size_t EGraphAddNode(EGraphType* graph, ExpressionTokenValue value,
+                                               ExpressionTokenValueTypeof valueType,
+                                               size_t left, size_t right)
+{
+    assert(graph);
+
+    if (graph->memError)
+        return EGRAPH_NONE;
+
+    if (2 * (graph->size + 1) > graph->tableCapacity)
+    {
+        size_t  newTableCapacity = 2 * graph->tableCapacity;
+        size_t* newTable = (size_t*) realloc(graph->table, newTableCapacity * sizeof(*newTable));
+
+        if (newTable == nullptr)
+        {
+            graph->memError = true;
+            return EGRAPH_NONE;
+        }
+
+        graph->table         = newTable;
+        graph->tableCapacity = newTableCapacity;
+        EGraphTableFill(graph, false, nullptr);
+    }
+
+    if (graph->size == graph->capacity)
+    {
+        size_t newCapacity = 2 * graph->capacity;
+        EGraphNodeType* newNodes = (EGraphNodeType*) realloc(graph->nodes,
+                                                            newCapacity * sizeof(*newNodes));
+
+        if (newNodes == nullptr)
+        {
+            graph->memError = true;
+            return EGRAPH_NONE;
+        }
+
+        graph->nodes    = newNodes;
+        graph->capacity = newCapacity;
+    }
+
+    size_t nodeId = graph->size;
+    EGraphNodeType* node = &graph->nodes[nodeId];
+
+    node->value       = value;
+    node->valueType   = valueType;
+    node->left        = left  == EGRAPH_NONE ? EGRAPH_NONE : EGraphFind(graph, left);
+    node->right       = right == EGRAPH_NONE ? EGRAPH_NONE : EGraphFind(graph, right);
+    node->isDuplicate = false;
+    node->nextInClass = EGRAPH_NONE;
+    node->parent      = nodeId;
+    node->lastInClass = nodeId;
+    node->hasConst    = valueType == ExpressionTokenValueTypeof::VALUE;
+    node->constValue  = valueType == ExpressionTokenValueTypeof::VALUE ? value.value : NAN;
+    node->cost        = INFINITY;
+    node->bestNode    = EGRAPH_NONE;
+
+    graph->size++;
+
+    EGraphNodeKeyType key = EGraphNodeGetKey(graph, nodeId);
+    size_t* slot = EGraphTableFind(graph, &key);
+
+    if (*slot != 0)
+    {
+        graph->size--;
+        return EGraphFind(graph, *slot - 1);
+    }
+
+    *slot = nodeId + 1;
+
+    return nodeId;
+}
+
+//---------------------------------------------------------------------------------------
+
+static EGraphNodeKeyType EGraphNodeGetKey(EGraphType* graph, size_t nodeId)
+{
+    assert(graph);
+    assert(nodeId < graph->size);
+
+    EGraphNodeType* node = &graph->nodes[nodeId];
+    EGraphNodeKeyType key = {};
+
+    key.valueType = (uint64_t)node->valueType;
+
+    switch (node->valueType)
+    {
+        case ExpressionTokenValueTypeof::VALUE:
+        {
+            double value = node->value.value + 0.0;     // -0 and 0 are the same node
+            memcpy(&key.value, &value, sizeof(value));
+            break;
+        }
+        case ExpressionTokenValueTypeof::VARIABLE:
+            key.value = (uintptr_t)node->value.varPtr;
+            break;
+        case ExpressionTokenValueTypeof::OPERATION:
+            key.value = (uint64_t)node->value.operation;
+            break;
+
+        default:
+            break;
+    }
+
+    key.left  = node->left  == EGRAPH_NONE ? EGRAPH_NONE : EGraphFind(graph, node->left);
+    key.right = node->right == EGRAPH_NONE ? EGRAPH_NONE : EGraphFind(graph, node->right);
+
+    return key;
+}
+
+static size_t* EGraphTableFind(EGraphType* graph, const EGraphNodeKeyType* key)
+{
+    assert(graph);
+    assert(key);
+
+    size_t mask = graph->tableCapacity - 1;
+    size_t pos  = MurmurHash(key, sizeof(*key)) & mask;
+
+    while (graph->table[pos] != 0)
+    {
+        EGraphNodeKeyType otherKey = EGraphNodeGetKey(graph, graph->table[pos] - 1);
+
+        if (memcmp(&otherKey, key, sizeof(*key)) == 0)
+            break;
+
+        pos = (pos + 1) & mask;
+    }
+
+    return &graph->table[pos];
+}
+
+static void EGraphTableFill(EGraphType* graph, bool mergeDuplicates, bool* merged)
+{
+    assert(graph);
+
+    memset(graph->table, 0, graph->tableCapacity * sizeof(*graph->table));
+
+    for (size_t nodeId = 0; nodeId < graph->size; ++nodeId)
+    {
+        EGraphNodeType* node = &graph->nodes[nodeId];
+
+        if (node->isDuplicate)
+            continue;
+
+        if (node->left  != EGRAPH_NONE) node->left  = EGraphFind(graph, node->left);
+        if (node->right != EGRAPH_NONE) node->right = EGraphFind(graph, node->right);
+
+        EGraphNodeKeyType key = EGraphNodeGetKey(graph, nodeId);
+        size_t* slot = EGraphTableFind(graph, &key);
+
+        if (*slot == 0)
+        {
+            *slot = nodeId + 1;
+            continue;
+        }
+
+        if (!mergeDuplicates)
+            continue;
+
+        node->isDuplicate = true;
+
+        if (EGraphUnion(graph, nodeId, *slot - 1))
+            *merged = true;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+
+// restores congruence: nodes with equal operations and equal son classes
+// have to be in the same class
+static bool EGraphRebuild(EGraphType* graph)
+{
+    assert(graph);
+
+    bool changed = false;
+    bool merged  = true;
+
+    while (merged && !graph->memError)
+    {
+        merged = false;
+
+        EGraphTableFill(graph, true, &merged);
+
+        merged |= EGraphFoldConstants(graph);
+        changed |= merged;
+    }
+
+    return changed;
+}
+
+static bool EGraphFoldConstants(EGraphType* graph)
+{
+    assert(graph);
+
+    bool merged = false;
+    size_t size = graph->size;
+
+    for (size_t nodeId = 0; nodeId < size; ++nodeId)
+    {
+        EGraphNodeType node = graph->nodes[nodeId];
+
+        if (node.isDuplicate || node.valueType != ExpressionTokenValueTypeof::OPERATION ||
+            graph->nodes[EGraphFind(graph, nodeId)].hasConst)
+            continue;
+
+        const EGraphNodeType* left  = &graph->nodes[EGraphFind(graph, node.left)];
+        const EGraphNodeType* right = node.right == EGRAPH_NONE ? nullptr :
+                                                &graph->nodes[EGraphFind(graph, node.right)];
+
+        if (!left->hasConst || (right && !right->hasConst))
+            continue;
+
+        double val1 = left->constValue;
+        double val2 = right ? right->constValue : NAN;
+
+        if (!EGraphOperationInDomain(node.value.operation, val1, val2))
+            continue;
+
+        double result = ExpressionOperationCalculate(node.value.operation, val1, val2);
+        if (!isfinite(result))
+            continue;
+
+        size_t constClass = EGraphAddNode(graph, ExpressionTokenValueСreate(result),
+                                          ExpressionTokenValueTypeof::VALUE,
+                                          EGRAPH_NONE, EGRAPH_NONE);
+        if (constClass == EGRAPH_NONE)
+            break;
+
+        merged |= EGraphUnion(graph, nodeId, constClass);
+    }
+
+    return merged;
+}
+
+// ExpressionOperationCalculate asserts on these instead of returning nan
+static bool EGraphOperationInDomain(ExpressionOperationId operation, double val1, double val2)
+{
+    switch (operation)
+    {
+        case ExpressionOperationId::DIV:
+            return !DoubleEqual(val2, 0);
+        case ExpressionOperationId::LOG:
+            return val1 > 0 && !DoubleEqual(val1, 1);
+        case ExpressionOperationId::COT:
+            return isfinite(tan(val1)) && !DoubleEqual(tan(val1), 0);
+
+        // out of domain values give nan, it is checked after calculation
+        case ExpressionOperationId::ADD:
+        case ExpressionOperationId::SUB:
+        case ExpressionOperationId::UNARY_SUB:
+        case ExpressionOperationId::MUL:
+        case ExpressionOperationId::POW:
+        case ExpressionOperationId::LN:
+        case ExpressionOperationId::SIN:
+        case ExpressionOperationId::COS:
+        case ExpressionOperationId::TAN:
+        case ExpressionOperationId::ARCSIN:
+        case ExpressionOperationId::ARCCOS:
+        case ExpressionOperationId::ARCTAN:
+        case ExpressionOperationId::ARCCOT:
+            return true;
+
+        default:
+            break;
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void EGraphMatch(EGraphType* graph, size_t patternId, size_t classId,
+                        const EGraphMatchType* match, EGraphMatchArrType* matches)
+{
+    assert(graph);
+    assert(match);
+    assert(matches);
+    assert(patternId < EGraphPatterns.size);
+
+    const EGraphPatternType* pattern = &EGraphPatterns.data[patternId];
+    classId = EGraphFind(graph, classId);
+
+    switch (pattern->type)
+    {
+        case EGraphPatternTypeof::VARIABLE:
+        {
+            size_t boundClass = match->vars[pattern->varId];
+
+            if (boundClass == EGRAPH_NONE)
+            {
+                EGraphMatchType newMatch = *match;
+                newMatch.vars[pattern->varId] = classId;
+
+                EGraphMatchPush(graph, matches, &newMatch);
+            }
+            else if (EGraphFind(graph, boundClass) == classId)
+                EGraphMatchPush(graph, matches, match);
+
+            break;
+        }
+
+        case EGraphPatternTypeof::VALUE:
+            if (graph->nodes[classId].hasConst &&
+                DoubleEqual(graph->nodes[classId].constValue, pattern->value))
+                EGraphMatchPush(graph, matches, match);
+            break;
+
+        case EGraphPatternTypeof::OPERATION:
+            for (size_t nodeId = classId; nodeId != EGRAPH_NONE;
+                                          nodeId = graph->nodes[nodeId].nextInClass)
+            {
+                const EGraphNodeType* node = &graph->nodes[nodeId];
+
+                if (node->isDuplicate || node->valueType != OP_TYPE_CNST ||
+                    node->value.operation != pattern->operation)
+                    continue;
+
+                if (pattern->right == EGRAPH_NONE)
+                {
+                    EGraphMatch(graph, pattern->left, node->left, match, matches);
+                    continue;
+                }
+
+                EGraphMatchArrType leftMatches = {};
+                EGraphMatch(graph, pattern->left, node->left, match, &leftMatches);
+
+                for (size_t i = 0; i < leftMatches.size; ++i)
+                    EGraphMatch(graph, pattern->right, graph->nodes[nodeId].right,
+                                &leftMatches.data[i], matches);
+
+                free(leftMatches.data);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void EGraphMatchPush(EGraphType* graph, EGraphMatchArrType* matches,
+                            const EGraphMatchType* match)
+{
+    assert(graph);
+    assert(matches);
+    assert(match);
+
+    if (matches->size == matches->capacity)
+    {
+        size_t newCapacity = matches->capacity == 0 ? 8 : 2 * matches->capacity;
+        EGraphMatchType* newData = (EGraphMatchType*) realloc(matches->data,
+                                                        newCapacity * sizeof(*newData));
+
+        if (newData == nullptr)
+        {
+            graph->memError = true;
+            return;
+        }
+
+        matches->data     = newData;
+        matches->capacity = newCapacity;
+    }
+
+    matches->data[matches->size++] = *match;
+}
+
+static size_t EGraphInstantiate(EGraphType* graph, size_t patternId,
+                                const EGraphMatchType* match)
+{
+    assert(graph);
+    assert(match);
+    assert(patternId < EGraphPatterns.size);
+
+    const EGraphPatternType* pattern = &EGraphPatterns.data[patternId];
+
+    switch (pattern->type)
+    {
+        case EGraphPatternTypeof::VARIABLE:
+            assert(match->vars[pattern->varId] != EGRAPH_NONE);
+            return match->vars[pattern->varId];
+
+        case EGraphPatternTypeof::VALUE:
+            return EGraphAddNode(graph, ExpressionTokenValueСreate(pattern->value),
+                                 VAL_TYPE_CNST, EGRAPH_NONE, EGRAPH_NONE);
+
+        case EGraphPatternTypeof::OPERATION:
+        {
+            size_t left  = EGraphInstantiate(graph, pattern->left, match);
+            size_t right = EGRAPH_NONE;
+
+            if (pattern->right != EGRAPH_NONE)
+                right = EGraphInstantiate(graph, pattern->right, match);
+
+            if (left == EGRAPH_NONE || (pattern->right != EGRAPH_NONE && right == EGRAPH_NONE))
+                return EGRAPH_NONE;
+
+            return EGraphAddNode(graph, ExpressionTokenValueСreate(pattern->operation),
+                                 OP_TYPE_CNST, left, right);
+        }
+
+        default:
+            break;
+    }
+
+    return EGRAPH_NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+static ExpressionTokenType* EGraphExtract(EGraphType* graph, size_t rootClass)
+{
+    assert(graph);
+
+    bool updated = true;
+    while (updated)
+    {
+        updated = false;
+
+        for (size_t nodeId = 0; nodeId < graph->size; ++nodeId)
+        {
+            const EGraphNodeType* node = &graph->nodes[nodeId];
+
+            if (node->isDuplicate)
+                continue;
+
+            double leftCost  = 0;
+            double rightCost = 0;
+
+            if (node->left  != EGRAPH_NONE)
+                leftCost  = graph->nodes[EGraphFind(graph, node->left)].cost;
+            if (node->right != EGRAPH_NONE)
+                rightCost = graph->nodes[EGraphFind(graph, node->right)].cost;
+
+            if (!isfinite(leftCost) || !isfinite(rightCost))
+                continue;
+
+            double cost = EGraphNodeCost(graph, node, leftCost, rightCost);
+
+            EGraphNodeType* classNode = &graph->nodes[EGraphFind(graph, nodeId)];
+            if (cost < classNode->cost)
+            {
+                classNode->cost     = cost;
+                classNode->bestNode = nodeId;
+                updated = true;
+            }
+        }
+    }
+
+    return EGraphBuildToken(graph, EGraphFind(graph, rootClass));
+}
+
+static ExpressionTokenType* EGraphBuildToken(EGraphType* graph, size_t classId)
+{
+    assert(graph);
+
+    size_t bestNode = graph->nodes[EGraphFind(graph, classId)].bestNode;
+    assert(bestNode != EGRAPH_NONE);
+
+    EGraphNodeType node = graph->nodes[bestNode];
+
+    ExpressionTokenType* left  = nullptr;
+    ExpressionTokenType* right = nullptr;
+
+    if (node.left  != EGRAPH_NONE) left  = EGraphBuildToken(graph, node.left);
+    if (node.right != EGRAPH_NONE) right = EGraphBuildToken(graph, node.right);
+
+    return ExpressionTokenCreate(node.value, node.valueType, left, right);
+}
+
+static double EGraphNodeCost(const EGraphType* graph, const EGraphNodeType* node,
+                             double leftCost, double rightCost)
+{
+    assert(graph);
+    assert(node);
+
+    if (graph->costModel == ExpressionEGraphCostModel::TEX_LENGTH)
+    {
+        switch (node->valueType)
+        {
+            case ExpressionTokenValueTypeof::VALUE:
+                return 1;
+            case ExpressionTokenValueTypeof::VARIABLE:
+                return (double)strlen(node->value.varPtr->variableName);
+            case ExpressionTokenValueTypeof::OPERATION:
+                return (double)ExpressionLatexGetLen(node->value.operation,
+                                                     (size_t)leftCost, (size_t)rightCost) +
+                       EGRAPH_NODE_COST;
+
+            default:
+                break;
+        }
+
+        return INFINITY;
+    }
+
+    if (node->valueType != ExpressionTokenValueTypeof::OPERATION)
+        return 0;
+
+    return EGraphOperationEvalCost(node->value.operation) + leftCost + rightCost +
+           EGRAPH_NODE_COST;
+}
+
+static double EGraphOperationEvalCost(ExpressionOperationId operation)
+{
+    switch (operation)
+    {
+        case ExpressionOperationId::ADD:
+        case ExpressionOperationId::SUB:
+        case ExpressionOperationId::UNARY_SUB:
+        case ExpressionOperationId::MUL:
+            return 1;
+
+        case ExpressionOperationId::DIV:
+            return 4;
+
+        case ExpressionOperationId::POW:
+            return 10;
+
+        case ExpressionOperationId::LN:
+        case ExpressionOperationId::SIN:
+        case ExpressionOperationId::COS:
+        case ExpressionOperationId::TAN:
+        case ExpressionOperationId::COT:
+        case ExpressionOperationId::ARCSIN:
+        case ExpressionOperationId::ARCCOS:
+        case ExpressionOperationId::ARCTAN:
+        case ExpressionOperationId::ARCCOT:
+            return 20;
+
+        case ExpressionOperationId::LOG:
+            return 40;
+
+        default:
+            break;
+    }
+
+    return 20;
+}
@@ -0,0 +1,24 @@
+#ifndef MATH_EXPRESSION_EGRAPH_H
+#define MATH_EXPRESSION_EGRAPH_H
+
+#include "MathExpressionsMain.h"
+
+enum class ExpressionEGraphCostModel
+{
+    EVALUATION,     // flops, transcendental calls are the most expensive
+    TEX_LENGTH,     // length of the printed formula
+};
+
+struct ExpressionEGraphParamsType
+{
+    size_t maxNodes;
+    size_t maxIterations;
+    double maxTime;         // seconds
+
+    ExpressionEGraphCostModel costModel;
+};
+
+ExpressionErrors ExpressionEGraphOptimize(ExpressionType* expression,
+                                          const ExpressionEGraphParamsType* params = nullptr);
+
+#endif
@@ -6,239 +6,180 @@
 #include "MathExpressionsMain.h"
 #include "MathExpressionEquationRead.h"
 #include "Common/StringFuncs.h"
+#include "Common/DoubleScan.h"
 #include "Vector/Vector.h"
 #include "Common/Colors.h"
 
 
-// G       ::= ADD_SUB '\0'
-// ADD_SUB ::= MUL_DIV {['+', '-'] MUL_DIV}*
-// MUL_DIV ::= POW {['*', '/'] POW}*
-// POW     ::= TRIG {['^'] TRIG}*
-// TRIG    ::= ['sin', 'cos', 'tan', 'cot', 'arctan', 'arccot', 'arcsin', 'arccos'] '(' ADD_SUB ')' | EXPR
-// EXPR    ::= '(' ADD_SUB ')' | ARG
-// ARG     ::= NUM | VAR
-// VAR     ::= ['a'-'z''A'-'Z''_']+['a'-'z' & 'A'-'Z' & '_' & '0'-'9']*
-// NUM     ::= ['0'-'9']+
+// G         ::= EXPR '\0'
+// EXPR      ::= OPERAND {BINARY_OP OPERAND}*
+// OPERAND   ::= {UNARY_OP}* (FUNC '(' EXPR ')' | '(' EXPR ')' | NUM | VAR)
+// BINARY_OP - infix operations from Operations.h ('+', '-', '*', '/', '^')
+// UNARY_OP  - prefix operations with PARSE_PRIORITY > 0 ('-')
+// FUNC      - prefix unary operations with PARSE_PRIORITY = 0 ('sin', 'ln', ...)
+// VAR       ::= ['a'-'z''A'-'Z''_']+['a'-'z' & 'A'-'Z' & '_' & '0'-'9']*
+// NUM       ::= ['0'-'9']+ ['.' ['0'-'9']*] [('e' | 'E') ['+' | '-'] ['0'-'9']+]
+//
+// Operator precedence parser: operands and pending operations are kept in explicit stacks,
+// so nesting depth of the expression is limited by memory only, not by the native stack.
 
-typedef VectorType TokensArrType;
+typedef ExpressionTokenType* (ParserOperationCreateFuncType)(ExpressionTokenType* left,
+                                                             ExpressionTokenType* right);
 
-static ExpressionErrors ParseOnTokens(const char* str, TokensArrType* tokens);
+struct ParserOperationType
+{
+    const char*               name;
+    ExpressionOperationFormat format;
+    bool                      isUnary;
+
+    int                       priority;
+    bool                      rightAssoc;
+
+    ParserOperationCreateFuncType* create;
+};
+
+// nesting depth that is parsed without allocations
+static const size_t PARSER_STACK_INLINE_CAPACITY = 64;
+
+static const size_t PARSER_MAX_WORD_LENGTH = 64;
 
-struct DescentStorage
+// Tokens are read from the string one by one when the parser needs them, 
+// so the token of a variable refers to the word buffer until the next token is read.
+// Operations stack contains nullptr for opening brace.
+struct ParserStorage
 {
-    TokensArrType tokens;
-    size_t tokenPos;
+    const char* str;
+    size_t      pos;
+    size_t      line;
+
+    char word[PARSER_MAX_WORD_LENGTH + 1];
+
+    VectorType<const ParserOperationType*, PARSER_STACK_INLINE_CAPACITY> operations;
+    VectorType<ExpressionTokenType*,       PARSER_STACK_INLINE_CAPACITY> operands;
 
     ExpressionVariablesArrayType varsArr;
 };
 
-static void DescentStorageCtor(DescentStorage* storage);
+static TokenType ParserNextToken(ParserStorage* storage);
+
+static void ParserStorageCtor(ParserStorage* storage, const char* str);
 
 //DOESN'T DTOR VARS_ARR, because it's better just to copy it to my expression
-static void DescentStorageDtor(DescentStorage* storage);
-
-static ExpressionTokenType* GetG            (DescentStorage* storage);
-static ExpressionTokenType* GetAddSub       (DescentStorage* storage);
-static ExpressionTokenType* GetMulDiv       (DescentStorage* storage);
-static ExpressionTokenType* GetPow          (DescentStorage* storage);
-static ExpressionTokenType* GetExpression   (DescentStorage* storage);
-static ExpressionTokenType* GetArgument     (DescentStorage* storage);
-static ExpressionTokenType* GetNum          (DescentStorage* storage);
-static ExpressionTokenType* GetTrig         (DescentStorage* storage);
-static ExpressionTokenType* GetVariable     (DescentStorage* storage);
-
-#define T_CRT_VAL(val)  TokenValueCreate(val)
+static void ParserStorageDtor(ParserStorage* storage);
+
+static bool ParseOperationName(const char* word, ExpressionOperationId* operation);
+
+static const ParserOperationType* ParserOperationGet(const ExpressionOperationId operation,
+                                                     const bool isUnary);
+
+static ExpressionTokenType* ParseExpression(ParserStorage* storage);
+static bool ParseOperand  (ParserStorage* storage, const TokenType* token);
+static bool ParseOperation(ParserStorage* storage, const TokenType* token);
+static void ParserReduce  (ParserStorage* storage);
+
 #define  T_OP_TYPE_CNST TokenValueType::OPERATION
 #define T_NUM_TYPE_CNST TokenValueType::VALUE
 #define T_VAR_TYPE_CNST TokenValueType::VARIABLE
 
-#define POS(storage) storage->tokenPos
-
-static inline const char* T_WORD(const DescentStorage* storage)
+#define SyntaxAssert(statement) SynAssert(statement, __FILE__, __func__, __LINE__)
+static inline void SynAssert(bool statement, const char* fileName, const char* funcName, const int line) 
+                                //const char* string, const size_t line, const size_t pos)
 {
-    return storage->tokens.data[storage->tokenPos].value.word;
-}
+    if (statement)
+        return;
 
-static inline const char* T_WORD(const DescentStorage* storage, const size_t pos)
-{
-    return storage->tokens.data[pos].value.word;
-}
+    printf("File - %s, func - %s, line - %d\n", fileName, funcName, line);
 
-static inline double T_NUM(const DescentStorage* storage)
-{
-    return storage->tokens.data[storage->tokenPos].value.val;
-}
+    assert(false);
+    //assert(string);
 
-static inline double T_NUM(const DescentStorage* storage, const size_t pos)
-{
-    return storage->tokens.data[pos].value.val;
+    //printf(RED_TEXT("Syntax error in line %zu, pos %zu, string - %s"), line, pos, string);
 }
 
-static inline bool T_IS_OP(const DescentStorage* storage)
+static TokenType ParseDigit(ParserStorage* storage)
 {
-    return storage->tokens.data[storage->tokenPos].valueType == T_OP_TYPE_CNST;
-}
+    assert(storage);
 
-static inline bool T_IS_OP(const DescentStorage* storage, const size_t pos)
-{
-    return storage->tokens.data[pos].valueType == T_OP_TYPE_CNST;
-}
+    size_t posStart = storage->pos;
 
-static inline bool T_IS_NUM(const DescentStorage* storage)
-{
-    return storage->tokens.data[storage->tokenPos].valueType == T_NUM_TYPE_CNST;
-}
+    double val = 0;
+    const char* valueEnd = DoubleScan(storage->str + posStart, &val);
 
-static inline bool T_IS_NUM(const DescentStorage* storage, const size_t pos)
-{
-    return storage->tokens.data[pos].valueType == T_NUM_TYPE_CNST;
-}
+    assert(valueEnd != storage->str + posStart);
 
-static inline bool T_IS_VAR(const DescentStorage* storage)
-{
-    return storage->tokens.data[storage->tokenPos].valueType == T_VAR_TYPE_CNST;
-}
+    storage->pos = (size_t)(valueEnd - storage->str);
 
-static inline bool T_IS_VAR(const DescentStorage* storage, const size_t pos)
-{
-    return storage->tokens.data[pos].valueType == T_VAR_TYPE_CNST;
+    return TokenCreate(TokenValueCreate(val), TokenValueType::VALUE, storage->line, posStart);
 }
 
-static inline bool T_CMP_WORD(const DescentStorage* storage, const char* str)
+static TokenType ParseWord(ParserStorage* storage)
 {
-    return (strcmp(T_WORD(storage), str) == 0);
-}
+    assert(storage);
 
-static inline bool T_CMP_WORD(const DescentStorage* storage, const size_t pos, const char* str)
-{
-    return (strcmp(T_WORD(storage, pos), str) == 0);
-}
+    const char* str = storage->str;
+    size_t posStart = storage->pos;
+    size_t pos      = posStart;
 
-static inline bool T_CMP_WORD(const TokensArrType* tokens, const size_t pos, const char* str)
-{
-    return (strcmp(tokens->data[pos].value.word, str) == 0);
-}
+    while (isalpha(str[pos]) || isdigit(str[pos]) || str[pos] == '_')
+        ++pos;
 
-static size_t ParseDigit(const char* str, const size_t posStart, const size_t line, 
-                                                                TokensArrType* tokens)
-{
-    assert(str);
-    assert(tokens);
+    size_t wordLength = pos - posStart;
+    SyntaxAssert(wordLength <= PARSER_MAX_WORD_LENGTH);
 
-    size_t pos = posStart;
+    if (wordLength > PARSER_MAX_WORD_LENGTH)
+        wordLength = PARSER_MAX_WORD_LENGTH;
 
-    int val = 0;
-    while (isdigit(str[pos]))
-    {
-        val = val * 10 + str[pos] - '0';
-        ++pos;
-    }
+    memcpy(storage->word, str + posStart, wordLength);
+    storage->word[wordLength] = '\0';
 
-    VectorPush(tokens, TokenCreate(TokenValueCreate(val), TokenValueType::VALUE, line, pos));
+    storage->pos = pos;
 
-    return pos;
+    ExpressionOperationId operation = {};
+
+    if (ParseOperationName(storage->word, &operation))
+        return TokenCreate(TokenValueCreate(operation), T_OP_TYPE_CNST, storage->line, posStart);
+
+    // word isn't copied, variable token is used before the next token is read
+    TokenValue value = {};
+    value.word = storage->word;
+
+    return TokenCreate(value, T_VAR_TYPE_CNST, storage->line, posStart);
 }
 
-static size_t ParseWord(const char* str, const size_t posStart, const size_t line, 
-                                                              TokensArrType* tokens)
+static TokenType ParseChar(ParserStorage* storage)
 {
-    assert(str);
-    assert(tokens);
-    
-    size_t pos = posStart;
-
-    static const size_t maxWordSize   =  64;
-    static char word[maxWordSize + 1] =  "";
-    
-    size_t wordPos = 0;
+    assert(storage);
 
-    while (isalpha(str[pos]) || isdigit(str[pos]) || str[pos] == '_')
-    {
-        assert(wordPos < maxWordSize);
+    size_t posStart = storage->pos;
 
-        word[wordPos] = str[pos];
-        ++pos;
-        ++wordPos;
-    }
+    storage->word[0] = storage->str[posStart];
+    storage->word[1] = '\0';
 
-    word[wordPos] = '\0';
-
-    #define GENERATE_OPERATION_CMD(NAME, v1, v2, v3, SHORT_NAME, ...)                   \
-        if (strcmp(word, SHORT_NAME) == 0)                                              \
-        {                                                                               \
-            VectorPush(tokens,                                                          \
-                TokenCreate(T_CRT_VAL(word), TokenValueType::OPERATION,                 \
-                                                                line, posStart));       \
-            return pos;                                                                 \
-        }
-    
-    //GENERATING if(strcmp(word, "+") == 0) ... if...
-    #include "Operations.h"
+    // '-' is always SUB here, parser turns it into UNARY_SUB where an operand is expected
+    ExpressionOperationId operation = {};
+    bool isOperation = ParseOperationName(storage->word, &operation);
 
-    //Now - word is not a special symbol
+    SyntaxAssert(isOperation);
 
-    VectorPush(tokens, TokenCreate(TokenValueCreate(word), 
-                                        TokenValueType::VARIABLE, line, posStart));
+    storage->pos = posStart + 1;
 
-    return pos;
+    return TokenCreate(TokenValueCreate(operation), T_OP_TYPE_CNST, storage->line, posStart);
 }
 
-static size_t ParseChar(const char* str, const size_t posStart, const size_t line, 
-                                                                TokensArrType* tokens)
+// first operation in Operations.h with such short name
+static bool ParseOperationName(const char* word, ExpressionOperationId* operation)
 {
-    assert(str);
-    assert(tokens);
-    
-    static const size_t  charWordLength  =  2;
-    static char charWord[charWordLength] = "";
-
-    charWord[0] = str[posStart];
-    charWord[1] = '\0';
-
-    bool isUnaryOperator = (tokens->size == 0 || 
-                            ((tokens->data[tokens->size - 1].valueType == T_OP_TYPE_CNST) &&
-                             ((T_CMP_WORD(tokens, tokens->size - 1, "+")) ||
-                              (T_CMP_WORD(tokens, tokens->size - 1, "-")) ||
-                              (T_CMP_WORD(tokens, tokens->size - 1, "*")) ||
-                              (T_CMP_WORD(tokens, tokens->size - 1, "/")) ||
-                              (T_CMP_WORD(tokens, tokens->size - 1, "^"))))) &&
-                           (isdigit(str[posStart + 1]) || isalpha(str[posStart + 1]) ||
-                            str[posStart + 1] == '(');
-
-    switch (str[posStart])
-    {
-        //TODO: если в языке у меня будет ++, -- эту часть переделывать
-        case '+':
-        {
-            //if (isUnaryOperator)
-            //    return posStart + 1;
-            
-            break;
-        }
+    assert(word);
+    assert(operation);
 
-        case '-':
-        {
-            /*if (isUnaryOperator)
-            {
-                VectorPush(tokens, TokenCreate(T_CRT_VAL("("), T_OP_TYPE_CNST, line, posStart));
-                VectorPush(tokens, TokenCreate(T_CRT_VAL(-1), T_NUM_TYPE_CNST, line, posStart));
-                VectorPush(tokens, TokenCreate(T_CRT_VAL("*"), T_OP_TYPE_CNST, line, posStart));
-                VectorPush(tokens, TokenCreate(T_CRT_VAL(")"), T_OP_TYPE_CNST, line, posStart));
+    int operationId = ExpressionOperationGetIdByShortName(word);
 
-                return posStart + 1;
-            }*/
-
-            break;
-        }
-        
-        default:
-            break;
-    }
+    if (operationId == -1)
+        return false;
 
-    VectorPush(tokens, TokenCreate(TokenValueCreate(charWord), TokenValueType::OPERATION,
-                                                                            line, posStart));
+    *operation = (ExpressionOperationId)operationId;
 
-    return posStart + 1;
+    return true;
 }
 
 ExpressionType ExpressionParse(const char* str)
@@ -247,125 +188,72 @@ ExpressionType ExpressionParse(const char* str)
 
     ExpressionType expression = {};
 
-    DescentStorage storage = {};
-    DescentStorageCtor(&storage);
+    ParserStorage storage = {};
+    ParserStorageCtor(&storage, str);
 
-    ParseOnTokens(str, &storage.tokens);
-    expression.root = GetG(&storage);
+    expression.root = ParseExpression(&storage);
 
     expression.variables = storage.varsArr;
-    //DescentStorageDtor(&storage);
-    ExpressionGraphicDump(&expression, true);
+    ParserStorageDtor(&storage);
+
     return expression;
 }
 
-static ExpressionErrors ParseOnTokens(const char* str, TokensArrType* tokens)
+static TokenType ParserNextToken(ParserStorage* storage)
 {
-    size_t pos  = 0;
-    size_t line = 0;
+    assert(storage);
+
+    const char* str = storage->str;
 
-    while (str[pos] != '\0')
+    while (isspace(str[storage->pos]))
     {
-        switch (str[pos])
-        {
-            // как это можно сделать - я читаю данное мне выражение, вижу -, смотрю в массив токенов 
-            // до меня, который я уже построил. Предыдущее должно быть не операцией если это не унарник
-            // иначе это унарник, тогда можно считать это как число тип 
-            //(удобнее унарник перевести в умножение на (-1) в случае переменной, мне кажется).
-            //TODO: +, - могут быть унарными операторами, можно просто пихать прям сразу в число
-            case '+':
-            case '-':
-            case '*':
-            case '/':
-            case '^':
-            {
-                pos = ParseChar(str, pos, line, tokens);
-                break;
-            }
-
-            case '(':
-            {
-                VectorPush(tokens, TokenCreate(TokenValueCreate("("), 
-                                                    TokenValueType::OPERATION, line, pos));
-                ++pos;
-                break;
-            }
-            case ')':
-            {
-                VectorPush(tokens, TokenCreate(TokenValueCreate(")"), 
-                                                    TokenValueType::OPERATION, line, pos));
-                ++pos;
-                break;
-            }
-
-            case '\t':
-            case ' ':
-            {
-                const char* strPtr = SkipSymbolsWhileStatement(str + pos, isspace);
-                pos = strPtr - str;
-                break;
-            }
-            case '\n':
-            {
-                const char* strPtr = SkipSymbolsWhileStatement(str + pos, isspace);
-                pos = strPtr - str;
-                line++;
-                break;
-            }
-
-            case '0':
-            case '1':
-            case '2':
-            case '3':
-            case '4':
-            case '5':
-            case '6':
-            case '7':
-            case '8':
-            case '9':
-            {
-                pos = ParseDigit(str, pos, line, tokens);
-                break;
-            }
-
-            default:
-            {
-                if (isalpha(str[pos]) || str[pos] == '_')
-                {
-                    pos = ParseWord(str, pos, line, tokens);
-                    break;
-                }
-
-                //TODO: здесь syn_assert очев, такого не бывает же
-                assert(0 == 1);
-                break;
-            }
-        }
+        if (str[storage->pos] == '\n')
+            storage->line++;
+
+        storage->pos++;
     }
 
-    /*for (size_t i = 0; i < tokens->size; ++i)
+    size_t pos = storage->pos;
+
+    switch (str[pos])
     {
-        switch (tokens->data[i].valueType)
-        {
-            case TokenValueType::OPERATION:
-                printf("Operation - %s\n", tokens->data[i].value.word);
-                break;
-            case TokenValueType::VARIABLE:
-                printf("Variable - %s\n", tokens->data[i].value.word);
-                break;
-            case TokenValueType::VALUE:
-                printf("Value - %lf\n", tokens->data[i].value.val);
-                break;
-            default:
-                abort();
-                break;
-        }
-    }*/
-    
-    VectorPush(tokens, TokenCreate(TokenValueCreate("\0"), TokenValueType::OPERATION, 
-                                                                            line, pos));
-
-    return ExpressionErrors::NO_ERR;
+        case '\0':
+            return TokenCreate({}, TokenValueType::END, storage->line, pos);
+
+        case '+':
+        case '-':
+        case '*':
+        case '/':
+        case '^':
+            return ParseChar(storage);
+
+        case '(':
+            storage->pos++;
+            return TokenCreate({}, TokenValueType::OPENING_BRACE, storage->line, pos);
+
+        case ')':
+            storage->pos++;
+            return TokenCreate({}, TokenValueType::CLOSING_BRACE, storage->line, pos);
+
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9':
+            return ParseDigit(storage);
+
+        default:
+            break;
+    }
+
+    SyntaxAssert(isalpha(str[pos]) || str[pos] == '_');
+
+    return ParseWord(storage);
 }
 
 TokenType TokenCreate(TokenValue value, TokenValueType valueType,   const size_t line, 
@@ -396,235 +284,235 @@ TokenValue TokenValueCreate(double value)
     return val;
 }
 
-TokenValue TokenValueCreate(const char* word)
+TokenValue TokenValueCreate(ExpressionOperationId operation)
 {
     TokenValue val =
     {
-        .word = strdup(word),
+        .operation = operation,
     };
 
     return val;
 }
 
-//-------------------Recursive descent-----------------
-
-#define SyntaxAssert(statement) SynAssert(statement, __FILE__, __func__, __LINE__)
-static inline void SynAssert(bool statement, const char* fileName, const char* funcName, const int line) 
-                                //const char* string, const size_t line, const size_t pos)
+TokenValue TokenValueCreate(const char* word)
 {
-    if (statement)
-        return;
+    TokenValue val =
+    {
+        .word = strdup(word),
+    };
 
-    printf("File - %s, func - %s, line - %d\n", fileName, funcName, line);
+    return val;
+}
 
-    assert(false);
-    //assert(string);
+//-------------------Operator precedence parser-----------------
 
-    //printf(RED_TEXT("Syntax error in line %zu, pos %zu, string - %s"), line, pos, string);
-}
+#define GENERATE_OPERATION_CMD(NAME, FORMAT, v1, IS_UNARY, SHORT_NAME, v2, v3, v4, v5, v6,   \
+                               v7, v8, v9, v10, PARSE_PRIORITY, PARSE_RIGHT_ASSOC, ...)    \
+    {SHORT_NAME, ExpressionOperationFormat::FORMAT, IS_UNARY,                              \
+                                        PARSE_PRIORITY, PARSE_RIGHT_ASSOC, _##NAME},
 
-static ExpressionTokenType* GetG(DescentStorage* storage)
+static const ParserOperationType ParserOperations[] =
 {
-    storage->tokenPos = 0;
-    ExpressionTokenType* token = GetAddSub(storage);
+    #include "Operations.h"
+};
 
-    SyntaxAssert(T_IS_OP(storage) && T_CMP_WORD(storage, "\0"));
+#undef GENERATE_OPERATION_CMD
 
-    //printf("Operation - %s, next op - %s, %d\n", T_WORD(storage), T_WORD(storage, storage->tokenPos + 1));
-    return  token;
-}
+static const size_t ParserOperationsCount = sizeof(ParserOperations) / sizeof(*ParserOperations);
 
-static ExpressionTokenType* GetAddSub(DescentStorage* storage)
+static const ParserOperationType* ParserOperationGet(const ExpressionOperationId operation,
+                                                     const bool isUnary)
 {
-    assert(storage);
+    assert((size_t)operation < ParserOperationsCount);
+
+    const ParserOperationType* parserOperation = ParserOperations + (size_t)operation;
 
-    ExpressionTokenType* mainToken = GetMulDiv(storage);
+    if (parserOperation->isUnary == isUnary)
+        return parserOperation;
 
-    while (T_IS_OP(storage) && (T_CMP_WORD(storage, "+") || T_CMP_WORD(storage, "-")))
+    // '-' is tokenized as SUB, its prefix form has the same name
+    for (size_t i = 0; i < ParserOperationsCount; ++i)
     {
-        size_t operationPos = POS(storage);
-        POS(storage)++;
-        ExpressionTokenType* tmpToken = GetMulDiv(storage);
-
-        if (T_CMP_WORD(storage, operationPos, "+"))
-            mainToken = _ADD(mainToken, tmpToken);
-        else if (T_CMP_WORD(storage, operationPos, "-"))
-            mainToken = _SUB(mainToken, tmpToken);
-        else
-            SyntaxAssert(false);
+        if (ParserOperations[i].isUnary == isUnary && 
+            strcmp(ParserOperations[i].name, parserOperation->name) == 0)
+            return ParserOperations + i;
     }
-    
-    return mainToken;
+
+    return nullptr;
 }
 
-static ExpressionTokenType* GetMulDiv(DescentStorage* storage)
+static inline const ParserOperationType* ParserOperationsTop(const ParserStorage* storage)
 {
     assert(storage);
+    assert(!VectorIsEmpty(&storage->operations));
 
-    ExpressionTokenType* mainToken = GetPow(storage);
-
-    while (T_IS_OP(storage) && (T_CMP_WORD(storage, "*") || T_CMP_WORD(storage, "/")))
-    {
-        size_t operationPos = POS(storage);
-        POS(storage)++;
-        ExpressionTokenType* tmpToken = GetPow(storage);
-
-        if (T_CMP_WORD(storage, operationPos, "*"))
-            mainToken = _MUL(mainToken, tmpToken);
-        else if (T_CMP_WORD(storage, operationPos, "/"))
-            mainToken = _DIV(mainToken, tmpToken);
-        else
-            SyntaxAssert(false);
-    }
+    return storage->operations.data[storage->operations.size - 1];
+}
 
-    return mainToken;
+static inline bool ParserOperationIsBrace(const ParserOperationType* operation)
+{
+    return operation == nullptr || operation->priority == 0;
 }
 
-static ExpressionTokenType* GetPow(DescentStorage* storage)
+static void ParserReduce(ParserStorage* storage)
 {
     assert(storage);
+    assert(!VectorIsEmpty(&storage->operations));
+
+    const ParserOperationType* operation = nullptr;
+    VectorPop(&storage->operations, &operation);
 
-    ExpressionTokenType* mainToken = GetTrig(storage);
-    ExpressionTokenType* powToken  = nullptr;
-    while (T_IS_OP(storage) && T_CMP_WORD(storage, "^"))
+    assert(operation);
+
+    ExpressionTokenType* right = nullptr;
+
+    if (!operation->isUnary)
     {
-        size_t operationPos = POS(storage);
-        POS(storage)++;
-        ExpressionTokenType* tmpToken = GetTrig(storage);
-
-        if (T_CMP_WORD(storage, operationPos, "^"))
-        {
-            if (powToken == nullptr) powToken = tmpToken;
-            else                     powToken = _POW(powToken, tmpToken);
-        }
-        else
-            SyntaxAssert(false);
+        SyntaxAssert(!VectorIsEmpty(&storage->operands));
+        VectorPop(&storage->operands, &right);
     }
 
-    if (powToken)
-        mainToken = _POW(mainToken, powToken);
+    SyntaxAssert(!VectorIsEmpty(&storage->operands));
 
-    return mainToken;    
+    // left operand is replaced with the result in place
+    ExpressionTokenType** left = storage->operands.data + storage->operands.size - 1;
+    *left = operation->create(*left, right);
 }
 
-static ExpressionTokenType* GetTrig(DescentStorage* storage)
+// returns true if operand is complete, false if it is still expected after prefix operation
+static bool ParseOperand(ParserStorage* storage, const TokenType* token)
 {
     assert(storage);
+    assert(token);
 
-    if (T_IS_OP(storage)     && ((T_CMP_WORD(storage, "sin"))       || 
-                                 (T_CMP_WORD(storage, "cos"))       ||
-                                 (T_CMP_WORD(storage, "tan"))       ||
-                                 (T_CMP_WORD(storage, "cot"))       ||
-                                 (T_CMP_WORD(storage, "arcsin"))    ||
-                                 (T_CMP_WORD(storage, "arccos"))    ||
-                                 (T_CMP_WORD(storage, "arctan"))    ||
-                                 (T_CMP_WORD(storage, "arccot"))))
+    switch (token->valueType)
     {
-        size_t operationPos = POS(storage);
-        POS(storage)++;
-        SyntaxAssert(T_IS_OP(storage) && T_CMP_WORD(storage,"("));
-        POS(storage)++;
-
-        ExpressionTokenType* mainToken = GetAddSub(storage);
-
-        SyntaxAssert(T_IS_OP(storage) && T_CMP_WORD(storage, ")"));
-        POS(storage)++;
-
-        assert(T_IS_OP(storage, operationPos));
-
-        if (T_CMP_WORD(storage, operationPos, "sin"))
-            return _SIN(mainToken);
-        else if (T_CMP_WORD(storage, operationPos, "cos"))
-            return _COS(mainToken);
-        else if (T_CMP_WORD(storage, operationPos, "tan"))
-            return _TAN(mainToken);
-        else if (T_CMP_WORD(storage, operationPos, "cot"))
-            return _COT(mainToken);
-        else if (T_CMP_WORD(storage, operationPos, "arcsin"))
-            return _ARCSIN(mainToken);
-        else if (T_CMP_WORD(storage, operationPos, "arccos"))
-            return _ARCCOS(mainToken);
-        else if (T_CMP_WORD(storage, operationPos, "arctan"))
-            return _ARCTAN(mainToken);
-        else if (T_CMP_WORD(storage, operationPos, "arccot"))
-            return _ARCCOT(mainToken);
-        else
-            SyntaxAssert(false);
-    }
+        case TokenValueType::VALUE:
+            VectorPush(&storage->operands, CRT_NUM(token->value.val));
+            return true;
 
-    ExpressionTokenType* mainToken = GetExpression(storage);
+        case TokenValueType::VARIABLE:
+            VectorPush(&storage->operands, CRT_VAR(&storage->varsArr, token->value.word));
+            return true;
 
-    return mainToken;
-}
+        case TokenValueType::OPENING_BRACE:
+            VectorEmplace(&storage->operations, nullptr);
+            return false;
 
-static ExpressionTokenType* GetExpression(DescentStorage* storage)
-{
-    assert(storage);
+        case TokenValueType::OPERATION:
+            break;
 
-    ExpressionTokenType* mainToken = nullptr;
-    if (T_IS_OP(storage) && T_CMP_WORD(storage, "("))
-    {
-        POS(storage)++;
+        case TokenValueType::CLOSING_BRACE:
+        case TokenValueType::END:
+        default:
+            SyntaxAssert(false);
+            return false;
+    }
 
-        mainToken = GetAddSub(storage);
-        SyntaxAssert(T_IS_OP(storage) && T_CMP_WORD(storage, ")"));
-        POS(storage)++;
+    const ParserOperationType* operation = ParserOperationGet(token->value.operation, true);
+    SyntaxAssert(operation != nullptr);
 
-        return mainToken;
+    // function - its opening brace is on the stack together with it
+    if (operation->priority == 0)
+    {
+        TokenType brace = ParserNextToken(storage);
+        SyntaxAssert(brace.valueType == TokenValueType::OPENING_BRACE);
     }
 
-    mainToken = GetArgument(storage);
+    VectorPush(&storage->operations, operation);
 
-    return mainToken;
+    return false;
 }
 
-static ExpressionTokenType* GetArgument(DescentStorage* storage)
+// returns true if operand is expected after the operation
+static bool ParseOperation(ParserStorage* storage, const TokenType* token)
 {
     assert(storage);
+    assert(token);
 
-    ExpressionTokenType* mainToken = nullptr;
+    if (token->valueType == TokenValueType::CLOSING_BRACE)
+    {
+        while (!VectorIsEmpty(&storage->operations) && 
+               !ParserOperationIsBrace(ParserOperationsTop(storage)))
+            ParserReduce(storage);
 
-    if (T_IS_NUM(storage))
-        return GetNum(storage);
+        SyntaxAssert(!VectorIsEmpty(&storage->operations));
 
-    return GetVariable(storage);
-}
+        if (ParserOperationsTop(storage) == nullptr)
+            VectorPop(&storage->operations);
+        else
+            ParserReduce(storage);
 
-static ExpressionTokenType* GetNum(DescentStorage* storage)
-{
-    assert(storage);
+        return false;
+    }
 
-    SyntaxAssert(T_IS_NUM(storage));
+    SyntaxAssert(token->valueType == T_OP_TYPE_CNST);
 
-    ExpressionTokenType* mainToken = CRT_NUM(T_NUM(storage));
+    const ParserOperationType* operation = ParserOperationGet(token->value.operation, false);
+    SyntaxAssert(operation != nullptr && operation->format == ExpressionOperationFormat::INFIX);
 
-    POS(storage)++;
+    while (!VectorIsEmpty(&storage->operations))
+    {
+        const ParserOperationType* top = ParserOperationsTop(storage);
 
-    return mainToken;
+        if (ParserOperationIsBrace(top) || top->priority < operation->priority ||
+           (top->priority == operation->priority && operation->rightAssoc))
+            break;
+
+        ParserReduce(storage);
+    }
+
+    VectorPush(&storage->operations, operation);
+
+    return true;
 }
 
-static ExpressionTokenType* GetVariable(DescentStorage* storage)
+static ExpressionTokenType* ParseExpression(ParserStorage* storage)
 {
     assert(storage);
 
-    SyntaxAssert(T_IS_VAR(storage));
+    bool expectOperand = true;
+    while (true)
+    {
+        TokenType token = ParserNextToken(storage);
+
+        if (expectOperand)
+            expectOperand = !ParseOperand(storage, &token);
+        else if (token.valueType == TokenValueType::END)
+            break;
+        else
+            expectOperand =  ParseOperation(storage, &token);
+    }
 
-    ExpressionTokenType* mainToken = CRT_VAR(&storage->varsArr, T_WORD(storage));
+    while (!VectorIsEmpty(&storage->operations))
+    {
+        SyntaxAssert(!ParserOperationIsBrace(ParserOperationsTop(storage)));
+        ParserReduce(storage);
+    }
 
-    POS(storage)++;
+    SyntaxAssert(storage->operands.size == 1);
+    ExpressionTokenType* mainToken = storage->operands.data[0];
 
     return mainToken;
 }
 
-static void DescentStorageCtor(DescentStorage* storage)
+static void ParserStorageCtor(ParserStorage* storage, const char* str)
 {
-    VectorCtor(&storage->tokens);
-    storage->tokenPos  = 0;
+    storage->str  = str;
+    storage->pos  = 0;
+    storage->line = 0;
+
+    VectorCtor(&storage->operations);
+    VectorCtor(&storage->operands);
+
     ExpressionVariableArrayCtor(&storage->varsArr);
 }
 
-static void DescentStorageDtor(DescentStorage* storage)
+static void ParserStorageDtor(ParserStorage* storage)
 {
-    VectorDtor(&storage->tokens);
-    storage->tokenPos = 0;
+    VectorDtor(&storage->operations);
+    VectorDtor(&storage->operands);
+
+    storage->str = nullptr;
+    storage->pos = 0;
 }
@@ -7,6 +7,7 @@ union TokenValue
 {
     char* word;
     double val;
+    ExpressionOperationId operation;
 };
 
 enum class TokenValueType
@@ -14,6 +15,10 @@ enum class TokenValueType
     OPERATION,
     VARIABLE,
     VALUE,
+
+    OPENING_BRACE,
+    CLOSING_BRACE,
+    END,
 };
 
 struct TokenType
@@ -31,6 +36,7 @@ TokenType TokenCreate(TokenValue value, TokenValueType valueType,   const size_t
 
 TokenValue TokenValueCreate(const char* word);
 TokenValue TokenValueCreate(double value);
+TokenValue TokenValueCreate(ExpressionOperationId operation);
 
 ExpressionType ExpressionParse(const char* str);
 
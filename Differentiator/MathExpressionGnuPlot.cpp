@@ -1,7 +1,17 @@
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
+#include <signal.h>
+#include <spawn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "MathExpressionGnuPlot.h"
+#include "MathExpressionSampler.h"
+#include "Common/Log.h"
+
+extern char** environ;
 
 static void ExpressionTokenPrintValue(const ExpressionTokenType* token, FILE* outStream);
 
@@ -9,6 +19,77 @@ static bool        ExpressionOperationIsPrefix      (const ExpressionOperationId
 static const char* ExpressionOperationGetGnuPlotName(const ExpressionOperationId operation);
 
 static char* CreateImgName(const size_t imgIndex);
+static void  CreateDataFileName(char* dataFileName, const size_t maxDataFileNameLength,
+                                const size_t imgIndex, const size_t funcIndex);
+
+static ExpressionErrors ExpressionGnuPlotWriteSamples(const char* dataFileName,
+                                                      const ExpressionType* expression);
+static const ExpressionVariableType* ExpressionGnuPlotFindVariable(
+                                                      const ExpressionType* expression);
+
+static const size_t GNU_PLOT_IMG_WIDTH  = 800;
+static const size_t GNU_PLOT_IMG_HEIGHT = 600;
+
+struct GnuPlotStateType
+{
+    GnuPlotMode mode;
+    size_t      samplesCount;
+
+    ExpressionSamplerParamsType samplerParams;
+
+    double xRangeLeft;
+    double xRangeRight;
+
+    size_t imgIndex;
+    size_t funcIndex;       // number of funcs already added to current plot
+};
+
+static GnuPlotStateType GnuPlotState = 
+{
+    GnuPlotMode::ADAPTIVE, 1000, 
+    {33, 10, 0.5, GNU_PLOT_IMG_WIDTH, GNU_PLOT_IMG_HEIGHT},
+    0, 0, 0, 0
+};
+
+// One gnuplot process reads jobs from its stdin and acknowledges every finished image 
+// by printing GNU_PLOT_ACK and job id to its stdout. Jobs are numbered from 1.
+// Script and data files of the acknowledged job are removed, 
+// files of the failed one are left for debugging.
+struct GnuPlotJobType
+{
+    char* scriptName;
+
+    size_t imgIndex;        // data files are expressionsTmpPlot_<imgIndex>_<k>.dat, k < funcsCount
+    size_t funcsCount;
+
+    bool  failed;
+    bool  filesRemoved;
+};
+
+struct GnuPlotProcessType
+{
+    pid_t pid;
+
+    FILE* commands;
+    FILE* acks;
+
+    GnuPlotJobType* jobs;       // jobs[id - 1]
+    size_t          jobsCapacity;
+
+    size_t lastJob;             // id of the last created job
+    size_t lastAck;             // jobs up to this id are finished or failed
+};
+
+static GnuPlotProcessType GnuPlotProcess = {-1, nullptr, nullptr, nullptr, 0, 0, 0};
+
+static const char* const GNU_PLOT_PROGRAM = "gnuplot";
+static const char* const GNU_PLOT_ACK     = "GnuPlotJobDone";
+
+static bool GnuPlotProcessStart  ();
+static void GnuPlotProcessStop   ();
+static bool GnuPlotProcessSend   (const size_t jobId);
+static bool GnuPlotProcessReadAck();
+static void GnuPlotProcessRecover();
 
 ExpressionErrors ExpressionPrintGnuPlotFormat(ExpressionTokenType* token, FILE* outStream)
 {
@@ -64,20 +145,309 @@ static char* CreateImgName(const size_t imgIndex)
     return strdup(imgName);
 }
 
-void GnuPlotImgCreate(const char* plotFileName)
+static void CreateDataFileName(char* dataFileName, const size_t maxDataFileNameLength,
+                               const size_t imgIndex, const size_t funcIndex)
+{
+    assert(dataFileName);
+
+    snprintf(dataFileName, maxDataFileNameLength, "expressionsTmpPlot_%zu_%zu.dat",
+                                                  imgIndex, funcIndex);
+}
+
+size_t GnuPlotImgCreate(const char* plotFileName)
 {
     assert(plotFileName);
 
-    static const size_t maxCommandLen = 256;
-    static char  commandName[]        = "";
+    FILE* plotFile = fopen(plotFileName, "a");
 
-    snprintf(commandName, maxCommandLen, "chmod +x %s", plotFileName);
-    system(commandName);
+    if (plotFile == nullptr)
+        return 0;
 
-    snprintf(commandName, maxCommandLen, "./%s", plotFileName);
-    system(commandName);
+    fprintf(plotFile, "\n");
+    fclose(plotFile);
+
+    if (GnuPlotProcess.lastJob == GnuPlotProcess.jobsCapacity)
+    {
+        size_t newCapacity = GnuPlotProcess.jobsCapacity == 0 ? 16 : 
+                                                                2 * GnuPlotProcess.jobsCapacity;
+        GnuPlotJobType* newJobs = (GnuPlotJobType*) realloc(GnuPlotProcess.jobs, 
+                                                            newCapacity * sizeof(*newJobs));
+        if (newJobs == nullptr)
+            return 0;
+
+        GnuPlotProcess.jobs         = newJobs;
+        GnuPlotProcess.jobsCapacity = newCapacity;
+    }
+
+    if (GnuPlotProcess.pid == -1 && !GnuPlotProcessStart())
+        return 0;
+
+    char* scriptName = strdup(plotFileName);
+    if (scriptName == nullptr)
+        return 0;
+
+    size_t jobId = ++GnuPlotProcess.lastJob;
+    GnuPlotProcess.jobs[jobId - 1] = {scriptName, GnuPlotState.imgIndex, GnuPlotState.funcIndex, 
+                                      false, false};
+
+    //gnuplot may have died on one of the previous jobs
+    if (!GnuPlotProcessSend(jobId))
+        GnuPlotProcessRecover();
+
+    return jobId;
 }
 
+//---------------------------------------------------------------------------------------
+
+bool GnuPlotWait(const size_t jobId)
+{
+    if (jobId == 0 || jobId > GnuPlotProcess.lastJob)
+        return false;
+
+    while (GnuPlotProcess.lastAck < jobId)
+        GnuPlotProcessReadAck();
+
+    GnuPlotJobType* job = &GnuPlotProcess.jobs[jobId - 1];
+
+    if (!job->failed && !job->filesRemoved)
+    {
+        unlink(job->scriptName);
+
+        static const size_t maxDataFileNameLength = 256;
+        char dataFileName[maxDataFileNameLength]  = "";
+
+        //formulas have no data files, unlink just fails for them
+        for (size_t funcIndex = 0; funcIndex < job->funcsCount; ++funcIndex)
+        {
+            CreateDataFileName(dataFileName, maxDataFileNameLength, job->imgIndex, funcIndex);
+            unlink(dataFileName);
+        }
+
+        job->filesRemoved = true;
+    }
+
+    return !job->failed;
+}
+
+bool GnuPlotWaitAll()
+{
+    bool allPlotted = true;
+
+    for (size_t jobId = 1; jobId <= GnuPlotProcess.lastJob; ++jobId)
+        allPlotted &= GnuPlotWait(jobId);
+
+    return allPlotted;
+}
+
+void GnuPlotClose()
+{
+    GnuPlotWaitAll();
+    GnuPlotProcessStop();
+
+    for (size_t i = 0; i < GnuPlotProcess.lastJob; ++i)
+        free(GnuPlotProcess.jobs[i].scriptName);
+
+    free(GnuPlotProcess.jobs);
+
+    GnuPlotProcess.jobs         = nullptr;
+    GnuPlotProcess.jobsCapacity = 0;
+    GnuPlotProcess.lastJob      = 0;
+    GnuPlotProcess.lastAck      = 0;
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool GnuPlotProcessStart()
+{
+    int commandsPipe[2] = {-1, -1};
+    int acksPipe[2]     = {-1, -1};
+
+    if (pipe(commandsPipe) != 0)
+        return false;
+
+    if (pipe(acksPipe) != 0)
+    {
+        close(commandsPipe[0]);
+        close(commandsPipe[1]);
+        return false;
+    }
+
+    //our ends must not leak to gnuplot and to other children (lualatex)
+    fcntl(commandsPipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(acksPipe[0],     F_SETFD, FD_CLOEXEC);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+
+    posix_spawn_file_actions_adddup2 (&actions, commandsPipe[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2 (&actions, acksPipe[1],     STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, commandsPipe[0]);
+    posix_spawn_file_actions_addclose(&actions, acksPipe[1]);
+
+    char* const argv[] = {const_cast<char*>(GNU_PLOT_PROGRAM), nullptr};
+
+    pid_t pid = -1;
+    int spawnErr = posix_spawnp(&pid, GNU_PLOT_PROGRAM, &actions, nullptr, argv, environ);
+
+    posix_spawn_file_actions_destroy(&actions);
+
+    close(commandsPipe[0]);
+    close(acksPipe[1]);
+
+    if (spawnErr != 0)
+    {
+        LOG_ERROR("can't start %s: %s\n", GNU_PLOT_PROGRAM, strerror(spawnErr));
+
+        close(commandsPipe[1]);
+        close(acksPipe[0]);
+        return false;
+    }
+
+    //dead gnuplot must give write error, not kill the program
+    signal(SIGPIPE, SIG_IGN);
+
+    GnuPlotProcess.pid      = pid;
+    GnuPlotProcess.commands = fdopen(commandsPipe[1], "w");
+    GnuPlotProcess.acks     = fdopen(acksPipe[0],     "r");
+
+    if (GnuPlotProcess.commands == nullptr || GnuPlotProcess.acks == nullptr)
+    {
+        if (GnuPlotProcess.commands == nullptr) close(commandsPipe[1]);
+        if (GnuPlotProcess.acks     == nullptr) close(acksPipe[0]);
+
+        GnuPlotProcessStop();
+        return false;
+    }
+
+    fprintf(GnuPlotProcess.commands, "set print \"-\"\n");
+
+    static bool closeRegistered = false;
+    if (!closeRegistered)
+    {
+        atexit(GnuPlotClose);
+        closeRegistered = true;
+    }
+
+    return true;
+}
+
+static void GnuPlotProcessStop()
+{
+    if (GnuPlotProcess.pid == -1)
+        return;
+
+    if (GnuPlotProcess.commands)
+    {
+        fprintf(GnuPlotProcess.commands, "exit\n");
+        fclose(GnuPlotProcess.commands);
+    }
+
+    if (GnuPlotProcess.acks)
+        fclose(GnuPlotProcess.acks);
+
+    waitpid(GnuPlotProcess.pid, nullptr, 0);
+
+    GnuPlotProcess.pid      = -1;
+    GnuPlotProcess.commands = nullptr;
+    GnuPlotProcess.acks     = nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool GnuPlotProcessSend(const size_t jobId)
+{
+    assert(jobId > 0 && jobId <= GnuPlotProcess.lastJob);
+
+    if (GnuPlotProcess.commands == nullptr)
+        return false;
+
+    //reset doesn't touch terminal and output, unset output closes the image
+    fprintf(GnuPlotProcess.commands, "reset\n"
+                                     "load \"%s\"\n"
+                                     "unset output\n"
+                                     "print \"%s %zu\"\n", 
+                                     GnuPlotProcess.jobs[jobId - 1].scriptName,
+                                     GNU_PLOT_ACK, jobId);
+
+    return fflush(GnuPlotProcess.commands) == 0;
+}
+
+static bool GnuPlotProcessReadAck()
+{
+    static const size_t maxLineLength = 256;
+    char line[maxLineLength] = "";
+
+    size_t ackLength = strlen(GNU_PLOT_ACK);
+
+    while (GnuPlotProcess.acks && fgets(line, maxLineLength, GnuPlotProcess.acks))
+    {
+        if (strncmp(line, GNU_PLOT_ACK, ackLength) != 0)
+            continue;
+
+        GnuPlotProcess.lastAck = strtoull(line + ackLength, nullptr, 10);
+        return true;
+    }
+
+    GnuPlotProcessRecover();
+
+    return false;
+}
+
+// gnuplot died on the first not acknowledged job: 
+// this job fails, the following ones are sent to the new process
+static void GnuPlotProcessRecover()
+{
+    if (GnuPlotProcess.commands)
+    {
+        fclose(GnuPlotProcess.commands);
+        GnuPlotProcess.commands = nullptr;
+    }
+
+    //acks written before the death are still in the pipe
+    size_t ackLength = strlen(GNU_PLOT_ACK);
+
+    static const size_t maxLineLength = 256;
+    char line[maxLineLength] = "";
+
+    while (GnuPlotProcess.acks && fgets(line, maxLineLength, GnuPlotProcess.acks))
+    {
+        if (strncmp(line, GNU_PLOT_ACK, ackLength) == 0)
+            GnuPlotProcess.lastAck = strtoull(line + ackLength, nullptr, 10);
+    }
+
+    GnuPlotProcessStop();
+
+    if (GnuPlotProcess.lastAck == GnuPlotProcess.lastJob)
+        return;
+
+    GnuPlotJobType* failedJob = &GnuPlotProcess.jobs[GnuPlotProcess.lastAck++];
+    failedJob->failed = true;
+
+    LOG_ERROR("gnuplot failed on %s\n", failedJob->scriptName);
+
+    if (GnuPlotProcess.lastAck == GnuPlotProcess.lastJob)
+        return;
+
+    if (!GnuPlotProcessStart())
+    {
+        //the rest jobs will never be plotted
+        for (size_t jobId = GnuPlotProcess.lastAck + 1; jobId <= GnuPlotProcess.lastJob; ++jobId)
+            GnuPlotProcess.jobs[jobId - 1].failed = true;
+
+        GnuPlotProcess.lastAck = GnuPlotProcess.lastJob;
+        return;
+    }
+
+    //if the new process dies too, it is noticed on reading its acks
+    for (size_t jobId = GnuPlotProcess.lastAck + 1; jobId <= GnuPlotProcess.lastJob; ++jobId)
+    {
+        if (!GnuPlotProcessSend(jobId))
+            break;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+
 static void ExpressionTokenPrintValue(const ExpressionTokenType* token, 
                                       FILE* outStream)
 {
@@ -143,21 +513,32 @@ const char* GnuPlotFileCreate(double xRangeLeft, double xRangeRight, char** outI
 {
     assert(xRangeLeft < xRangeRight);
     
-    static const char* gnuPlotFileName = "expressionsTmpPlot.gpi";
+    static size_t imgIndex = 1337;
+
+    //every image has its own script, so it can be changed while previous ones are plotted
+    static const size_t maxFileNameLength         = 256;
+    static char gnuPlotFileName[maxFileNameLength] = "";
+
+    snprintf(gnuPlotFileName, maxFileNameLength, "expressionsTmpPlot_%zu.gpi", imgIndex);
 
     FILE* outStream = fopen(gnuPlotFileName, "w");
 
     static const char* gnuPlotFilePrefix = "#! /opt/homebrew/bin/gnuplot -persist\n"
                                            "set xlabel \"X\"\n" 
                                            "set ylabel \"Y\"\n"
-                                           "set terminal png size 800, 600\n"
                                            "set grid";
 
     fprintf(outStream, "%s\n", gnuPlotFilePrefix);
+    fprintf(outStream, "set terminal png size %zu, %zu\n", GNU_PLOT_IMG_WIDTH, GNU_PLOT_IMG_HEIGHT);
     
     fprintf(outStream, "set xrange[%lg:%lg]\n", xRangeLeft, xRangeRight);
-    static size_t imgIndex = 1337;
     char* imgName = CreateImgName(imgIndex);
+
+    GnuPlotState.xRangeLeft  = xRangeLeft;
+    GnuPlotState.xRangeRight = xRangeRight;
+    GnuPlotState.imgIndex    = imgIndex;
+    GnuPlotState.funcIndex   = 0;
+
     imgIndex++;
 
     fprintf(outStream, "set output \"%s\"\n", imgName);
@@ -177,16 +558,122 @@ ExpressionErrors ExpressionGnuPlotAddFunc(const char* plotFileName,  ExpressionT
                                                         const char* funcTitle, 
                                                         const char* funcColor)
 {
+    assert(plotFileName);
+    assert(expression);
+
+    ExpressionErrors err = ExpressionErrors::NO_ERR;
+
+    static const size_t maxDataFileNameLength = 256;
+    char dataFileName[maxDataFileNameLength]  = "";
+
+    if (GnuPlotState.mode != GnuPlotMode::FORMULA)
+    {
+        CreateDataFileName(dataFileName, maxDataFileNameLength, 
+                           GnuPlotState.imgIndex, GnuPlotState.funcIndex);
+
+        err = ExpressionGnuPlotWriteSamples(dataFileName, expression);
+
+        if (err != ExpressionErrors::NO_ERR)
+            return err;
+    }
+
     FILE* outStream = fopen(plotFileName, "a");
 
-    ExpressionErrors err = ExpressionPrintGnuPlotFormat(expression, outStream);
-    fprintf(outStream, " title \"%s\" lc rgb \"%s\", ", funcTitle, funcColor);
+    //gnuplot doesn't accept trailing comma in plot command
+    if (GnuPlotState.funcIndex > 0)
+        fprintf(outStream, ", ");
+
+    if (GnuPlotState.mode != GnuPlotMode::FORMULA)
+        fprintf(outStream, "\"%s\" binary format=\"%%float64%%float64\" using 1:2 with lines", 
+                                                                                dataFileName);
+    else
+        err = ExpressionPrintGnuPlotFormat(expression, outStream);
+
+    fprintf(outStream, " title \"%s\" lc rgb \"%s\"", funcTitle, funcColor);
 
     fclose(outStream);
 
+    GnuPlotState.funcIndex++;
+
     return err;
 }
 
+//---------------------------------------------------------------------------------------
+
+void GnuPlotSetMode(const GnuPlotMode mode, const size_t samplesCount)
+{
+    assert(samplesCount > 1);
+
+    GnuPlotState.mode         = mode;
+    GnuPlotState.samplesCount = samplesCount;
+}
+
+void GnuPlotSetSamplerParams(const ExpressionSamplerParamsType* params)
+{
+    assert(params);
+    assert(params->startSamples > 1);
+
+    GnuPlotState.samplerParams = *params;
+}
+
+static ExpressionErrors ExpressionGnuPlotWriteSamples(const char* dataFileName,
+                                                      const ExpressionType* expression)
+{
+    assert(dataFileName);
+    assert(expression);
+
+    ExpressionSamplesType samples = {};
+    ExpressionErrors err = ExpressionSamplesCtor(&samples);
+
+    if (err != ExpressionErrors::NO_ERR)
+        return err;
+
+    const ExpressionVariableType* variable = ExpressionGnuPlotFindVariable(expression);
+
+    if (GnuPlotState.mode == GnuPlotMode::ADAPTIVE)
+        err = ExpressionSampleAdaptive(expression, variable, 
+                                       GnuPlotState.xRangeLeft, GnuPlotState.xRangeRight,
+                                       &GnuPlotState.samplerParams, &samples);
+    else
+        err = ExpressionSampleUniform (expression, variable,
+                                       GnuPlotState.xRangeLeft, GnuPlotState.xRangeRight,
+                                       GnuPlotState.samplesCount, &samples);
+
+    if (err == ExpressionErrors::NO_ERR)
+    {
+        FILE* dataStream = fopen(dataFileName, "wb");
+
+        if (dataStream == nullptr || 
+            fwrite(samples.points, 2 * sizeof(*samples.points), samples.size, dataStream) != 
+                                                                                samples.size)
+            err = ExpressionErrors::MEM_ERR;
+
+        if (dataStream)
+            fclose(dataStream);
+    }
+
+    ExpressionSamplesDtor(&samples);
+
+    return err;
+}
+
+static const ExpressionVariableType* ExpressionGnuPlotFindVariable(
+                                                      const ExpressionType* expression)
+{
+    assert(expression);
+
+    //gnuplot formulas are plotted over x as well
+    static const char* plotVariableName = "x";
+
+    for (size_t i = 0; i < expression->variables.size; ++i)
+    {
+        if (strcmp(expression->variables.data[i].variableName, plotVariableName) == 0)
+            return &expression->variables.data[i];
+    }
+
+    return nullptr;
+}
+
 ExpressionErrors ExpressionPlotTwoFuncs(ExpressionType* func1, 
                                         const char* title1,  const char* color1, 
                                         ExpressionType* func2,
@@ -2,6 +2,18 @@
 #define MATH_EXPRESSION_GNU_PLOT_H
 
 #include "MathExpressionsMain.h"
+#include "MathExpressionSampler.h"
+
+enum class GnuPlotMode
+{
+    FORMULA,        // expression is printed to the script and calculated by gnuplot
+    SAMPLES,        // expression is calculated here in samplesCount uniform points, 
+                    // script plots binary file with samples
+    ADAPTIVE,       // as SAMPLES, but points are chosen by ExpressionSampleAdaptive()
+};
+
+void GnuPlotSetMode(const GnuPlotMode mode, const size_t samplesCount = 1000);
+void GnuPlotSetSamplerParams(const ExpressionSamplerParamsType* params);
 
 ExpressionErrors ExpressionPrintGnuPlotFormat (ExpressionTokenType* token, FILE* outStream);
 ExpressionErrors ExpressionPrintGnuPlotFormat (ExpressionType* expression, FILE* outStream);
@@ -21,7 +33,14 @@ ExpressionErrors ExpressionPlotFunc(ExpressionType* func,
                                     double xRangeLeft,     double xRangeRight,     
                                     char** outImgName = nullptr);
 
-void        GnuPlotImgCreate (const char* plotFileName);
 const char* GnuPlotFileCreate(double xRangeLeft, double xRangeRight, char** outImgName = nullptr);
 
+// Images are plotted by one gnuplot process started on the first call.
+// GnuPlotImgCreate() only sends the job and returns its id (0 on failure), 
+// image is ready after GnuPlotWait() with this id returns true.
+size_t GnuPlotImgCreate(const char* plotFileName);
+bool   GnuPlotWait     (const size_t jobId);
+bool   GnuPlotWaitAll  ();
+void   GnuPlotClose    ();
+
 #endif
\ No newline at end of file
@@ -6,59 +6,126 @@
 #include "Common/Log.h"
 #include "FastInput/InputOutput.h"
 #include "Common/StringFuncs.h"
+#include "Common/OutputBuffer.h"
+#include "Common/DoubleScan.h"
+#include "MathExpressionTokensStack.h"
+
+// chunk of the stream is kept in the buffer, token that is cut by the end of the chunk
+// is moved to the beginning of the buffer before reading the next chunk
+static const size_t PREFIX_STREAM_CHUNK_SIZE = 1 << 16;
+
+struct PrefixStreamType
+{
+    FILE* inStream;
+
+    char*  buffer;      // always '\0'-terminated
+    size_t size;
+    size_t pos;
+
+    bool   ended;
+};
+
+// stage - how many sons of the token are already read
+struct PrefixStreamFrameType
+{
+    ExpressionTokenType* token;
+    int stage;
+    int sonsCount;
+};
+
+// stage - how many sons of the token are already printed
+struct PrintFrameType
+{
+    const ExpressionTokenType* token;
+    int stage;
+
+    bool needLeftBrackets;
+    bool needRightBrackets;
+};
+
+typedef TokensStackType<PrintFrameType> PrintStackType;
 
 static bool ExpressionOperationIsPrefix(const ExpressionOperationId operation);
 
 static ExpressionErrors ExpressionPrintPrefixFormat     (
                                                 const ExpressionTokenType* token, 
-                                                FILE* outStream);
+                                                OutputBufferType* outBuffer);
 
 static ExpressionErrors ExpressionPrintEquationFormat   (
                                                 const ExpressionTokenType* token, 
-                                                FILE* outStream);
+                                                OutputBufferType* outBuffer);
+
+static inline void ExpressionPrintPrefixTokenBegin(const ExpressionTokenType* token,
+                                                   OutputBufferType* outBuffer);
 
 static void ExpressionTokenPrintValue                       (
                                                 const ExpressionTokenType* token, 
-                                                FILE* outStream);
+                                                OutputBufferType* outBuffer);
+
+static void ExpressionTokenPrintOperation(const ExpressionOperationId operation,
+                                          OutputBufferType* outBuffer);
 
-static ExpressionTokenType* ExpressionReadPrefixFormat(
+static ExpressionErrors ExpressionReadPrefixFormat(
                                                 const char* const string, 
                                                 const char** stringEndPtr,
-                                                ExpressionVariablesArrayType* varsArr);
+                                                ExpressionVariablesArrayType* varsArr,
+                                                ExpressionTokenType** tokenPtr);
 
-static ExpressionTokenType* ExpressionReadEquationFormat(
+static ExpressionErrors ExpressionReadEquationFormat(
                                                 const char* const string, 
                                                 const char** stringEndPtr,
-                                                ExpressionVariablesArrayType* varsArr);
+                                                ExpressionVariablesArrayType* varsArr,
+                                                ExpressionTokenType** tokenPtr);
+
+static ExpressionErrors PrefixStreamCtor(PrefixStreamType* stream, FILE* inStream);
+static void             PrefixStreamDtor(PrefixStreamType* stream);
+
+static bool PrefixStreamReadChunk     (PrefixStreamType* stream);
+static int  PrefixStreamSkipSpaces    (PrefixStreamType* stream);
+static bool PrefixStreamSkipClosing   (PrefixStreamType* stream, const int nilsCount);
+static bool PrefixStreamLoadWord      (PrefixStreamType* stream);
+
+static ExpressionErrors ExpressionReadPrefixFormatStream(PrefixStreamType* stream,
+                                                         ExpressionTokenType** rootPtr,
+                                                         ExpressionVariablesArrayType* varsArr);
 
 static const char* ExpressionReadTokenValue(ExpressionTokenValue* value, 
                                                ExpressionTokenValueTypeof* valueType, 
                                                ExpressionVariablesArrayType* varsArr,
                                                const char* stringPtr);
+static inline bool ExpressionIsWordEnd(const char symbol);
+static inline bool ExpressionIsNil    (const char* word);
+static inline int  ExpressionTokenSonsCount(const ExpressionTokenType* token);
 
 static bool HaveToPutBrackets(const ExpressionTokenType* parent, 
                               const ExpressionTokenType* son);
 
-#define PRINT(outStream, ...)                          \
-do                                                     \
-{                                                      \
-    if (outStream) fprintf(outStream, __VA_ARGS__);    \
-    Log(__VA_ARGS__);                                  \
-} while (0)
+static ExpressionErrors ExpressionPrintToStream(const ExpressionType* expression, FILE* outStream,
+                                               ExpressionErrors (*printFunc)(const ExpressionType*,
+                                                                             OutputBufferType*));
+
+//---------------------------------------------------------------------------------------
 
 ExpressionErrors ExpressionPrintPrefixFormat(const ExpressionType* expression, 
                                              FILE* outStream)
 {
-    assert(expression);
-    assert(outStream);
+    return ExpressionPrintToStream(expression, outStream, ExpressionPrintPrefixFormat);
+}
 
-    LOG_BEGIN();
+//---------------------------------------------------------------------------------------
 
-    ExpressionErrors err = ExpressionPrintPrefixFormat(expression->root, outStream);
+ExpressionErrors ExpressionPrintPrefixFormat(const ExpressionType* expression,
+                                             OutputBufferType* outBuffer)
+{
+    assert(expression);
+    assert(outBuffer);
+
+    ExpressionErrors err = ExpressionPrintPrefixFormat(expression->root, outBuffer);
 
-    PRINT(outStream, "\n");
+    OutputBufferPutChar(outBuffer, '\n');
 
-    LOG_END();
+    if (err == ExpressionErrors::NO_ERR && outBuffer->failed)
+        err = ExpressionErrors::MEM_ERR;
 
     return err;
 }
@@ -67,93 +134,207 @@ ExpressionErrors ExpressionPrintPrefixFormat(const ExpressionType* expression,
 
 static ExpressionErrors ExpressionPrintPrefixFormat(
                                                     const ExpressionTokenType* token, 
-                                                    FILE* outStream)
+                                                    OutputBufferType* outBuffer)
 {
     if (token == nullptr)
     {
-        PRINT(outStream, "nil ");
+        OutputBufferPutString(outBuffer, "nil ");
         return ExpressionErrors::NO_ERR;
     }
 
-    PRINT(outStream, "(");
-    
-    if (token->valueType == ExpressionTokenValueTypeof::VALUE)
-        PRINT(outStream, "%.2lg ", token->value.value);
-    else if (token->valueType == ExpressionTokenValueTypeof::VARIABLE)
-        PRINT(outStream, "%s ", token->value.varPtr->variableName);
-    else
-        PRINT(outStream, "%s ", ExpressionOperationGetLongName(token->value.operation));
+    PrintStackType stack;
+    VectorCtor(&stack);
 
     ExpressionErrors err = ExpressionErrors::NO_ERR;
 
-    err = ExpressionPrintPrefixFormat(token->left, outStream);
-    
-    err = ExpressionPrintPrefixFormat(token->right, outStream);
+    ExpressionPrintPrefixTokenBegin(token, outBuffer);
+    if (VectorPush(&stack, PrintFrameType{token, 0, false, false}) != VectorErrors::VECTOR_NO_ERR)
+        err = ExpressionErrors::MEM_ERR;
+
+    while (!VectorIsEmpty(&stack) && err == ExpressionErrors::NO_ERR)
+    {
+        PrintFrameType* frame = TokensStackTop(&stack);
+
+        if (frame->stage == 2)
+        {
+            OutputBufferPutChar(outBuffer, ')');
+            TokensStackPop(&stack);
+            continue;
+        }
+
+        const ExpressionTokenType* son = frame->stage == 0 ? frame->token->left : 
+                                                             frame->token->right;
+        frame->stage++;
+
+        if (son == nullptr)
+        {
+            OutputBufferPutString(outBuffer, "nil ");
+            continue;
+        }
+
+        ExpressionPrintPrefixTokenBegin(son, outBuffer);
+
+        if (son->left == nullptr && son->right == nullptr)
+            OutputBufferPutString(outBuffer, "nil nil )");
+        else if (VectorPush(&stack, PrintFrameType{son, 0, false, false}) != 
+                                                            VectorErrors::VECTOR_NO_ERR)
+            err = ExpressionErrors::MEM_ERR;
+    }
 
-    PRINT(outStream, ")");
+    VectorDtor(&stack);
     
     return err;
 }
 
+static inline void ExpressionPrintPrefixTokenBegin(const ExpressionTokenType* token,
+                                                   OutputBufferType* outBuffer)
+{
+    assert(token);
+    assert(outBuffer);
+
+    OutputBufferPutChar(outBuffer, '(');
+    
+    if (token->valueType == ExpressionTokenValueTypeof::VALUE)
+    {
+        OutputBufferPrintf(outBuffer, "%.2lg ", token->value.value);
+        return;
+    }
+
+    if (token->valueType == ExpressionTokenValueTypeof::VARIABLE)
+        OutputBufferPutString(outBuffer, token->value.varPtr->variableName);
+    else
+        OutputBufferPutString(outBuffer, ExpressionOperationGetLongName(token->value.operation));
+        
+    OutputBufferPutChar(outBuffer, ' ');
+}
+
 //---------------------------------------------------------------------------------------
 
 ExpressionErrors ExpressionPrintEquationFormat(const ExpressionType* expression, 
                                                        FILE* outStream)
+{
+    return ExpressionPrintToStream(expression, outStream, ExpressionPrintEquationFormat);
+}
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionPrintEquationFormat(const ExpressionType* expression,
+                                               OutputBufferType* outBuffer)
 {
     assert(expression);
-    assert(outStream);
+    assert(outBuffer);
 
-    LOG_BEGIN();
+    ExpressionErrors err = ExpressionPrintEquationFormat(expression->root, outBuffer);
 
-    ExpressionErrors err = ExpressionPrintEquationFormat(expression->root, outStream);
-    PRINT(outStream, "\n");
+    OutputBufferPutChar(outBuffer, '\n');
 
-    LOG_END();
+    if (err == ExpressionErrors::NO_ERR && outBuffer->failed)
+        err = ExpressionErrors::MEM_ERR;
 
     return err; 
 }
 
 //---------------------------------------------------------------------------------------
 
+static ExpressionErrors ExpressionPrintToStream(const ExpressionType* expression, FILE* outStream,
+                                               ExpressionErrors (*printFunc)(const ExpressionType*,
+                                                                             OutputBufferType*))
+{
+    assert(expression);
+    assert(printFunc);
+
+    OutputBufferType outBuffer = {};
+    if (!OutputBufferCtor(&outBuffer, outStream))
+        return ExpressionErrors::MEM_ERR;
+
+    ExpressionErrors err = printFunc(expression, &outBuffer);
+
+    if (outStream == nullptr)
+        LogText(outBuffer.data, outBuffer.size);
+    else if (!OutputBufferFlush(&outBuffer) && err == ExpressionErrors::NO_ERR)
+        err = ExpressionErrors::MEM_ERR;
+
+    OutputBufferDtor(&outBuffer);
+
+    return err;
+}
+
+//---------------------------------------------------------------------------------------
+
 static ExpressionErrors ExpressionPrintEquationFormat(
                                           const ExpressionTokenType* token, 
-                                          FILE* outStream)
+                                          OutputBufferType* outBuffer)
 {
     if (token->left == nullptr && token->right == nullptr)
     {
-        ExpressionTokenPrintValue(token, outStream);
+        ExpressionTokenPrintValue(token, outBuffer);
 
         return ExpressionErrors::NO_ERR;
     }
 
-    assert(token->valueType == ExpressionTokenValueTypeof::OPERATION);
+    PrintStackType stack;
+    VectorCtor(&stack);
 
-    bool isPrefixOperation = ExpressionOperationIsPrefix(token->value.operation);
-    if (isPrefixOperation) fprintf(outStream, "%s ", 
-                                    ExpressionOperationGetShortName(token->value.operation));
+    ExpressionErrors err = ExpressionErrors::NO_ERR;
 
-    bool needLeftBrackets = HaveToPutBrackets(token, token->left);
+    if (VectorPush(&stack, PrintFrameType{token, 0, false, false}) != VectorErrors::VECTOR_NO_ERR)
+        err = ExpressionErrors::MEM_ERR;
 
-    if (needLeftBrackets) PRINT(outStream, "(");
+    while (!VectorIsEmpty(&stack) && err == ExpressionErrors::NO_ERR)
+    {
+        PrintFrameType* frame = TokensStackTop(&stack);
+        token = frame->token;
 
-    ExpressionErrors err = ExpressionErrors::NO_ERR;
-    err = ExpressionPrintEquationFormat(token->left, outStream);
+        assert(token->valueType == ExpressionTokenValueTypeof::OPERATION);
 
-    if (needLeftBrackets) PRINT(outStream, ")");
+        ExpressionOperationId operation = token->value.operation;
+        const ExpressionTokenType* son  = nullptr;
+        
+        switch (frame->stage++)
+        {
+            case 0:
+                if (ExpressionOperationIsPrefix(operation)) 
+                    ExpressionTokenPrintOperation(operation, outBuffer);
 
-    if (!isPrefixOperation) fprintf(outStream, "%s ", 
-                                     ExpressionOperationGetShortName(token->value.operation));
+                frame->needLeftBrackets = HaveToPutBrackets(token, token->left);
+                if (frame->needLeftBrackets) OutputBufferPutChar(outBuffer, '(');
 
-    if (ExpressionOperationIsUnary(token->value.operation))  
-        return err;
+                son = token->left;
+                break;
+
+            case 1:
+                if (frame->needLeftBrackets) OutputBufferPutChar(outBuffer, ')');
+
+                if (!ExpressionOperationIsPrefix(operation)) 
+                    ExpressionTokenPrintOperation(operation, outBuffer);
 
-    bool needRightBrackets = HaveToPutBrackets(token, token->right);
+                if (ExpressionOperationIsUnary(operation))
+                {
+                    TokensStackPop(&stack);
+                    continue;
+                }
 
-    if (needRightBrackets) PRINT(outStream, "(");
+                frame->needRightBrackets = HaveToPutBrackets(token, token->right);
+                if (frame->needRightBrackets) OutputBufferPutChar(outBuffer, '(');
 
-    err = ExpressionPrintEquationFormat(token->right, outStream);
+                son = token->right;
+                break;
 
-    if (needRightBrackets) PRINT(outStream, ")");
+            default:
+                if (frame->needRightBrackets) OutputBufferPutChar(outBuffer, ')');
+
+                TokensStackPop(&stack);
+                continue;
+        }
+
+        if (son->left == nullptr && son->right == nullptr)
+            ExpressionTokenPrintValue(son, outBuffer);
+        else if (VectorPush(&stack, PrintFrameType{son, 0, false, false}) != 
+                                                            VectorErrors::VECTOR_NO_ERR)
+            err = ExpressionErrors::MEM_ERR;
+    }
+
+    VectorDtor(&stack);
 
     return err;
 }
@@ -206,66 +387,354 @@ ExpressionErrors ExpressionReadPrefixFormat(ExpressionType* expression, FILE* in
     assert(expression);
     assert(inStream);
 
-    char* inputExpression = ReadText(inStream);
+    //mapped text is parsed in place without copying the file
+    MappedTextType inputText = {};
 
-    if (inputExpression == nullptr)
-        return ExpressionErrors::MEM_ERR;
+    if (MappedTextCtor(&inputText, inStream) != 0)
+        return ExpressionErrors::READING_ERR;
+
+    ExpressionErrors err = ExpressionReadPrefixFormat(expression, inputText.text);
+
+    MappedTextDtor(&inputText);
+
+    return err;
+}
+
+ExpressionErrors ExpressionReadPrefixFormat(ExpressionType* expression, const char* string)
+{
+    assert(expression);
+    assert(string);
+
+    const char* stringEndPtr = string;
+
+    ExpressionErrors err = ExpressionReadPrefixFormat(string, &stringEndPtr, 
+                                                      &expression->variables, &expression->root);
+
+    if (err != ExpressionErrors::NO_ERR)
+    {
+        ExpressionDtor(expression->root);
+        expression->root = nullptr;
+    }
+
+    return err;
+}
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionReadPrefixFormatStream(FILE* inStream, 
+                                                  ExpressionStreamCallbackType* callback,
+                                                  void* context)
+{
+    assert(inStream);
+    assert(callback);
+
+    PrefixStreamType stream = {};
+    ExpressionErrors err    = PrefixStreamCtor(&stream, inStream);
+
+    if (err != ExpressionErrors::NO_ERR)
+        return err;
+
+    while (PrefixStreamSkipSpaces(&stream) != EOF)
+    {
+        ExpressionType expression = {};
+        err = ExpressionCtor(&expression);
+
+        if (err == ExpressionErrors::NO_ERR)
+            err = ExpressionReadPrefixFormatStream(&stream, &expression.root, 
+                                                            &expression.variables);
+
+        bool keepReading = err == ExpressionErrors::NO_ERR && callback(&expression, context);
+
+        ExpressionDtor(&expression);
+
+        if (!keepReading)
+            break;
+    }
+
+    if (err == ExpressionErrors::NO_ERR && ferror(inStream))
+        err = ExpressionErrors::READING_ERR;
+
+    PrefixStreamDtor(&stream);
+
+    return err;
+}
+
+//---------------------------------------------------------------------------------------
+
+static ExpressionErrors ExpressionReadPrefixFormatStream(PrefixStreamType* stream,
+                                                         ExpressionTokenType** rootPtr,
+                                                         ExpressionVariablesArrayType* varsArr)
+{
+    assert(stream);
+    assert(rootPtr);
+    assert(varsArr);
+
+    ExpressionErrors err = ExpressionErrors::NO_ERR;
+
+    TokensStackType<PrefixStreamFrameType> stack;
+    VectorCtor(&stack);
+
+    // tokens are attached to the tree as soon as they are read,
+    // so the tree is destructed as a whole on error
+    ExpressionTokenType** tokenPtr = rootPtr;
+
+    while (true)
+    {
+        int symbol = PrefixStreamSkipSpaces(stream);
+
+        // the root and operands of operations can't be nil
+        if (symbol != '(')
+        {
+            err = ExpressionErrors::READING_ERR;
+            break;
+        }
+
+        stream->pos++;
+
+        if (PrefixStreamSkipSpaces(stream) == EOF || !PrefixStreamLoadWord(stream))
+        {
+            err = ExpressionErrors::READING_ERR;
+            break;
+        }
+
+        ExpressionTokenValue value;
+        ExpressionTokenValueTypeof valueType;
+
+        const char* valueEnd = ExpressionReadTokenValue(&value, &valueType, varsArr, 
+                                                        stream->buffer + stream->pos);
+        if (valueEnd == nullptr)
+        {
+            err = ExpressionErrors::READING_ERR;
+            break;
+        }
+
+        stream->pos = (size_t)(valueEnd - stream->buffer);
+
+        *tokenPtr = ExpressionTokenCreate(value, valueType);
+
+        if (VectorPush(&stack, PrefixStreamFrameType{*tokenPtr, 0, 
+                                    ExpressionTokenSonsCount(*tokenPtr)}) != 
+                                                        VectorErrors::VECTOR_NO_ERR)
+        {
+            err = ExpressionErrors::MEM_ERR;
+            break;
+        }
+
+        tokenPtr = nullptr;
+
+        while (!VectorIsEmpty(&stack))
+        {
+            PrefixStreamFrameType* frame = TokensStackTop(&stack);
 
-    const char* inputExpressionEndPtr = inputExpression;
+            if (frame->stage < frame->sonsCount)
+            {
+                tokenPtr = frame->stage == 0 ? &frame->token->left : &frame->token->right;
+                frame->stage++;
+                break;
+            }
 
-    expression->root = ExpressionReadPrefixFormat(inputExpression, 
-                                                      &inputExpressionEndPtr, 
-                                                      &expression->variables);
+            if (!PrefixStreamSkipClosing(stream, 2 - frame->sonsCount))
+            {
+                err = ExpressionErrors::READING_ERR;
+                break;
+            }
 
-    free(inputExpression);
+            TokensStackPop(&stack);
+        }
+
+        if (tokenPtr == nullptr)
+            break;
+    }
+
+    VectorDtor(&stack);
+
+    return err;
+}
+
+//---------------------------------------------------------------------------------------
+
+static ExpressionErrors PrefixStreamCtor(PrefixStreamType* stream, FILE* inStream)
+{
+    assert(stream);
+    assert(inStream);
+
+    stream->buffer = (char*) calloc(PREFIX_STREAM_CHUNK_SIZE + 1, sizeof(*stream->buffer));
+
+    if (stream->buffer == nullptr)
+        return ExpressionErrors::MEM_ERR;
+
+    stream->inStream = inStream;
+    stream->size     = 0;
+    stream->pos      = 0;
+    stream->ended    = false;
 
     return ExpressionErrors::NO_ERR;
 }
 
+static void PrefixStreamDtor(PrefixStreamType* stream)
+{
+    assert(stream);
+
+    free(stream->buffer);
+
+    stream->buffer   = nullptr;
+    stream->inStream = nullptr;
+    stream->size     = 0;
+    stream->pos      = 0;
+}
+
 //---------------------------------------------------------------------------------------
 
-static ExpressionTokenType* ExpressionReadPrefixFormat(
-                                                        const char* const string, 
-                                                        const char** stringEndPtr,
-                                                        ExpressionVariablesArrayType* varsArr)
+// moves unread chars to the beginning of the buffer and appends the next chunk,
+// returns false if nothing was appended
+static bool PrefixStreamReadChunk(PrefixStreamType* stream)
 {
-    assert(string);
+    assert(stream);
 
-    const char* stringPtr = string;
+    size_t restSize = stream->size - stream->pos;
 
-    stringPtr = SkipSymbolsWhileStatement(stringPtr, isspace);
+    // stream ended or one token takes the whole buffer
+    if (stream->ended || restSize == PREFIX_STREAM_CHUNK_SIZE)
+        return false;
+    memmove(stream->buffer, stream->buffer + stream->pos, restSize);
+
+    stream->size = restSize;
+    stream->pos  = 0;
+
+    size_t readenSize = fread(stream->buffer + stream->size, sizeof(*stream->buffer),
+                              PREFIX_STREAM_CHUNK_SIZE - stream->size, stream->inStream);
+
+    stream->size += readenSize;
+    stream->buffer[stream->size] = '\0';
+
+    if (readenSize == 0)
+        stream->ended = true;
+
+    return readenSize != 0;
+}
+
+//---------------------------------------------------------------------------------------
 
-    int symbol = *stringPtr;
-    stringPtr++;
-    if (symbol != '(') //skipping nils
+// returns the first not space symbol without skipping it
+static int PrefixStreamSkipSpaces(PrefixStreamType* stream)
+{
+    assert(stream);
+
+    do
     {
-        int shift = 0;
-        sscanf(stringPtr, "%*s%n", &shift);
-        stringPtr += shift;
+        while (stream->pos < stream->size && isspace(stream->buffer[stream->pos]))
+            stream->pos++;
 
-        *stringEndPtr = stringPtr;
-        return nullptr;
+        if (stream->pos < stream->size)
+            return stream->buffer[stream->pos];
+
+    } while (PrefixStreamReadChunk(stream));
+
+    return EOF;
+}
+
+// after the sons only nils in place of the missing sons and ')' are allowed
+static bool PrefixStreamSkipClosing(PrefixStreamType* stream, const int nilsCount)
+{
+    assert(stream);
+
+    int symbol = PrefixStreamSkipSpaces(stream);
+
+    for (int nilId = 0; nilId < nilsCount && symbol != ')'; ++nilId)
+    {
+        if (symbol == EOF || !PrefixStreamLoadWord(stream) || 
+            !ExpressionIsNil(stream->buffer + stream->pos))
+            return false;
+
+        stream->pos += sizeof("nil") - 1;
+        symbol = PrefixStreamSkipSpaces(stream);
     }
 
+    if (symbol != ')')
+        return false;
+
+    stream->pos++;
+
+    return true;
+}
+
+// makes the whole word at pos and the symbol after it lie in the buffer
+static bool PrefixStreamLoadWord(PrefixStreamType* stream)
+{
+    assert(stream);
+
+    size_t wordSize = 0;
+
+    do
+    {
+        while (stream->pos + wordSize < stream->size && 
+               !ExpressionIsWordEnd(stream->buffer[stream->pos + wordSize]))
+            wordSize++;
+
+        if (stream->pos + wordSize < stream->size)
+            return true;
+
+    } while (PrefixStreamReadChunk(stream));
+
+    return false;
+}
+
+//---------------------------------------------------------------------------------------
+
+static ExpressionErrors ExpressionReadPrefixFormat(
+                                                        const char* const string, 
+                                                        const char** stringEndPtr,
+                                                        ExpressionVariablesArrayType* varsArr,
+                                                        ExpressionTokenType** tokenPtr)
+{
+    assert(string);
+    assert(stringEndPtr);
+    assert(tokenPtr);
+
+    *tokenPtr = nullptr;
+
+    const char* stringPtr = SkipSymbolsWhileStatement(string, isspace);
+
+    // the root and operands of operations can't be nil
+    if (*stringPtr != '(')
+        return ExpressionErrors::READING_ERR;
+
     ExpressionTokenValue value;
     ExpressionTokenValueTypeof valueType;
 
-    stringPtr = ExpressionReadTokenValue(&value, &valueType, varsArr, stringPtr);
+    stringPtr = ExpressionReadTokenValue(&value, &valueType, varsArr, stringPtr + 1);
+
+    if (stringPtr == nullptr)
+        return ExpressionErrors::READING_ERR;
+
+    // token is attached at once, so the caller destructs the whole tree on error
     ExpressionTokenType* token = ExpressionTokenCreate(value, valueType);
-    
-    ExpressionTokenType* left  = ExpressionReadPrefixFormat(stringPtr, &stringPtr, varsArr);
+    *tokenPtr = token;
 
-    ExpressionTokenType* right = nullptr;
-    if (!ExpressionOperationIsUnary(token->value.operation))
-        right = ExpressionReadPrefixFormat(stringPtr, &stringPtr, varsArr);
+    const int sonsCount = ExpressionTokenSonsCount(token);
 
-    stringPtr = SkipSymbolsUntilStopChar(stringPtr, ')');
-    ++stringPtr;
+    ExpressionErrors err = ExpressionErrors::NO_ERR;
 
-    ExpressionTokenSetEdges(token, left, right);
+    if (sonsCount > 0)
+        err = ExpressionReadPrefixFormat(stringPtr, &stringPtr, varsArr, &token->left);
 
-    *stringEndPtr = stringPtr;
-    return token;
+    if (err == ExpressionErrors::NO_ERR && sonsCount > 1)
+        err = ExpressionReadPrefixFormat(stringPtr, &stringPtr, varsArr, &token->right);
+
+    if (err != ExpressionErrors::NO_ERR)
+        return err;
+
+    stringPtr = SkipSymbolsWhileStatement(stringPtr, isspace);
+
+    // only nils in place of the missing sons are allowed
+    for (int nilId = sonsCount; nilId < 2 && ExpressionIsNil(stringPtr); ++nilId)
+        stringPtr = SkipSymbolsWhileStatement(stringPtr + sizeof("nil") - 1, isspace);
+
+    if (*stringPtr != ')')
+        return ExpressionErrors::READING_ERR;
+
+    *stringEndPtr = stringPtr + 1;
+    return ExpressionErrors::NO_ERR;
 }
 
 //---------------------------------------------------------------------------------------
@@ -275,64 +744,91 @@ ExpressionErrors ExpressionReadEquationFormat (ExpressionType* expression, FILE*
     assert(expression);
     assert(inStream);
 
-    char* inputExpression = ReadText(inStream);
+    MappedTextType inputText = {};
 
-    if (inputExpression == nullptr)
-        return ExpressionErrors::MEM_ERR;
+    if (MappedTextCtor(&inputText, inStream) != 0)
+        return ExpressionErrors::READING_ERR;
     
-    const char* inputExpressionEndPtr = inputExpression;
+    const char* inputExpressionEndPtr = inputText.text;
 
-    expression->root = ExpressionReadEquationFormat(inputExpression, 
-                                                     &inputExpressionEndPtr, 
-                                                     &expression->variables);
+    ExpressionErrors err = ExpressionReadEquationFormat(inputText.text, 
+                                                        &inputExpressionEndPtr, 
+                                                        &expression->variables,
+                                                        &expression->root);
 
-    free(inputExpression);
+    if (err != ExpressionErrors::NO_ERR)
+    {
+        ExpressionDtor(expression->root);
+        expression->root = nullptr;
+    }
 
-    return ExpressionErrors::NO_ERR;
+    MappedTextDtor(&inputText);
+
+    return err;
 }
 
 //---------------------------------------------------------------------------------------
 
-static ExpressionTokenType* ExpressionReadEquationFormat(
+static ExpressionErrors ExpressionReadEquationFormat(
                                             const char* const string, 
                                             const char** stringEndPtr,
-                                            ExpressionVariablesArrayType* varsArr)
+                                            ExpressionVariablesArrayType* varsArr,
+                                            ExpressionTokenType** tokenPtr)
 {
     assert(string);
+    assert(stringEndPtr);
+    assert(tokenPtr);
 
-    const char* stringPtr = string;
+    *tokenPtr = nullptr;
 
-    stringPtr = SkipSymbolsWhileStatement(stringPtr, isspace);
+    const char* stringPtr = SkipSymbolsWhileStatement(string, isspace);
 
     ExpressionTokenValue     value;
     ExpressionTokenValueTypeof valueType;
 
-    int symbol = *stringPtr;
-    stringPtr++;
-
-    if (symbol != '(')
+    if (*stringPtr != '(')
     {
-        --stringPtr;
-
         stringPtr = ExpressionReadTokenValue(&value, &valueType, varsArr, stringPtr);
-        ExpressionTokenType* token = ExpressionTokenCreate(value, valueType);
 
+        if (stringPtr == nullptr)
+            return ExpressionErrors::READING_ERR;
+
+        *tokenPtr     = ExpressionTokenCreate(value, valueType);
         *stringEndPtr = stringPtr;
-        return token;
+        return ExpressionErrors::NO_ERR;
     }
 
-    ExpressionTokenType* left  = ExpressionReadEquationFormat(stringPtr, &stringPtr, varsArr);
+    ExpressionTokenType* left = nullptr;
+    ExpressionErrors err = ExpressionReadEquationFormat(stringPtr + 1, &stringPtr, varsArr, &left);
+
+    if (err == ExpressionErrors::NO_ERR)
+    {
+        stringPtr = ExpressionReadTokenValue(&value, &valueType, varsArr, stringPtr);
+
+        if (stringPtr == nullptr)
+            err = ExpressionErrors::READING_ERR;
+    }
+
+    if (err != ExpressionErrors::NO_ERR)
+    {
+        ExpressionDtor(left);
+        return err;
+    }
 
-    stringPtr = ExpressionReadTokenValue(&value, &valueType, varsArr, stringPtr);
     ExpressionTokenType* token = ExpressionTokenCreate(value, valueType);
-    ExpressionTokenType* right = ExpressionReadEquationFormat(stringPtr, &stringPtr, varsArr);
+    *tokenPtr = token;
 
-    ExpressionTokenSetEdges(token, left, right);
+    ExpressionTokenSetEdges(token, left, nullptr);
+
+    err = ExpressionReadEquationFormat(stringPtr, &stringPtr, varsArr, &token->right);
+
+    if (err != ExpressionErrors::NO_ERR)
+        return err;
 
     stringPtr = SkipSymbolsWhileChar(stringPtr, ')');
 
     *stringEndPtr = stringPtr;
-    return token;
+    return ExpressionErrors::NO_ERR;
 }
 
 //---------------------------------------------------------------------------------------
@@ -346,27 +842,36 @@ static const char* ExpressionReadTokenValue(ExpressionTokenValue* value,
     assert(string);
     assert(valueType);
 
+    const char* stringPtr = SkipSymbolsWhileStatement(string, isspace);
+
     double readenValue = NAN;
-    int shift = 0;
-    int scanResult = sscanf(string, "%lf%n\n", &readenValue, &shift);
+    const char* valueEnd = DoubleScan(stringPtr, &readenValue);
 
-    if (scanResult != 0)
+    if (valueEnd != stringPtr)
     {
         value->value = readenValue;
         *valueType   = ExpressionTokenValueTypeof::VALUE;
-        return string + shift;
+        return valueEnd;
     }
 
-    shift = 0;
-
     static const size_t      maxInputStringSize  = 128;
     static char  inputString[maxInputStringSize] =  "";
 
-    const char* stringPtr = string;
-    sscanf(string, "%s%n", inputString, &shift);
+    size_t inputStringSize = 0;
+    while (!ExpressionIsWordEnd(*stringPtr))
+    {
+        // too long word or empty word is not a token
+        if (inputStringSize + 1 >= maxInputStringSize)
+            return nullptr;
+
+        inputString[inputStringSize++] = *stringPtr;
+        stringPtr++;
+    }
+
+    if (inputStringSize == 0)
+        return nullptr;
 
-    stringPtr = string + shift;
-    assert(isspace(*stringPtr));
+    inputString[inputStringSize] = '\0';
 
     int operationId = ExpressionOperationGetId(inputString);
     if (operationId != -1)
@@ -378,7 +883,8 @@ static const char* ExpressionReadTokenValue(ExpressionTokenValue* value,
 
     ExpressionVariableType* varPtr = ExpressionVariableSet(varsArr, inputString);
 
-    assert(varPtr != nullptr);
+    if (varPtr == nullptr)
+        return nullptr;
 
     value->varPtr = varPtr;
     *valueType   = ExpressionTokenValueTypeof::VARIABLE;
@@ -386,25 +892,52 @@ static const char* ExpressionReadTokenValue(ExpressionTokenValue* value,
     return stringPtr;
 }
 
+// words of both formats are separated by spaces and braces
+static inline bool ExpressionIsWordEnd(const char symbol)
+{
+    return symbol == '\0' || symbol == '(' || symbol == ')' || isspace(symbol);
+}
+
+static inline bool ExpressionIsNil(const char* word)
+{
+    assert(word);
+
+    return strncmp(word, "nil", sizeof("nil") - 1) == 0 && 
+           ExpressionIsWordEnd(word[sizeof("nil") - 1]);
+}
+
+// values and variables are leaves, operations have as many sons as operands
+static inline int ExpressionTokenSonsCount(const ExpressionTokenType* token)
+{
+    assert(token);
+
+    if (token->valueType != ExpressionTokenValueTypeof::OPERATION)
+        return 0;
+
+    return ExpressionOperationIsUnary(token->value.operation) ? 1 : 2;
+}
+
 //---------------------------------------------------------------------------------------
 
 static void ExpressionTokenPrintValue(const ExpressionTokenType* token, 
-                                      FILE* outStream)
+                                      OutputBufferType* outBuffer)
 {
     assert(token->valueType != ExpressionTokenValueTypeof::OPERATION);
 
     switch (token->valueType)
     {
         case ExpressionTokenValueTypeof::VALUE:
-            PRINT(outStream, "%lg ", token->value.value);
+            OutputBufferPrintf(outBuffer, "%lg ", token->value.value);
             break;
         
         case ExpressionTokenValueTypeof::VARIABLE:
-            PRINT(outStream, "%s ", token->value.varPtr->variableName);
+            OutputBufferPutString(outBuffer, token->value.varPtr->variableName);
+            OutputBufferPutChar  (outBuffer, ' ');
             break;
         
         case ExpressionTokenValueTypeof::OPERATION:
-            PRINT(outStream, "%s ", ExpressionOperationGetLongName(token->value.operation));
+            OutputBufferPutString(outBuffer, ExpressionOperationGetLongName(token->value.operation));
+            OutputBufferPutChar  (outBuffer, ' ');
             break;
         
         default:
@@ -412,7 +945,14 @@ static void ExpressionTokenPrintValue(const ExpressionTokenType* token,
     }
 }
 
-#undef PRINT
+//---------------------------------------------------------------------------------------
+
+static void ExpressionTokenPrintOperation(const ExpressionOperationId operation,
+                                          OutputBufferType* outBuffer)
+{
+    OutputBufferPutString(outBuffer, ExpressionOperationGetShortName(operation));
+    OutputBufferPutChar  (outBuffer, ' ');
+}
 
 //---------------------------------------------------------------------------------------
 
@@ -4,15 +4,34 @@
 #include <stdio.h>
 
 #include "MathExpressionsMain.h"
+#include "Common/OutputBuffer.h"
 
 ExpressionErrors ExpressionPrintPrefixFormat  (const ExpressionType* expression, 
                                                         FILE* outStream = stdout);
 ExpressionErrors ExpressionPrintEquationFormat(const ExpressionType* expression, 
                                                         FILE* outStream = stdout);
 
+ExpressionErrors ExpressionPrintPrefixFormat  (const ExpressionType* expression,
+                                                        OutputBufferType* outBuffer);
+ExpressionErrors ExpressionPrintEquationFormat(const ExpressionType* expression,
+                                                        OutputBufferType* outBuffer);
+
 ExpressionErrors ExpressionReadPrefixFormat  (ExpressionType* expression, FILE* inStream = stdin);
 ExpressionErrors ExpressionReadEquationFormat(ExpressionType* expression, FILE* inStream = stdin);
 
+ExpressionErrors ExpressionReadPrefixFormat  (ExpressionType* expression, const char* string);
+
+// Called for every expression read from the stream, returns false to stop reading.
+// Expression is destructed after the call, to keep it callback moves it out:
+// *kept = *expression; ExpressionCtor(expression);
+typedef bool (ExpressionStreamCallbackType)(ExpressionType* expression, void* context);
+
+// Reads prefix format expressions one after another by chunks of constant size,
+// so streams bigger than memory and pipes can be processed
+ExpressionErrors ExpressionReadPrefixFormatStream(FILE* inStream, 
+                                                  ExpressionStreamCallbackType* callback,
+                                                  void* context);
+
 ExpressionErrors ExpressionReadVariables(ExpressionType* expression);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,448 @@
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+
+#include "MathExpressionInterval.h"
+#include "Common/DoubleFuncs.h"
+
+#include "DSL.h"
+
+// Bounds are moved outwards by a few ulps instead of switching fpu rounding mode:
+// one ulp covers a correctly rounded arithmetic operation, libm functions get more.
+static const int INTERVAL_ARITHMETIC_ULPS = 1;
+static const int INTERVAL_LIBM_ULPS       = 4;
+
+// pi of the periodic functions, Common's PI is too rough to find their extremums and poles
+static const double INTERVAL_PI = 3.14159265358979323846;
+
+static ExpressionIntervalType ExpressionIntervalCalculate(const ExpressionTokenType* token,
+                                                const ExpressionVariableType* variables,
+                                                const ExpressionIntervalType* variablesIntervals);
+
+static ExpressionIntervalType IntervalResult(double low, double high, const bool partial,
+                                                                       const int ulps);
+static ExpressionIntervalType IntervalEntire(const bool partial);
+
+static inline double IntervalMin(const double a, const double b);
+static inline double IntervalMax(const double a, const double b);
+static inline double IntervalMulBound(const double a, const double b);
+
+static bool IntervalContainsPeriodicPoint(const ExpressionIntervalType interval,
+                                          const double offset, const double period);
+static bool IntervalIsPointInteger(const ExpressionIntervalType interval);
+
+static ExpressionIntervalType ExpressionIntervalPowPositiveBase(const ExpressionIntervalType base,
+                                                                const ExpressionIntervalType power,
+                                                                const bool partial);
+static ExpressionIntervalType ExpressionIntervalPowInteger(const ExpressionIntervalType base,
+                                                           const double power);
+
+//---------------------------------------------------------------------------------------
+
+ExpressionIntervalType ExpressionIntervalCreate(const double low, const double high)
+{
+    return {low, high, false};
+}
+
+ExpressionIntervalType ExpressionIntervalEmpty()
+{
+    return {INFINITY, -INFINITY, false};
+}
+
+bool ExpressionIntervalIsEmpty(const ExpressionIntervalType interval)
+{
+    return !(interval.low <= interval.high);
+}
+
+//---------------------------------------------------------------------------------------
+
+ExpressionIntervalType ExpressionIntervalCalculate(const ExpressionType* expression,
+                                            const ExpressionIntervalType* variablesIntervals)
+{
+    assert(expression);
+    assert(expression->root);
+
+    return ExpressionIntervalCalculate(expression->root, expression->variables.data,
+                                                         variablesIntervals);
+}
+
+static ExpressionIntervalType ExpressionIntervalCalculate(const ExpressionTokenType* token,
+                                                const ExpressionVariableType* variables,
+                                                const ExpressionIntervalType* variablesIntervals)
+{
+    assert(token);
+
+    if (IS_VAL(token))
+        return ExpressionIntervalCreate(VAL(token), VAL(token));
+
+    if (IS_VAR(token))
+    {
+        assert(variablesIntervals);
+
+        return variablesIntervals[VAR(token) - variables];
+    }
+
+    assert(L(token));
+
+    ExpressionIntervalType firstVal  = ExpressionIntervalCalculate(L(token), variables,
+                                                                   variablesIntervals);
+    ExpressionIntervalType secondVal = ExpressionIntervalEmpty();
+
+    if (!ExpressionOperationIsUnary(OP(token)))
+    {
+        assert(R(token));
+
+        secondVal = ExpressionIntervalCalculate(R(token), variables, variablesIntervals);
+    }
+
+    return ExpressionIntervalOperationCalculate(OP(token), firstVal, secondVal);
+}
+
+ExpressionIntervalType ExpressionIntervalOperationCalculate(const ExpressionOperationId operation,
+                                                            const ExpressionIntervalType val1,
+                                                            const ExpressionIntervalType val2)
+{
+    #define GENERATE_OPERATION_CMD(NAME, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12,  \
+                                   INTERVAL_CODE, ...)                                      \
+        case ExpressionOperationId::NAME:                                                   \
+        {                                                                                   \
+            INTERVAL_CODE;                                                                  \
+            break;                                                                          \
+        }
+
+    switch (operation)
+    {
+        #include "Operations.h"
+
+        default:
+            break;
+    }
+
+    #undef GENERATE_OPERATION_CMD
+
+    return IntervalEntire(true);
+}
+
+//-------------Arithmetic----------
+
+ExpressionIntervalType ExpressionIntervalAdd(const ExpressionIntervalType val1,
+                                             const ExpressionIntervalType val2)
+{
+    if (ExpressionIntervalIsEmpty(val1) || ExpressionIntervalIsEmpty(val2))
+        return ExpressionIntervalEmpty();
+
+    return IntervalResult(val1.low + val2.low, val1.high + val2.high,
+                          val1.partial || val2.partial, INTERVAL_ARITHMETIC_ULPS);
+}
+
+ExpressionIntervalType ExpressionIntervalSub(const ExpressionIntervalType val1,
+                                             const ExpressionIntervalType val2)
+{
+    return ExpressionIntervalAdd(val1, ExpressionIntervalNeg(val2));
+}
+
+ExpressionIntervalType ExpressionIntervalNeg(const ExpressionIntervalType val1)
+{
+    if (ExpressionIntervalIsEmpty(val1))
+        return ExpressionIntervalEmpty();
+
+    return {-val1.high, -val1.low, val1.partial};
+}
+
+ExpressionIntervalType ExpressionIntervalMul(const ExpressionIntervalType val1,
+                                             const ExpressionIntervalType val2)
+{
+    if (ExpressionIntervalIsEmpty(val1) || ExpressionIntervalIsEmpty(val2))
+        return ExpressionIntervalEmpty();
+
+    double ll = IntervalMulBound(val1.low,  val2.low);
+    double lh = IntervalMulBound(val1.low,  val2.high);
+    double hl = IntervalMulBound(val1.high, val2.low);
+    double hh = IntervalMulBound(val1.high, val2.high);
+
+    return IntervalResult(IntervalMin(IntervalMin(ll, lh), IntervalMin(hl, hh)),
+                          IntervalMax(IntervalMax(ll, lh), IntervalMax(hl, hh)),
+                          val1.partial || val2.partial, INTERVAL_ARITHMETIC_ULPS);
+}
+
+ExpressionIntervalType ExpressionIntervalDiv(const ExpressionIntervalType val1,
+                                             const ExpressionIntervalType val2)
+{
+    if (ExpressionIntervalIsEmpty(val1) || ExpressionIntervalIsEmpty(val2))
+        return ExpressionIntervalEmpty();
+
+    if (val2.low >= 0 && val2.high <= 0)
+        return ExpressionIntervalEmpty();
+
+    //pole inside the divisor
+    if (val2.low <= 0 && val2.high >= 0)
+        return IntervalEntire(true);
+
+    double ll = val1.low  / val2.low;
+    double lh = val1.low  / val2.high;
+    double hl = val1.high / val2.low;
+    double hh = val1.high / val2.high;
+
+    return IntervalResult(IntervalMin(IntervalMin(ll, lh), IntervalMin(hl, hh)),
+                          IntervalMax(IntervalMax(ll, lh), IntervalMax(hl, hh)),
+                          val1.partial || val2.partial, INTERVAL_ARITHMETIC_ULPS);
+}
+
+//-------------Pow----------
+
+ExpressionIntervalType ExpressionIntervalPow(const ExpressionIntervalType val1,
+                                             const ExpressionIntervalType val2)
+{
+    if (ExpressionIntervalIsEmpty(val1) || ExpressionIntervalIsEmpty(val2))
+        return ExpressionIntervalEmpty();
+
+    bool partial = val1.partial || val2.partial;
+
+    if (val1.low > 0)
+        return ExpressionIntervalPowPositiveBase(val1, val2, partial);
+
+    if (IntervalIsPointInteger(val2))
+    {
+        ExpressionIntervalType result = ExpressionIntervalPowInteger(val1, val2.low);
+        result.partial = result.partial || partial;
+
+        return result;
+    }
+
+    //negative base is defined only for integer powers
+    if (val1.high <= 0 || floor(val2.high) >= val2.low)
+        return IntervalEntire(true);
+
+    return ExpressionIntervalPowPositiveBase(ExpressionIntervalCreate(0, val1.high), val2, true);
+}
+
+static ExpressionIntervalType ExpressionIntervalPowPositiveBase(const ExpressionIntervalType base,
+                                                                const ExpressionIntervalType power,
+                                                                const bool partial)
+{
+    //pow(x, y) = exp(y * ln(x)) is monotone in both arguments on every quadrant,
+    //so its extremums are in the corners
+    double ll = pow(base.low,  power.low);
+    double lh = pow(base.low,  power.high);
+    double hl = pow(base.high, power.low);
+    double hh = pow(base.high, power.high);
+
+    return IntervalResult(IntervalMin(IntervalMin(ll, lh), IntervalMin(hl, hh)),
+                          IntervalMax(IntervalMax(ll, lh), IntervalMax(hl, hh)),
+                          partial || (power.low < 0 && base.low <= 0), INTERVAL_LIBM_ULPS);
+}
+
+static ExpressionIntervalType ExpressionIntervalPowInteger(const ExpressionIntervalType base,
+                                                           const double power)
+{
+    bool containsZero = base.low <= 0 && base.high >= 0;
+
+    if (power < 0 && containsZero)
+        return IntervalEntire(true);
+
+    double low  = pow(base.low,  power);
+    double high = pow(base.high, power);
+
+    bool isEven = fabs(fmod(power, 2)) < 1;
+
+    if (isEven && containsZero)
+        return IntervalResult(0, IntervalMax(low, high), false, INTERVAL_LIBM_ULPS);
+
+    return IntervalResult(IntervalMin(low, high), IntervalMax(low, high),
+                          false, INTERVAL_LIBM_ULPS);
+}
+
+//-------------Ln----------
+
+ExpressionIntervalType ExpressionIntervalLn(const ExpressionIntervalType val1)
+{
+    if (ExpressionIntervalIsEmpty(val1) || val1.high <= 0)
+        return ExpressionIntervalEmpty();
+
+    if (val1.low <= 0)
+        return IntervalResult(-INFINITY, log(val1.high), true, INTERVAL_LIBM_ULPS);
+
+    return IntervalResult(log(val1.low), log(val1.high), val1.partial, INTERVAL_LIBM_ULPS);
+}
+
+//-------------Trigonometry----------
+
+ExpressionIntervalType ExpressionIntervalSin(const ExpressionIntervalType val1)
+{
+    if (ExpressionIntervalIsEmpty(val1))
+        return ExpressionIntervalEmpty();
+
+    if (!(val1.high - val1.low < 2 * INTERVAL_PI))
+        return {-1, 1, val1.partial};
+
+    double sinLow  = sin(val1.low);
+    double sinHigh = sin(val1.high);
+
+    double low  = IntervalContainsPeriodicPoint(val1, -INTERVAL_PI / 2, 2 * INTERVAL_PI) ? -1 :
+                                                IntervalMin(sinLow, sinHigh);
+    double high = IntervalContainsPeriodicPoint(val1,  INTERVAL_PI / 2, 2 * INTERVAL_PI) ?  1 :
+                                                IntervalMax(sinLow, sinHigh);
+
+    ExpressionIntervalType result = IntervalResult(low, high, val1.partial, INTERVAL_LIBM_ULPS);
+
+    result.low  = IntervalMax(result.low,  -1);
+    result.high = IntervalMin(result.high,  1);
+
+    return result;
+}
+
+ExpressionIntervalType ExpressionIntervalCos(const ExpressionIntervalType val1)
+{
+    if (ExpressionIntervalIsEmpty(val1))
+        return ExpressionIntervalEmpty();
+
+    if (!(val1.high - val1.low < 2 * INTERVAL_PI))
+        return {-1, 1, val1.partial};
+
+    double cosLow  = cos(val1.low);
+    double cosHigh = cos(val1.high);
+
+    double low  = IntervalContainsPeriodicPoint(val1, INTERVAL_PI, 2 * INTERVAL_PI) ? -1 :
+                                                IntervalMin(cosLow, cosHigh);
+    double high = IntervalContainsPeriodicPoint(val1, 0,           2 * INTERVAL_PI) ?  1 :
+                                                IntervalMax(cosLow, cosHigh);
+
+    ExpressionIntervalType result = IntervalResult(low, high, val1.partial, INTERVAL_LIBM_ULPS);
+
+    result.low  = IntervalMax(result.low,  -1);
+    result.high = IntervalMin(result.high,  1);
+
+    return result;
+}
+
+ExpressionIntervalType ExpressionIntervalTan(const ExpressionIntervalType val1)
+{
+    if (ExpressionIntervalIsEmpty(val1))
+        return ExpressionIntervalEmpty();
+
+    if (!(val1.high - val1.low < INTERVAL_PI) ||
+        IntervalContainsPeriodicPoint(val1, INTERVAL_PI / 2, INTERVAL_PI))
+        return IntervalEntire(true);
+
+    return IntervalResult(tan(val1.low), tan(val1.high), val1.partial, INTERVAL_LIBM_ULPS);
+}
+
+ExpressionIntervalType ExpressionIntervalCot(const ExpressionIntervalType val1)
+{
+    if (ExpressionIntervalIsEmpty(val1))
+        return ExpressionIntervalEmpty();
+
+    if (!(val1.high - val1.low < INTERVAL_PI) ||
+        IntervalContainsPeriodicPoint(val1, 0, INTERVAL_PI))
+        return IntervalEntire(true);
+
+    return IntervalResult(1 / tan(val1.high), 1 / tan(val1.low), val1.partial,
+                                                                 INTERVAL_LIBM_ULPS);
+}
+
+//-------------Inverse trigonometry----------
+
+ExpressionIntervalType ExpressionIntervalArcsin(const ExpressionIntervalType val1)
+{
+    if (ExpressionIntervalIsEmpty(val1) || val1.high < -1 || val1.low > 1)
+        return ExpressionIntervalEmpty();
+
+    bool partial = val1.partial || val1.low < -1 || val1.high > 1;
+
+    return IntervalResult(asin(IntervalMax(val1.low,  -1)),
+                          asin(IntervalMin(val1.high,  1)), partial, INTERVAL_LIBM_ULPS);
+}
+
+ExpressionIntervalType ExpressionIntervalArccos(const ExpressionIntervalType val1)
+{
+    if (ExpressionIntervalIsEmpty(val1) || val1.high < -1 || val1.low > 1)
+        return ExpressionIntervalEmpty();
+
+    bool partial = val1.partial || val1.low < -1 || val1.high > 1;
+
+    return IntervalResult(acos(IntervalMin(val1.high,  1)),
+                          acos(IntervalMax(val1.low,  -1)), partial, INTERVAL_LIBM_ULPS);
+}
+
+ExpressionIntervalType ExpressionIntervalArctan(const ExpressionIntervalType val1)
+{
+    if (ExpressionIntervalIsEmpty(val1))
+        return ExpressionIntervalEmpty();
+
+    return IntervalResult(atan(val1.low), atan(val1.high), val1.partial, INTERVAL_LIBM_ULPS);
+}
+
+ExpressionIntervalType ExpressionIntervalArccot(const ExpressionIntervalType val1)
+{
+    if (ExpressionIntervalIsEmpty(val1))
+        return ExpressionIntervalEmpty();
+
+    //same PI as the calculation code in Operations.h
+    return IntervalResult(PI / 2 - atan(val1.high), PI / 2 - atan(val1.low), val1.partial,
+                                                                         INTERVAL_LIBM_ULPS);
+}
+
+//---------------------------------------------------------------------------------------
+
+static ExpressionIntervalType IntervalResult(double low, double high, const bool partial,
+                                                                       const int ulps)
+{
+    //inf - inf and similar cases
+    if (isnan(low) || isnan(high))
+        return IntervalEntire(true);
+
+    for (int i = 0; i < ulps; ++i)
+    {
+        if (isfinite(low))
+            low  = nextafter(low,  -INFINITY);
+        if (isfinite(high))
+            high = nextafter(high,  INFINITY);
+    }
+
+    return {low, high, partial};
+}
+
+static ExpressionIntervalType IntervalEntire(const bool partial)
+{
+    return {-INFINITY, INFINITY, partial};
+}
+
+static inline double IntervalMin(const double a, const double b)
+{
+    return a < b ? a : b;
+}
+
+static inline double IntervalMax(const double a, const double b)
+{
+    return a > b ? a : b;
+}
+
+static inline double IntervalMulBound(const double a, const double b)
+{
+    double product = a * b;
+
+    //0 * inf is 0 for bounds of closed intervals
+    return isnan(product) ? 0 : product;
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool IntervalContainsPeriodicPoint(const ExpressionIntervalType interval,
+                                          const double offset, const double period)
+{
+    //points offset + k * period are calculated with an error, so borders are widened by it
+    double tolerance = 16 * DBL_EPSILON * (fabs(interval.low) + fabs(interval.high) + 1);
+
+    double k     = floor((interval.high + tolerance - offset) / period);
+    double point = offset + k * period;
+
+    return point >= interval.low - tolerance;
+}
+
+static bool IntervalIsPointInteger(const ExpressionIntervalType interval)
+{
+    static const double maxExactInteger = 9007199254740992.0; // 2^53
+
+    return interval.low >= interval.high && fabs(interval.low) < maxExactInteger &&
+           floor(interval.low) >= interval.low;
+}
@@ -0,0 +1,53 @@
+#ifndef MATH_EXPRESSION_INTERVAL_H
+#define MATH_EXPRESSION_INTERVAL_H
+
+#include "MathExpressionsMain.h"
+
+// Closed interval [low, high] enclosing all values of an expression over a box of variables.
+// low > high - empty interval: expression is undefined in every point of the box.
+struct ExpressionIntervalType
+{
+    double low;
+    double high;
+
+    bool   partial;     // expression may be undefined in some points of the box
+};
+
+// variablesIntervals[i] is the interval of expression->variables.data[i]
+ExpressionIntervalType ExpressionIntervalCalculate(const ExpressionType* expression,
+                                            const ExpressionIntervalType* variablesIntervals);
+
+ExpressionIntervalType ExpressionIntervalOperationCalculate(const ExpressionOperationId operation,
+                                                            const ExpressionIntervalType val1,
+                                                            const ExpressionIntervalType val2);
+
+ExpressionIntervalType ExpressionIntervalCreate(const double low, const double high);
+ExpressionIntervalType ExpressionIntervalEmpty ();
+bool                   ExpressionIntervalIsEmpty(const ExpressionIntervalType interval);
+
+//-------------Operations.h interval code----------
+
+ExpressionIntervalType ExpressionIntervalAdd(const ExpressionIntervalType val1,
+                                             const ExpressionIntervalType val2);
+ExpressionIntervalType ExpressionIntervalSub(const ExpressionIntervalType val1,
+                                             const ExpressionIntervalType val2);
+ExpressionIntervalType ExpressionIntervalNeg(const ExpressionIntervalType val1);
+ExpressionIntervalType ExpressionIntervalMul(const ExpressionIntervalType val1,
+                                             const ExpressionIntervalType val2);
+ExpressionIntervalType ExpressionIntervalDiv(const ExpressionIntervalType val1,
+                                             const ExpressionIntervalType val2);
+ExpressionIntervalType ExpressionIntervalPow(const ExpressionIntervalType val1,
+                                             const ExpressionIntervalType val2);
+ExpressionIntervalType ExpressionIntervalLn (const ExpressionIntervalType val1);
+
+ExpressionIntervalType ExpressionIntervalSin(const ExpressionIntervalType val1);
+ExpressionIntervalType ExpressionIntervalCos(const ExpressionIntervalType val1);
+ExpressionIntervalType ExpressionIntervalTan(const ExpressionIntervalType val1);
+ExpressionIntervalType ExpressionIntervalCot(const ExpressionIntervalType val1);
+
+ExpressionIntervalType ExpressionIntervalArcsin(const ExpressionIntervalType val1);
+ExpressionIntervalType ExpressionIntervalArccos(const ExpressionIntervalType val1);
+ExpressionIntervalType ExpressionIntervalArctan(const ExpressionIntervalType val1);
+ExpressionIntervalType ExpressionIntervalArccot(const ExpressionIntervalType val1);
+
+#endif
@@ -0,0 +1,895 @@
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "MathExpressionPolynomial.h"
+#include "Common/DoubleFuncs.h"
+#include "Vector/HashFuncs.h"
+#include "MathExpressionTokensStack.h"
+
+#include "DSL.h"
+
+static const size_t   POLYNOMIAL_MAX_TERMS = 4096;
+static const unsigned POLYNOMIAL_MAX_POWER = 64;
+
+// normalized subtrees keep polynomials, so fewer of them fit the inline storage
+static const size_t   NORMALIZE_STACK_INLINE_CAPACITY = 32;
+
+struct PolynomialTermRefType
+{
+    double          coefficient;
+    const unsigned* exponents;
+    size_t          varsCount;
+    unsigned        degree;
+};
+
+static size_t* ExpressionPolynomialTableFind(const ExpressionPolynomialType* poly,
+                                             const unsigned* exponents);
+static ExpressionErrors ExpressionPolynomialTableRehash(ExpressionPolynomialType* poly,
+                                                        const size_t newCapacity);
+
+static bool ExpressionPolynomialCombine(ExpressionPolynomialType* poly,
+                                        const ExpressionOperationId operation,
+                                        const ExpressionPolynomialType* left,
+                                        const ExpressionPolynomialType* right);
+static bool ExpressionPolynomialGetConstant(const ExpressionPolynomialType* poly,
+                                            double* value);
+static bool ExpressionPolynomialDivExactly(ExpressionPolynomialType* poly,
+                                           const ExpressionPolynomialType* left,
+                                           const double divisor);
+static void ExpressionPolynomialDropZeroTerms(ExpressionPolynomialType* poly);
+
+static ExpressionErrors ExpressionPolynomialNormalizeToken(ExpressionTokenType** tokenPtr,
+                                                           ExpressionVariablesArrayType* varsArr,
+                                                           ExpressionPolynomialType* poly,
+                                                           bool* isPolynomial,
+                                                           bool* changed);
+static void ExpressionPolynomialReplaceIfShorter(ExpressionTokenType** tokenPtr,
+                                                 const ExpressionPolynomialType* poly,
+                                                 ExpressionVariablesArrayType* varsArr,
+                                                 bool* changed);
+
+static ExpressionTokenType* ExpressionPolynomialMonomialToToken(
+                                                const PolynomialTermRefType* term,
+                                                ExpressionVariablesArrayType* varsArr);
+static int    PolynomialTermsCmp(const void* first, const void* second);
+static size_t ExpressionTokenCountNodes(const ExpressionTokenType* token);
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionPolynomialCtor(ExpressionPolynomialType* poly, const size_t varsCount)
+{
+    assert(poly);
+    assert(varsCount > 0);
+
+    static const size_t startCapacity = 8;
+
+    poly->varsCount = varsCount;
+
+    poly->coefficients = (double*)   calloc(startCapacity, sizeof(*poly->coefficients));
+    poly->exponents    = (unsigned*) calloc(startCapacity * varsCount,
+                                                                sizeof(*poly->exponents));
+    poly->size     = 0;
+    poly->capacity = startCapacity;
+
+    poly->table         = (size_t*) calloc(2 * startCapacity, sizeof(*poly->table));
+    poly->tableCapacity = 2 * startCapacity;
+
+    if (poly->coefficients == nullptr || poly->exponents == nullptr || poly->table == nullptr)
+    {
+        ExpressionPolynomialDtor(poly);
+        return ExpressionErrors::MEM_ERR;
+    }
+
+    return ExpressionErrors::NO_ERR;
+}
+
+void ExpressionPolynomialDtor(ExpressionPolynomialType* poly)
+{
+    assert(poly);
+
+    free(poly->coefficients);
+    free(poly->exponents);
+    free(poly->table);
+
+    poly->coefficients  = nullptr;
+    poly->exponents     = nullptr;
+    poly->table         = nullptr;
+    poly->size          = 0;
+    poly->capacity      = 0;
+    poly->tableCapacity = 0;
+}
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionPolynomialAddTerm(ExpressionPolynomialType* poly,
+                                             const double coefficient,
+                                             const unsigned* exponents)
+{
+    assert(poly);
+    assert(poly->coefficients);
+
+    if (exponents == nullptr)
+    {
+        unsigned* zeroExponents = (unsigned*) calloc(poly->varsCount, sizeof(*zeroExponents));
+        if (zeroExponents == nullptr)
+            return ExpressionErrors::MEM_ERR;
+
+        ExpressionErrors err = ExpressionPolynomialAddTerm(poly, coefficient, zeroExponents);
+        free(zeroExponents);
+
+        return err;
+    }
+
+    size_t* slot = ExpressionPolynomialTableFind(poly, exponents);
+
+    if (*slot != 0)
+    {
+        poly->coefficients[*slot - 1] += coefficient;
+        return ExpressionErrors::NO_ERR;
+    }
+
+    if (DoubleEqual(coefficient, 0))
+        return ExpressionErrors::NO_ERR;
+
+    if (poly->size == poly->capacity)
+    {
+        size_t newCapacity = 2 * poly->capacity;
+
+        double* newCoefficients = (double*) realloc(poly->coefficients,
+                                                    newCapacity * sizeof(*newCoefficients));
+        if (newCoefficients == nullptr)
+            return ExpressionErrors::MEM_ERR;
+        poly->coefficients = newCoefficients;
+
+        unsigned* newExponents = (unsigned*) realloc(poly->exponents,
+                                    newCapacity * poly->varsCount * sizeof(*newExponents));
+        if (newExponents == nullptr)
+            return ExpressionErrors::MEM_ERR;
+        poly->exponents = newExponents;
+
+        poly->capacity = newCapacity;
+    }
+
+    size_t termId = poly->size++;
+    poly->coefficients[termId] = coefficient;
+    memcpy(poly->exponents + termId * poly->varsCount, exponents,
+                                            poly->varsCount * sizeof(*exponents));
+
+    if (2 * poly->size > poly->tableCapacity)
+        return ExpressionPolynomialTableRehash(poly, 2 * poly->tableCapacity);
+
+    *slot = termId + 1;
+
+    return ExpressionErrors::NO_ERR;
+}
+
+static size_t* ExpressionPolynomialTableFind(const ExpressionPolynomialType* poly,
+                                             const unsigned* exponents)
+{
+    assert(poly);
+    assert(exponents);
+
+    size_t length = poly->varsCount * sizeof(*exponents);
+    size_t mask   = poly->tableCapacity - 1;
+    size_t pos    = MurmurHash(exponents, length) & mask;
+
+    while (poly->table[pos] != 0)
+    {
+        const unsigned* termExponents = poly->exponents + (poly->table[pos] - 1) *
+                                                                        poly->varsCount;
+        if (memcmp(termExponents, exponents, length) == 0)
+            break;
+
+        pos = (pos + 1) & mask;
+    }
+
+    return &poly->table[pos];
+}
+
+static ExpressionErrors ExpressionPolynomialTableRehash(ExpressionPolynomialType* poly,
+                                                        const size_t newCapacity)
+{
+    assert(poly);
+
+    size_t* newTable = (size_t*) calloc(newCapacity, sizeof(*newTable));
+    if (newTable == nullptr)
+        return ExpressionErrors::MEM_ERR;
+
+    free(poly->table);
+    poly->table         = newTable;
+    poly->tableCapacity = newCapacity;
+
+    for (size_t termId = 0; termId < poly->size; ++termId)
+        *ExpressionPolynomialTableFind(poly, poly->exponents + termId * poly->varsCount) =
+                                                                                termId + 1;
+
+    return ExpressionErrors::NO_ERR;
+}
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionPolynomialAdd(ExpressionPolynomialType* target,
+                                         const ExpressionPolynomialType* poly,
+                                         const double scale)
+{
+    assert(target);
+    assert(poly);
+    assert(target->varsCount == poly->varsCount);
+
+    for (size_t termId = 0; termId < poly->size; ++termId)
+    {
+        ExpressionErrors err = ExpressionPolynomialAddTerm(target,
+                                            scale * poly->coefficients[termId],
+                                            poly->exponents + termId * poly->varsCount);
+        if (err != ExpressionErrors::NO_ERR)
+            return err;
+    }
+
+    return ExpressionErrors::NO_ERR;
+}
+
+ExpressionErrors ExpressionPolynomialMul(ExpressionPolynomialType* result,
+                                         const ExpressionPolynomialType* first,
+                                         const ExpressionPolynomialType* second)
+{
+    assert(result);
+    assert(first);
+    assert(second);
+    assert(result->size == 0);
+    assert(result->varsCount == first->varsCount && first->varsCount == second->varsCount);
+
+    size_t varsCount = first->varsCount;
+
+    unsigned* exponents = (unsigned*) calloc(varsCount, sizeof(*exponents));
+    if (exponents == nullptr)
+        return ExpressionErrors::MEM_ERR;
+
+    ExpressionErrors err = ExpressionErrors::NO_ERR;
+
+    for (size_t i = 0; i < first->size && err == ExpressionErrors::NO_ERR; ++i)
+    {
+        if (DoubleEqual(first->coefficients[i], 0))
+            continue;
+
+        for (size_t j = 0; j < second->size && err == ExpressionErrors::NO_ERR; ++j)
+        {
+            if (DoubleEqual(second->coefficients[j], 0))
+                continue;
+
+            for (size_t v = 0; v < varsCount; ++v)
+                exponents[v] = first->exponents[i * varsCount + v] +
+                              second->exponents[j * varsCount + v];
+
+            err = ExpressionPolynomialAddTerm(result,
+                                        first->coefficients[i] * second->coefficients[j],
+                                        exponents);
+        }
+    }
+
+    free(exponents);
+
+    return err;
+}
+
+ExpressionErrors ExpressionPolynomialPow(ExpressionPolynomialType* result,
+                                         const ExpressionPolynomialType* poly,
+                                         unsigned power)
+{
+    assert(result);
+    assert(poly);
+    assert(result->size == 0);
+
+    ExpressionErrors err = ExpressionPolynomialAddTerm(result, 1, nullptr);
+    if (err != ExpressionErrors::NO_ERR)
+        return err;
+
+    if (power == 0)
+        return err;
+
+    ExpressionPolynomialType base = {};
+    err = ExpressionPolynomialCtor(&base, poly->varsCount);
+    if (err == ExpressionErrors::NO_ERR)
+        err = ExpressionPolynomialAdd(&base, poly);
+
+    while (power > 0 && err == ExpressionErrors::NO_ERR)
+    {
+        ExpressionPolynomialType tmp = {};
+
+        if (power & 1)
+        {
+            err = ExpressionPolynomialCtor(&tmp, poly->varsCount);
+            if (err == ExpressionErrors::NO_ERR)
+                err = ExpressionPolynomialMul(&tmp, result, &base);
+
+            ExpressionPolynomialDtor(result);
+            *result = tmp;
+            tmp     = {};
+
+            if (err != ExpressionErrors::NO_ERR)
+                break;
+        }
+
+        power >>= 1;
+        if (power == 0)
+            break;
+
+        err = ExpressionPolynomialCtor(&tmp, poly->varsCount);
+        if (err == ExpressionErrors::NO_ERR)
+            err = ExpressionPolynomialMul(&tmp, &base, &base);
+
+        ExpressionPolynomialDtor(&base);
+        base = tmp;
+    }
+
+    ExpressionPolynomialDtor(&base);
+
+    return err;
+}
+
+//---------------------------------------------------------------------------------------
+
+bool ExpressionPolynomialFromToken(ExpressionPolynomialType* poly,
+                                   const ExpressionTokenType* token,
+                                   const ExpressionVariablesArrayType* varsArr)
+{
+    assert(poly);
+    assert(token);
+    assert(varsArr);
+
+    switch (token->valueType)
+    {
+        case ExpressionTokenValueTypeof::VALUE:
+            return ExpressionPolynomialAddTerm(poly, VAL(token), nullptr) ==
+                                                                ExpressionErrors::NO_ERR;
+
+        case ExpressionTokenValueTypeof::VARIABLE:
+        {
+            size_t varId = (size_t)(VAR(token) - varsArr->data);
+            if (varId >= poly->varsCount)
+                return false;
+
+            unsigned* exponents = (unsigned*) calloc(poly->varsCount, sizeof(*exponents));
+            if (exponents == nullptr)
+                return false;
+
+            exponents[varId] = 1;
+            ExpressionErrors err = ExpressionPolynomialAddTerm(poly, 1, exponents);
+            free(exponents);
+
+            return err == ExpressionErrors::NO_ERR;
+        }
+
+        case ExpressionTokenValueTypeof::OPERATION:
+            break;
+
+        default:
+            return false;
+    }
+
+    ExpressionPolynomialType left  = {};
+    ExpressionPolynomialType right = {};
+
+    bool isPolynomial =
+        ExpressionPolynomialCtor(&left,  poly->varsCount) == ExpressionErrors::NO_ERR &&
+        ExpressionPolynomialCtor(&right, poly->varsCount) == ExpressionErrors::NO_ERR &&
+        ExpressionPolynomialFromToken(&left, L(token), varsArr) &&
+        (R(token) == nullptr || ExpressionPolynomialFromToken(&right, R(token), varsArr)) &&
+        ExpressionPolynomialCombine(poly, OP(token), &left, R(token) ? &right : nullptr);
+
+    ExpressionPolynomialDtor(&left);
+    ExpressionPolynomialDtor(&right);
+
+    return isPolynomial;
+}
+
+static bool ExpressionPolynomialCombine(ExpressionPolynomialType* poly,
+                                        const ExpressionOperationId operation,
+                                        const ExpressionPolynomialType* left,
+                                        const ExpressionPolynomialType* right)
+{
+    assert(poly);
+    assert(left);
+
+    ExpressionErrors err = ExpressionErrors::NO_ERR;
+    double rightValue = NAN;
+
+    switch (operation)
+    {
+        case ExpressionOperationId::ADD:
+        case ExpressionOperationId::SUB:
+            assert(right);
+
+            err = ExpressionPolynomialAdd(poly, left);
+            if (err == ExpressionErrors::NO_ERR)
+                err = ExpressionPolynomialAdd(poly, right,
+                                        operation == ExpressionOperationId::ADD ? 1 : -1);
+            break;
+
+        case ExpressionOperationId::UNARY_SUB:
+            err = ExpressionPolynomialAdd(poly, left, -1);
+            break;
+
+        case ExpressionOperationId::MUL:
+            assert(right);
+
+            err = ExpressionPolynomialMul(poly, left, right);
+            break;
+
+        case ExpressionOperationId::DIV:
+            assert(right);
+
+            if (!ExpressionPolynomialGetConstant(right, &rightValue) ||
+                DoubleEqual(rightValue, 0))
+                return false;
+
+            // x / 3 is not turned into 0.333333 * x, inexact divisions are kept as they are
+            return ExpressionPolynomialDivExactly(poly, left, rightValue) &&
+                   poly->size <= POLYNOMIAL_MAX_TERMS;
+
+        case ExpressionOperationId::POW:
+            assert(right);
+
+            if (!ExpressionPolynomialGetConstant(right, &rightValue) || rightValue < 0 ||
+                rightValue > POLYNOMIAL_MAX_POWER ||
+                !DoubleEqual(rightValue, round(rightValue)))
+                return false;
+
+            err = ExpressionPolynomialPow(poly, left, (unsigned)round(rightValue));
+            break;
+
+        // subtrees with these operations are kept as they are
+        case ExpressionOperationId::LOG:
+        case ExpressionOperationId::LN:
+        case ExpressionOperationId::SIN:
+        case ExpressionOperationId::COS:
+        case ExpressionOperationId::TAN:
+        case ExpressionOperationId::COT:
+        case ExpressionOperationId::ARCSIN:
+        case ExpressionOperationId::ARCCOS:
+        case ExpressionOperationId::ARCTAN:
+        case ExpressionOperationId::ARCCOT:
+            return false;
+
+        default:
+            return false;
+    }
+
+    if (err != ExpressionErrors::NO_ERR)
+        return false;
+
+    ExpressionPolynomialDropZeroTerms(poly);
+
+    return poly->size <= POLYNOMIAL_MAX_TERMS;
+}
+
+// succeeds only if every coefficient of left is divided by divisor into an integer
+static bool ExpressionPolynomialDivExactly(ExpressionPolynomialType* poly,
+                                           const ExpressionPolynomialType* left,
+                                           const double divisor)
+{
+    assert(poly);
+    assert(left);
+    assert(poly->size == 0);
+
+    for (size_t termId = 0; termId < left->size; ++termId)
+    {
+        double quotient = left->coefficients[termId] / divisor;
+
+        if (!isfinite(quotient) || !DoubleEqual(quotient, round(quotient)))
+            return false;
+
+        if (ExpressionPolynomialAddTerm(poly, round(quotient),
+                                        left->exponents + termId * left->varsCount) !=
+                                                                ExpressionErrors::NO_ERR)
+            return false;
+    }
+
+    return true;
+}
+
+// like terms that cancelled out are removed, so they don't count towards the terms limit
+static void ExpressionPolynomialDropZeroTerms(ExpressionPolynomialType* poly)
+{
+    assert(poly);
+
+    size_t newSize = 0;
+    for (size_t termId = 0; termId < poly->size; ++termId)
+    {
+        if (DoubleEqual(poly->coefficients[termId], 0))
+            continue;
+
+        if (newSize != termId)
+        {
+            poly->coefficients[newSize] = poly->coefficients[termId];
+            memmove(poly->exponents + newSize * poly->varsCount,
+                    poly->exponents + termId  * poly->varsCount,
+                    poly->varsCount * sizeof(*poly->exponents));
+        }
+
+        newSize++;
+    }
+
+    if (newSize == poly->size)
+        return;
+
+    poly->size = newSize;
+
+    memset(poly->table, 0, poly->tableCapacity * sizeof(*poly->table));
+    for (size_t termId = 0; termId < poly->size; ++termId)
+        *ExpressionPolynomialTableFind(poly, poly->exponents + termId * poly->varsCount) =
+                                                                                termId + 1;
+}
+
+static bool ExpressionPolynomialGetConstant(const ExpressionPolynomialType* poly,
+                                            double* value)
+{
+    assert(poly);
+    assert(value);
+
+    *value = 0;
+
+    for (size_t termId = 0; termId < poly->size; ++termId)
+    {
+        if (DoubleEqual(poly->coefficients[termId], 0))
+            continue;
+
+        for (size_t v = 0; v < poly->varsCount; ++v)
+        {
+            if (poly->exponents[termId * poly->varsCount + v] != 0)
+                return false;
+        }
+
+        *value += poly->coefficients[termId];
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+
+ExpressionTokenType* ExpressionPolynomialToToken(const ExpressionPolynomialType* poly,
+                                                 ExpressionVariablesArrayType* varsArr)
+{
+    assert(poly);
+    assert(varsArr);
+
+    PolynomialTermRefType* terms = (PolynomialTermRefType*) calloc(poly->size + 1,
+                                                                   sizeof(*terms));
+    if (terms == nullptr)
+        return nullptr;
+
+    size_t termsCount = 0;
+    for (size_t termId = 0; termId < poly->size; ++termId)
+    {
+        if (!isfinite(poly->coefficients[termId]))
+        {
+            free(terms);
+            return nullptr;
+        }
+
+        if (DoubleEqual(poly->coefficients[termId], 0))
+            continue;
+
+        PolynomialTermRefType* term = &terms[termsCount++];
+
+        term->coefficient = poly->coefficients[termId];
+        term->exponents   = poly->exponents + termId * poly->varsCount;
+        term->varsCount   = poly->varsCount;
+        term->degree      = 0;
+
+        for (size_t v = 0; v < poly->varsCount; ++v)
+            term->degree += term->exponents[v];
+    }
+
+    qsort(terms, termsCount, sizeof(*terms), PolynomialTermsCmp);
+
+    ExpressionTokenType* root = nullptr;
+
+    for (size_t i = 0; i < termsCount; ++i)
+    {
+        double coefficient = terms[i].coefficient;
+
+        if (root != nullptr && coefficient < 0)
+            coefficient = -coefficient;
+
+        ExpressionTokenType* term = ExpressionPolynomialMonomialToToken(&terms[i], varsArr);
+
+        if (term == nullptr)
+            term = CRT_NUM(coefficient);
+        else if (!DoubleEqual(coefficient, 1))
+            term = _MUL(CRT_NUM(coefficient), term);
+
+        if (root == nullptr)
+            root = term;
+        else if (terms[i].coefficient < 0)
+            root = _SUB(root, term);
+        else
+            root = _ADD(root, term);
+    }
+
+    free(terms);
+
+    if (root == nullptr)
+        root = CRT_NUM(0);
+
+    return root;
+}
+
+static ExpressionTokenType* ExpressionPolynomialMonomialToToken(
+                                                const PolynomialTermRefType* term,
+                                                ExpressionVariablesArrayType* varsArr)
+{
+    assert(term);
+    assert(varsArr);
+
+    ExpressionTokenType* monomial = nullptr;
+
+    for (size_t v = 0; v < term->varsCount; ++v)
+    {
+        unsigned exponent = term->exponents[v];
+        if (exponent == 0)
+            continue;
+
+        ExpressionTokenType* factor = ExpressionTokenCreate(
+                                        ExpressionTokenValueСreate(&varsArr->data[v]),
+                                        VAR_TYPE_CNST);
+        if (exponent > 1)
+            factor = _POW(factor, CRT_NUM(exponent));
+
+        monomial = monomial == nullptr ? factor : _MUL(monomial, factor);
+    }
+
+    return monomial;
+}
+
+// higher degree first, then lexicographically by exponents
+static int PolynomialTermsCmp(const void* first, const void* second)
+{
+    const PolynomialTermRefType* firstTerm  = (const PolynomialTermRefType*) first;
+    const PolynomialTermRefType* secondTerm = (const PolynomialTermRefType*) second;
+
+    if (firstTerm->degree != secondTerm->degree)
+        return firstTerm->degree > secondTerm->degree ? -1 : 1;
+
+    for (size_t v = 0; v < firstTerm->varsCount; ++v)
+    {
+        if (firstTerm->exponents[v] != secondTerm->exponents[v])
+            return firstTerm->exponents[v] > secondTerm->exponents[v] ? -1 : 1;
+    }
+
+    return 0;
+}
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionPolynomialNormalize(ExpressionType* expression, bool* changed)
+{
+    assert(expression);
+    assert(changed);
+
+    *changed = false;
+
+    if (expression->root == nullptr || expression->variables.size == 0)
+        return ExpressionErrors::NO_ERR;
+
+    bool isPolynomial = false;
+
+    ExpressionPolynomialType poly = {};
+    ExpressionErrors err = ExpressionPolynomialNormalizeToken(&expression->root, 
+                                                              &expression->variables,
+                                                              &poly, &isPolynomial, changed);
+    if (isPolynomial)
+        ExpressionPolynomialReplaceIfShorter(&expression->root, &poly,
+                                             &expression->variables, changed);
+
+    ExpressionPolynomialDtor(&poly);
+
+    return err;
+}
+
+// isPolynomial is true if the whole subtree is a polynomial, then it is left in poly 
+// for the parent, otherwise maximal polynomial subtrees below are replaced by their normal form
+static ExpressionErrors ExpressionPolynomialNormalizeToken(ExpressionTokenType** tokenPtr,
+                                                           ExpressionVariablesArrayType* varsArr,
+                                                           ExpressionPolynomialType* poly,
+                                                           bool* isPolynomial,
+                                                           bool* changed)
+{
+    assert(tokenPtr);
+    assert(*tokenPtr);
+    assert(varsArr);
+    assert(poly);
+    assert(isPolynomial);
+    assert(changed);
+
+    // stage - how many sons of the token are already normalized
+    struct NormalizeFrameType
+    {
+        ExpressionTokenType** tokenPtr;
+        int stage;
+    };
+
+    // normalized subtree waits for its parent in the results stack
+    struct NormalizeResultType
+    {
+        ExpressionPolynomialType poly;
+
+        bool isPolynomial;
+        bool changed;
+    };
+
+    TokensStackType<NormalizeFrameType> stack;
+    VectorCtor(&stack);
+
+    TokensStackType<NormalizeResultType, NORMALIZE_STACK_INLINE_CAPACITY> results;
+    VectorCtor(&results);
+
+    *isPolynomial = false;
+
+    ExpressionErrors err = ExpressionErrors::NO_ERR;
+
+    if (VectorPush(&stack, NormalizeFrameType{tokenPtr, 0}) != VectorErrors::VECTOR_NO_ERR)
+        err = ExpressionErrors::MEM_ERR;
+
+    while (!VectorIsEmpty(&stack) && err == ExpressionErrors::NO_ERR)
+    {
+        NormalizeFrameType* frame  = TokensStackTop(&stack);
+        ExpressionTokenType* token = *frame->tokenPtr;
+
+        if (IS_OP(token) && frame->stage < 2)
+        {
+            ExpressionTokenType** sonPtr = frame->stage == 0 ? &token->left : &token->right;
+            frame->stage++;
+
+            if (*sonPtr != nullptr && 
+                VectorPush(&stack, NormalizeFrameType{sonPtr, 0}) != VectorErrors::VECTOR_NO_ERR)
+                err = ExpressionErrors::MEM_ERR;
+
+            continue;
+        }
+
+        TokensStackPop(&stack);
+
+        NormalizeResultType result = {};
+        bool ctorSucceeded =
+            ExpressionPolynomialCtor(&result.poly, varsArr->size) == ExpressionErrors::NO_ERR;
+
+        if (!IS_OP(token))
+        {
+            result.isPolynomial = ctorSucceeded &&
+                                  ExpressionPolynomialFromToken(&result.poly, token, varsArr);
+
+            if (VectorPush(&results, result) != VectorErrors::VECTOR_NO_ERR)
+            {
+                ExpressionPolynomialDtor(&result.poly);
+                err = ExpressionErrors::MEM_ERR;
+            }
+
+            continue;
+        }
+
+        NormalizeResultType right = {{}, true, false};
+        if (R(token) != nullptr)
+            right = TokensStackPop(&results);
+
+        NormalizeResultType left = TokensStackPop(&results);
+
+        result.changed      = left.changed || right.changed;
+        result.isPolynomial = ctorSucceeded && left.isPolynomial && right.isPolynomial &&
+                              ExpressionPolynomialCombine(&result.poly, OP(token), &left.poly,
+                                                          R(token) ? &right.poly : nullptr);
+
+        if (!result.isPolynomial)
+        {
+            if (left.isPolynomial)
+                ExpressionPolynomialReplaceIfShorter(&token->left, &left.poly, varsArr,
+                                                                   &result.changed);
+            if (R(token) && right.isPolynomial)
+                ExpressionPolynomialReplaceIfShorter(&token->right, &right.poly, varsArr,
+                                                                    &result.changed);
+        }
+
+        if (result.changed)
+            token->texLen = 0;
+
+        ExpressionPolynomialDtor(&left.poly);
+        ExpressionPolynomialDtor(&right.poly);
+
+        // results stack has already given two places for the result
+        VectorPush(&results, result);
+    }
+
+    if (err == ExpressionErrors::NO_ERR)
+    {
+        NormalizeResultType result = TokensStackPop(&results);
+
+        *poly         = result.poly;
+        *isPolynomial = result.isPolynomial;
+
+        if (result.changed)
+            *changed = true;
+    }
+    else
+    {
+        // some subtrees could be already replaced, their old tokens are freed
+        *changed = true;
+
+        while (!VectorIsEmpty(&results))
+        {
+            NormalizeResultType result = TokensStackPop(&results);
+            ExpressionPolynomialDtor(&result.poly);
+        }
+    }
+
+    VectorDtor(&results);
+    VectorDtor(&stack);
+
+    return err;
+}
+
+static void ExpressionPolynomialReplaceIfShorter(ExpressionTokenType** tokenPtr,
+                                                 const ExpressionPolynomialType* poly,
+                                                 ExpressionVariablesArrayType* varsArr,
+                                                 bool* changed)
+{
+    assert(tokenPtr);
+    assert(poly);
+    assert(changed);
+
+    ExpressionTokenType* normalForm = ExpressionPolynomialToToken(poly, varsArr);
+    if (normalForm == nullptr)
+        return;
+
+    size_t normalFormSize = ExpressionTokenCountNodes(normalForm);
+    size_t tokenSize      = ExpressionTokenCountNodes(*tokenPtr);
+
+    // subtree is kept if the sizes are unknown
+    if (normalFormSize == 0 || tokenSize == 0 || normalFormSize >= tokenSize)
+    {
+        ExpressionDtor(normalForm);
+        return;
+    }
+
+    ExpressionDtor(*tokenPtr);
+    *tokenPtr = normalForm;
+    *changed  = true;
+}
+
+static size_t ExpressionTokenCountNodes(const ExpressionTokenType* token)
+{
+    if (token == nullptr)
+        return 0;
+
+    TokensStackType<const ExpressionTokenType*> stack;
+    VectorCtor(&stack);
+
+    size_t nodesCount = 0;
+
+    while (true)
+    {
+        nodesCount++;
+
+        // 0 - nodes can't be counted
+        if (token->right != nullptr && 
+            VectorPush(&stack, (const ExpressionTokenType*) token->right) != 
+                                                            VectorErrors::VECTOR_NO_ERR)
+        {
+            nodesCount = 0;
+            break;
+        }
+
+        if (token->left != nullptr)
+            token = token->left;
+        else if (!VectorIsEmpty(&stack))
+            token = TokensStackPop(&stack);
+        else
+            break;
+    }
+
+    VectorDtor(&stack);
+
+    return nodesCount;
+}
@@ -0,0 +1,47 @@
+#ifndef MATH_EXPRESSION_POLYNOMIAL_H
+#define MATH_EXPRESSION_POLYNOMIAL_H
+
+#include "MathExpressionsMain.h"
+
+// Sparse polynomial: term i is coefficients[i] * prod(var_v ^ exponents[i * varsCount + v]),
+// terms are found by their exponent vectors through open addressing table
+struct ExpressionPolynomialType
+{
+    size_t varsCount;
+
+    double*   coefficients;
+    unsigned* exponents;
+
+    size_t size;
+    size_t capacity;
+
+    size_t* table;
+    size_t  tableCapacity;
+};
+
+ExpressionErrors ExpressionPolynomialCtor(ExpressionPolynomialType* poly, const size_t varsCount);
+void             ExpressionPolynomialDtor(ExpressionPolynomialType* poly);
+
+ExpressionErrors ExpressionPolynomialAddTerm(ExpressionPolynomialType* poly,
+                                             const double coefficient,
+                                             const unsigned* exponents);
+
+ExpressionErrors ExpressionPolynomialAdd(ExpressionPolynomialType* target,
+                                         const ExpressionPolynomialType* poly,
+                                         const double scale = 1);
+ExpressionErrors ExpressionPolynomialMul(ExpressionPolynomialType* result,
+                                         const ExpressionPolynomialType* first,
+                                         const ExpressionPolynomialType* second);
+ExpressionErrors ExpressionPolynomialPow(ExpressionPolynomialType* result,
+                                         const ExpressionPolynomialType* poly,
+                                         unsigned power);
+
+bool ExpressionPolynomialFromToken(ExpressionPolynomialType* poly,
+                                   const ExpressionTokenType* token,
+                                   const ExpressionVariablesArrayType* varsArr);
+ExpressionTokenType* ExpressionPolynomialToToken(const ExpressionPolynomialType* poly,
+                                                 ExpressionVariablesArrayType* varsArr);
+
+ExpressionErrors ExpressionPolynomialNormalize(ExpressionType* expression, bool* changed);
+
+#endif
@@ -0,0 +1,325 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "MathExpressionPostfix.h"
+#include "MathExpressionCalculations.h"
+#include "Common/DoubleFuncs.h"
+
+#include "DSL.h"
+
+// values are calculated by columns of POSTFIX_BLOCK_SIZE points,
+// so every instruction is one tight loop instead of a tree walk per point
+static const size_t POSTFIX_BLOCK_SIZE = 256;
+
+static ExpressionErrors ExpressionPostfixAddToken(ExpressionPostfixType* postfix,
+                                                  const ExpressionTokenType* token,
+                                                  size_t* stackSize);
+static ExpressionErrors ExpressionPostfixPush    (ExpressionPostfixType* postfix,
+                                                  const ExpressionTokenType* token);
+
+static void ExpressionPostfixCalculateUnary (const ExpressionOperationId operation,
+                                             double* first, const size_t count);
+static void ExpressionPostfixCalculateBinary(const ExpressionOperationId operation,
+                                             double* first, const double* second,
+                                             const size_t count);
+
+static inline void ExpressionPostfixFill(double* column, const double value, const size_t count);
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionPostfixCtor(ExpressionPostfixType* postfix,
+                                       const ExpressionType* expression)
+{
+    assert(postfix);
+    assert(expression);
+    assert(expression->root);
+
+    static const size_t startCapacity = 64;
+
+    postfix->data      = (ExpressionPostfixInstructionType*)
+                                        calloc(startCapacity, sizeof(*postfix->data));
+    postfix->size      = 0;
+    postfix->capacity  = startCapacity;
+    postfix->stackSize = 0;
+
+    if (postfix->data == nullptr)
+    {
+        postfix->capacity = 0;
+        return ExpressionErrors::MEM_ERR;
+    }
+
+    ExpressionErrors err = ExpressionPostfixAddToken(postfix, expression->root,
+                                                              &postfix->stackSize);
+
+    if (err != ExpressionErrors::NO_ERR)
+        ExpressionPostfixDtor(postfix);
+
+    return err;
+}
+
+void ExpressionPostfixDtor(ExpressionPostfixType* postfix)
+{
+    assert(postfix);
+
+    free(postfix->data);
+
+    postfix->data      = nullptr;
+    postfix->size      = 0;
+    postfix->capacity  = 0;
+    postfix->stackSize = 0;
+}
+
+//---------------------------------------------------------------------------------------
+
+static ExpressionErrors ExpressionPostfixAddToken(ExpressionPostfixType* postfix,
+                                                  const ExpressionTokenType* token,
+                                                  size_t* stackSize)
+{
+    assert(postfix);
+    assert(token);
+    assert(stackSize);
+
+    ExpressionErrors err = ExpressionErrors::NO_ERR;
+
+    if (!IS_OP(token))
+    {
+        *stackSize = 1;
+        return ExpressionPostfixPush(postfix, token);
+    }
+
+    if (L(token) == nullptr)
+        return ExpressionErrors::TOKEN_EDGES_ERR;
+
+    size_t leftStackSize = 0;
+    err = ExpressionPostfixAddToken(postfix, L(token), &leftStackSize);
+
+    if (err != ExpressionErrors::NO_ERR)
+        return err;
+
+    *stackSize = leftStackSize;
+
+    if (!ExpressionOperationIsUnary(OP(token)))
+    {
+        if (R(token) == nullptr)
+            return ExpressionErrors::TOKEN_EDGES_ERR;
+
+        size_t rightStackSize = 0;
+        err = ExpressionPostfixAddToken(postfix, R(token), &rightStackSize);
+
+        if (err != ExpressionErrors::NO_ERR)
+            return err;
+
+        //left value lies on the stack while right one is calculated
+        if (rightStackSize + 1 > *stackSize)
+            *stackSize = rightStackSize + 1;
+    }
+
+    return ExpressionPostfixPush(postfix, token);
+}
+
+static ExpressionErrors ExpressionPostfixPush(ExpressionPostfixType* postfix,
+                                              const ExpressionTokenType* token)
+{
+    assert(postfix);
+    assert(token);
+
+    if (postfix->size == postfix->capacity)
+    {
+        size_t newCapacity = 2 * postfix->capacity;
+        ExpressionPostfixInstructionType* newData = (ExpressionPostfixInstructionType*)
+                                realloc(postfix->data, newCapacity * sizeof(*newData));
+
+        if (newData == nullptr)
+            return ExpressionErrors::MEM_ERR;
+
+        postfix->data     = newData;
+        postfix->capacity = newCapacity;
+    }
+
+    postfix->data[postfix->size++] = {token->value, token->valueType};
+
+    return ExpressionErrors::NO_ERR;
+}
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionPostfixCalculate(const ExpressionPostfixType* postfix,
+                                            const ExpressionVariableType* variable,
+                                            const double* values, double* results,
+                                            const size_t count)
+{
+    assert(postfix);
+    assert(values);
+    assert(results);
+    assert(postfix->size > 0);
+
+    double* stack = (double*) calloc(postfix->stackSize * POSTFIX_BLOCK_SIZE, sizeof(*stack));
+
+    if (stack == nullptr)
+        return ExpressionErrors::MEM_ERR;
+
+    for (size_t start = 0; start < count; start += POSTFIX_BLOCK_SIZE)
+    {
+        size_t blockSize = count - start < POSTFIX_BLOCK_SIZE ? count - start : POSTFIX_BLOCK_SIZE;
+        size_t top       = 0;
+
+        for (size_t i = 0; i < postfix->size; ++i)
+        {
+            const ExpressionPostfixInstructionType* instruction = &postfix->data[i];
+
+            switch (instruction->valueType)
+            {
+                case ExpressionTokenValueTypeof::VALUE:
+                    ExpressionPostfixFill(stack + top * POSTFIX_BLOCK_SIZE,
+                                          instruction->value.value, blockSize);
+                    top++;
+                    break;
+
+                case ExpressionTokenValueTypeof::VARIABLE:
+                    if (instruction->value.varPtr == variable)
+                        memcpy(stack + top * POSTFIX_BLOCK_SIZE, values + start,
+                                                                 blockSize * sizeof(*stack));
+                    else
+                        ExpressionPostfixFill(stack + top * POSTFIX_BLOCK_SIZE,
+                                              instruction->value.varPtr->variableValue,
+                                                                            blockSize);
+                    top++;
+                    break;
+
+                case ExpressionTokenValueTypeof::OPERATION:
+                    if (ExpressionOperationIsUnary(instruction->value.operation))
+                    {
+                        ExpressionPostfixCalculateUnary(instruction->value.operation,
+                                                        stack + (top - 1) * POSTFIX_BLOCK_SIZE,
+                                                        blockSize);
+                        break;
+                    }
+
+                    top--;
+                    ExpressionPostfixCalculateBinary(instruction->value.operation,
+                                                     stack + (top - 1) * POSTFIX_BLOCK_SIZE,
+                                                     stack +  top      * POSTFIX_BLOCK_SIZE,
+                                                     blockSize);
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        assert(top == 1);
+        memcpy(results + start, stack, blockSize * sizeof(*results));
+    }
+
+    free(stack);
+
+    return ExpressionErrors::NO_ERR;
+}
+
+//---------------------------------------------------------------------------------------
+
+// Kernels repeat Operations.h calculation code without domain asserts:
+// points out of domain simply become nan, as they do in gnuplot.
+
+#define POSTFIX_KERNEL(NAME, CODE)                                  \
+    case ExpressionOperationId::NAME:                               \
+        for (size_t i = 0; i < count; ++i)                          \
+        {                                                           \
+            const double val1 = first[i];                           \
+            first[i] = (CODE);                                      \
+        }                                                           \
+        break;
+
+static void ExpressionPostfixCalculateUnary(const ExpressionOperationId operation,
+                                            double* first, const size_t count)
+{
+    assert(first);
+
+    switch (operation)
+    {
+        POSTFIX_KERNEL(UNARY_SUB, -val1)
+        POSTFIX_KERNEL(LN,        log(val1))
+        POSTFIX_KERNEL(SIN,       sin(val1))
+        POSTFIX_KERNEL(COS,       cos(val1))
+        POSTFIX_KERNEL(TAN,       tan(val1))
+        POSTFIX_KERNEL(COT,       1 / tan(val1))
+        POSTFIX_KERNEL(ARCSIN,    asin(val1))
+        POSTFIX_KERNEL(ARCCOS,    acos(val1))
+        POSTFIX_KERNEL(ARCTAN,    atan(val1))
+        POSTFIX_KERNEL(ARCCOT,    PI / 2 - atan(val1))
+
+        // binary operations never get here, they are calculated as Operations.h says
+        case ExpressionOperationId::ADD:
+        case ExpressionOperationId::SUB:
+        case ExpressionOperationId::MUL:
+        case ExpressionOperationId::DIV:
+        case ExpressionOperationId::POW:
+        case ExpressionOperationId::LOG:
+        default:
+            for (size_t i = 0; i < count; ++i)
+                first[i] = isfinite(first[i]) ? ExpressionOperationCalculate(operation, first[i]) :
+                                                NAN;
+            break;
+    }
+}
+
+#undef POSTFIX_KERNEL
+
+#define POSTFIX_KERNEL(NAME, CODE)                                  \
+    case ExpressionOperationId::NAME:                               \
+        for (size_t i = 0; i < count; ++i)                          \
+        {                                                           \
+            const double val1 = first[i];                           \
+            const double val2 = second[i];                          \
+            first[i] = (CODE);                                      \
+        }                                                           \
+        break;
+
+static void ExpressionPostfixCalculateBinary(const ExpressionOperationId operation,
+                                             double* first, const double* second,
+                                             const size_t count)
+{
+    assert(first);
+    assert(second);
+
+    switch (operation)
+    {
+        POSTFIX_KERNEL(ADD, val1 + val2)
+        POSTFIX_KERNEL(SUB, val1 - val2)
+        POSTFIX_KERNEL(MUL, val1 * val2)
+        POSTFIX_KERNEL(DIV, val1 / val2)
+        POSTFIX_KERNEL(POW, pow(val1, val2))
+        POSTFIX_KERNEL(LOG, log(val2) / log(val1))
+
+        // unary operations never get here, they are calculated as Operations.h says
+        case ExpressionOperationId::UNARY_SUB:
+        case ExpressionOperationId::LN:
+        case ExpressionOperationId::SIN:
+        case ExpressionOperationId::COS:
+        case ExpressionOperationId::TAN:
+        case ExpressionOperationId::COT:
+        case ExpressionOperationId::ARCSIN:
+        case ExpressionOperationId::ARCCOS:
+        case ExpressionOperationId::ARCTAN:
+        case ExpressionOperationId::ARCCOT:
+        default:
+            for (size_t i = 0; i < count; ++i)
+                first[i] = isfinite(first[i]) && isfinite(second[i]) ?
+                           ExpressionOperationCalculate(operation, first[i], second[i]) : NAN;
+            break;
+    }
+}
+
+#undef POSTFIX_KERNEL
+
+//---------------------------------------------------------------------------------------
+
+static inline void ExpressionPostfixFill(double* column, const double value, const size_t count)
+{
+    assert(column);
+
+    for (size_t i = 0; i < count; ++i)
+        column[i] = value;
+}
@@ -0,0 +1,35 @@
+#ifndef MATH_EXPRESSION_POSTFIX_H
+#define MATH_EXPRESSION_POSTFIX_H
+
+#include "MathExpressionsMain.h"
+
+// Expression tree flattened to postfix order for evaluation on many points at once.
+// Instructions keep token values, so variables are still bound to the expression's variables array.
+struct ExpressionPostfixInstructionType
+{
+    ExpressionTokenValue       value;
+    ExpressionTokenValueTypeof valueType;
+};
+
+struct ExpressionPostfixType
+{
+    ExpressionPostfixInstructionType* data;
+
+    size_t size;
+    size_t capacity;
+
+    size_t stackSize;       // max number of values on evaluation stack
+};
+
+ExpressionErrors ExpressionPostfixCtor(ExpressionPostfixType* postfix,
+                                       const ExpressionType* expression);
+void             ExpressionPostfixDtor(ExpressionPostfixType* postfix);
+
+// results[i] = expression value with variable equal to values[i], other variables keep their values.
+// Out of domain points give nan or inf instead of failing asserts.
+ExpressionErrors ExpressionPostfixCalculate(const ExpressionPostfixType* postfix,
+                                            const ExpressionVariableType* variable,
+                                            const double* values, double* results,
+                                            const size_t count);
+
+#endif
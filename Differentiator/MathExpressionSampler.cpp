@@ -0,0 +1,446 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "MathExpressionSampler.h"
+#include "MathExpressionPostfix.h"
+#include "MathExpressionInterval.h"
+
+// intervals are refined a bit below one pixel to draw steep parts near poles
+static const double SAMPLER_MIN_PIXELS = 0.125;
+
+struct SamplerIntervalType
+{
+    double xLeft;
+    double yLeft;
+
+    double xRight;
+    double yRight;
+};
+
+static ExpressionErrors ExpressionSamplePostfixUniform(const ExpressionPostfixType* postfix,
+                                                      const ExpressionVariableType* variable,
+                                                      const double left, const double right,
+                                                      const size_t count,
+                                                      ExpressionSamplesType* samples);
+
+static ExpressionErrors ExpressionSamplesAdd   (ExpressionSamplesType* samples,
+                                                const double x, const double y);
+static ExpressionErrors ExpressionSamplesReserve(ExpressionSamplesType* samples,
+                                                 const size_t count);
+
+static bool SamplerIntervalNeedRefine(const SamplerIntervalType* interval, const double yMid,
+                                      const double yScale, const double pixelTolerance);
+static bool SamplerIntervalNeedMidpoint(const ExpressionType* expression,
+                                        ExpressionIntervalType* variablesIntervals,
+                                        const size_t variableIndex,
+                                        const SamplerIntervalType* interval,
+                                        const double yScale, const double pixelTolerance);
+
+static ExpressionIntervalType* SamplerVariablesIntervalsCreate(const ExpressionType* expression);
+
+static bool SamplerArrayGrow(void** data, size_t* capacity, const size_t newCapacity,
+                                                            const size_t elemSize);
+static int  SamplerPointsCmp(const void* first, const void* second);
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionSamplesCtor(ExpressionSamplesType* samples, const size_t capacity)
+{
+    assert(samples);
+    assert(capacity > 0);
+
+    samples->points      = (double*) calloc(2 * capacity, sizeof(*samples->points));
+    samples->size        = 0;
+    samples->capacity    = capacity;
+    samples->evaluations = 0;
+
+    if (samples->points == nullptr)
+    {
+        samples->capacity = 0;
+        return ExpressionErrors::MEM_ERR;
+    }
+
+    return ExpressionErrors::NO_ERR;
+}
+
+void ExpressionSamplesDtor(ExpressionSamplesType* samples)
+{
+    assert(samples);
+
+    free(samples->points);
+
+    samples->points      = nullptr;
+    samples->size        = 0;
+    samples->capacity    = 0;
+    samples->evaluations = 0;
+}
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionSampleUniform(const ExpressionType* expression,
+                                         const ExpressionVariableType* variable,
+                                         const double left, const double right,
+                                         const size_t count,
+                                         ExpressionSamplesType* samples)
+{
+    assert(expression);
+    assert(samples);
+
+    ExpressionPostfixType postfix = {};
+    ExpressionErrors err = ExpressionPostfixCtor(&postfix, expression);
+
+    if (err != ExpressionErrors::NO_ERR)
+        return err;
+
+    err = ExpressionSamplePostfixUniform(&postfix, variable, left, right, count, samples);
+
+    ExpressionPostfixDtor(&postfix);
+
+    return err;
+}
+
+static ExpressionErrors ExpressionSamplePostfixUniform(const ExpressionPostfixType* postfix,
+                                                      const ExpressionVariableType* variable,
+                                                      const double left, const double right,
+                                                      const size_t count,
+                                                      ExpressionSamplesType* samples)
+{
+    assert(postfix);
+    assert(samples);
+    assert(left < right);
+    assert(count > 1);
+
+    ExpressionErrors err = ExpressionErrors::NO_ERR;
+
+    double* xs = (double*) calloc(count, sizeof(*xs));
+    double* ys = (double*) calloc(count, sizeof(*ys));
+
+    if (xs == nullptr || ys == nullptr)
+        err = ExpressionErrors::MEM_ERR;
+
+    if (err == ExpressionErrors::NO_ERR)
+    {
+        double step = (right - left) / (double)(count - 1);
+
+        for (size_t i = 0; i < count; ++i)
+            xs[i] = left + step * (double)i;
+
+        err = ExpressionPostfixCalculate(postfix, variable, xs, ys, count);
+        samples->evaluations += count;
+    }
+
+    if (err == ExpressionErrors::NO_ERR)
+        err = ExpressionSamplesReserve(samples, samples->size + count);
+
+    for (size_t i = 0; i < count && err == ExpressionErrors::NO_ERR; ++i)
+        err = ExpressionSamplesAdd(samples, xs[i], ys[i]);
+
+    free(xs);
+    free(ys);
+
+    return err;
+}
+
+//---------------------------------------------------------------------------------------
+
+ExpressionErrors ExpressionSampleAdaptive(const ExpressionType* expression,
+                                          const ExpressionVariableType* variable,
+                                          const double left, const double right,
+                                          const ExpressionSamplerParamsType* params,
+                                          ExpressionSamplesType* samples)
+{
+    assert(expression);
+    assert(params);
+    assert(samples);
+    assert(left < right);
+    assert(params->startSamples > 1);
+
+    size_t firstPoint = samples->size;
+
+    ExpressionPostfixType postfix = {};
+    ExpressionErrors err = ExpressionPostfixCtor(&postfix, expression);
+
+    if (err != ExpressionErrors::NO_ERR)
+        return err;
+
+    err = ExpressionSamplePostfixUniform(&postfix, variable, left, right, 
+                                         params->startSamples, samples);
+    if (err != ExpressionErrors::NO_ERR)
+    {
+        ExpressionPostfixDtor(&postfix);
+        return err;
+    }
+
+    //tolerance is measured in pixels of the image autoscaled by the start samples
+    double yMin = INFINITY;
+    double yMax = -INFINITY;
+
+    for (size_t i = firstPoint; i < samples->size; ++i)
+    {
+        double y = samples->points[2 * i + 1];
+
+        if (!isfinite(y))
+            continue;
+
+        if (y < yMin) yMin = y;
+        if (y > yMax) yMax = y;
+    }
+
+    double yRange = yMax > yMin ? yMax - yMin : 1;
+    double yScale = (double)params->heightPixels / yRange;
+    double xScale = (double)params->widthPixels  / (right - left);
+
+    SamplerIntervalType* intervals     = nullptr;
+    SamplerIntervalType* nextIntervals = nullptr;
+    size_t intervalsCapacity     = 0;
+    size_t nextIntervalsCapacity = 0;
+
+    double* xs = nullptr;
+    double* ys = nullptr;
+    size_t xsCapacity = 0;
+    size_t ysCapacity = 0;
+
+    size_t intervalsCount = params->startSamples - 1;
+
+    //enclosures of the expression over the intervals drop regions out of domain
+    //and flat regions before their midpoints are calculated
+    ExpressionIntervalType* variablesIntervals = nullptr;
+    size_t variableIndex = 0;
+
+    if (variable != nullptr)
+    {
+        variablesIntervals = SamplerVariablesIntervalsCreate(expression);
+        variableIndex      = (size_t)(variable - expression->variables.data);
+
+        if (variablesIntervals == nullptr)
+            err = ExpressionErrors::MEM_ERR;
+    }
+
+    if (!SamplerArrayGrow((void**)&intervals, &intervalsCapacity, intervalsCount,
+                                                                  sizeof(*intervals)))
+        err = ExpressionErrors::MEM_ERR;
+
+    for (size_t i = 0; i < intervalsCount && err == ExpressionErrors::NO_ERR; ++i)
+    {
+        const double* point = samples->points + 2 * (firstPoint + i);
+        intervals[i] = {point[0], point[1], point[2], point[3]};
+    }
+
+    //intervals of one depth are refined together to calculate their midpoints in one batch
+    for (size_t depth = 0; depth < params->maxDepth && intervalsCount > 0 &&
+                                                       err == ExpressionErrors::NO_ERR; ++depth)
+    {
+        if (variablesIntervals != nullptr)
+        {
+            size_t keptCount = 0;
+
+            for (size_t i = 0; i < intervalsCount; ++i)
+                if (SamplerIntervalNeedMidpoint(expression, variablesIntervals, variableIndex,
+                                                &intervals[i], yScale, params->pixelTolerance))
+                    intervals[keptCount++] = intervals[i];
+
+            intervalsCount = keptCount;
+
+            if (intervalsCount == 0)
+                break;
+        }
+
+        if (!SamplerArrayGrow((void**)&xs, &xsCapacity, intervalsCount, sizeof(*xs)) ||
+            !SamplerArrayGrow((void**)&ys, &ysCapacity, intervalsCount, sizeof(*ys)) ||
+            !SamplerArrayGrow((void**)&nextIntervals, &nextIntervalsCapacity,
+                                                      2 * intervalsCount, sizeof(*nextIntervals)))
+        {
+            err = ExpressionErrors::MEM_ERR;
+            break;
+        }
+
+        for (size_t i = 0; i < intervalsCount; ++i)
+            xs[i] = (intervals[i].xLeft + intervals[i].xRight) / 2;
+
+        err = ExpressionPostfixCalculate(&postfix, variable, xs, ys, intervalsCount);
+        samples->evaluations += intervalsCount;
+
+        size_t nextCount = 0;
+
+        for (size_t i = 0; i < intervalsCount && err == ExpressionErrors::NO_ERR; ++i)
+        {
+            const SamplerIntervalType* interval = &intervals[i];
+
+            err = ExpressionSamplesAdd(samples, xs[i], ys[i]);
+
+            //narrower intervals can't be seen on the image
+            if ((interval->xRight - interval->xLeft) * xScale <= SAMPLER_MIN_PIXELS ||
+                !SamplerIntervalNeedRefine(interval, ys[i], yScale, params->pixelTolerance))
+                continue;
+
+            nextIntervals[nextCount++] = {interval->xLeft, interval->yLeft,  xs[i], ys[i]};
+            nextIntervals[nextCount++] = {xs[i], ys[i], interval->xRight, interval->yRight};
+        }
+
+        SamplerIntervalType* tmpIntervals = intervals;
+        intervals     = nextIntervals;
+        nextIntervals = tmpIntervals;
+
+        size_t tmpCapacity    = intervalsCapacity;
+        intervalsCapacity     = nextIntervalsCapacity;
+        nextIntervalsCapacity = tmpCapacity;
+
+        intervalsCount = nextCount;
+    }
+
+    free(intervals);
+    free(nextIntervals);
+    free(xs);
+    free(ys);
+    free(variablesIntervals);
+    ExpressionPostfixDtor(&postfix);
+
+    if (err == ExpressionErrors::NO_ERR)
+        qsort(samples->points + 2 * firstPoint, samples->size - firstPoint,
+                                                2 * sizeof(*samples->points), SamplerPointsCmp);
+
+    return err;
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool SamplerIntervalNeedRefine(const SamplerIntervalType* interval, const double yMid,
+                                      const double yScale, const double pixelTolerance)
+{
+    assert(interval);
+
+    bool leftDefined  = isfinite(interval->yLeft);
+    bool rightDefined = isfinite(interval->yRight);
+    bool midDefined   = isfinite(yMid);
+
+    //border of the domain or a pole is somewhere inside
+    if (!leftDefined || !rightDefined || !midDefined)
+        return leftDefined || rightDefined || midDefined;
+
+    //distance between the midpoint and the chord is half of the second difference
+    double chordDistance = fabs(interval->yLeft - 2 * yMid + interval->yRight) / 2;
+
+    return chordDistance * yScale > pixelTolerance;
+}
+
+static bool SamplerIntervalNeedMidpoint(const ExpressionType* expression,
+                                        ExpressionIntervalType* variablesIntervals,
+                                        const size_t variableIndex,
+                                        const SamplerIntervalType* interval,
+                                        const double yScale, const double pixelTolerance)
+{
+    assert(expression);
+    assert(variablesIntervals);
+    assert(interval);
+
+    variablesIntervals[variableIndex] = ExpressionIntervalCreate(interval->xLeft,
+                                                                 interval->xRight);
+
+    ExpressionIntervalType enclosure = ExpressionIntervalCalculate(expression, variablesIntervals);
+
+    //expression is undefined on the whole interval
+    if (ExpressionIntervalIsEmpty(enclosure))
+        return false;
+
+    //the curve can't leave a band thinner than the tolerance, so the chord is close enough
+    return enclosure.partial || !isfinite(enclosure.high - enclosure.low) ||
+           (enclosure.high - enclosure.low) * yScale > pixelTolerance;
+}
+
+static ExpressionIntervalType* SamplerVariablesIntervalsCreate(const ExpressionType* expression)
+{
+    assert(expression);
+
+    size_t variablesCount = expression->variables.size > 0 ? expression->variables.size : 1;
+
+    ExpressionIntervalType* variablesIntervals = (ExpressionIntervalType*)
+                                    calloc(variablesCount, sizeof(*variablesIntervals));
+
+    if (variablesIntervals == nullptr)
+        return nullptr;
+
+    for (size_t i = 0; i < expression->variables.size; ++i)
+    {
+        double value = expression->variables.data[i].variableValue;
+
+        variablesIntervals[i] = ExpressionIntervalCreate(value, value);
+    }
+
+    return variablesIntervals;
+}
+
+//---------------------------------------------------------------------------------------
+
+static ExpressionErrors ExpressionSamplesAdd(ExpressionSamplesType* samples,
+                                             const double x, const double y)
+{
+    assert(samples);
+
+    if (samples->size == samples->capacity)
+    {
+        ExpressionErrors err = ExpressionSamplesReserve(samples, 2 * samples->capacity);
+
+        if (err != ExpressionErrors::NO_ERR)
+            return err;
+    }
+
+    samples->points[2 * samples->size]     = x;
+    samples->points[2 * samples->size + 1] = y;
+    samples->size++;
+
+    return ExpressionErrors::NO_ERR;
+}
+
+static ExpressionErrors ExpressionSamplesReserve(ExpressionSamplesType* samples,
+                                                 const size_t count)
+{
+    assert(samples);
+
+    if (count <= samples->capacity)
+        return ExpressionErrors::NO_ERR;
+
+    double* newPoints = (double*) realloc(samples->points, 2 * count * sizeof(*newPoints));
+
+    if (newPoints == nullptr)
+        return ExpressionErrors::MEM_ERR;
+
+    samples->points   = newPoints;
+    samples->capacity = count;
+
+    return ExpressionErrors::NO_ERR;
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool SamplerArrayGrow(void** data, size_t* capacity, const size_t newCapacity,
+                                                            const size_t elemSize)
+{
+    assert(data);
+    assert(capacity);
+
+    if (newCapacity <= *capacity)
+        return true;
+
+    void* newData = realloc(*data, newCapacity * elemSize);
+
+    if (newData == nullptr)
+        return false;
+
+    *data     = newData;
+    *capacity = newCapacity;
+
+    return true;
+}
+
+static int SamplerPointsCmp(const void* first, const void* second)
+{
+    assert(first);
+    assert(second);
+
+    double firstX  = *(const double*)first;
+    double secondX = *(const double*)second;
+
+    return (firstX > secondX) - (firstX < secondX);
+}
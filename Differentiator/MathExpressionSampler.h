@@ -0,0 +1,46 @@
+#ifndef MATH_EXPRESSION_SAMPLER_H
+#define MATH_EXPRESSION_SAMPLER_H
+
+#include "MathExpressionsMain.h"
+
+// points of the curve sorted by x: x0, y0, x1, y1, ...
+struct ExpressionSamplesType
+{
+    double* points;
+
+    size_t size;            // number of points
+    size_t capacity;
+
+    size_t evaluations;     // number of calculated points, including dropped ones
+};
+
+struct ExpressionSamplerParamsType
+{
+    size_t startSamples;    // uniform samples before refinement
+    size_t maxDepth;        // max number of halvings of start intervals
+
+    double pixelTolerance;  // max distance in pixels between the curve and the chord
+
+    size_t widthPixels;     // image size, converts tolerance to x and y units
+    size_t heightPixels;
+};
+
+ExpressionErrors ExpressionSamplesCtor(ExpressionSamplesType* samples, const size_t capacity = 64);
+void             ExpressionSamplesDtor(ExpressionSamplesType* samples);
+
+ExpressionErrors ExpressionSampleUniform (const ExpressionType* expression,
+                                          const ExpressionVariableType* variable,
+                                          const double left, const double right,
+                                          const size_t count,
+                                          ExpressionSamplesType* samples);
+
+// Starts with uniform samples and halves intervals, where the midpoint is further
+// from the chord than params->pixelTolerance or the function is defined only on one end.
+// Intervals, where interval arithmetic proves the function undefined or flat, are not refined.
+ExpressionErrors ExpressionSampleAdaptive(const ExpressionType* expression,
+                                          const ExpressionVariableType* variable,
+                                          const double left, const double right,
+                                          const ExpressionSamplerParamsType* params,
+                                          ExpressionSamplesType* samples);
+
+#endif
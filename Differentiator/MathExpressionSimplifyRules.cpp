@@ -0,0 +1,221 @@
+#include <assert.h>
+#include <math.h>
+
+#include "MathExpressionSimplifyRules.h"
+#include "MathExpressionCalculations.h"
+#include "Common/DoubleFuncs.h"
+
+#include "DSL.h"
+
+enum SimplifyTokenClass
+{
+    CLASS_NIL,
+    CLASS_ZERO,
+    CLASS_ONE,
+    CLASS_VAL,
+    CLASS_VAR,
+    CLASS_SAME_VAR,
+    CLASS_OP,
+
+    CLASSES_COUNT,
+};
+
+static const unsigned PATTERN_NIL        = 1u << CLASS_NIL;
+static const unsigned PATTERN_ZERO       = 1u << CLASS_ZERO;
+static const unsigned PATTERN_ONE        = 1u << CLASS_ONE;
+static const unsigned PATTERN_VAL        = 1u << CLASS_VAL;
+static const unsigned PATTERN_VAR        = 1u << CLASS_VAR;
+static const unsigned PATTERN_SAME_VAR   = 1u << CLASS_SAME_VAR;
+static const unsigned PATTERN_OP         = 1u << CLASS_OP;
+
+static const unsigned PATTERN_NUM        = PATTERN_ZERO | PATTERN_ONE | PATTERN_VAL;
+static const unsigned PATTERN_NUM_OR_NIL = PATTERN_NUM  | PATTERN_NIL;
+static const unsigned PATTERN_ANY        = (1u << CLASSES_COUNT) - 1;
+
+#define GENERATE_OPERATION_CMD(NAME, ...) RULE_OPERATION_##NAME,
+
+enum SimplifyRuleOperation
+{
+    #include "Operations.h"
+
+    RULE_OPERATION_ANY_OPERATION,
+};
+
+#undef GENERATE_OPERATION_CMD
+
+static const size_t OPERATIONS_COUNT = RULE_OPERATION_ANY_OPERATION;
+
+struct SimplifyRuleType
+{
+    SimplifyRuleOperation operation;
+
+    unsigned  leftPattern;
+    unsigned rightPattern;
+
+    ExpressionSimplifyRuleResult result;
+};
+
+#define GENERATE_SIMPLIFY_RULE(OPERATION, LEFT, RIGHT, RESULT)                               \
+    {RULE_OPERATION_##OPERATION, PATTERN_##LEFT, PATTERN_##RIGHT,                           \
+     ExpressionSimplifyRuleResult::RESULT},
+
+static constexpr SimplifyRuleType SimplifyRules[] =
+{
+    #include "SimplifyRules.h"
+};
+
+#undef GENERATE_SIMPLIFY_RULE
+
+//---------------------------------------------------------------------------------------
+
+struct SimplifyRulesTableType
+{
+    ExpressionSimplifyRuleResult results[OPERATIONS_COUNT][CLASSES_COUNT][CLASSES_COUNT];
+};
+
+// Every (operation, left class, right class) cell gets the first rule matching it,
+// so the simplifier does a single lookup per node no matter how many rules there are.
+static constexpr SimplifyRulesTableType SimplifyRulesTableBuild()
+{
+    SimplifyRulesTableType table = {};
+
+    for (const SimplifyRuleType& rule : SimplifyRules)
+    {
+        for (size_t operation = 0; operation < OPERATIONS_COUNT; ++operation)
+        {
+            if (rule.operation != RULE_OPERATION_ANY_OPERATION &&
+                rule.operation != operation)
+                continue;
+
+            for (size_t leftClass = 0; leftClass < CLASSES_COUNT; ++leftClass)
+            {
+                if ((rule.leftPattern & (1u << leftClass)) == 0)
+                    continue;
+
+                for (size_t rightClass = 0; rightClass < CLASSES_COUNT; ++rightClass)
+                {
+                    if ((rule.rightPattern & (1u << rightClass)) == 0)
+                        continue;
+
+                    ExpressionSimplifyRuleResult& cell =
+                                        table.results[operation][leftClass][rightClass];
+
+                    if (cell == ExpressionSimplifyRuleResult::NO_RULE)
+                        cell = rule.result;
+                }
+            }
+        }
+    }
+
+    return table;
+}
+
+static constexpr SimplifyRulesTableType SimplifyRulesTable = SimplifyRulesTableBuild();
+
+//---------------------------------------------------------------------------------------
+
+static inline SimplifyTokenClass SimplifyTokenGetClass(const ExpressionTokenType* token)
+{
+    if (token == nullptr)
+        return CLASS_NIL;
+
+    switch (VAL_TYPE(token))
+    {
+        case ExpressionTokenValueTypeof::VALUE:
+            if (DoubleEqual(VAL(token), 0)) return CLASS_ZERO;
+            if (DoubleEqual(VAL(token), 1)) return CLASS_ONE;
+
+            return CLASS_VAL;
+
+        case ExpressionTokenValueTypeof::VARIABLE:
+            return CLASS_VAR;
+
+        case ExpressionTokenValueTypeof::OPERATION:
+            return CLASS_OP;
+
+        default:
+            break;
+    }
+
+    assert(false);
+    return CLASS_OP;
+}
+
+ExpressionSimplifyRuleResult ExpressionSimplifyRuleFind(const ExpressionOperationId operation,
+                                                        const ExpressionTokenType* left,
+                                                        const ExpressionTokenType* right)
+{
+    assert((size_t)operation < OPERATIONS_COUNT);
+
+    SimplifyTokenClass leftClass  = SimplifyTokenGetClass(left);
+    SimplifyTokenClass rightClass = SimplifyTokenGetClass(right);
+
+    if (leftClass == CLASS_VAR && rightClass == CLASS_VAR && VAR(left) == VAR(right))
+        rightClass = CLASS_SAME_VAR;
+
+    return SimplifyRulesTable.results[(size_t)operation][leftClass][rightClass];
+}
+
+//---------------------------------------------------------------------------------------
+
+ExpressionTokenType* ExpressionSimplifyRuleCreateToken(const ExpressionSimplifyRuleResult result,
+                                                       const ExpressionOperationId operation,
+                                                       ExpressionTokenType* left,
+                                                       ExpressionTokenType* right)
+{
+    switch (result)
+    {
+        case ExpressionSimplifyRuleResult::CALCULATE:
+            assert(left);
+
+            return CRT_NUM(ExpressionOperationCalculate(operation, VAL(left),
+                                                        right ? VAL(right) : NAN));
+
+        case ExpressionSimplifyRuleResult::RETURN_LEFT:
+            return left;
+        case ExpressionSimplifyRuleResult::RETURN_RIGHT:
+            return right;
+
+        case ExpressionSimplifyRuleResult::RETURN_ZERO:
+            return CRT_NUM(0);
+        case ExpressionSimplifyRuleResult::RETURN_ONE:
+            return CRT_NUM(1);
+
+        case ExpressionSimplifyRuleResult::NEGATE_RIGHT:
+            return _MUL(CRT_NUM(-1), right);
+
+        case ExpressionSimplifyRuleResult::NO_RULE:
+        default:
+            break;
+    }
+
+    return nullptr;
+}
+
+void ExpressionSimplifyRuleDeleteUnused(const ExpressionSimplifyRuleResult result,
+                                        ExpressionTokenType* left,
+                                        ExpressionTokenType* right)
+{
+    switch (result)
+    {
+        case ExpressionSimplifyRuleResult::CALCULATE:
+        case ExpressionSimplifyRuleResult::RETURN_ZERO:
+        case ExpressionSimplifyRuleResult::RETURN_ONE:
+            ExpressionDtor(left);
+            ExpressionDtor(right);
+            break;
+
+        case ExpressionSimplifyRuleResult::RETURN_LEFT:
+            ExpressionDtor(right);
+            break;
+
+        case ExpressionSimplifyRuleResult::RETURN_RIGHT:
+        case ExpressionSimplifyRuleResult::NEGATE_RIGHT:
+            ExpressionDtor(left);
+            break;
+
+        case ExpressionSimplifyRuleResult::NO_RULE:
+        default:
+            break;
+    }
+}
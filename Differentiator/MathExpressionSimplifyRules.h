@@ -0,0 +1,31 @@
+#ifndef MATH_EXPRESSION_SIMPLIFY_RULES_H
+#define MATH_EXPRESSION_SIMPLIFY_RULES_H
+
+#include "MathExpressionsMain.h"
+
+enum class ExpressionSimplifyRuleResult
+{
+    NO_RULE,
+
+    CALCULATE,
+    RETURN_LEFT,
+    RETURN_RIGHT,
+    RETURN_ZERO,
+    RETURN_ONE,
+    NEGATE_RIGHT,
+};
+
+ExpressionSimplifyRuleResult ExpressionSimplifyRuleFind(const ExpressionOperationId operation,
+                                                        const ExpressionTokenType* left,
+                                                        const ExpressionTokenType* right);
+
+ExpressionTokenType* ExpressionSimplifyRuleCreateToken(const ExpressionSimplifyRuleResult result,
+                                                       const ExpressionOperationId operation,
+                                                       ExpressionTokenType* left,
+                                                       ExpressionTokenType* right);
+
+void ExpressionSimplifyRuleDeleteUnused(const ExpressionSimplifyRuleResult result,
+                                        ExpressionTokenType* left,
+                                        ExpressionTokenType* right);
+
+#endif
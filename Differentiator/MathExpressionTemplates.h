@@ -0,0 +1,478 @@
+#ifndef MATH_EXPRESSION_TEMPLATES_H
+#define MATH_EXPRESSION_TEMPLATES_H
+
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+#include <type_traits>
+
+#include "MathExpressionsMain.h"
+#include "Common/DoubleFuncs.h"
+
+// Expressions known at compile time are built from types instead of tokens:
+//
+//     constexpr ExpressionTemplateVariableType<0> x;
+//     constexpr auto derivative = ExpressionTemplateDiff(ExpressionTemplateSin(x * x), x);
+//
+//     const double variables[] = {2};
+//     ExpressionTemplateCalculate(derivative, variables);
+//
+// Derivative is a type too, so it is taken by the compiler and calculation is straight-line
+// code without tree and allocations. Integer constants are folded while the type is built:
+// 0 * f, 1 * f, f + 0, f ^ 1 are not a part of the result.
+// Differentiation rules are DIFF_CODE of Operations.h compiled for the types, so results are
+// the same as the ones of ExpressionDifferentiate. It treats every variable as x, here the other
+// variables are constants.
+
+//---------------------------------------------------------------------------------------
+
+// integer known at compile time
+template <long long Value>
+struct ExpressionTemplateConstType
+{
+    static constexpr long long value = Value;
+};
+
+// number known at runtime only, for example 0.5 or 1.5e-3
+struct ExpressionTemplateNumberType
+{
+    double value;
+};
+
+// variables[Index] in ExpressionTemplateCalculate
+template <size_t Index>
+struct ExpressionTemplateVariableType
+{
+};
+
+// right son of unary operations
+struct ExpressionTemplateNoneType
+{
+};
+
+template <ExpressionOperationId Operation, typename Left, typename Right>
+struct ExpressionTemplateOperationType
+{
+    Left  left;
+    Right right;
+};
+
+typedef ExpressionTemplateConstType<0> ExpressionTemplateZeroType;
+typedef ExpressionTemplateConstType<1> ExpressionTemplateOneType;
+
+#define GENERATE_OPERATION_CMD(NAME, ...) + 1
+
+static constexpr size_t EXPRESSION_TEMPLATE_OPERATIONS_COUNT = 0
+    #include "Operations.h"
+    ;
+
+#undef GENERATE_OPERATION_CMD
+
+static_assert(EXPRESSION_TEMPLATE_OPERATIONS_COUNT == 16,
+              "new operation needs its builder and its name for DIFF_CODE in ExpressionTemplateDiff");
+
+//---------------------------------------------------------------------------------------
+
+template <typename T>
+struct ExpressionTemplateIsConst : std::false_type {};
+
+template <long long Value>
+struct ExpressionTemplateIsConst<ExpressionTemplateConstType<Value>> : std::true_type {};
+
+template <typename T>
+struct ExpressionTemplateIsExpression : std::false_type {};
+
+template <long long Value>
+struct ExpressionTemplateIsExpression<ExpressionTemplateConstType<Value>> : std::true_type {};
+
+template <>
+struct ExpressionTemplateIsExpression<ExpressionTemplateNumberType> : std::true_type {};
+
+template <size_t Index>
+struct ExpressionTemplateIsExpression<ExpressionTemplateVariableType<Index>> : std::true_type {};
+
+template <ExpressionOperationId Operation, typename Left, typename Right>
+struct ExpressionTemplateIsExpression<ExpressionTemplateOperationType<Operation, Left, Right>>
+    : std::true_type {};
+
+// the same as ExpressionTokenContainVariable, but for one variable
+template <typename T, size_t Index>
+struct ExpressionTemplateContainVariable : std::false_type {};
+
+template <size_t Index>
+struct ExpressionTemplateContainVariable<ExpressionTemplateVariableType<Index>, Index>
+    : std::true_type {};
+
+template <ExpressionOperationId Operation, typename Left, typename Right, size_t Index>
+struct ExpressionTemplateContainVariable<ExpressionTemplateOperationType<Operation, Left, Right>,
+                                         Index>
+    : std::integral_constant<bool, ExpressionTemplateContainVariable<Left,  Index>::value ||
+                                   ExpressionTemplateContainVariable<Right, Index>::value> {};
+
+static constexpr bool ExpressionTemplateIsInteger(const double value)
+{
+    return !(value < (double)(long long)value) && !(value > (double)(long long)value);
+}
+
+// integers are folded as the other constants, the other numbers are kept as they are
+template <long long IntegerValue, bool IsInteger>
+static constexpr auto ExpressionTemplateNumberCreate(const double value)
+{
+    if constexpr (IsInteger)
+        return ExpressionTemplateConstType<IntegerValue>{};
+    else
+        return ExpressionTemplateNumberType{value};
+}
+
+template <typename T, long long Value>
+static constexpr bool ExpressionTemplateIsConstEqual()
+{
+    if constexpr (ExpressionTemplateIsConst<T>::value)
+        return T::value == Value;
+    else
+        return false;
+}
+
+//---------------------------------------------------------------------------------------
+
+// numbers are turned into ExpressionTemplateNumberType
+template <typename T, typename = std::enable_if_t<ExpressionTemplateIsExpression<T>::value>>
+static constexpr T ExpressionTemplateOperand(const T& operand)
+{
+    return operand;
+}
+
+static constexpr ExpressionTemplateNumberType ExpressionTemplateOperand(const double value)
+{
+    return ExpressionTemplateNumberType{value};
+}
+
+template <ExpressionOperationId Operation, typename Left, typename Right>
+static constexpr ExpressionTemplateOperationType<Operation, Left, Right>
+ExpressionTemplateOperationCreate(const Left& left, const Right& right)
+{
+    return ExpressionTemplateOperationType<Operation, Left, Right>{left, right};
+}
+
+#define EXPRESSION_TEMPLATE_UNARY_CREATE(OPERATION, ARG)                            \
+    ExpressionTemplateOperationCreate<ExpressionOperationId::OPERATION>             \
+                (ExpressionTemplateOperand(ARG), ExpressionTemplateNoneType{})
+
+#define EXPRESSION_TEMPLATE_BINARY_CREATE(OPERATION, LEFT, RIGHT)                   \
+    ExpressionTemplateOperationCreate<ExpressionOperationId::OPERATION>             \
+                (ExpressionTemplateOperand(LEFT), ExpressionTemplateOperand(RIGHT))
+
+//---------------------------------------------------------------------------------------
+
+template <typename Left, typename Right>
+static constexpr auto ExpressionTemplateAdd(const Left& left, const Right& right)
+{
+    typedef decltype(ExpressionTemplateOperand(left))  LeftType;
+    typedef decltype(ExpressionTemplateOperand(right)) RightType;
+
+    if constexpr (ExpressionTemplateIsConst<LeftType>::value &&
+                  ExpressionTemplateIsConst<RightType>::value)
+        return ExpressionTemplateConstType<LeftType::value + RightType::value>{};
+    else if constexpr (ExpressionTemplateIsConstEqual<LeftType, 0>())
+        return ExpressionTemplateOperand(right);
+    else if constexpr (ExpressionTemplateIsConstEqual<RightType, 0>())
+        return ExpressionTemplateOperand(left);
+    else
+        return EXPRESSION_TEMPLATE_BINARY_CREATE(ADD, left, right);
+}
+
+template <typename Arg>
+static constexpr auto ExpressionTemplateNeg(const Arg& arg)
+{
+    typedef decltype(ExpressionTemplateOperand(arg)) ArgType;
+
+    if constexpr (ExpressionTemplateIsConst<ArgType>::value)
+        return ExpressionTemplateConstType<-ArgType::value>{};
+    else
+        return EXPRESSION_TEMPLATE_UNARY_CREATE(UNARY_SUB, arg);
+}
+
+template <typename Left, typename Right>
+static constexpr auto ExpressionTemplateSub(const Left& left, const Right& right)
+{
+    typedef decltype(ExpressionTemplateOperand(left))  LeftType;
+    typedef decltype(ExpressionTemplateOperand(right)) RightType;
+
+    if constexpr (ExpressionTemplateIsConst<LeftType>::value &&
+                  ExpressionTemplateIsConst<RightType>::value)
+        return ExpressionTemplateConstType<LeftType::value - RightType::value>{};
+    else if constexpr (ExpressionTemplateIsConstEqual<RightType, 0>())
+        return ExpressionTemplateOperand(left);
+    else if constexpr (ExpressionTemplateIsConstEqual<LeftType, 0>())
+        return ExpressionTemplateNeg(right);
+    else
+        return EXPRESSION_TEMPLATE_BINARY_CREATE(SUB, left, right);
+}
+
+template <typename Left, typename Right>
+static constexpr auto ExpressionTemplateMul(const Left& left, const Right& right)
+{
+    typedef decltype(ExpressionTemplateOperand(left))  LeftType;
+    typedef decltype(ExpressionTemplateOperand(right)) RightType;
+
+    if constexpr (ExpressionTemplateIsConst<LeftType>::value &&
+                  ExpressionTemplateIsConst<RightType>::value)
+        return ExpressionTemplateConstType<LeftType::value * RightType::value>{};
+    else if constexpr (ExpressionTemplateIsConstEqual<LeftType,  0>() ||
+                       ExpressionTemplateIsConstEqual<RightType, 0>())
+        return ExpressionTemplateZeroType{};
+    else if constexpr (ExpressionTemplateIsConstEqual<LeftType, 1>())
+        return ExpressionTemplateOperand(right);
+    else if constexpr (ExpressionTemplateIsConstEqual<RightType, 1>())
+        return ExpressionTemplateOperand(left);
+    else
+        return EXPRESSION_TEMPLATE_BINARY_CREATE(MUL, left, right);
+}
+
+template <typename Left, typename Right>
+static constexpr auto ExpressionTemplateDiv(const Left& left, const Right& right)
+{
+    typedef decltype(ExpressionTemplateOperand(left))  LeftType;
+    typedef decltype(ExpressionTemplateOperand(right)) RightType;
+
+    static_assert(!ExpressionTemplateIsConstEqual<RightType, 0>(), "division by zero");
+
+    if constexpr (ExpressionTemplateIsConstEqual<LeftType, 0>())
+        return ExpressionTemplateZeroType{};
+    else if constexpr (ExpressionTemplateIsConstEqual<RightType, 1>())
+        return ExpressionTemplateOperand(left);
+    else if constexpr (ExpressionTemplateIsConst<LeftType>::value &&
+                       ExpressionTemplateIsConst<RightType>::value)
+    {
+        // fraction stays as it is, it can't be a type
+        if constexpr (LeftType::value % RightType::value == 0)
+            return ExpressionTemplateConstType<LeftType::value / RightType::value>{};
+        else
+            return EXPRESSION_TEMPLATE_BINARY_CREATE(DIV, left, right);
+    }
+    else
+        return EXPRESSION_TEMPLATE_BINARY_CREATE(DIV, left, right);
+}
+
+template <typename Left, typename Right>
+static constexpr auto ExpressionTemplatePow(const Left& left, const Right& right)
+{
+    typedef decltype(ExpressionTemplateOperand(right)) RightType;
+
+    if constexpr (ExpressionTemplateIsConstEqual<RightType, 0>())
+        return ExpressionTemplateOneType{};
+    else if constexpr (ExpressionTemplateIsConstEqual<RightType, 1>())
+        return ExpressionTemplateOperand(left);
+    else
+        return EXPRESSION_TEMPLATE_BINARY_CREATE(POW, left, right);
+}
+
+// logarithm of arg with the base, as LOG token: base is the left son
+template <typename Base, typename Arg>
+static constexpr auto ExpressionTemplateLog(const Base& base, const Arg& arg)
+{
+    return EXPRESSION_TEMPLATE_BINARY_CREATE(LOG, base, arg);
+}
+
+#define EXPRESSION_TEMPLATE_UNARY_FUNC(NAME, OPERATION)                             \
+    template <typename Arg>                                                         \
+    static constexpr auto ExpressionTemplate##NAME(const Arg& arg)                  \
+    {                                                                               \
+        return EXPRESSION_TEMPLATE_UNARY_CREATE(OPERATION, arg);                    \
+    }
+
+EXPRESSION_TEMPLATE_UNARY_FUNC(Ln,     LN)
+EXPRESSION_TEMPLATE_UNARY_FUNC(Sin,    SIN)
+EXPRESSION_TEMPLATE_UNARY_FUNC(Cos,    COS)
+EXPRESSION_TEMPLATE_UNARY_FUNC(Tan,    TAN)
+EXPRESSION_TEMPLATE_UNARY_FUNC(Cot,    COT)
+EXPRESSION_TEMPLATE_UNARY_FUNC(Arcsin, ARCSIN)
+EXPRESSION_TEMPLATE_UNARY_FUNC(Arccos, ARCCOS)
+EXPRESSION_TEMPLATE_UNARY_FUNC(Arctan, ARCTAN)
+EXPRESSION_TEMPLATE_UNARY_FUNC(Arccot, ARCCOT)
+
+#undef EXPRESSION_TEMPLATE_UNARY_FUNC
+
+//---------------------------------------------------------------------------------------
+
+// operators are used if at least one of the operands is an expression
+#define EXPRESSION_TEMPLATE_OPERATOR(OPERATOR, BUILDER)                                     \
+    template <typename Left, typename Right,                                                \
+              typename = std::enable_if_t<ExpressionTemplateIsExpression<Left>::value ||    \
+                                          ExpressionTemplateIsExpression<Right>::value>>    \
+    static constexpr auto operator OPERATOR(const Left& left, const Right& right)           \
+    {                                                                                       \
+        return BUILDER(left, right);                                                        \
+    }
+
+EXPRESSION_TEMPLATE_OPERATOR(+, ExpressionTemplateAdd)
+EXPRESSION_TEMPLATE_OPERATOR(-, ExpressionTemplateSub)
+EXPRESSION_TEMPLATE_OPERATOR(*, ExpressionTemplateMul)
+EXPRESSION_TEMPLATE_OPERATOR(/, ExpressionTemplateDiv)
+
+#undef EXPRESSION_TEMPLATE_OPERATOR
+
+template <typename Arg, typename = std::enable_if_t<ExpressionTemplateIsExpression<Arg>::value>>
+static constexpr auto operator -(const Arg& arg)
+{
+    return ExpressionTemplateNeg(arg);
+}
+
+//---------------------------------------------------------------------------------------
+
+template <long long Value, size_t Index>
+static constexpr ExpressionTemplateZeroType
+ExpressionTemplateDiff(const ExpressionTemplateConstType<Value>&,
+                       const ExpressionTemplateVariableType<Index>&)
+{
+    return ExpressionTemplateZeroType{};
+}
+
+template <size_t Index>
+static constexpr ExpressionTemplateZeroType
+ExpressionTemplateDiff(const ExpressionTemplateNumberType&,
+                       const ExpressionTemplateVariableType<Index>&)
+{
+    return ExpressionTemplateZeroType{};
+}
+
+template <size_t VariableIndex, size_t Index>
+static constexpr ExpressionTemplateConstType<VariableIndex == Index>
+ExpressionTemplateDiff(const ExpressionTemplateVariableType<VariableIndex>&,
+                       const ExpressionTemplateVariableType<Index>&)
+{
+    return ExpressionTemplateConstType<VariableIndex == Index>{};
+}
+
+// DIFF_CODE of Operations.h is compiled for the types: builders are used instead of token
+// functions, D() is ExpressionTemplateDiff of the son, C() is the son itself
+// and branches on variables in the sons are taken at compile time
+template <ExpressionOperationId Operation, typename Left, typename Right, size_t Index>
+static constexpr auto
+ExpressionTemplateDiff(const ExpressionTemplateOperationType<Operation, Left, Right>& expression,
+                       const ExpressionTemplateVariableType<Index>& variable)
+{
+    const ExpressionTemplateOperationType<Operation, Left, Right>* token = &expression;
+
+    #define D(SON) ExpressionTemplateDiff(SON, variable)
+    #define C(SON) SON
+
+    #define CRT_NUM(VALUE)                                                              \
+        ExpressionTemplateNumberCreate<(long long)(VALUE),                              \
+                                       ExpressionTemplateIsInteger(VALUE)>(VALUE)
+
+    #define DIFF_CHECK(NAME)
+    #define DIFF_IF(CONDITION) if constexpr (CONDITION)
+    #define CONTAIN_VAR(SON)                                                            \
+        ExpressionTemplateContainVariable<std::decay_t<decltype(SON)>, Index>::value
+
+    #define _ADD       ExpressionTemplateAdd
+    #define _SUB       ExpressionTemplateSub
+    #define _UNARY_SUB ExpressionTemplateNeg
+    #define _MUL       ExpressionTemplateMul
+    #define _DIV       ExpressionTemplateDiv
+    #define _POW       ExpressionTemplatePow
+    #define _LOG       ExpressionTemplateLog
+    #define _LN        ExpressionTemplateLn
+    #define _SIN       ExpressionTemplateSin
+    #define _COS       ExpressionTemplateCos
+    #define _TAN       ExpressionTemplateTan
+    #define _COT       ExpressionTemplateCot
+    #define _ARCSIN    ExpressionTemplateArcsin
+    #define _ARCCOS    ExpressionTemplateArccos
+    #define _ARCTAN    ExpressionTemplateArctan
+    #define _ARCCOT    ExpressionTemplateArccot
+
+    #define GENERATE_OPERATION_CMD(NAME, v1, v2, v3, v4, v5, v6, v7, v8, DIFF_CODE, ...)   \
+        if constexpr (Operation == ExpressionOperationId::NAME)                             \
+            DIFF_CODE                                                                       \
+        else
+
+    #include "Operations.h"
+    {
+        static_assert(Operation != Operation, "unknown operation");
+    }
+
+    #undef GENERATE_OPERATION_CMD
+
+    #undef _ADD
+    #undef _SUB
+    #undef _UNARY_SUB
+    #undef _MUL
+    #undef _DIV
+    #undef _POW
+    #undef _LOG
+    #undef _LN
+    #undef _SIN
+    #undef _COS
+    #undef _TAN
+    #undef _COT
+    #undef _ARCSIN
+    #undef _ARCCOS
+    #undef _ARCTAN
+    #undef _ARCCOT
+
+    #undef CRT_NUM
+    #undef D
+    #undef C
+}
+
+//---------------------------------------------------------------------------------------
+
+template <ExpressionOperationId Operation>
+static inline double ExpressionTemplateOperationCalculate(const double val1, const double val2)
+{
+    #define GENERATE_OPERATION_CMD(NAME, v1, v2, v3, v4, v5, v6, v7, CALCULATE_CODE, ...)   \
+        if constexpr (Operation == ExpressionOperationId::NAME)                             \
+            CALCULATE_CODE                                                                  \
+        else
+
+    #include "Operations.h"
+    {
+        static_assert(Operation != Operation, "unknown operation");
+    }
+
+    #undef GENERATE_OPERATION_CMD
+}
+
+template <long long Value>
+static inline double ExpressionTemplateCalculate(const ExpressionTemplateConstType<Value>&,
+                                                 const double*)
+{
+    return static_cast<double>(Value);
+}
+
+static inline double ExpressionTemplateCalculate(const ExpressionTemplateNumberType& number,
+                                                 const double*)
+{
+    return number.value;
+}
+
+template <size_t Index>
+static inline double ExpressionTemplateCalculate(const ExpressionTemplateVariableType<Index>&,
+                                                 const double* variables)
+{
+    assert(variables);
+
+    return variables[Index];
+}
+
+// variables[i] - value of ExpressionTemplateVariableType<i>
+template <ExpressionOperationId Operation, typename Left, typename Right>
+static inline double
+ExpressionTemplateCalculate(const ExpressionTemplateOperationType<Operation, Left, Right>& expression,
+                            const double* variables)
+{
+    double val1 = ExpressionTemplateCalculate(expression.left, variables);
+    double val2 = 0;
+
+    if constexpr (!std::is_same<Right, ExpressionTemplateNoneType>::value)
+        val2 = ExpressionTemplateCalculate(expression.right, variables);
+
+    return ExpressionTemplateOperationCalculate<Operation>(val1, val2);
+}
+
+#undef EXPRESSION_TEMPLATE_UNARY_CREATE
+#undef EXPRESSION_TEMPLATE_BINARY_CREATE
+
+#endif
@@ -4,6 +4,7 @@
 
 #include "MathExpressionTexDump.h"
 #include "FastInput/InputOutput.h"
+#include "Vector/HashFuncs.h"
 
 static bool        ExpressionOperationIsPrefix          (const ExpressionOperationId operation);
 static bool        ExpressionOperationNeedTexRightBraces(const ExpressionOperationId operation);
@@ -15,15 +16,47 @@ static LatexReplacementType* ExpressionLatexFindReplacement(const LatexReplaceme
 static LatexReplacementType* ExpressionLatexAddReplacement(LatexReplacementArrType* arr,
                                                            const ExpressionTokenType* token);
 static char* ExpressionLatexReplacementCreateName();
-static size_t ExpressionLatexGetLen(ExpressionOperationId operation, const size_t leftSz, 
-                                                                     const size_t rightSz);
+
+static size_t* ExpressionLatexReplacementTableFind(const LatexReplacementArrType* arr,
+                                                   const ExpressionTokenType* token);
+static bool    ExpressionLatexReplacementTableRehash(LatexReplacementArrType* arr,
+                                                     const size_t newCapacity);
+static void    ExpressionLatexReplacementTableErase (LatexReplacementArrType* arr, size_t* slot);
+
+static inline bool ExpressionLatexTokenIsLong(const ExpressionTokenType* token);
+static bool ExpressionLatexTokenNeedReplacement(const LatexReplacementArrType* arr,
+                                                const ExpressionTokenType* token);
+
+static ExpressionErrors ExpressionTokenPrintTexExpanded(const ExpressionTokenType* token,
+                                                        OutputBufferType* outBuffer,
+                                                        LatexReplacementArrType* replacementArr);
+
+static OutputBufferType* ExpressionTexBufferAcquire(FILE* outStream);
+static ExpressionErrors  ExpressionTexBufferRelease(OutputBufferType* outBuffer, 
+                                                    ExpressionErrors err);
+
+static bool  ExpressionTraceRenderStep(const ExpressionTokenType* prevToken,
+                                       const ExpressionTokenType* newToken,
+                                       const char* string, const size_t maxLength);
+static void  ExpressionTraceEmit      (const char* text, const size_t length);
+static void  ExpressionTraceTopPush   (const ExpressionTokenType* prevToken,
+                                       const ExpressionTokenType* newToken,
+                                       const char* string, const size_t size);
+static int   ExpressionTraceStepsCmp  (const void* first, const void* second);
 
 static bool HaveToPutBrackets(const ExpressionTokenType* parent, 
                               const ExpressionTokenType* son,
                               const LatexReplacementArrType* arr);
 
 static void ExpressionTokenPrintValue   (const ExpressionTokenType* token, 
-                                         FILE* outStream);
+                                         OutputBufferType* outBuffer);
+static inline void ExpressionTexPutWord (OutputBufferType* outBuffer, const char* word);
+
+// tex output is built in memory and written to the stream with big blocks
+static const size_t TexBufferFlushSize = 1 << 16;
+static const int    TexValuePrecision  = 6;
+
+static OutputBufferType TexBuffer = {};
 
 ExpressionErrors ExpressionPrintTex(const ExpressionType* expression,
                                     FILE* outStream,
@@ -46,6 +79,26 @@ ExpressionErrors ExpressionTokenPrintTexWithTrollString(
     assert(rootToken);
     assert(outStream);
 
+    OutputBufferType* outBuffer = ExpressionTexBufferAcquire(outStream);
+
+    if (outBuffer == nullptr)
+        return ExpressionErrors::MEM_ERR;
+
+    ExpressionErrors err = ExpressionTokenPrintTexWithTrollString(rootToken, outBuffer, string,
+                                                                  replacementArr);
+
+    return ExpressionTexBufferRelease(outBuffer, err);
+}
+
+ExpressionErrors ExpressionTokenPrintTexWithTrollString(
+                                                const ExpressionTokenType* rootToken,
+                                                OutputBufferType* outBuffer,
+                                                const char* string,
+                                                LatexReplacementArrType* replacementArr)
+{
+    assert(rootToken);
+    assert(outBuffer);
+
     static const char* roflStrings[] = 
     {
         "Kind of obvious expression transformation. ",
@@ -68,55 +121,95 @@ ExpressionErrors ExpressionTokenPrintTexWithTrollString(
     static const size_t numberOfRoflStrings = sizeof(roflStrings) / sizeof(*roflStrings);
 
     if (string == nullptr)
-        fprintf(outStream, "%s It is:\n", roflStrings[rand() % numberOfRoflStrings]);
+    {
+        OutputBufferPutString(outBuffer, roflStrings[rand() % numberOfRoflStrings]);
+        OutputBufferPutString(outBuffer, " It is:\n");
+    }
     else
-        fprintf(outStream, "%s\n", string);
-    
-
-    size_t prevArrSize = 0;
-    if (replacementArr)
     {
-        prevArrSize = replacementArr->size;
-        ExpressionLatexReplacementArrayInit(rootToken, replacementArr);
+        OutputBufferPutString(outBuffer, string);
+        OutputBufferPutChar  (outBuffer, '\n');
     }
 
-    fprintf(outStream, "\\begin{gather}\n");
+    size_t prevArrSize = replacementArr ? replacementArr->replacements.size : 0;
 
-    ExpressionErrors err = ExpressionTokenPrintTex(rootToken, outStream, replacementArr);
+    OutputBufferPutString(outBuffer, "\\begin{gather}\n");
 
-    fprintf(outStream, "\n\\end{gather}\n");
+    ExpressionErrors err = ExpressionTokenPrintTex(rootToken, outBuffer, replacementArr);
 
-    if (replacementArr && prevArrSize < replacementArr->size)
+    OutputBufferPutString(outBuffer, "\n\\end{gather}\n");
+
+    if (replacementArr && prevArrSize < replacementArr->replacements.size)
     {
-        fprintf(outStream, "Using these replacements: \n");
-        for (size_t i = prevArrSize; i < replacementArr->size; ++i)
+        OutputBufferPutString(outBuffer, "Using these replacements: \n");
+
+        //printing of replacement may add new replacements for its subexpressions
+        for (size_t i = prevArrSize; i < replacementArr->replacements.size; ++i)
         {
-            ExpressionLatexReplacementPrint(replacementArr, replacementArr->data[i].token, 
-                                                                                outStream);
+            ExpressionLatexReplacementPrint(replacementArr, replacementArr->replacements.data[i].token, 
+                                                                                outBuffer);
         }                                                                                
     }
 
+    if (err == ExpressionErrors::NO_ERR && outBuffer->failed)
+        err = ExpressionErrors::MEM_ERR;
+
     return err;
 }
 
 ExpressionErrors ExpressionTokenPrintTex(const ExpressionTokenType* token, 
                                          FILE* outStream,
-                                         const LatexReplacementArrType* replacementArr)
+                                         LatexReplacementArrType* replacementArr)
 {
     assert(token);
     assert(outStream);
 
-    if (token->left == nullptr && token->right == nullptr)
+    OutputBufferType* outBuffer = ExpressionTexBufferAcquire(outStream);
+
+    if (outBuffer == nullptr)
+        return ExpressionErrors::MEM_ERR;
+
+    ExpressionErrors err = ExpressionTokenPrintTex(token, outBuffer, replacementArr);
+
+    return ExpressionTexBufferRelease(outBuffer, err);
+}
+
+ExpressionErrors ExpressionTokenPrintTex(const ExpressionTokenType* token, 
+                                         OutputBufferType* outBuffer,
+                                         LatexReplacementArrType* replacementArr)
+{
+    assert(token);
+    assert(outBuffer);
+
+    //the rest of the tree can't be printed anyway
+    if (outBuffer->failed)
+        return ExpressionErrors::MEM_ERR;
+
+    if (ExpressionLatexTokenNeedReplacement(replacementArr, token))
     {
-        ExpressionTokenPrintValue(token, outStream);
+        LatexReplacementType* replacement = ExpressionLatexAddReplacement(replacementArr, token);
 
-        return ExpressionErrors::NO_ERR;
+        if (replacement != nullptr)
+        {
+            OutputBufferPutString(outBuffer, replacement->replacementStr);
+            return ExpressionErrors::NO_ERR;
+        }
     }
 
-    LatexReplacementType* replacement = ExpressionLatexFindReplacement(replacementArr, token);
-    if (replacement != nullptr)
+    return ExpressionTokenPrintTexExpanded(token, outBuffer, replacementArr);
+}
+
+static ExpressionErrors ExpressionTokenPrintTexExpanded(const ExpressionTokenType* token,
+                                                        OutputBufferType* outBuffer,
+                                                        LatexReplacementArrType* replacementArr)
+{
+    assert(token);
+    assert(outBuffer);
+
+    if (token->left == nullptr && token->right == nullptr)
     {
-        fprintf(outStream, "%s", replacement->replacementStr);
+        ExpressionTokenPrintValue(token, outBuffer);
+
         return ExpressionErrors::NO_ERR;
     }
 
@@ -125,22 +218,22 @@ ExpressionErrors ExpressionTokenPrintTex(const ExpressionTokenType* token,
 
     bool isPrefixOperation = ExpressionOperationIsPrefix(token->value.operation);
 
-    if (isPrefixOperation) fprintf(outStream, "%s ", 
-                                    ExpressionOperationGetTexName(token->value.operation));
+    if (isPrefixOperation) 
+        ExpressionTexPutWord(outBuffer, ExpressionOperationGetTexName(token->value.operation));
 
     bool needLeftBrackets  = HaveToPutBrackets(token, token->left, replacementArr);
     bool needTexLeftBraces = ExpressionOperationNeedTexLeftBraces(token->value.operation);
 
-    if (needTexLeftBraces)                      fprintf(outStream, "{");
-    if (!needTexLeftBraces && needLeftBrackets) fprintf(outStream, "(");
+    if (needTexLeftBraces)                      OutputBufferPutChar(outBuffer, '{');
+    if (!needTexLeftBraces && needLeftBrackets) OutputBufferPutChar(outBuffer, '(');
 
-    err = ExpressionTokenPrintTex(token->left, outStream, replacementArr);
+    err = ExpressionTokenPrintTex(token->left, outBuffer, replacementArr);
 
-    if (!needTexLeftBraces && needLeftBrackets) fprintf(outStream, ")");
-    if (needTexLeftBraces)                      fprintf(outStream, "}");
+    if (!needTexLeftBraces && needLeftBrackets) OutputBufferPutChar(outBuffer, ')');
+    if (needTexLeftBraces)                      OutputBufferPutChar(outBuffer, '}');
 
-    if (!isPrefixOperation) fprintf(outStream, "%s ", 
-                                    ExpressionOperationGetTexName(token->value.operation));
+    if (!isPrefixOperation) 
+        ExpressionTexPutWord(outBuffer, ExpressionOperationGetTexName(token->value.operation));
 
     if (ExpressionOperationIsUnary(token->value.operation))
         return err;
@@ -148,13 +241,13 @@ ExpressionErrors ExpressionTokenPrintTex(const ExpressionTokenType* token,
     bool needTexRightBraces = ExpressionOperationNeedTexRightBraces(token->value.operation);
     bool needRightBrackets  = HaveToPutBrackets(token, token->right, replacementArr);
     
-    if (needTexRightBraces)                       fprintf(outStream, "{");
-    if (!needTexRightBraces && needRightBrackets) fprintf(outStream, "(");
+    if (needTexRightBraces)                       OutputBufferPutChar(outBuffer, '{');
+    if (!needTexRightBraces && needRightBrackets) OutputBufferPutChar(outBuffer, '(');
 
-    err = ExpressionTokenPrintTex(token->right, outStream, replacementArr);
+    err = ExpressionTokenPrintTex(token->right, outBuffer, replacementArr);
 
-    if (!needTexRightBraces && needRightBrackets) fprintf(outStream, ")");
-    if (needTexRightBraces)                       fprintf(outStream, "}");
+    if (!needTexRightBraces && needRightBrackets) OutputBufferPutChar(outBuffer, ')');
+    if (needTexRightBraces)                       OutputBufferPutChar(outBuffer, '}');
 
     return err;   
 }
@@ -219,22 +312,32 @@ static bool ExpressionOperationNeedTexLeftBraces(const ExpressionOperationId ope
     return false;
 }
 
-static void ExpressionTokenPrintValue(const ExpressionTokenType* token, FILE* outStream)
+static inline void ExpressionTexPutWord(OutputBufferType* outBuffer, const char* word)
+{
+    assert(outBuffer);
+    assert(word);
+
+    OutputBufferPutString(outBuffer, word);
+    OutputBufferPutChar  (outBuffer, ' ');
+}
+
+static void ExpressionTokenPrintValue(const ExpressionTokenType* token, OutputBufferType* outBuffer)
 {
     assert(token->valueType != ExpressionTokenValueTypeof::OPERATION);
 
     switch (token->valueType)
     {
         case ExpressionTokenValueTypeof::VALUE:
-            fprintf(outStream, "%lg ", token->value.value);
+            OutputBufferPutDouble(outBuffer, token->value.value, TexValuePrecision);
+            OutputBufferPutChar  (outBuffer, ' ');
             break;
         
         case ExpressionTokenValueTypeof::VARIABLE:
-            fprintf(outStream, "%s ", token->value.varPtr->variableName);
+            ExpressionTexPutWord(outBuffer, token->value.varPtr->variableName);
             break;
         
         case ExpressionTokenValueTypeof::OPERATION:
-            fprintf(outStream, "%s ", ExpressionOperationGetTexName(token->value.operation));
+            ExpressionTexPutWord(outBuffer, ExpressionOperationGetTexName(token->value.operation));
             break;
         
         default:
@@ -253,7 +356,7 @@ static bool HaveToPutBrackets(const ExpressionTokenType* parent,
     if (son->valueType != ExpressionTokenValueTypeof::OPERATION)
         return false;
 
-    if (ExpressionLatexFindReplacement(arr, son) != nullptr)
+    if (ExpressionLatexTokenNeedReplacement(arr, son))
         return false;
 
     ExpressionOperationId parentOperation = parent->value.operation;
@@ -308,6 +411,45 @@ static bool ExpressionOperationIsPrefix(const ExpressionOperationId operation)
     return false;
 }
 
+//---------------------------------------------------------------------------------------
+
+static OutputBufferType* ExpressionTexBufferAcquire(FILE* outStream)
+{
+    assert(outStream);
+    assert(TexBuffer.sink == nullptr);
+
+    if (TexBuffer.data == nullptr)
+    {
+        if (!OutputBufferCtor(&TexBuffer, outStream, TexBufferFlushSize))
+            return nullptr;
+
+        return &TexBuffer;
+    }
+
+    OutputBufferClear(&TexBuffer);
+
+    TexBuffer.sink      = outStream;
+    TexBuffer.flushSize = TexBufferFlushSize;
+    TexBuffer.failed    = false;
+
+    return &TexBuffer;
+}
+
+static ExpressionErrors ExpressionTexBufferRelease(OutputBufferType* outBuffer, 
+                                                   ExpressionErrors err)
+{
+    assert(outBuffer);
+
+    if (!OutputBufferFlush(outBuffer) && err == ExpressionErrors::NO_ERR)
+        err = ExpressionErrors::MEM_ERR;
+
+    outBuffer->sink = nullptr;
+
+    return err;
+}
+
+//---------------------------------------------------------------------------------------
+
 void LaTexInsertImg(const char* imgName, FILE* outStream, const char* string)
 {
     assert(imgName);
@@ -379,16 +521,15 @@ static LatexReplacementType* ExpressionLatexFindReplacement(const LatexReplaceme
 {
     assert(token);
 
-    if (arr == nullptr)
+    if (arr == nullptr || arr->replacements.size == 0)
         return nullptr;
 
-    for (size_t i = 0; i < arr->size; ++i)
-    {
-        if (arr->data[i].token == token)
-            return arr->data + i;
-    }
+    size_t* slot = ExpressionLatexReplacementTableFind(arr, token);
+
+    if (*slot == 0)
+        return nullptr;
     
-    return nullptr;
+    return arr->replacements.data + *slot - 1;
 }
 
 static LatexReplacementType* ExpressionLatexAddReplacement(LatexReplacementArrType* arr,
@@ -396,24 +537,134 @@ static LatexReplacementType* ExpressionLatexAddReplacement(LatexReplacementArrTy
 {
     assert(token);
 
-    if (arr == nullptr)
+    if (arr == nullptr || arr->table == nullptr)
         return nullptr;
 
-    if (arr->size >= arr->capacity)
-        return nullptr;
+    size_t* slot = ExpressionLatexReplacementTableFind(arr, token);
 
-    LatexReplacementType* replacement = ExpressionLatexFindReplacement(arr, token);
+    if (*slot != 0)
+        return arr->replacements.data + *slot - 1;
 
-    if (replacement != nullptr)
-        return replacement;
+    if (2 * (arr->replacements.size + 1) > arr->tableCapacity)
+    {
+        if (!ExpressionLatexReplacementTableRehash(arr, 2 * arr->tableCapacity))
+            return nullptr;
+
+        slot = ExpressionLatexReplacementTableFind(arr, token);
+    }
 
     char* replaceName = ExpressionLatexReplacementCreateName();
 
-    arr->data[arr->size].token       = token;
-    arr->data[arr->size].replacementStr = replaceName;
-    arr->size++;
+    if (VectorPush(&arr->replacements, {token, replaceName}) != VectorErrors::VECTOR_NO_ERR)
+    {
+        free(replaceName);
+        return nullptr;
+    }
+
+    *slot = arr->replacements.size;
     
-    return arr->data + arr->size - 1;
+    return arr->replacements.data + arr->replacements.size - 1;
+}
+
+void ExpressionLatexReplacementRemove(LatexReplacementArrType* arr,
+                                      const ExpressionTokenType* token,
+                                      const bool withSubtree)
+{
+    assert(arr);
+
+    if (token == nullptr || arr->replacements.size == 0)
+        return;
+
+    if (withSubtree)
+    {
+        ExpressionLatexReplacementRemove(arr, token->left,  true);
+        ExpressionLatexReplacementRemove(arr, token->right, true);
+    }
+
+    size_t* slot = ExpressionLatexReplacementTableFind(arr, token);
+
+    if (*slot == 0)
+        return;
+
+    size_t replacementId = *slot - 1;
+    free(arr->replacements.data[replacementId].replacementStr);
+
+    ExpressionLatexReplacementTableErase(arr, slot);
+
+    //the last replacement takes the place of the removed one
+    LatexReplacementType lastReplacement = {};
+    VectorPop(&arr->replacements, &lastReplacement);
+
+    if (replacementId == arr->replacements.size)
+        return;
+
+    arr->replacements.data[replacementId] = lastReplacement;
+    *ExpressionLatexReplacementTableFind(arr, arr->replacements.data[replacementId].token) = replacementId + 1;
+}
+
+static size_t* ExpressionLatexReplacementTableFind(const LatexReplacementArrType* arr,
+                                                   const ExpressionTokenType* token)
+{
+    assert(arr);
+    assert(arr->table);
+
+    size_t mask = arr->tableCapacity - 1;
+    size_t pos  = MurmurHash(&token, sizeof(token)) & mask;
+
+    while (arr->table[pos] != 0 && arr->replacements.data[arr->table[pos] - 1].token != token)
+        pos = (pos + 1) & mask;
+
+    return &arr->table[pos];
+}
+
+static bool ExpressionLatexReplacementTableRehash(LatexReplacementArrType* arr,
+                                                  const size_t newCapacity)
+{
+    assert(arr);
+
+    size_t* newTable = (size_t*) calloc(newCapacity, sizeof(*newTable));
+    if (newTable == nullptr)
+        return false;
+
+    free(arr->table);
+    arr->table         = newTable;
+    arr->tableCapacity = newCapacity;
+
+    for (size_t i = 0; i < arr->replacements.size; ++i)
+        *ExpressionLatexReplacementTableFind(arr, arr->replacements.data[i].token) = i + 1;
+
+    return true;
+}
+
+static void ExpressionLatexReplacementTableErase(LatexReplacementArrType* arr, size_t* slot)
+{
+    assert(arr);
+    assert(slot);
+
+    //backward shift deletion, so lookups don't need tombstones
+    size_t mask = arr->tableCapacity - 1;
+    size_t hole = (size_t)(slot - arr->table);
+    size_t pos  = hole;
+
+    while (true)
+    {
+        pos = (pos + 1) & mask;
+
+        if (arr->table[pos] == 0)
+            break;
+
+        const ExpressionTokenType* token = arr->replacements.data[arr->table[pos] - 1].token;
+        size_t home = MurmurHash(&token, sizeof(token)) & mask;
+
+        //entry can be moved to the hole only if the hole is between its home and pos
+        if (((pos - home) & mask) >= ((pos - hole) & mask))
+        {
+            arr->table[hole] = arr->table[pos];
+            hole = pos;
+        }
+    }
+
+    arr->table[hole] = 0;
 }
 
 static char* ExpressionLatexReplacementCreateName()
@@ -438,57 +689,96 @@ void ExpressionLatexReplacementArrayCtor(LatexReplacementArrType* arr, size_t ca
 {
     assert(arr);
 
-    arr->data     = (LatexReplacementType*) calloc(capacity, sizeof(*(arr->data)));
-    arr->capacity = capacity;
-    arr->size     = 0;
+    if (capacity == 0)
+        capacity = 1;
+
+    size_t tableCapacity = 1;
+    while (tableCapacity < 2 * capacity)
+        tableCapacity *= 2;
+
+    VectorErrors vectorErr = VectorCtor(&arr->replacements, capacity);
+
+    arr->table         = (size_t*) calloc(tableCapacity, sizeof(*(arr->table)));
+    arr->tableCapacity = tableCapacity;
+
+    if (vectorErr != VectorErrors::VECTOR_NO_ERR || arr->table == nullptr)
+    {
+        free(arr->table);
+
+        arr->table         = nullptr;
+        arr->tableCapacity = 0;
+    }
 }
 
 void ExpressionLatexReplacementArrayDtor(LatexReplacementArrType* arr)
 {
     assert(arr);
 
-    for (size_t i = 0; i < arr->size; ++i)
+    for (size_t i = 0; i < arr->replacements.size; ++i)
     {
-        if (arr->data[i].replacementStr)
+        if (arr->replacements.data[i].replacementStr)
         {
-            arr->data[i].token = nullptr;
-            free(arr->data[i].replacementStr);
+            arr->replacements.data[i].token = nullptr;
+            free(arr->replacements.data[i].replacementStr);
         }
     }
 
-    arr->capacity = 0;
-    arr->size     = 0;
-    free(arr->data);
+    VectorDtor(&arr->replacements);
+
+    arr->tableCapacity = 0;
+    free(arr->table);
+    arr->table         = nullptr;
 }
 
-size_t ExpressionLatexReplacementArrayInit(const ExpressionTokenType* token, 
-                                           LatexReplacementArrType* arr)
-{
-    assert(arr);
+static const size_t ExpressionLatexMaxTokenLen = 16;
 
+size_t ExpressionLatexTokenGetLen(const ExpressionTokenType* token)
+{
     if (token == nullptr)
         return 0;
 
-    static const size_t maxTokenSize = 16;
-    if (token->valueType == ExpressionTokenValueTypeof::VALUE)
-        return 1;
-    
-    if (token->valueType == ExpressionTokenValueTypeof::VARIABLE)
-        return strlen(token->value.varPtr->variableName);
-    
-    size_t leftSz  = ExpressionLatexReplacementArrayInit(token->left,  arr);
-    size_t rightSz = ExpressionLatexReplacementArrayInit(token->right, arr);
+    if (token->texLen != 0)
+        return token->texLen;
 
-    assert(token->valueType == ExpressionTokenValueTypeof::OPERATION);
-    size_t mySz = ExpressionLatexGetLen(token->value.operation, leftSz, rightSz);
-    
-    if (mySz >= maxTokenSize)
+    switch (token->valueType)
     {
-        ExpressionLatexAddReplacement(arr, token);
-        return 1;
+        case ExpressionTokenValueTypeof::VALUE:
+            token->texLen = 1;
+            break;
+
+        case ExpressionTokenValueTypeof::VARIABLE:
+            token->texLen = strlen(token->value.varPtr->variableName);
+            break;
+
+        case ExpressionTokenValueTypeof::OPERATION:
+        {
+            //too long subexpressions are printed as replacements of length 1
+            size_t leftSz  = ExpressionLatexTokenIsLong(token->left)  ? 
+                                            1 : ExpressionLatexTokenGetLen(token->left);
+            size_t rightSz = ExpressionLatexTokenIsLong(token->right) ? 
+                                            1 : ExpressionLatexTokenGetLen(token->right);
+
+            token->texLen = ExpressionLatexGetLen(token->value.operation, leftSz, rightSz);
+            break;
+        }
+
+        default:
+            break;
     }
 
-    return mySz;
+    return token->texLen;
+}
+
+static inline bool ExpressionLatexTokenIsLong(const ExpressionTokenType* token)
+{
+    return token != nullptr && token->valueType == ExpressionTokenValueTypeof::OPERATION &&
+           ExpressionLatexTokenGetLen(token) >= ExpressionLatexMaxTokenLen;
+}
+
+static bool ExpressionLatexTokenNeedReplacement(const LatexReplacementArrType* arr,
+                                                const ExpressionTokenType* token)
+{
+    return arr != nullptr && ExpressionLatexTokenIsLong(token);
 }
 
 static inline size_t max(const size_t leftSz, const size_t rightSz)
@@ -496,11 +786,11 @@ static inline size_t max(const size_t leftSz, const size_t rightSz)
     return leftSz > rightSz ? leftSz : rightSz;
 }
 
-static size_t ExpressionLatexGetLen(ExpressionOperationId operation, const size_t leftSz, 
-                                                                     const size_t rightSz)
+size_t ExpressionLatexGetLen(ExpressionOperationId operation, const size_t leftSz, 
+                                                              const size_t rightSz)
 {
     #define GENERATE_OPERATION_CMD(NAME, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11,  \
-                                   SUM_LENS_CODE)                                       \
+                                   SUM_LENS_CODE, ...)                                  \
             case ExpressionOperationId::NAME:                                           \
             {                                                                           \
                 SUM_LENS_CODE;                                                          \
@@ -525,12 +815,29 @@ ExpressionErrors ExpressionLatexReplacementPrint(LatexReplacementArrType* arr,
                                                  FILE* outStream)
 {
     assert(arr);
+    assert(outStream);
 
-    if (arr->size == 0)
-        return ExpressionErrors::NO_ERR;
+    OutputBufferType* outBuffer = ExpressionTexBufferAcquire(outStream);
+
+    if (outBuffer == nullptr)
+        return ExpressionErrors::MEM_ERR;
+
+    ExpressionErrors err = ExpressionLatexReplacementPrint(arr, token, outBuffer);
 
-    fprintf(outStream, "\\begin{gather*}\n");
+    return ExpressionTexBufferRelease(outBuffer, err);
+}
+
+ExpressionErrors ExpressionLatexReplacementPrint(LatexReplacementArrType* arr,
+                                                 const ExpressionTokenType* token,
+                                                 OutputBufferType* outBuffer)
+{
+    assert(arr);
+    assert(outBuffer);
+
+    if (arr->replacements.size == 0)
+        return ExpressionErrors::NO_ERR;
 
+    //token itself is printed expanded, its long subexpressions get their own replacements
     if (token != nullptr)
     {
         LatexReplacementType* replacement = ExpressionLatexFindReplacement(arr, token);
@@ -538,30 +845,364 @@ ExpressionErrors ExpressionLatexReplacementPrint(LatexReplacementArrType* arr,
         if (replacement == nullptr)
             return ExpressionErrors::NO_REPLACEMENT;
 
-        replacement->token = nullptr;
+        OutputBufferPutString(outBuffer, "\\begin{gather*}\n");
+        OutputBufferPutString(outBuffer, replacement->replacementStr);
+        OutputBufferPutString(outBuffer, " = ");
+        ExpressionTokenPrintTexExpanded(token, outBuffer, arr);
+        OutputBufferPutString(outBuffer, "\n\\end{gather*}\n");
 
-        fprintf(outStream, "%s = ", replacement->replacementStr);
-        ExpressionTokenPrintTex(token, outStream, arr);
-        fprintf(outStream, "\n\\end{gather*}\n");
+        return ExpressionErrors::NO_ERR;
+    }
 
-        replacement->token = token;
+    OutputBufferPutString(outBuffer, "\\begin{gather*}\n");
 
-        return ExpressionErrors::NO_ERR;
+    for (size_t i = 0; i < arr->replacements.size; ++i)
+    {
+        OutputBufferPutString(outBuffer, arr->replacements.data[i].replacementStr);
+        OutputBufferPutString(outBuffer, " = ");
+
+        ExpressionTokenPrintTexExpanded(arr->replacements.data[i].token, outBuffer, arr);
+        OutputBufferPutString(outBuffer, "\\\\\n");
     }
 
-    for (size_t i = 0; i < arr->size; ++i)
+    OutputBufferPutString(outBuffer, "\\end{gather*}\n");
+    return ExpressionErrors::NO_ERR;
+}
+
+//---------------------------------------------------------------------------------------
+
+struct ExpressionTraceStepType
+{
+    size_t id;
+    size_t size;
+
+    char*  text;
+    size_t length;
+};
+
+struct ExpressionTraceType
+{
+    ExpressionTraceParamsType params;
+
+    FILE* outTex;
+
+    // sizes of tokens on the recursion path, sizes[depth - 1] belongs to the current token
+    size_t* sizes;
+    size_t  depth;
+    size_t  sizesCapacity;
+
+    size_t stepsCount;
+    size_t omittedCount;
+    size_t bytesWritten;
+    bool   budgetExhausted;
+
+    // min-heap by size for TOP_K mode, steps are printed at the end of the trace
+    ExpressionTraceStepType* top;
+    size_t                   topSize;
+
+    // rendered text of the current step, reused between steps
+    OutputBufferType text;
+};
+
+static ExpressionTraceType Trace = 
+{
+    {ExpressionTraceMode::ALL, 0, 0, 1, 0},
+    nullptr, nullptr, 0, 0, 0, 0, 0, false, nullptr, 0, {}
+};
+
+//---------------------------------------------------------------------------------------
+
+void ExpressionTraceSetParams(const ExpressionTraceParamsType* params)
+{
+    assert(params);
+
+    Trace.params = *params;
+}
+
+void ExpressionTraceBegin(FILE* outTex)
+{
+    Trace.outTex          = outTex;
+    Trace.depth           = 0;
+    Trace.stepsCount      = 0;
+    Trace.omittedCount    = 0;
+    Trace.bytesWritten    = 0;
+    Trace.budgetExhausted = false;
+    Trace.topSize         = 0;
+
+    if (outTex && Trace.params.mode == ExpressionTraceMode::TOP_K && Trace.params.k > 0)
+        Trace.top = (ExpressionTraceStepType*) calloc(Trace.params.k, sizeof(*Trace.top));
+}
+
+void ExpressionTraceEnd()
+{
+    if (Trace.outTex == nullptr)
+        return;
+
+    if (Trace.top)
     {
-        fprintf(outStream, "%s = ", arr->data[i].replacementStr);
+        //steps are printed in the order they were made
+        qsort(Trace.top, Trace.topSize, sizeof(*Trace.top), ExpressionTraceStepsCmp);
 
-        const ExpressionTokenType* tmpToken = arr->data[i].token;
-        arr->data[i].token = nullptr;
+        for (size_t i = 0; i < Trace.topSize; ++i)
+        {
+            ExpressionTraceEmit(Trace.top[i].text, Trace.top[i].length);
+            free(Trace.top[i].text);
+        }
 
-        ExpressionTokenPrintTex(arr->data[i].token, outStream, arr);
-        fprintf(outStream, "\\\\\n");
+        free(Trace.top);
+        Trace.top     = nullptr;
+        Trace.topSize = 0;
+    }
+
+    if (Trace.omittedCount > 0)
+        fprintf(Trace.outTex, "%zu more steps are left to the reader as an exercise.\\\\\n", 
+                                                                        Trace.omittedCount);
+
+    OutputBufferDtor(&Trace.text);
+
+    free(Trace.sizes);
+    Trace.sizes         = nullptr;
+    Trace.sizesCapacity = 0;
+    Trace.depth         = 0;
+
+    Trace.outTex = nullptr;
+}
 
-        arr->data[i].token = tmpToken;
+//---------------------------------------------------------------------------------------
+
+void ExpressionTraceEnter()
+{
+    if (Trace.outTex == nullptr)
+        return;
+
+    if (Trace.depth == Trace.sizesCapacity)
+    {
+        size_t newCapacity = Trace.sizesCapacity == 0 ? 64 : 2 * Trace.sizesCapacity;
+        size_t* newSizes   = (size_t*) realloc(Trace.sizes, newCapacity * sizeof(*newSizes));
+
+        if (newSizes == nullptr)
+            return;
+
+        Trace.sizes         = newSizes;
+        Trace.sizesCapacity = newCapacity;
     }
 
-    fprintf(outStream, "\\end{gather}\n");
-    return ExpressionErrors::NO_ERR;
+    Trace.sizes[Trace.depth++] = 1;
+}
+
+size_t ExpressionTraceLeave()
+{
+    if (Trace.outTex == nullptr || Trace.depth == 0)
+        return 0;
+
+    size_t size = Trace.sizes[--Trace.depth];
+
+    if (Trace.depth > 0)
+        Trace.sizes[Trace.depth - 1] += size;
+
+    return size;
+}
+
+//---------------------------------------------------------------------------------------
+
+void ExpressionTraceStep(const ExpressionTokenType* prevToken,
+                         const ExpressionTokenType* newToken,
+                         const char* string,
+                         LatexReplacementArrType* replacementArr)
+{
+    assert(prevToken);
+    assert(newToken);
+
+    if (Trace.outTex == nullptr)
+        return;
+
+    Trace.stepsCount++;
+
+    size_t size  = Trace.depth > 0 ? Trace.sizes[Trace.depth - 1] : 1;
+    size_t depth = Trace.depth > 0 ? Trace.depth - 1 : 0;
+
+    const ExpressionTraceParamsType* params = &Trace.params;
+
+    bool needPrint = true;
+
+    switch (params->mode)
+    {
+        case ExpressionTraceMode::ALL:
+            if (params->maxBytes == 0)
+            {
+                //steps share replacements with the whole derivation as before
+                ExpressionTokenPrintTexWithTrollString(prevToken, Trace.outTex, string, 
+                                                                          replacementArr);
+                ExpressionTokenPrintTexWithTrollString(newToken,  Trace.outTex, nullptr, 
+                                                                          replacementArr);
+                return;
+            }
+            break;
+
+        case ExpressionTraceMode::TOP_K:
+            ExpressionTraceTopPush(prevToken, newToken, string, size);
+            return;
+
+        case ExpressionTraceMode::MAX_DEPTH:
+            needPrint = depth <= params->maxDepth;
+            break;
+
+        case ExpressionTraceMode::EVERY_N:
+            needPrint = params->n != 0 && Trace.stepsCount % params->n == 0;
+            break;
+
+        case ExpressionTraceMode::OFF:
+        default:
+            needPrint = false;
+            break;
+    }
+
+    if (!needPrint || Trace.budgetExhausted)
+    {
+        Trace.omittedCount++;
+        return;
+    }
+
+    //step that doesn't fit into the rest of the budget is not rendered till the end
+    size_t maxLength = params->maxBytes == 0 ? 0 : params->maxBytes - Trace.bytesWritten;
+
+    if (!ExpressionTraceRenderStep(prevToken, newToken, string, maxLength))
+    {
+        Trace.budgetExhausted = params->maxBytes != 0;
+        Trace.omittedCount++;
+        return;
+    }
+
+    ExpressionTraceEmit(Trace.text.data, Trace.text.size);
+}
+
+//---------------------------------------------------------------------------------------
+
+// renders step to Trace.text with its own replacements, so it can be dropped without breaking others,
+// rendering stops as soon as the text is longer than maxLength, 0 - unlimited
+static bool ExpressionTraceRenderStep(const ExpressionTokenType* prevToken,
+                                      const ExpressionTokenType* newToken,
+                                      const char* string, const size_t maxLength)
+{
+    assert(prevToken);
+    assert(newToken);
+
+    if (Trace.text.data == nullptr && !OutputBufferCtor(&Trace.text))
+        return false;
+
+    OutputBufferClear(&Trace.text);
+    Trace.text.failed  = false;
+    Trace.text.maxSize = maxLength;
+
+    LatexReplacementArrType stepArr = {};
+    ExpressionLatexReplacementArrayCtor(&stepArr);
+
+    ExpressionTokenPrintTexWithTrollString(prevToken, &Trace.text, string,  &stepArr);
+    ExpressionTokenPrintTexWithTrollString(newToken,  &Trace.text, nullptr, &stepArr);
+
+    ExpressionLatexReplacementArrayDtor(&stepArr);
+
+    return !Trace.text.failed;
+}
+
+static void ExpressionTraceEmit(const char* text, const size_t length)
+{
+    assert(text);
+
+    if (Trace.params.maxBytes != 0 && 
+        (Trace.budgetExhausted || Trace.bytesWritten + length > Trace.params.maxBytes))
+    {
+        Trace.budgetExhausted = true;
+        Trace.omittedCount++;
+        return;
+    }
+
+    fwrite(text, sizeof(*text), length, Trace.outTex);
+    Trace.bytesWritten += length;
+}
+
+//---------------------------------------------------------------------------------------
+
+// step is rendered only if it gets into the heap, steps longer than the budget can't be printed,
+// so rendering of each step is bounded by maxBytes
+static void ExpressionTraceTopPush(const ExpressionTokenType* prevToken,
+                                   const ExpressionTokenType* newToken,
+                                   const char* string, const size_t size)
+{
+    assert(prevToken);
+    assert(newToken);
+
+    ExpressionTraceStepType* top = Trace.top;
+    size_t k = Trace.params.k;
+
+    if (top == nullptr || (Trace.topSize == k && size <= top[0].size))
+    {
+        Trace.omittedCount++;
+        return;
+    }
+
+    if (!ExpressionTraceRenderStep(prevToken, newToken, string, Trace.params.maxBytes))
+    {
+        Trace.omittedCount++;
+        return;
+    }
+
+    ExpressionTraceStepType step = {Trace.stepsCount, size, nullptr, Trace.text.size};
+
+    step.text = (char*) calloc(step.length + 1, sizeof(*step.text));
+    if (step.text == nullptr)
+    {
+        Trace.omittedCount++;
+        return;
+    }
+
+    memcpy(step.text, Trace.text.data, step.length);
+
+    size_t pos = 0;
+
+    if (Trace.topSize < k)
+    {
+        pos = Trace.topSize++;
+
+        while (pos > 0 && top[(pos - 1) / 2].size > step.size)
+        {
+            top[pos] = top[(pos - 1) / 2];
+            pos = (pos - 1) / 2;
+        }
+
+        top[pos] = step;
+        return;
+    }
+
+    free(top[0].text);
+    Trace.omittedCount++;
+
+    while (true)
+    {
+        size_t child = 2 * pos + 1;
+        if (child >= Trace.topSize)
+            break;
+
+        if (child + 1 < Trace.topSize && top[child + 1].size < top[child].size)
+            child++;
+
+        if (top[child].size >= step.size)
+            break;
+
+        top[pos] = top[child];
+        pos = child;
+    }
+
+    top[pos] = step;
+}
+
+static int ExpressionTraceStepsCmp(const void* first, const void* second)
+{
+    assert(first);
+    assert(second);
+
+    size_t firstId  = ((const ExpressionTraceStepType*)first)->id;
+    size_t secondId = ((const ExpressionTraceStepType*)second)->id;
+
+    return (firstId > secondId) - (firstId < secondId);
 }
@@ -2,6 +2,8 @@
 #define MATH_EXPRESSION_TEX_DUMP
 
 #include "MathExpressionsMain.h"
+#include "Common/OutputBuffer.h"
+#include "Vector/Vector.h"
 
 struct ExpressionLatexReplacementType
 {
@@ -11,16 +13,40 @@ struct ExpressionLatexReplacementType
 
 typedef ExpressionLatexReplacementType LatexReplacementType;
 
+// replacements of one formula are few, so they usually stay in the inline storage
+static const size_t LATEX_REPLACEMENTS_INLINE_CAPACITY = 16;
+
 struct ExpressionLatexReplacementArrayType
 {
-    LatexReplacementType* data;
+    VectorType<LatexReplacementType, LATEX_REPLACEMENTS_INLINE_CAPACITY> replacements;
 
-    size_t size;
-    size_t capacity;
+    // open addressing table of data indexes + 1 keyed by token pointer, 0 - empty slot
+    size_t* table;
+    size_t  tableCapacity;
 };
 
 typedef ExpressionLatexReplacementArrayType LatexReplacementArrType;
 
+enum class ExpressionTraceMode
+{
+    ALL,            // every step
+    OFF,            // no steps
+    TOP_K,          // k steps with the largest expressions
+    MAX_DEPTH,      // steps for tokens not deeper than maxDepth
+    EVERY_N,        // every n-th step
+};
+
+struct ExpressionTraceParamsType
+{
+    ExpressionTraceMode mode;
+
+    size_t k;
+    size_t maxDepth;
+    size_t n;
+
+    size_t maxBytes;    // output budget for the steps of one trace, 0 - unlimited
+};
+
 void LatexFileTrollingStart(FILE* outTex);
 void LatexFileTrollingEnd  (FILE* outTex);
 void LatexCreatePdf(const char* fileName);
@@ -38,17 +64,49 @@ ExpressionErrors ExpressionTokenPrintTexWithTrollString(
                                                 const char* string,
                                                 LatexReplacementArrType* replacementArr);
 
+ExpressionErrors ExpressionTokenPrintTexWithTrollString(
+                                                const ExpressionTokenType* rootToken,
+                                                OutputBufferType* outBuffer,
+                                                const char* string,
+                                                LatexReplacementArrType* replacementArr);
+
 ExpressionErrors ExpressionTokenPrintTex(const ExpressionTokenType* token, 
                                          FILE* outStream,
-                                         const LatexReplacementArrType* replacementArr);
+                                         LatexReplacementArrType* replacementArr);
+
+ExpressionErrors ExpressionTokenPrintTex(const ExpressionTokenType* token, 
+                                         OutputBufferType* outBuffer,
+                                         LatexReplacementArrType* replacementArr);
 
 ExpressionErrors ExpressionLatexReplacementPrint(LatexReplacementArrType* arr,
                                                  const ExpressionTokenType* token,
                                                  FILE* outStream);
 
-size_t ExpressionLatexReplacementArrayInit(const ExpressionTokenType* token, 
-                                            LatexReplacementArrType* arr);
-                                            
+ExpressionErrors ExpressionLatexReplacementPrint(LatexReplacementArrType* arr,
+                                                 const ExpressionTokenType* token,
+                                                 OutputBufferType* outBuffer);
+
+size_t ExpressionLatexGetLen(ExpressionOperationId operation, const size_t leftSz, 
+                                                              const size_t rightSz);
+
+size_t ExpressionLatexTokenGetLen(const ExpressionTokenType* token);
+
+
+void ExpressionTraceSetParams(const ExpressionTraceParamsType* params);
+
+void   ExpressionTraceBegin(FILE* outTex);
+void   ExpressionTraceEnd  ();
+void   ExpressionTraceEnter();
+size_t ExpressionTraceLeave();
+void   ExpressionTraceStep (const ExpressionTokenType* prevToken,
+                            const ExpressionTokenType* newToken,
+                            const char* string,
+                            LatexReplacementArrType* replacementArr);
+
+void ExpressionLatexReplacementRemove(LatexReplacementArrType* arr,
+                                      const ExpressionTokenType* token,
+                                      const bool withSubtree = true);
+
 void ExpressionLatexReplacementArrayDtor(LatexReplacementArrType* arr);
-void ExpressionLatexReplacementArrayCtor(LatexReplacementArrType* arr, size_t capacity = 20);
+void ExpressionLatexReplacementArrayCtor(LatexReplacementArrType* arr, size_t capacity = 32);
 #endif
\ No newline at end of file
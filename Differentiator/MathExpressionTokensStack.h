@@ -0,0 +1,39 @@
+#ifndef MATH_EXPRESSION_TOKENS_STACK_H
+#define MATH_EXPRESSION_TOKENS_STACK_H
+
+#include <assert.h>
+
+#include "MathExpressionsMain.h"
+#include "Vector/Vector.h"
+
+// Tree algorithms keep the path to the current token in explicit stacks instead of recursion,
+// so depth of the tree is limited by memory only. Trees of usual depth don't allocate at all.
+static const size_t TOKENS_STACK_INLINE_CAPACITY = 64;
+
+// Stack of traversal frames is a vector, first InlineCapacity frames are stored in the struct
+template <typename T, size_t InlineCapacity = TOKENS_STACK_INLINE_CAPACITY>
+using TokensStackType = VectorType<T, InlineCapacity>;
+
+//---------------------------------------------------------------------------------------
+
+template <typename T, size_t InlineCapacity>
+static inline T TokensStackPop(TokensStackType<T, InlineCapacity>* stack)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "frames are popped by copy");
+
+    assert(stack);
+    assert(stack->size > 0);
+
+    return stack->data[--stack->size];
+}
+
+template <typename T, size_t InlineCapacity>
+static inline T* TokensStackTop(TokensStackType<T, InlineCapacity>* stack)
+{
+    assert(stack);
+    assert(stack->size > 0);
+
+    return stack->data + stack->size - 1;
+}
+
+#endif
@@ -2,6 +2,7 @@
 #include <ctype.h>
 #include <string.h>
 #include <math.h>
+#include <stdint.h>
 
 #include "MathExpressionsMain.h"
 #include "Common/StringFuncs.h"
@@ -9,18 +10,23 @@
 #include "FastInput/InputOutput.h"
 #include "Common/DoubleFuncs.h"
 #include "MathExpressionInOut.h"
+#include "MathExpressionTokensStack.h"
 
 //---------------------------------------------------------------------------------------
 
-static void ExpressionDtor     (ExpressionTokenType* token);
 static void ExpressionVariableValuesDtor(ExpressionVariableType* varPtr);
 
 static ExpressionVariableType* GetVariablePtrByName(const ExpressionVariablesArrayType* varsArr, 
                                                     const char* variableName);
 
+static ExpressionErrors ExpressionTokenRebindVariables(ExpressionTokenType* token,
+                                              const ExpressionVariablesArrayType* prevVarsArr,
+                                              ExpressionVariablesArrayType* newVarsArr);
+
 static void ExpressionGraphicDump(const ExpressionTokenType* token, FILE* outDotFile);
 static void DotFileCreateTokens(const ExpressionTokenType* token, 
                                const ExpressionVariablesArrayType* varsArr, FILE* outDotFile);
+static void DotFileCreateToken (const ExpressionTokenType* token, FILE* outDotFile);
 
 static inline void CreateImgInLogFile(const size_t imgIndex, bool openImg);
 static inline void DotFileBegin(FILE* outDotFile);
@@ -55,11 +61,7 @@ ExpressionErrors ExpressionVariableArrayCtor(ExpressionVariablesArrayType* arr)
 {
     assert(arr);
 
-    arr->capacity = 100;
-    arr->size     = 0;
-    arr->data     = (ExpressionVariableType*) calloc(arr->capacity, sizeof(*(arr->data)));
-
-    if (arr->data == nullptr)
+    if (VectorCtor(arr, EXPRESSION_VARIABLES_CAPACITY) != VectorErrors::VECTOR_NO_ERR)
         return ExpressionErrors::MEM_ERR;
 
     return ExpressionErrors::NO_ERR;
@@ -81,33 +83,39 @@ ExpressionErrors ExpressionDtor(ExpressionType* expression)
 
 ExpressionErrors ExpressionVariableArrayDtor(ExpressionVariablesArrayType* arr)
 {
-    for (size_t i = 0; i < arr->capacity; ++i)
-    {
-        if (arr->data->variableName)
-            ExpressionVariableValuesDtor(arr->data + i);
-    }
+    assert(arr);
+
+    for (size_t i = 0; i < arr->size; ++i)
+        ExpressionVariableValuesDtor(arr->data + i);
 
-    free(arr->data);
-    arr->data     = nullptr;
-    arr->size     = 0;
-    arr->capacity = 0;
+    VectorDtor(arr);
 
     return ExpressionErrors::NO_ERR;
 }
 
 //---------------------------------------------------------------------------------------
 
-static void ExpressionDtor(ExpressionTokenType* token)
+void ExpressionDtor(ExpressionTokenType* token)
 {
-    if (token == nullptr)
-        return;
-    
-    assert(token);
+    // left son is rotated up until there is no one, so the tree is freed without any stack
+    while (token != nullptr)
+    {
+        ExpressionTokenType* left = token->left;
 
-    ExpressionDtor(token->left);
-    ExpressionDtor(token->right);
+        if (left == nullptr)
+        {
+            ExpressionTokenType* right = token->right;
 
-    ExpressionTokenDtor(token);
+            ExpressionTokenDtor(token);
+
+            token = right;
+            continue;
+        }
+
+        token->left = left->right;
+        left->right = token;
+        token       = left;
+    }
 }
 
 static void ExpressionVariableValuesDtor(ExpressionVariableType* varPtr)
@@ -166,29 +174,51 @@ ExpressionErrors ExpressionVerify(const ExpressionTokenType* token)
     if (token == nullptr)
         return ExpressionErrors::NO_ERR;
 
-    ExpressionErrors err = ExpressionVerify(token->left);
-    if (err != ExpressionErrors::NO_ERR) return err;
+    TokensStackType<const ExpressionTokenType*> stack;
+    VectorCtor(&stack);
 
-    err = ExpressionVerify(token->right);
-    if (err != ExpressionErrors::NO_ERR) return err;
+    ExpressionErrors err = ExpressionErrors::NO_ERR;
 
-    if (token->left == token->right && token->left != nullptr)
-        return ExpressionErrors::TOKEN_EDGES_ERR;
-    
-    if (token->left == token || token->right == token)
-        return ExpressionErrors::TOKEN_EDGES_ERR;
+    while (true)
+    {
+        if ((token->left == token->right && token->left != nullptr) ||
+            (token->left == token || token->right == token))
+        {
+            err = ExpressionErrors::TOKEN_EDGES_ERR;
+            break;
+        }
 
-    return ExpressionErrors::NO_ERR;
+        if (token->right != nullptr && 
+            VectorPush(&stack, (const ExpressionTokenType*) token->right) != 
+                                                            VectorErrors::VECTOR_NO_ERR)
+        {
+            err = ExpressionErrors::MEM_ERR;
+            break;
+        }
+
+        if (token->left != nullptr)
+            token = token->left;
+        else if (!VectorIsEmpty(&stack))
+            token = TokensStackPop(&stack);
+        else
+            break;
+    }
+
+    VectorDtor(&stack);
+
+    return err;
 }
 
 ExpressionErrors ExpressionVariablesArrayVerify(const ExpressionVariablesArrayType* varsArr)
 {
     assert(varsArr);
 
-    if (varsArr->size > varsArr->capacity)
+    VectorErrors vectorErr = VectorVerify(varsArr);
+
+    if (vectorErr == VectorErrors::VECTOR_SIZE_OUT_OF_RANGE)
         return ExpressionErrors::CAPACITY_ERR;
     
-    if (varsArr->data == nullptr)
+    if (vectorErr != VectorErrors::VECTOR_NO_ERR || varsArr->data == nullptr)
         return ExpressionErrors::VARIABLES_DATA_ERR;
 
     for (size_t i = 0; i < varsArr->size; ++i)
@@ -217,7 +247,7 @@ static inline void CreateImgInLogFile(const size_t imgIndex, bool openImg)
     system(commandName);
 
     snprintf(commandName, maxCommandLength, "<img src = \"%s\">\n", imgName);    
-    Log(commandName);
+    Log("%s", commandName);
 
     if (openImg)
     {
@@ -278,7 +308,35 @@ static void DotFileCreateTokens(const ExpressionTokenType* token,
 
     if (token == nullptr)
         return;
-    
+
+    TokensStackType<const ExpressionTokenType*> stack;
+    VectorCtor(&stack);
+
+    // dump is left incomplete if the stack can't grow
+    bool pushed = VectorPush(&stack, token) == VectorErrors::VECTOR_NO_ERR;
+
+    while (pushed && !VectorIsEmpty(&stack))
+    {
+        token = TokensStackPop(&stack);
+
+        DotFileCreateToken(token, outDotFile);
+
+        if (token->right != nullptr)
+            pushed = VectorPush(&stack, (const ExpressionTokenType*) token->right) == 
+                                                            VectorErrors::VECTOR_NO_ERR;
+        if (token->left  != nullptr && pushed)
+            pushed = VectorPush(&stack, (const ExpressionTokenType*) token->left) == 
+                                                            VectorErrors::VECTOR_NO_ERR;
+    }
+
+    VectorDtor(&stack);
+}
+
+static void DotFileCreateToken(const ExpressionTokenType* token, FILE* outDotFile)
+{
+    assert(token);
+    assert(outDotFile);
+
     fprintf(outDotFile, "token%p"
                         "[shape=Mrecord, style=filled, ", token);
 
@@ -294,28 +352,43 @@ static void DotFileCreateTokens(const ExpressionTokenType* token,
         fprintf(outDotFile, "fillcolor=\"#FF0000\", label = \"ERROR\", ");
 
     fprintf(outDotFile, "color = \"#D0D000\"];\n");
-
-    DotFileCreateTokens(token->left,  varsArr, outDotFile);
-    DotFileCreateTokens(token->right, varsArr, outDotFile);
 }
 
 //---------------------------------------------------------------------------------------
 
 static void ExpressionGraphicDump(const ExpressionTokenType* token, FILE* outDotFile)
 {
+    assert(outDotFile);
+
     if (token == nullptr)
-    {
-        fprintf(outDotFile, "\n");
         return;
-    }
-    
-    fprintf(outDotFile, "token%p;\n", token);
 
-    if (token->left != nullptr) fprintf(outDotFile, "token%p->", token);
-    ExpressionGraphicDump(token->left, outDotFile);
+    TokensStackType<const ExpressionTokenType*> stack;
+    VectorCtor(&stack);
 
-    if (token->right != nullptr) fprintf(outDotFile, "token%p->", token);
-    ExpressionGraphicDump(token->right, outDotFile);
+    // dump is left incomplete if the stack can't grow
+    bool pushed = VectorPush(&stack, token) == VectorErrors::VECTOR_NO_ERR;
+
+    while (pushed && !VectorIsEmpty(&stack))
+    {
+        token = TokensStackPop(&stack);
+
+        if (token->left != nullptr)
+        {
+            fprintf(outDotFile, "token%p->token%p;\n", token, token->left);
+            pushed = VectorPush(&stack, (const ExpressionTokenType*) token->left) == 
+                                                            VectorErrors::VECTOR_NO_ERR;
+        }
+
+        if (token->right != nullptr && pushed)
+        {
+            fprintf(outDotFile, "token%p->token%p;\n", token, token->right);
+            pushed = VectorPush(&stack, (const ExpressionTokenType*) token->right) == 
+                                                            VectorErrors::VECTOR_NO_ERR;
+        }
+    }
+
+    VectorDtor(&stack);
 }
 
 //---------------------------------------------------------------------------------------
@@ -330,9 +403,16 @@ void ExpressionTextDump(const ExpressionType* expression, const char* fileName,
 
     LogBegin(fileName, funcName, line);
 
-    Log("Tree root: %p, value: %s\n", expression->root, expression->root->value);
+    Log("Tree root: %p\n", expression->root);
     Log("Tree: ");
-    ExpressionPrintPrefixFormat(expression, nullptr);
+
+    OutputBufferType outBuffer = {};
+    if (OutputBufferCtor(&outBuffer))
+    {
+        ExpressionPrintPrefixFormat(expression, &outBuffer);
+        LogText(outBuffer.data, outBuffer.size);
+    }
+    OutputBufferDtor(&outBuffer);
 
     LOG_END();
 }
@@ -360,24 +440,83 @@ ExpressionErrors ExpressionCopyVariables(      ExpressionType* target,
     assert(target);
     assert(source);
 
-    assert(target->variables.capacity == source->variables.capacity);
+    assert(target->variables.capacity >= source->variables.size);
     assert(target->variables.size == 0);
 
     EXPRESSION_CHECK(target);
     EXPRESSION_CHECK(source);
 
+    // same order keeps indices of the variables, tokens are rebound by them
     for (size_t i = 0; i < source->variables.size; ++i)
     {
-        target->variables.data[i].variableName  = strdup(source->variables.data->variableName);
-        target->variables.data[i].variableValue = source->variables.data->variableValue;
-    }
+        const ExpressionVariableType* variable = source->variables.data + i;
 
-    target->variables.size      = source->variables.size;
-    target->variables.capacity  = source->variables.capacity;
+        if (ExpressionVariableSet(&target->variables, variable->variableName,
+                                                      variable->variableValue) == nullptr)
+            return ExpressionErrors::MEM_ERR;
+    }
 
     return ExpressionErrors::NO_ERR;
 }
 
+ExpressionErrors ExpressionRebindVariables(ExpressionType* expression, 
+                                           const ExpressionVariablesArrayType* prevVarsArr)
+{
+    assert(expression);
+    assert(prevVarsArr);
+
+    return ExpressionTokenRebindVariables(expression->root, prevVarsArr, &expression->variables);
+}
+
+static ExpressionErrors ExpressionTokenRebindVariables(ExpressionTokenType* token,
+                                              const ExpressionVariablesArrayType* prevVarsArr,
+                                              ExpressionVariablesArrayType* newVarsArr)
+{
+    assert(prevVarsArr);
+    assert(newVarsArr);
+
+    if (token == nullptr)
+        return ExpressionErrors::NO_ERR;
+
+    TokensStackType<ExpressionTokenType*> stack;
+    VectorCtor(&stack);
+
+    ExpressionErrors err = ExpressionErrors::NO_ERR;
+
+    while (true)
+    {
+        if (token->valueType == ExpressionTokenValueTypeof::VARIABLE)
+        {
+            const ExpressionVariableType* varPtr = token->value.varPtr;
+
+            if (prevVarsArr->data <= varPtr && varPtr < prevVarsArr->data + prevVarsArr->size &&
+                (size_t)(varPtr - prevVarsArr->data) < newVarsArr->size)
+                token->value.varPtr = newVarsArr->data + (varPtr - prevVarsArr->data);
+            else
+                token->value.varPtr = ExpressionVariableSet(newVarsArr, varPtr->variableName,
+                                                                        varPtr->variableValue);
+        }
+
+        if (token->right != nullptr && 
+            VectorPush(&stack, token->right) != VectorErrors::VECTOR_NO_ERR)
+        {
+            err = ExpressionErrors::MEM_ERR;
+            break;
+        }
+
+        if (token->left != nullptr)
+            token = token->left;
+        else if (!VectorIsEmpty(&stack))
+            token = TokensStackPop(&stack);
+        else
+            break;
+    }
+
+    VectorDtor(&stack);
+
+    return err;
+}
+
 //---------------------------------------------------------------------------------------
 
 ExpressionVariableType* ExpressionVariableSet(ExpressionType* expression, 
@@ -402,18 +541,24 @@ ExpressionVariableType* ExpressionVariableSet(ExpressionVariablesArrayType* vars
     if (varPtr != nullptr)
         return varPtr;
         
+    // pushing into the full table would move the variables under the tokens
     assert(varsArr->size < varsArr->capacity);
+    if (varsArr->size == varsArr->capacity)
+        return nullptr;
 
-    varsArr->data[varsArr->size].variableName  = strdup(variableName);
+    ExpressionVariableType variable = {strdup(variableName), variableValue};
 
-    assert(varsArr->data[varsArr->size].variableName);
-    if (varsArr->data[varsArr->size].variableName == nullptr)
+    assert(variable.variableName);
+    if (variable.variableName == nullptr)
         return nullptr;
     
-    varsArr->data[varsArr->size].variableValue = variableValue;
-    varsArr->size++;
+    if (VectorPush(varsArr, variable) != VectorErrors::VECTOR_NO_ERR)
+    {
+        free(variable.variableName);
+        return nullptr;
+    }
 
-    return varsArr->data + (int)varsArr->size - 1;
+    return varsArr->data + varsArr->size - 1;
 }
 
 ExpressionVariableType* ExpressionVariableChangeName(ExpressionType* expression,
@@ -491,6 +636,7 @@ ExpressionType ExpressionCopy(const ExpressionType* expression)
     ExpressionTokenType* copyExprRoot = ExpressionTokenCopy(expression->root);
 
     copyExpr.root = copyExprRoot;
+    ExpressionRebindVariables(&copyExpr, &expression->variables);
 
     return copyExpr;
 }
@@ -500,10 +646,52 @@ ExpressionTokenType* ExpressionTokenCopy(const ExpressionTokenType* token)
     if (token == nullptr)
         return nullptr;
 
-    ExpressionTokenType* left  = ExpressionTokenCopy(token->left);
-    ExpressionTokenType* right = ExpressionTokenCopy(token->right);
+    // token is copied before its sons, stack keeps right sons with the place for their copies
+    struct CopyFrameType
+    {
+        const ExpressionTokenType* token;
+        ExpressionTokenType**      copyPtr;
+    };
+
+    TokensStackType<CopyFrameType> stack;
+    VectorCtor(&stack);
+
+    ExpressionTokenType*  copyRoot = nullptr;
+    ExpressionTokenType** copyPtr  = &copyRoot;
+
+    while (true)
+    {
+        ExpressionTokenType* copy = ExpressionTokenCreate(token->value, token->valueType);
+        *copyPtr = copy;
+
+        if (token->right != nullptr && 
+            VectorPush(&stack, CopyFrameType{token->right, &copy->right}) != 
+                                                            VectorErrors::VECTOR_NO_ERR)
+        {
+            ExpressionTokenDtor(copyRoot);
+            copyRoot = nullptr;
+            break;
+        }
+
+        if (token->left != nullptr)
+        {
+            token   = token->left;
+            copyPtr = &copy->left;
+            continue;
+        }
+
+        if (VectorIsEmpty(&stack))
+            break;
+
+        CopyFrameType frame = TokensStackPop(&stack);
 
-    return ExpressionTokenCreate(token->value, token->valueType, left, right);
+        token   = frame.token;
+        copyPtr = frame.copyPtr;
+    }
+
+    VectorDtor(&stack);
+
+    return copyRoot;
 }
 
 //---------------------------------------------------------------------------------------
@@ -566,41 +754,177 @@ void ExpressionTokenSetEdges(ExpressionTokenType* token, ExpressionTokenType* le
 {
     assert(token);
 
-    token->left  = left;
-    token->right = right;
+    token->left   = left;
+    token->right  = right;
+    token->texLen = 0;
 }
 
-int ExpressionOperationGetId(const char* string)
+//---------------------------------------------------------------------------------------
+
+// Operation names are looked up in perfect hash tables built at compile time from
+// Operations.h: every name has its own slot, so a lookup hashes the string and
+// compares it with one name only.
+
+struct OperationNameType
 {
-    assert(string);
+    const char*           name;
+    ExpressionOperationId operation;
+    bool                  isShortName;
+};
+
+// in order of the old linear search: short name and then long name of every operation
+#define GENERATE_OPERATION_CMD(NAME, v1, v2, v3, SHORT_NAME, ...)       \
+    {SHORT_NAME, ExpressionOperationId::NAME, true},                     \
+    {#NAME,      ExpressionOperationId::NAME, false},
+
+static constexpr OperationNameType OperationNames[] =
+{
+    #include "Operations.h"
+};
+
+#undef GENERATE_OPERATION_CMD
+
+static const size_t OPERATION_NAMES_COUNT = sizeof(OperationNames) / sizeof(*OperationNames);
+
+// power of two, 4 times more than names, so a seed without collisions is found quickly
+static const size_t   OPERATIONS_HASH_TABLE_SIZE = 128;
+static const uint32_t OPERATIONS_HASH_MAX_SEED   = 1 << 16;
+
+static_assert(OPERATION_NAMES_COUNT < OPERATIONS_HASH_TABLE_SIZE / 2, 
+              "increase OPERATIONS_HASH_TABLE_SIZE");
+
+struct OperationsHashTableType
+{
+    uint32_t    seed;
+    signed char slots[OPERATIONS_HASH_TABLE_SIZE];  // index in OperationNames, -1 - empty
+};
+
+static constexpr char OperationNameFoldChar(const char c, const bool ignoreCase)
+{
+    return ignoreCase && 'A' <= c && c <= 'Z' ? (char)(c - 'A' + 'a') : c;
+}
 
-    #define GENERATE_OPERATION_CMD(NAME, v1, v2, v3, SHORT_NAME, ...) SHORT_NAME,
+// FNV-1a
+static constexpr uint32_t OperationNameHash(const char* name, const uint32_t seed, 
+                                                              const bool ignoreCase)
+{
+    uint32_t hash = 2166136261u ^ seed;
+
+    for (; *name != '\0'; ++name)
+        hash = (hash ^ (unsigned char)OperationNameFoldChar(*name, ignoreCase)) * 16777619u;
 
-    static const char* shortNamesArr[] = 
+    return hash ^ (hash >> 15);
+}
+
+static constexpr bool OperationNamesEqual(const char* name1, const char* name2, 
+                                          const bool ignoreCase)
+{
+    for (; *name1 != '\0' && *name2 != '\0'; ++name1, ++name2)
     {
-        #include "Operations.h"
-    };
+        if (OperationNameFoldChar(*name1, ignoreCase) != OperationNameFoldChar(*name2, ignoreCase))
+            return false;
+    }
 
-    #undef  GENERATE_OPERATION_CMD
-    #define GENERATE_OPERATION_CMD(NAME, ...) #NAME, 
+    return *name1 == *name2;
+}
 
-    static const char* longNamesArr[] = 
+// true if the name is taken by the previous operation, the first one is found as before
+static constexpr bool OperationNameIsTaken(const size_t nameIndex, const bool ignoreCase)
+{
+    for (size_t i = 0; i < nameIndex; ++i)
     {
-        #include "Operations.h"
-    };
+        if ((ignoreCase || OperationNames[i].isShortName) &&
+            OperationNamesEqual(OperationNames[i].name, OperationNames[nameIndex].name, ignoreCase))
+            return true;
+    }
 
-    #undef GENERATE_OPERATION_CMD
+    return false;
+}
+
+// ignoreCase - table of all names compared case insensitively, otherwise of short names only
+static constexpr OperationsHashTableType OperationsHashTableBuild(const bool ignoreCase)
+{
+    bool isKey[OPERATION_NAMES_COUNT] = {};
 
-    static const size_t NumberOfOperations = sizeof(shortNamesArr) / sizeof(*shortNamesArr);
+    for (size_t i = 0; i < OPERATION_NAMES_COUNT; ++i)
+        isKey[i] = (ignoreCase || OperationNames[i].isShortName) && 
+                   !OperationNameIsTaken(i, ignoreCase);
 
-    for (size_t i = 0; i < NumberOfOperations; ++i)
+    for (uint32_t seed = 0; seed < OPERATIONS_HASH_MAX_SEED; ++seed)
     {
-        if (strcasecmp(string, shortNamesArr[i]) == 0 || 
-            strcasecmp(string, longNamesArr[i])  == 0)
-            return (int)i;
+        OperationsHashTableType table = {};
+        table.seed = seed;
+
+        for (size_t slot = 0; slot < OPERATIONS_HASH_TABLE_SIZE; ++slot)
+            table.slots[slot] = -1;
+
+        bool hasCollision = false;
+
+        for (size_t i = 0; i < OPERATION_NAMES_COUNT && !hasCollision; ++i)
+        {
+            if (!isKey[i])
+                continue;
+
+            size_t slot = OperationNameHash(OperationNames[i].name, seed, ignoreCase) & 
+                                                        (OPERATIONS_HASH_TABLE_SIZE - 1);
+
+            if (table.slots[slot] != -1)
+                hasCollision = true;
+
+            table.slots[slot] = (signed char)i;
+        }
+
+        if (!hasCollision)
+            return table;
     }
 
-    return -1;
+    OperationsHashTableType noTable = {};
+    noTable.seed = OPERATIONS_HASH_MAX_SEED;
+
+    return noTable;
+}
+
+static constexpr OperationsHashTableType OperationsNamesTable      = OperationsHashTableBuild(true);
+static constexpr OperationsHashTableType OperationsShortNamesTable = OperationsHashTableBuild(false);
+
+static_assert(OperationsNamesTable.seed      != OPERATIONS_HASH_MAX_SEED &&
+              OperationsShortNamesTable.seed != OPERATIONS_HASH_MAX_SEED, 
+              "no perfect hash for operation names, increase OPERATIONS_HASH_TABLE_SIZE");
+
+static inline int OperationsHashTableFind(const OperationsHashTableType* table, 
+                                          const char* string, const bool ignoreCase)
+{
+    assert(table);
+    assert(string);
+
+    int nameIndex = table->slots[OperationNameHash(string, table->seed, ignoreCase) & 
+                                                        (OPERATIONS_HASH_TABLE_SIZE - 1)];
+
+    if (nameIndex == -1)
+        return -1;
+
+    const char* name = OperationNames[nameIndex].name;
+
+    if ((ignoreCase ? strcasecmp(string, name) : strcmp(string, name)) != 0)
+        return -1;
+
+    return (int)OperationNames[nameIndex].operation;
+}
+
+//---------------------------------------------------------------------------------------
+
+int ExpressionOperationGetId(const char* string)
+{
+    assert(string);
+
+    return OperationsHashTableFind(&OperationsNamesTable, string, true);
+}
+
+int ExpressionOperationGetIdByShortName(const char* string)
+{
+    assert(string);
+
+    return OperationsHashTableFind(&OperationsShortNamesTable, string, false);
 }
 
 const char* ExpressionOperationGetLongName(const  ExpressionOperationId operation)
@@ -4,19 +4,20 @@
 #include <stdio.h>
 #include <math.h>
 
+#include "Vector/Vector.h"
+
 struct ExpressionVariableType
 {
     char*  variableName;
     double variableValue; 
 };
 
-struct ExpressionVariablesArrayType
-{
-    ExpressionVariableType* data;
+/// @brief Variables of the expression, tokens point right into data.
+/// @details Table is reserved once in ExpressionVariableArrayCtor and never grows,
+/// @details so pointers to the variables stay valid.
+typedef VectorType<ExpressionVariableType> ExpressionVariablesArrayType;
 
-    size_t capacity;
-    size_t size;
-};
+static const size_t EXPRESSION_VARIABLES_CAPACITY = 100;
 
 #define GENERATE_OPERATION_CMD(NAME, ...) NAME, 
 
@@ -57,6 +58,8 @@ struct ExpressionTokenType
     
     ExpressionTokenType*  left;
     ExpressionTokenType* right;
+
+    mutable size_t texLen;      // cached ExpressionLatexTokenGetLen(), 0 - not calculated yet
 };
 
 struct ExpressionType
@@ -82,12 +85,16 @@ enum class ExpressionErrors
     TOKEN_EDGES_ERR,
 
     NO_REPLACEMENT,
+
+    CACHE_ERR,
+    COMPILE_ERR,
 };
 
 //-------------Expression main funcs----------
 
 ExpressionErrors ExpressionCtor(ExpressionType* expression);
 ExpressionErrors ExpressionDtor(ExpressionType* expression);
+void             ExpressionDtor(ExpressionTokenType* token);
 
 ExpressionTokenType* ExpressionTokenCreate(ExpressionTokenValue value, 
                                             ExpressionTokenValueTypeof valueType,
@@ -150,10 +157,13 @@ ExpressionVariableType* ExpressionVariableChangeName(ExpressionVariablesArrayTyp
                                                      const char* newName);
 
 ExpressionErrors ExpressionCopyVariables(ExpressionType* target, const ExpressionType* source);
+ExpressionErrors ExpressionRebindVariables(ExpressionType* expression, 
+                                           const ExpressionVariablesArrayType* prevVarsArr);
 
 //-------------Operations funcs-----------
 
 int  ExpressionOperationGetId(const char* string);
+int  ExpressionOperationGetIdByShortName(const char* string);
 const char* ExpressionOperationGetLongName (const  ExpressionOperationId operation);
 const char* ExpressionOperationGetShortName(const ExpressionOperationId operation);
 bool ExpressionOperationIsUnary(const ExpressionOperationId operation);
@@ -6,10 +6,22 @@
 //                       NEED_LEFT_TEX_BRACES, NEED_RIGHT_TEX_BRACES,                  
 //                       OPERATION_CALCULATION_CODE, OPERATION_DIFF_CODE,
 //                       GNU_PLOT_NAME, GNU_PLOT_FORMAT,
-//                       SUM_TEX_LENS_CODE) 
+//                       SUM_TEX_LENS_CODE, INTERVAL_CODE,
+//                       PARSE_PRIORITY, PARSE_RIGHT_ASSOC,
+//                       C_NAME, C_FORMAT)
 
 //OPERATION_CALCILATION_CODE - format of function f(const double val1, const double val2)
-//OPERATION_DIFF_CODE        - format of function f(const ExpressionTokenType* token)
+//OPERATION_DIFF_CODE        - format of function f(const ExpressionTokenType* token),
+//                             D(son) - derivative of the son, it can be taken only once.
+//                             Sons that are not always differentiated - see ExpressionDiffNeedSon.
+//                             DIFF_IF(CONTAIN_VAR(son)) - branch on variables in the son,
+//                             every branch has to end with return or else.
+//INTERVAL_CODE              - format of function f(const ExpressionIntervalType val1,
+//                                                  const ExpressionIntervalType val2)
+//PARSE_PRIORITY             - binding strength in ExpressionParse, 0 - function with argument in braces
+//PARSE_RIGHT_ASSOC          - a op b op c is read as a op (b op c)
+//C_NAME                     - operator or function in C source of ExpressionExportC,
+//                             Expression* functions are defined in the exported source
 
 /*
 
@@ -24,6 +36,7 @@ do                              \
     assert(isfinite(val2));     \
 } while (0)
 
+#ifndef DIFF_CHECK
 #define DIFF_CHECK(NAME)                                    \
 do                                                          \
 {                                                           \
@@ -31,6 +44,15 @@ do                                                          \
     assert(IS_OP(token));                                   \
     assert(TOKEN_OP(token) == ExpressionOperationId::NAME); \
 } while (0)
+#endif
+
+#ifndef DIFF_IF
+#define DIFF_IF(CONDITION) if (CONDITION)
+#endif
+
+#ifndef CONTAIN_VAR
+#define CONTAIN_VAR(SON) ExpressionTokenContainVariable(SON)
+#endif
 
 GENERATE_OPERATION_CMD(ADD, INFIX,  INFIX, false, "+", "+", false, false,
 {
@@ -46,7 +68,12 @@ GENERATE_OPERATION_CMD(ADD, INFIX,  INFIX, false, "+", "+", false, false,
 "+", INFIX,
 {
     return leftSz + rightSz + 1;
-})
+},
+{
+    return ExpressionIntervalAdd(val1, val2);
+},
+1, false,
+"+", INFIX)
 
 GENERATE_OPERATION_CMD(SUB, INFIX,  INFIX, false, "-", "-",      false, false,
 {
@@ -62,7 +89,12 @@ GENERATE_OPERATION_CMD(SUB, INFIX,  INFIX, false, "-", "-",      false, false,
 "-", INFIX,
 {
     return leftSz + rightSz + 1;
-})
+},
+{
+    return ExpressionIntervalSub(val1, val2);
+},
+1, false,
+"-", INFIX)
 
 GENERATE_OPERATION_CMD(UNARY_SUB, PREFIX, PREFIX, true, "-", "-",      false, false,
 {
@@ -78,7 +110,12 @@ GENERATE_OPERATION_CMD(UNARY_SUB, PREFIX, PREFIX, true, "-", "-",      false, fa
 "-", PREFIX,
 {
     return leftSz + 1;
-})
+},
+{
+    return ExpressionIntervalNeg(val1);
+},
+3, false,
+"-", PREFIX)
 
 GENERATE_OPERATION_CMD(MUL, INFIX,  INFIX, false, "*", "\\cdot", false, false,
 {
@@ -95,7 +132,12 @@ GENERATE_OPERATION_CMD(MUL, INFIX,  INFIX, false, "*", "\\cdot", false, false,
 "*", INFIX,
 {
     return leftSz + rightSz + 1;
-})
+},
+{
+    return ExpressionIntervalMul(val1, val2);
+},
+2, false,
+"*", INFIX)
 
 GENERATE_OPERATION_CMD(DIV, INFIX, PREFIX, false, "/", "\\frac", true,  true,
 {
@@ -114,7 +156,12 @@ GENERATE_OPERATION_CMD(DIV, INFIX, PREFIX, false, "/", "\\frac", true,  true,
 "/", INFIX,
 {
     return max(leftSz, rightSz);
-})
+},
+{
+    return ExpressionIntervalDiv(val1, val2);
+},
+2, false,
+"/", INFIX)
 
 GENERATE_OPERATION_CMD(POW, INFIX, INFIX, false,     "^",     "^",  false, true,
 {
@@ -125,31 +172,34 @@ GENERATE_OPERATION_CMD(POW, INFIX, INFIX, false,     "^",     "^",  false, true,
 {
     DIFF_CHECK(POW);
 
-    bool baseContainVar  = ExpressionTokenContainVariable(token->left);
-    bool powerContainVar = ExpressionTokenContainVariable(token->right);
-
-    if (!baseContainVar && !powerContainVar)
-        return CRT_NUM(0);
-
-    if (baseContainVar && !powerContainVar)
-        return _MUL(_MUL(C(token->right), D(token->left)), 
-                          _POW(C(token->left), 
-                                     _SUB(C(token->right), CRT_NUM(1))));
-                        
-    if (!baseContainVar && powerContainVar)
+    DIFF_IF (!CONTAIN_VAR(token->right))
+    {
+        DIFF_IF (!CONTAIN_VAR(token->left))
+            return CRT_NUM(0);
+        else
+            return _MUL(_MUL(C(token->right), D(token->left)), 
+                              _POW(C(token->left), 
+                                         _SUB(C(token->right), CRT_NUM(1))));
+    }
+    else DIFF_IF (!CONTAIN_VAR(token->left))
         return _MUL(_POW(C(token->left), C(token->right)),
                           _MUL(_LN(C(token->left)),
                                      D(token->right)));
-
-    return _MUL(_POW(C(token->left), C(token->right)),
-                      _ADD(_MUL(C(token->right),
-                                            _DIV(D(token->left), C(token->left))),
-                                 _MUL(_LN(C(token->left)), D(token->right))));
+    else
+        return _MUL(_POW(C(token->left), C(token->right)),
+                          _ADD(_MUL(C(token->right),
+                                                _DIV(D(token->left), C(token->left))),
+                                     _MUL(_LN(C(token->left)), D(token->right))));
 },
 "**", INFIX,
 {
     return leftSz + 0.8 * rightSz;
-})
+},
+{
+    return ExpressionIntervalPow(val1, val2);
+},
+4, true,
+"pow", PREFIX)
 
 GENERATE_OPERATION_CMD(LOG, PREFIX, PREFIX, false, "log", "\\log_", true, false,
 {
@@ -164,12 +214,21 @@ GENERATE_OPERATION_CMD(LOG, PREFIX, PREFIX, false, "log", "\\log_", true, false,
 {
     DIFF_CHECK(LOG);
 
-    return _DIV(D(token->left), C(token->left));
+    //log_a(b)' = (b' / b - log_a(b) * a' / a) / ln(a)
+    return _DIV(_SUB(_DIV(D(token->right), C(token->right)),
+                                 _MUL(_LOG(C(token->left), C(token->right)),
+                                            _DIV(D(token->left), C(token->left)))),
+                      _LN(C(token->left)));
 },
 "log", PREFIX,
 {
     return 0.8 * leftSz + rightSz + 3;
-})
+},
+{
+    return ExpressionIntervalDiv(ExpressionIntervalLn(val2), ExpressionIntervalLn(val1));
+},
+0, false,
+"ExpressionLog", PREFIX)
 
 #undef  CALC_CHECK
 #define CALC_CHECK()        \
@@ -192,7 +251,12 @@ GENERATE_OPERATION_CMD(LN,  PREFIX, PREFIX, true,  "ln",  "\\ln",   false, false
 "log", PREFIX,
 {
     return leftSz + rightSz + 2;
-})
+},
+{
+    return ExpressionIntervalLn(val1);
+},
+0, false,
+"log", PREFIX)
 
 GENERATE_OPERATION_CMD(SIN, PREFIX, PREFIX, true, "sin", "\\sin", false, false,
 {
@@ -208,7 +272,12 @@ GENERATE_OPERATION_CMD(SIN, PREFIX, PREFIX, true, "sin", "\\sin", false, false,
 "sin", PREFIX,
 {
     return leftSz + 3;
-})
+},
+{
+    return ExpressionIntervalSin(val1);
+},
+0, false,
+"sin", PREFIX)
 
 GENERATE_OPERATION_CMD(COS, PREFIX, PREFIX, true, "cos", "\\cos", false, false,
 {
@@ -225,7 +294,12 @@ GENERATE_OPERATION_CMD(COS, PREFIX, PREFIX, true, "cos", "\\cos", false, false,
 "cos", PREFIX,
 {
     return leftSz + 3;
-})
+},
+{
+    return ExpressionIntervalCos(val1);
+},
+0, false,
+"cos", PREFIX)
 
 GENERATE_OPERATION_CMD(TAN, PREFIX, PREFIX, true, "tan", "\\tan", false, false,
 {
@@ -242,7 +316,12 @@ GENERATE_OPERATION_CMD(TAN, PREFIX, PREFIX, true, "tan", "\\tan", false, false,
 "tan", PREFIX,
 {
     return leftSz + 3;
-})
+},
+{
+    return ExpressionIntervalTan(val1);
+},
+0, false,
+"tan", PREFIX)
 
 GENERATE_OPERATION_CMD(COT, PREFIX, PREFIX, true, "cot", "\\cot", false, false,
 {
@@ -265,7 +344,12 @@ GENERATE_OPERATION_CMD(COT, PREFIX, PREFIX, true, "cot", "\\cot", false, false,
 "1 / tan", PREFIX,
 {
     return leftSz + 3;
-})
+},
+{
+    return ExpressionIntervalCot(val1);
+},
+0, false,
+"ExpressionCot", PREFIX)
 
 GENERATE_OPERATION_CMD(ARCSIN, PREFIX, PREFIX, true, "arcsin", "\\arcsin", false, false,
 {
@@ -284,7 +368,12 @@ GENERATE_OPERATION_CMD(ARCSIN, PREFIX, PREFIX, true, "arcsin", "\\arcsin", false
 "asin", PREFIX,
 {
     return leftSz + 6;
-})
+},
+{
+    return ExpressionIntervalArcsin(val1);
+},
+0, false,
+"asin", PREFIX)
 
 GENERATE_OPERATION_CMD(ARCCOS, PREFIX, PREFIX, true, "arccos", "\\arccos", false, false,
 {
@@ -295,8 +384,8 @@ GENERATE_OPERATION_CMD(ARCCOS, PREFIX, PREFIX, true, "arccos", "\\arccos", false
 {
     DIFF_CHECK(ARCCOS);
 
-    return _DIV(CRT_NUM(-1),
-                      _MUL(D(token->left),
+    return _MUL(CRT_NUM(-1),
+                      _DIV(D(token->left),
                                  _POW(_SUB(CRT_NUM(1), 
                                                        _POW(C(token->left), CRT_NUM(2))),
                                             CRT_NUM(0.5))));
@@ -304,7 +393,12 @@ GENERATE_OPERATION_CMD(ARCCOS, PREFIX, PREFIX, true, "arccos", "\\arccos", false
 "acos", PREFIX,
 {
     return leftSz + 6;
-})
+},
+{
+    return ExpressionIntervalArccos(val1);
+},
+0, false,
+"acos", PREFIX)
 
 GENERATE_OPERATION_CMD(ARCTAN, PREFIX, PREFIX, true, "arctan", "\\arctan", false, false,
 {
@@ -322,7 +416,12 @@ GENERATE_OPERATION_CMD(ARCTAN, PREFIX, PREFIX, true, "arctan", "\\arctan", false
 "atan", PREFIX,
 {
     return leftSz + 6;
-})
+},
+{
+    return ExpressionIntervalArctan(val1);
+},
+0, false,
+"atan", PREFIX)
 
 GENERATE_OPERATION_CMD(ARCCOT, PREFIX, PREFIX, true, "arccot", "\\arccot", false, false,
 {
@@ -341,7 +440,14 @@ GENERATE_OPERATION_CMD(ARCCOT, PREFIX, PREFIX, true, "arccot", "\\arccot", false
 "pi / 2 - atan", PREFIX,
 {
     return leftSz + 6;
-})
+},
+{
+    return ExpressionIntervalArccot(val1);
+},
+0, false,
+"ExpressionArccot", PREFIX)
 
 #undef CALC_CHECK
 #undef DIFF_CHECK
+#undef DIFF_IF
+#undef CONTAIN_VAR
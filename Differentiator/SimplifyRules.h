@@ -0,0 +1,39 @@
+#ifndef GENERATE_SIMPLIFY_RULE
+#define GENERATE_SIMPLIFY_RULE(...)
+#endif
+
+//GENERATE_SIMPLIFY_RULE(OPERATION, LEFT_PATTERN, RIGHT_PATTERN, RESULT)
+
+//OPERATION     - NAME from Operations.h or ANY_OPERATION
+//LEFT_PATTERN,
+//RIGHT_PATTERN - NIL, ZERO, ONE, VAL, NUM (= ZERO | ONE | VAL), NUM_OR_NIL,
+//                VAR, SAME_VAR (variable equal to the left one), OP, ANY
+//RESULT        - CALCULATE, RETURN_LEFT, RETURN_RIGHT, RETURN_ZERO, RETURN_ONE, NEGATE_RIGHT
+
+//Rules are compiled into table [operation][left class][right class],
+//if several rules match the same cell, the first one wins
+
+GENERATE_SIMPLIFY_RULE(ANY_OPERATION, NUM,  NUM_OR_NIL, CALCULATE)
+
+GENERATE_SIMPLIFY_RULE(ADD,           ANY,  ZERO,       RETURN_LEFT)
+GENERATE_SIMPLIFY_RULE(ADD,           ZERO, ANY,        RETURN_RIGHT)
+
+GENERATE_SIMPLIFY_RULE(SUB,           ANY,  ZERO,       RETURN_LEFT)
+GENERATE_SIMPLIFY_RULE(SUB,           ZERO, ANY,        NEGATE_RIGHT)
+GENERATE_SIMPLIFY_RULE(SUB,           VAR,  SAME_VAR,   RETURN_ZERO)
+
+GENERATE_SIMPLIFY_RULE(MUL,           ANY,  ZERO,       RETURN_ZERO)
+GENERATE_SIMPLIFY_RULE(MUL,           ZERO, ANY,        RETURN_ZERO)
+GENERATE_SIMPLIFY_RULE(MUL,           ANY,  ONE,        RETURN_LEFT)
+GENERATE_SIMPLIFY_RULE(MUL,           ONE,  ANY,        RETURN_RIGHT)
+
+GENERATE_SIMPLIFY_RULE(DIV,           ZERO, ANY,        RETURN_ZERO)
+GENERATE_SIMPLIFY_RULE(DIV,           ANY,  ONE,        RETURN_LEFT)
+GENERATE_SIMPLIFY_RULE(DIV,           VAR,  SAME_VAR,   RETURN_ONE)
+
+GENERATE_SIMPLIFY_RULE(POW,           ANY,  ZERO,       RETURN_ONE)
+GENERATE_SIMPLIFY_RULE(POW,           ZERO, ANY,        RETURN_ZERO)
+GENERATE_SIMPLIFY_RULE(POW,           ANY,  ONE,        RETURN_LEFT)
+GENERATE_SIMPLIFY_RULE(POW,           ONE,  ANY,        RETURN_ONE)
+
+GENERATE_SIMPLIFY_RULE(LOG,           ANY,  ONE,        RETURN_ZERO)
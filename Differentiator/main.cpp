@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <stdlib.h>
 
 #include "MathExpressionsMain.h"
 #include "MathExpressionInOut.h"
@@ -6,6 +7,8 @@
 #include "MathExpressionGnuPlot.h"
 #include "MathExpressionTexDump.h"
 #include "MathExpressionEquationRead.h"
+#include "MathExpressionCache.h"
+#include "MathExpressionEGraph.h"
 
 #include "Common/Log.h"
 
@@ -20,7 +23,9 @@ int main(const int argc, const char* argv[])
     setbuf(stdout, nullptr);
     
     //ExpressionParse("5 - -(2 + 3)^4");
-    ExpressionParse("sin(x^2) + 2*x    - (3^(2 + 3*x)^21^(x+2))^2*16");
+    ExpressionType parsed = ExpressionParse("sin(x^2) + 2*x    - (3^(2 + 3*x)^21^(x+2))^2*16");
+    ExpressionGraphicDump(&parsed, true);
+    ExpressionDtor(&parsed);
     //TODO: парсинг унарного минуса, очень просто за счет рекурсивного спуска просто создавать
 
     ExpressionErrors err = ExpressionErrors::NO_ERR;
@@ -30,6 +35,14 @@ int main(const int argc, const char* argv[])
     
     IF_ERR_RETURN(err);
 
+    //results are cached between runs only if the directory is given
+    const char* cacheDir = getenv("DIFF_CACHE_DIR");
+    if (cacheDir)
+    {
+        err = ExpressionCacheOpen(cacheDir);
+        IF_ERR_RETURN(err);
+    }
+
     static const char* outputTexFileName = "PHD.tex";
     static const char* inputFileName     = "input.txt";
 
@@ -48,6 +61,15 @@ int main(const int argc, const char* argv[])
     LaTexStartNewSection("Derivative", outputTex);
     ExpressionType expressionDifferentiate =  ExpressionDifferentiate(&expression, outputTex);
     IF_ERR_RETURN(err);
+
+    //e-graph optimization is experimental, so it runs only on demand
+    if (getenv("DIFF_EGRAPH"))
+    {
+        err = ExpressionEGraphOptimize(&expressionDifferentiate);
+        IF_ERR_RETURN(err);
+        err = ExpressionPrintTex(&expressionDifferentiate, outputTex, "Optimized derivative: ");
+        IF_ERR_RETURN(err);
+    }
     
     //-----------------------TANGENT--------------------
 
@@ -180,6 +202,8 @@ int main(const int argc, const char* argv[])
 
     LatexFileTrollingEnd(outputTex);
     fclose(outputTex);
+
+    GnuPlotWaitAll();
     LatexCreatePdf(outputTexFileName);
 
     free(imgFunc);
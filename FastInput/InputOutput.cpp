@@ -1,7 +1,10 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include "../Common/Colors.h"
 #include "InputOutput.h"
@@ -56,13 +59,196 @@ int TextTypeCtor(TextType* text, FILE* const inStream)
 
     // parsing on lines:
 
-    text->lines = BuildLinesArr(text->text, '\n', &(text->linesCnt));
+    text->lines = BuildLinesArr(text->text, text->textSz, '\n', &(text->linesCnt));
 
     return text->lines? 0 : -1;
 }
 
 //------------------------------------------------------------------------------------------------
 
+static int MappedTextRead(MappedTextType* text, FILE* const inStream);
+
+//------------------------------------------------------------------------------------------------
+
+int MappedTextCtor(MappedTextType* text, const char* const fileName)
+{
+    FILE* inStream = TryOpenFile(fileName, "rb");
+
+    if (inStream == nullptr)
+    {
+        UPDATE_ERR(Errors::FILE_OPENING_ERR);
+        return -1;
+    }
+
+    int retVal = MappedTextCtor(text, inStream);
+
+    fclose(inStream);
+
+    return retVal;
+}
+
+//------------------------------------------------------------------------------------------------
+
+int MappedTextCtor(MappedTextType* text, FILE* const inStream)
+{
+    assert(text);
+    assert(inStream);
+
+    text->text      = "";
+    text->textSz    = 0;
+    text->mapping   = nullptr;
+    text->mappingSz = 0;
+    text->buffer    = nullptr;
+    text->lines     = nullptr;
+    text->linesCnt  = 0;
+
+    int fd = fileno(inStream);
+    struct stat fileStats = {};
+
+    if (fd == -1 || fstat(fd, &fileStats) != 0 || !S_ISREG(fileStats.st_mode))
+        return MappedTextRead(text, inStream);
+
+    // ftell takes the data already buffered by the stream into account
+    const long position = ftell(inStream);
+
+    if (position < 0)
+        return MappedTextRead(text, inStream);
+
+    const size_t fileSize = (size_t) fileStats.st_size;
+    const size_t textPos  = (size_t) position;
+
+    if (textPos >= fileSize)
+        return 0;
+
+    // mapping offset has to be aligned to the page size
+    const size_t pageSize   = (size_t) sysconf(_SC_PAGESIZE);
+    const size_t mappingPos = textPos / pageSize * pageSize;
+    const size_t mappedSize = fileSize - mappingPos;
+
+    // file is mapped over zero pages one page longer than the file,
+    // so the text ends with '\0' even if its size is a multiple of the page size
+    const size_t mappingSize = (mappedSize / pageSize + 1) * pageSize;
+
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (mapping == MAP_FAILED)
+    {
+        UPDATE_ERR(Errors::FILE_MAPPING_ERR);
+        return -1;
+    }
+
+    if (mmap(mapping, mappedSize, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd,
+             (off_t) mappingPos) == MAP_FAILED)
+    {
+        munmap(mapping, mappingSize);
+
+        UPDATE_ERR(Errors::FILE_MAPPING_ERR);
+        return -1;
+    }
+
+    madvise(mapping, mappedSize, MADV_SEQUENTIAL);
+
+    // stream is left at the end of the file as if the text was read from it
+    fseek(inStream, 0, SEEK_END);
+
+    text->text      = (const char*) mapping + (textPos - mappingPos);
+    text->textSz    = fileSize - textPos;
+    text->mapping   = mapping;
+    text->mappingSz = mappingSize;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------------------------
+
+static int MappedTextRead(MappedTextType* text, FILE* const inStream)
+{
+    assert(text);
+    assert(inStream);
+
+    size_t capacity = 4096;
+    size_t size     = 0;
+
+    char* buffer = (char*) calloc(capacity, sizeof(*buffer));
+
+    while (buffer != nullptr)
+    {
+        size += fread(buffer + size, sizeof(*buffer), capacity - size - 1, inStream);
+
+        if (size + 1 < capacity)
+            break;
+
+        char* newBuffer = (char*) realloc(buffer, 2 * capacity * sizeof(*buffer));
+
+        if (newBuffer == nullptr)
+            free(buffer);
+
+        buffer    = newBuffer;
+        capacity *= 2;
+    }
+
+    if (buffer == nullptr)
+    {
+        UPDATE_ERR(Errors::MEMORY_ALLOCATION_ERR);
+        return -1;
+    }
+
+    if (size == 0)
+    {
+        free(buffer);
+        return 0;
+    }
+
+    buffer[size] = '\0';
+
+    text->text   = buffer;
+    text->textSz = size;
+    text->buffer = buffer;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------------------------
+
+void MappedTextDtor(MappedTextType* text)
+{
+    if (text == nullptr)
+        return;
+
+    if (text->mapping != nullptr)
+        munmap(text->mapping, text->mappingSz);
+
+    free(text->buffer);
+    free(text->lines);
+
+    text->text      = nullptr;
+    text->textSz    = 0;
+    text->mapping   = nullptr;
+    text->mappingSz = 0;
+    text->buffer    = nullptr;
+    text->lines     = nullptr;
+    text->linesCnt  = 0;
+}
+
+//------------------------------------------------------------------------------------------------
+
+const LineType* MappedTextGetLines(MappedTextType* text, size_t* linesCnt)
+{
+    assert(text);
+    assert(text->text);
+    assert(linesCnt);
+
+    if (text->lines == nullptr)
+        text->lines = BuildLinesArr(text->text, text->textSz, '\n', &text->linesCnt,
+                                    (size_t) sysconf(_SC_NPROCESSORS_ONLN));
+
+    *linesCnt = text->linesCnt;
+
+    return text->lines;
+}
+
+//------------------------------------------------------------------------------------------------
+
 char* ReadText(FILE* const inStream)
 {
     assert(inStream);
@@ -26,6 +26,24 @@ struct TextType
     size_t linesCnt;            ///< number of elements in ptrArr
 };
 
+/// @brief Read-only text of the file mapped to memory
+///
+/// @details Text is not copied and not changed, so it keeps empty lines unlike TextType.
+/// @details Text is always terminated with '\0'.
+struct MappedTextType
+{
+    const char* text;           ///< mapped text
+    size_t textSz;              ///< number of chars in text without '\0'
+
+    void* mapping;              ///< start of the mapping
+    size_t mappingSz;           ///< length of the mapping in bytes
+
+    char* buffer;               ///< Dynamic array with text if the stream can't be mapped
+
+    LineType* lines;            ///< Dynamic arr with lines, built on the first MappedTextGetLines
+    size_t linesCnt;            ///< number of elements in lines
+};
+
 /// @brief Destructs text
 ///
 /// @details Free all dynamic arrays
@@ -54,6 +72,44 @@ int TextTypeCtor(TextType* text, FILE* const inStream);
 
 //------------------------------------------------------------------------------------------------
 
+/// @brief opens file with fileName and calls MappedTextCtor(text, fp);
+///
+/// @param [out]text struct to fill
+/// @param [in]fileName file to map
+/// @return 0 if no errors occurred otherwise not 0
+int MappedTextCtor(MappedTextType* text, const char* const fileName);
+
+//------------------------------------------------------------------------------------------------
+
+/// @brief maps the rest of the file of the inStream, starting from its current position, to memory
+///
+/// @details mapping is read-only and advised for sequential access.
+/// @details stream is left at the end of the file, just like after reading.
+/// @details streams that can't be mapped (pipes, terminals) are read to a dynamic array.
+/// @param [out]text struct to fill
+/// @param [in]inStream stream to map
+/// @return 0 if no errors occurred otherwise not 0
+/// @attention Creates mapping or dynamic array, MappedTextDtor has to be called
+int MappedTextCtor(MappedTextType* text, FILE* const inStream);
+
+//------------------------------------------------------------------------------------------------
+
+/// @brief unmaps text and frees lines array
+///
+/// @param [out]text structure to destruct
+void MappedTextDtor(MappedTextType* text);
+
+//------------------------------------------------------------------------------------------------
+
+/// @brief returns lines of the text separated by '\n', builds them on the first call
+///
+/// @param [in]text text to parse on lines
+/// @param [out]linesCnt number of elements in returned array
+/// @return array of lines owned by text, nullptr if error occurred
+const LineType* MappedTextGetLines(MappedTextType* text, size_t* linesCnt);
+
+//------------------------------------------------------------------------------------------------
+
 /// @brief reads text from the inStream
 ///
 /// @param [in]inStream stream to read from
@@ -1,20 +1,105 @@
 #include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "../Common/Errors.h"
 #include "StringFuncs.h"
 
+// Separators are found by blocks: one compare gives a bit mask of their positions in the block.
+#if defined(__AVX2__)
+
+    #include <immintrin.h>
+
+    static const size_t SCAN_BLOCK_SIZE = 32;
+
+    static inline uint32_t ScanBlock(const char* block, const char ch)
+    {
+        __m256i chars = _mm256_loadu_si256((const __m256i*) block);
+
+        return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(ch)));
+    }
+
+#elif defined(__SSE2__)
+
+    #include <emmintrin.h>
+
+    static const size_t SCAN_BLOCK_SIZE = 16;
+
+    static inline uint32_t ScanBlock(const char* block, const char ch)
+    {
+        __m128i chars = _mm_loadu_si128((const __m128i*) block);
+
+        return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8(ch)));
+    }
+
+#else
+
+    static const size_t SCAN_BLOCK_SIZE = 1;
+
+    static inline uint32_t ScanBlock(const char* block, const char ch)
+    {
+        return *block == ch;
+    }
+
+#endif
+
+// smaller chunks are not worth a thread
+static const size_t LINES_MIN_CHUNK_SIZE = 1 << 20;
+static const size_t LINES_MAX_THREADS    = 64;
+
+/// @brief Part of the text, which lines are found by one thread
+struct LinesChunkType
+{
+    const char* begin;      ///< chunk start
+    const char* end;        ///< chunk end (not included)
+    char separator;         ///< lines separator
+
+    size_t linesCnt;        ///< number of separators in chunk
+    
+    LineType* lines;        ///< lines array of the whole text
+    size_t firstLine;       ///< index of the line starting after the first separator of chunk
+};
+
+static LineType* BuildLinesArrSequential(const char* text, const char* textEnd, 
+                                         const char separator, size_t* arrSize);
+static LineType* BuildLinesArrParallel  (const char* text, const char* textEnd,
+                                         const char separator, size_t* arrSize,
+                                         const size_t chunksCount);
+
+static void* LinesChunkCount(void* chunkPtr);
+static void* LinesChunkFill (void* chunkPtr);
+static void  LinesChunksRun (void* (*chunkFunc)(void*), LinesChunkType* chunks, 
+                                                        const size_t chunksCount);
+
+static inline void LinesArrAdd  (LineType* lines, const size_t lineIndex, 
+                                                  const char* separatorPtr);
+static inline void LinesChunkAdd(LinesChunkType* chunk, const size_t lineIndex,
+                                                        const char* separatorPtr);
+static bool        LinesArrGrow (LineType** lines, size_t* linesCapacity);
+
+static size_t CountCharsInRange(const char* begin, const char* end, const char ch);
+
 //------------------------------------------------------------------------------------------------
 
-LineType* BuildLinesArr(const char* text, const char separator, size_t* arrSize)
+LineType* BuildLinesArr(const char* text, const size_t textLength, const char separator,
+                        size_t* arrSize, const size_t threadsCount)
 {
     assert(text);
+    assert(text[textLength] == '\0');
     assert(arrSize);
 
-    size_t linesCnt = CountChars(text, separator) + 1;
+    const char* textEnd = text + textLength;
 
-    LineType* lines = (LineType*) calloc(linesCnt, sizeof(*lines));
+    size_t chunksCount = threadsCount < LINES_MAX_THREADS ? threadsCount : LINES_MAX_THREADS;
+
+    if ((size_t)(textEnd - text) < chunksCount * LINES_MIN_CHUNK_SIZE)
+        chunksCount = (size_t)(textEnd - text) / LINES_MIN_CHUNK_SIZE;
+
+    LineType* lines = chunksCount > 1 ? 
+                      BuildLinesArrParallel  (text, textEnd, separator, arrSize, chunksCount) :
+                      BuildLinesArrSequential(text, textEnd, separator, arrSize);
 
     if (lines == nullptr)
     {
@@ -22,63 +107,277 @@ LineType* BuildLinesArr(const char* text, const char separator, size_t* arrSize)
         return nullptr;
     }
 
-    size_t lineIndex = 0;
+    assert(*arrSize > 0);
+    lines[*arrSize - 1].lineLength = 1; // \0 symbol at the end
 
-#pragma GCC diagnostic ignored "-Wtype-limits"
-    assert(0 <= lineIndex && lineIndex < linesCnt);
-#pragma GCC diagnostic warning "-Wtype-limits"
+    return lines;
+}
 
-    lines[lineIndex].line       = text;
-    lines[lineIndex].lineEnding = '\n';
+//------------------------------------------------------------------------------------------------
 
-    ++lineIndex;
+static LineType* BuildLinesArrSequential(const char* text, const char* textEnd, 
+                                         const char separator, size_t* arrSize)
+{
+    assert(text);
+    assert(textEnd);
+    assert(arrSize);
+
+    // array grows while separators are found, so the text is scanned only once
+    size_t linesCapacity = (size_t)(textEnd - text) / 64 + 16;
+    size_t linesCnt      = 1;
+
+    LineType* lines = (LineType*) calloc(linesCapacity, sizeof(*lines));
+
+    if (lines == nullptr)
+        return nullptr;
+
+    lines[0].line       = text;
+    lines[0].lineEnding = '\n';
 
     const char* textIterator = text;
-    while (*textIterator)
+
+    for (; textIterator + SCAN_BLOCK_SIZE <= textEnd; textIterator += SCAN_BLOCK_SIZE)
     {
-        if (*textIterator == separator)
+        uint32_t separatorsMask = ScanBlock(textIterator, separator);
+
+        while (separatorsMask)
         {
-#pragma GCC diagnostic ignored "-Wtype-limits"
-            assert(0 <= lineIndex && lineIndex < linesCnt);     
-#pragma GCC diagnostic warning "-Wtype-limits"   
-
-            assert(lineIndex > 0);
-            lines[lineIndex].lineEnding     = '\n';
-            lines[lineIndex].line           = textIterator + 1;
-            lines[lineIndex - 1].lineLength = (size_t) (lines[lineIndex].line - lines[lineIndex - 1].line);
-            ++lineIndex;
+            if (linesCnt == linesCapacity && 
+                !LinesArrGrow(&lines, &linesCapacity))
+                return nullptr;
+
+            const char* separatorPtr = textIterator + __builtin_ctz(separatorsMask);
+            separatorsMask &= separatorsMask - 1;
+
+            LinesArrAdd(lines, linesCnt++, separatorPtr);
         }
-        ++textIterator;
     }
-    
-    *arrSize = lineIndex;
 
-    assert(lineIndex > 0);
-    assert(lineIndex - 1 < linesCnt);
-    lines[lineIndex - 1].lineLength = 1; // \0 symbol at the end
+    for (; textIterator < textEnd; ++textIterator)
+    {
+        if (*textIterator != separator)
+            continue;
+
+        if (linesCnt == linesCapacity && 
+            !LinesArrGrow(&lines, &linesCapacity))
+            return nullptr;
+
+        LinesArrAdd(lines, linesCnt++, textIterator);
+    }
+
+    *arrSize = linesCnt;
+
+    return lines;
+}
+
+//------------------------------------------------------------------------------------------------
+
+static LineType* BuildLinesArrParallel(const char* text, const char* textEnd,
+                                       const char separator, size_t* arrSize,
+                                       const size_t chunksCount)
+{
+    assert(text);
+    assert(textEnd);
+    assert(arrSize);
+    assert(0 < chunksCount && chunksCount <= LINES_MAX_THREADS);
+
+    LinesChunkType chunks[LINES_MAX_THREADS] = {};
+
+    const size_t chunkSize = (size_t)(textEnd - text) / chunksCount;
+
+    for (size_t i = 0; i < chunksCount; ++i)
+    {
+        chunks[i].begin     = text + i * chunkSize;
+        chunks[i].end       = i + 1 == chunksCount ? textEnd : chunks[i].begin + chunkSize;
+        chunks[i].separator = separator;
+    }
+
+    // first pass counts separators of every chunk, second one fills their parts of array
+    LinesChunksRun(LinesChunkCount, chunks, chunksCount);
+
+    size_t linesCnt = 1;
+    for (size_t i = 0; i < chunksCount; ++i)
+        linesCnt += chunks[i].linesCnt;
+
+    LineType* lines = (LineType*) calloc(linesCnt, sizeof(*lines));
+
+    if (lines == nullptr)
+        return nullptr;
+
+    lines[0].line       = text;
+    lines[0].lineEnding = '\n';
+
+    size_t firstLine = 1;
+    for (size_t i = 0; i < chunksCount; ++i)
+    {
+        chunks[i].lines     = lines;
+        chunks[i].firstLine = firstLine;
+
+        firstLine += chunks[i].linesCnt;
+    }
+
+    LinesChunksRun(LinesChunkFill, chunks, chunksCount);
+
+    // lengths of the lines started in the previous chunks
+    for (size_t i = 0; i < chunksCount; ++i)
+    {
+        size_t lineIndex = chunks[i].firstLine;
+
+        if (chunks[i].linesCnt > 0)
+            lines[lineIndex - 1].lineLength = (size_t)(lines[lineIndex].line - 
+                                                       lines[lineIndex - 1].line);
+    }
+
+    *arrSize = linesCnt;
 
     return lines;
 }
 
 //------------------------------------------------------------------------------------------------
 
+static void* LinesChunkCount(void* chunkPtr)
+{
+    assert(chunkPtr);
+
+    LinesChunkType* chunk = (LinesChunkType*) chunkPtr;
+
+    chunk->linesCnt = CountCharsInRange(chunk->begin, chunk->end, chunk->separator);
+
+    return nullptr;
+}
+
+static void* LinesChunkFill(void* chunkPtr)
+{
+    assert(chunkPtr);
+
+    LinesChunkType* chunk = (LinesChunkType*) chunkPtr;
+
+    size_t      lineIndex    = chunk->firstLine;
+    const char  separator    = chunk->separator;
+    const char* textIterator = chunk->begin;
+
+    for (; textIterator + SCAN_BLOCK_SIZE <= chunk->end; textIterator += SCAN_BLOCK_SIZE)
+    {
+        uint32_t separatorsMask = ScanBlock(textIterator, separator);
+
+        while (separatorsMask)
+        {
+            const char* separatorPtr = textIterator + __builtin_ctz(separatorsMask);
+            separatorsMask &= separatorsMask - 1;
+
+            LinesChunkAdd(chunk, lineIndex++, separatorPtr);
+        }
+    }
+
+    for (; textIterator < chunk->end; ++textIterator)
+        if (*textIterator == separator)
+            LinesChunkAdd(chunk, lineIndex++, textIterator);
+
+    assert(lineIndex == chunk->firstLine + chunk->linesCnt);
+
+    return nullptr;
+}
+
+static void LinesChunksRun(void* (*chunkFunc)(void*), LinesChunkType* chunks, 
+                                                      const size_t chunksCount)
+{
+    assert(chunkFunc);
+    assert(chunks);
+
+    pthread_t threads[LINES_MAX_THREADS] = {};
+    bool      started[LINES_MAX_THREADS] = {};
+
+    for (size_t i = 1; i < chunksCount; ++i)
+        started[i] = pthread_create(&threads[i], nullptr, chunkFunc, &chunks[i]) == 0;
+
+    chunkFunc(&chunks[0]);
+
+    for (size_t i = 1; i < chunksCount; ++i)
+    {
+        if (started[i])
+            pthread_join(threads[i], nullptr);
+        else
+            chunkFunc(&chunks[i]);
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+static inline void LinesArrAdd(LineType* lines, const size_t lineIndex, 
+                                                const char* separatorPtr)
+{
+    assert(lines);
+    assert(lineIndex > 0);
+
+    lines[lineIndex].line           = separatorPtr + 1;
+    lines[lineIndex].lineEnding     = '\n';
+    lines[lineIndex - 1].lineLength = (size_t)(lines[lineIndex].line - lines[lineIndex - 1].line);
+}
+
+static inline void LinesChunkAdd(LinesChunkType* chunk, const size_t lineIndex,
+                                                        const char* separatorPtr)
+{
+    assert(chunk);
+    assert(lineIndex >= chunk->firstLine);
+
+    LineType* lines = chunk->lines;
+
+    lines[lineIndex].line       = separatorPtr + 1;
+    lines[lineIndex].lineEnding = '\n';
+
+    // previous line may belong to the other chunk, its length is set after all chunks are done
+    if (lineIndex > chunk->firstLine)
+        lines[lineIndex - 1].lineLength = (size_t)(lines[lineIndex].line - 
+                                                   lines[lineIndex - 1].line);
+}
+
+static bool LinesArrGrow(LineType** lines, size_t* linesCapacity)
+{
+    assert(lines);
+    assert(linesCapacity);
+
+    LineType* newLines = (LineType*) realloc(*lines, 2 * *linesCapacity * sizeof(*newLines));
+
+    if (newLines == nullptr)
+    {
+        free(*lines);
+        *lines = nullptr;
+
+        return false;
+    }
+
+    *lines          = newLines;
+    *linesCapacity *= 2;
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
 size_t CountChars(const char* str, const char ch)
 {
-    size_t cnt = 0;
+    assert(str);
 
     if (ch == '\0')
         return 1;
     
-    while (true) 
-    {
-        str = strchr(str, ch);
+    return CountCharsInRange(str, str + strlen(str), ch);
+}
 
-        if (str == nullptr)
-            break;
-        
-        ++str;
-        ++cnt;
-    }
+static size_t CountCharsInRange(const char* begin, const char* end, const char ch)
+{
+    assert(begin);
+    assert(end);
+
+    size_t cnt = 0;
+
+    const char* strIterator = begin;
+
+    for (; strIterator + SCAN_BLOCK_SIZE <= end; strIterator += SCAN_BLOCK_SIZE)
+        cnt += (size_t) __builtin_popcount(ScanBlock(strIterator, ch));
+
+    for (; strIterator < end; ++strIterator)
+        cnt += *strIterator == ch;
 
     return cnt;
 }
@@ -11,12 +11,16 @@
 /// @brief builds array containing pointers to the strings in text array and returns it
 ///
 /// @details strings are separated by separator. pointers points to the starts of each string
+/// @details separators are found with SSE2/AVX2 compares if they are available
 /// @param [in]text text to parse on strings
+/// @param [in]textLength number of chars in text without '\0', so the text is scanned only once
 /// @param [in]separator separator to separate strings
 /// @param [out]arrSize - number of elements in returned pointers array. 
+/// @param [in]threadsCount - max number of threads scanning chunks of the big text
 /// @return dynamic array containg pointers to the lines in text array
 /// @attention Creates dynamic array 
-LineType* BuildLinesArr(const char* text, const char separator, size_t* arrSize);
+LineType* BuildLinesArr(const char* text, const size_t textLength, const char separator,
+                        size_t* arrSize, const size_t threadsCount = 1);
 
 //------------------------------------------------------------------------------------------------
 
@@ -2,151 +2,662 @@
 #define VECTOR_H
 
 /// @file
-/// @brief Contains functions to work with vector
+/// @brief Contains generic vector and functions to work with it
 
 #include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 #include "Common/Errors.h"
-#include "Types.h"
 #include "HashFuncs.h"
 
-//#define VECTOR_CANARY_PROTECTION
-//#define VECTOR_HASH_PROTECTION
+///@brief vector dump that substitutes __FILE__, __func__, __LINE__
+#define VECTOR_DUMP(VEC) VectorDump((VEC), __FILE__, __func__, __LINE__)
 
-#ifdef VECTOR_CANARY_PROTECTION
+/// @brief Errors that can occure while vector is working.
+enum class VectorErrors
+{
+    VECTOR_NO_ERR,
 
-    #define ON_CANARY(...) __VA_ARGS__
-    typedef unsigned long long CanaryType;
+    VECTOR_MEMORY_ALLOCATION_ERROR,
+    VECTOR_EMPTY_ERR,
+    VECTOR_IS_NULLPTR,
+    VECTOR_CAPACITY_OUT_OF_RANGE,
+    VECTOR_SIZE_OUT_OF_RANGE,
+    VECTOR_INVALID_CANARY,
+    VECTOR_INVALID_DATA_HASH,
+};
 
-#else
-    
-    #define ON_CANARY(...)
+//-------------Protection policies----------
 
-#endif
+// Policy gives types of protection data before the vector fields and after them
+// and the size of the margins around dynamic data
+
+struct VectorNoProtectionData
+{
+};
 
-#ifdef VECTOR_HASH_PROTECTION
+/// @brief No checks, default policy
+struct VectorNoProtection
+{
+    typedef VectorNoProtectionData LeftType;
+    typedef VectorNoProtectionData RightType;
 
-    #define ON_HASH(...) __VA_ARGS__
+    static constexpr size_t dataMargin = 0;
+};
 
-#else
+typedef unsigned long long VectorCanaryType;
 
-    #define ON_HASH(...) 
+/// @brief Canaries at the start and at the end of the vector struct and around dynamic data. 
+/// They catch writes out of the struct and out of the allocated array
+struct VectorCanaryProtection
+{
+    typedef VectorCanaryType LeftType;
+    typedef VectorCanaryType RightType;
 
-#endif
+    // left margin keeps elements aligned as malloc does
+    static constexpr size_t dataMargin = alignof(max_align_t);
+};
 
-///@brief vector dump that substitutes __FILE__, __func__, __LINE__
-#define VECTOR_DUMP(STK) VectorDump((STK), __FILE__, __func__, __LINE__)
+/// @brief Sum of hashes of the used elements, each one is seeded with its index.
+/// @details Push and pop add and subtract one element hash, only VectorVerify rehashes all of them,
+/// @details VECTOR_CHECK in every call skips it to keep the calls O(1)
+struct VectorHashProtection
+{
+    typedef VectorNoProtectionData LeftType;
+    typedef HashType               RightType;
 
-ON_HASH
-(
-    ///@brief HashType for hasing function in vector
-    typedef HashType HashFuncType(const void* hashingArr, const size_t length, const uint64_t seed);
-)
+    static constexpr size_t dataMargin = 0;
+};
+
+static const VectorCanaryType VECTOR_CANARY = 0xDEADBABE;
 
-/// @brief Contains all info about data to use it 
+//-------------Vector----------
+
+/// @brief Dynamic array of T. First InlineCapacity elements are stored in the struct itself.
+///
+/// @details data points into the struct while elements fit inline storage,
+/// @details so vectors are moved with VectorMove and never copied byte by byte.
+template <typename T, size_t InlineCapacity = 0, typename Protection = VectorNoProtection>
 struct VectorType
 {
-    ON_CANARY
-    (
-        CanaryType structCanaryLeft; ///< left canary for the struct
-    )
+    typename Protection::LeftType leftProtection;   ///< left struct canary
 
-    ElemType* data;       ///< data with values. Have to be a dynamic array.
-    size_t size;          ///< pos to push/pop values (actual size of the data at this moment).
-    
-    ON_HASH
-    (
-        
-        HashType dataHash;      ///< hash of all elements in data.
+    T* data;              ///< elements, inline storage or dynamic array
+    size_t size;          ///< number of elements
+    size_t capacity;      ///< number of elements that fit data without reallocation
 
-        HashFuncType* HashFunc; ///< hashing function
+    alignas(T) unsigned char inlineData[(InlineCapacity > 0 ? InlineCapacity : 1) * sizeof(T)];
 
-        HashType structHash;    ///< hash of all elements in struct.
-    )
+    typename Protection::RightType rightProtection; ///< right struct canary or data hash
+};
 
-    size_t capacity;     ///< REAL size of the data at this moment (calloced more than need at this moment).
+/// @brief Prints vector info to log-file, doesn't depend on element type
+void VectorDump(const void* vector, const void* data, const size_t size, const size_t capacity,
+                const char* const fileName, const char* const funcName, const int lineNumber);
 
-    ON_CANARY
-    (
-        CanaryType structCanaryRight; ///< right canary for the struct
-    )
-};
+/// @brief Prints vector error to log file
+/// @param [in]error error to print
+void VectorPrintError(VectorErrors error);
 
-/// @brief Errors that can occure while vector is working. 
-enum class VectorErrors
+//---------------------------------------------------------------------------------------
+
+template <typename T, size_t InlineCapacity, typename Protection>
+static inline T* VectorInlineData(VectorType<T, InlineCapacity, Protection>* vector)
 {
-    VECTOR_NO_ERR,
+    assert(vector);
 
-    VECTOR_MEMORY_ALLOCATION_ERROR,
-    VECTOR_EMPTY_ERR, 
-    VECTOR_IS_NULLPTR,
-    VECTOR_CAPACITY_OUT_OF_RANGE,
-    VECTOR_SIZE_OUT_OF_RANGE,
-    VECTOR_INVALID_CANARY, 
-    VECTOR_INVALID_DATA_HASH,
-    VECTOR_INVALID_STRUCT_HASH,
-};
+    return InlineCapacity > 0 ? reinterpret_cast<T*>(vector->inlineData) : nullptr;
+}
+
+template <typename T, size_t InlineCapacity, typename Protection>
+static inline bool VectorIsInline(const VectorType<T, InlineCapacity, Protection>* vector)
+{
+    assert(vector);
+
+    return InlineCapacity > 0 &&
+           vector->data == reinterpret_cast<const T*>(vector->inlineData);
+}
+
+//-------------Dynamic data----------
+
+// dynamic array is allocated with dataMargin bytes before and after the elements
+
+template <typename T, size_t InlineCapacity, typename Protection>
+static inline T* VectorDataAlloc(const VectorType<T, InlineCapacity, Protection>*,
+                                 const size_t capacity)
+{
+    const size_t margin = Protection::dataMargin;
+
+    char* memory = (char*) malloc(capacity * sizeof(T) + 2 * margin);
+
+    return memory ? (T*) (memory + margin) : nullptr;
+}
+
+template <typename T, size_t InlineCapacity, typename Protection>
+static inline T* VectorDataRealloc(VectorType<T, InlineCapacity, Protection>* vector,
+                                   const size_t capacity)
+{
+    assert(vector);
+    assert(!VectorIsInline(vector));
+
+    const size_t margin = Protection::dataMargin;
+    char* memory = vector->data ? (char*) vector->data - margin : nullptr;
+
+    memory = (char*) realloc(memory, capacity * sizeof(T) + 2 * margin);
+
+    return memory ? (T*) (memory + margin) : nullptr;
+}
+
+template <typename T, size_t InlineCapacity, typename Protection>
+static inline void VectorDataFree(VectorType<T, InlineCapacity, Protection>* vector)
+{
+    assert(vector);
+
+    if (VectorIsInline(vector) || vector->data == nullptr)
+        return;
+
+    free((char*) vector->data - Protection::dataMargin);
+}
+
+//-------------Protection----------
+
+template <typename T, size_t InlineCapacity>
+static inline void VectorProtectionUpdate(VectorType<T, InlineCapacity, VectorNoProtection>*)
+{
+}
+
+template <typename T, size_t InlineCapacity>
+static inline VectorErrors VectorProtectionVerify(
+                                const VectorType<T, InlineCapacity, VectorNoProtection>*)
+{
+    return VectorErrors::VECTOR_NO_ERR;
+}
+
+/// @brief Addresses of the canaries around dynamic data, they may be unaligned
+template <typename T, size_t InlineCapacity>
+static inline char* VectorDataLeftCanary(
+                                const VectorType<T, InlineCapacity, VectorCanaryProtection>* vector)
+{
+    return (char*) vector->data - sizeof(VectorCanaryType);
+}
+
+template <typename T, size_t InlineCapacity>
+static inline char* VectorDataRightCanary(
+                                const VectorType<T, InlineCapacity, VectorCanaryProtection>* vector)
+{
+    return (char*) (vector->data + vector->capacity);
+}
+
+template <typename T, size_t InlineCapacity>
+static inline void VectorProtectionUpdate(
+                                VectorType<T, InlineCapacity, VectorCanaryProtection>* vector)
+{
+    assert(vector);
+
+    vector->leftProtection  = VECTOR_CANARY;
+    vector->rightProtection = VECTOR_CANARY;
+
+    if (VectorIsInline(vector) || vector->data == nullptr)
+        return;
+
+    memcpy(VectorDataLeftCanary (vector), &VECTOR_CANARY, sizeof(VECTOR_CANARY));
+    memcpy(VectorDataRightCanary(vector), &VECTOR_CANARY, sizeof(VECTOR_CANARY));
+}
+
+template <typename T, size_t InlineCapacity>
+static inline VectorErrors VectorProtectionVerify(
+                            const VectorType<T, InlineCapacity, VectorCanaryProtection>* vector)
+{
+    assert(vector);
+
+    if (vector->leftProtection != VECTOR_CANARY || vector->rightProtection != VECTOR_CANARY)
+        return VectorErrors::VECTOR_INVALID_CANARY;
+
+    if (VectorIsInline(vector) || vector->data == nullptr)
+        return VectorErrors::VECTOR_NO_ERR;
+
+    VectorCanaryType leftCanary  = 0;
+    VectorCanaryType rightCanary = 0;
+    memcpy(&leftCanary,  VectorDataLeftCanary (vector), sizeof(leftCanary));
+    memcpy(&rightCanary, VectorDataRightCanary(vector), sizeof(rightCanary));
+
+    if (leftCanary != VECTOR_CANARY || rightCanary != VECTOR_CANARY)
+        return VectorErrors::VECTOR_INVALID_CANARY;
+
+    return VectorErrors::VECTOR_NO_ERR;
+}
+
+template <typename T, size_t InlineCapacity>
+static inline HashType VectorElementHash(
+                                const VectorType<T, InlineCapacity, VectorHashProtection>* vector,
+                                const size_t index)
+{
+    return MurmurHash(vector->data + index, sizeof(T), index);
+}
+
+template <typename T, size_t InlineCapacity>
+static inline HashType VectorDataHash(
+                                const VectorType<T, InlineCapacity, VectorHashProtection>* vector)
+{
+    HashType dataHash = 0;
+
+    for (size_t i = 0; i < vector->size; ++i)
+        dataHash += VectorElementHash(vector, i);
+
+    return dataHash;
+}
+
+// called after reallocation only, it takes O(size) anyway
+template <typename T, size_t InlineCapacity>
+static inline void VectorProtectionUpdate(
+                                VectorType<T, InlineCapacity, VectorHashProtection>* vector)
+{
+    assert(vector);
+
+    vector->rightProtection = VectorDataHash(vector);
+}
+
+template <typename T, size_t InlineCapacity>
+static inline void VectorProtectionPush(
+                                VectorType<T, InlineCapacity, VectorHashProtection>* vector)
+{
+    assert(vector);
+    assert(vector->size > 0);
+
+    vector->rightProtection += VectorElementHash(vector, vector->size - 1);
+}
+
+template <typename T, size_t InlineCapacity>
+static inline void VectorProtectionPop(
+                                VectorType<T, InlineCapacity, VectorHashProtection>* vector)
+{
+    assert(vector);
+    assert(vector->size > 0);
+
+    vector->rightProtection -= VectorElementHash(vector, vector->size - 1);
+}
+
+template <typename T, size_t InlineCapacity>
+static inline VectorErrors VectorProtectionVerify(
+                                const VectorType<T, InlineCapacity, VectorHashProtection>* vector)
+{
+    assert(vector);
+
+    if (VectorDataHash(vector) != vector->rightProtection)
+        return VectorErrors::VECTOR_INVALID_DATA_HASH;
+
+    return VectorErrors::VECTOR_NO_ERR;
+}
+
+template <typename T, size_t InlineCapacity>
+static inline VectorErrors VectorProtectionCheck(
+                                const VectorType<T, InlineCapacity, VectorHashProtection>*)
+{
+    return VectorErrors::VECTOR_NO_ERR;
+}
+
+// other policies don't depend on the elements and check everything in O(1)
+
+template <typename T, size_t InlineCapacity, typename Protection>
+static inline void VectorProtectionPush(VectorType<T, InlineCapacity, Protection>*)
+{
+}
+
+template <typename T, size_t InlineCapacity, typename Protection>
+static inline void VectorProtectionPop(VectorType<T, InlineCapacity, Protection>*)
+{
+}
+
+template <typename T, size_t InlineCapacity, typename Protection>
+static inline VectorErrors VectorProtectionCheck(
+                                const VectorType<T, InlineCapacity, Protection>* vector)
+{
+    return VectorProtectionVerify(vector);
+}
+
+template <typename T, size_t InlineCapacity, typename Protection>
+static inline void VectorUpdateProtection(VectorType<T, InlineCapacity, Protection>* vector)
+{
+    assert(vector);
+
+    VectorProtectionUpdate(vector);
+}
+
+/// @brief Moves count elements from src to uninitialized dst
+template <typename T>
+static inline void VectorMoveElements(T* dst, T* src, const size_t count)
+{
+    if (count == 0)
+        return;
+
+    assert(dst);
+    assert(src);
+
+    if (std::is_trivially_copyable<T>::value)
+    {
+        memcpy((void*) dst, (const void*) src, count * sizeof(T));
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        new (dst + i) T(std::move(src[i]));
+        src[i].~T();
+    }
+}
+
+template <typename T>
+static inline void VectorDestroyElements(T* data, const size_t count)
+{
+    if (std::is_trivially_destructible<T>::value)
+        return;
+
+    for (size_t i = 0; i < count; ++i)
+        data[i].~T();
+}
+
+//---------------------------------------------------------------------------------------
+
+template <typename T, size_t InlineCapacity, typename Protection>
+static inline VectorErrors VectorVerifyFields(
+                                const VectorType<T, InlineCapacity, Protection>* vector)
+{
+    assert(vector);
+
+    if (vector->data == nullptr && vector->capacity > 0)
+        return VectorErrors::VECTOR_IS_NULLPTR;
+
+    if (vector->capacity < InlineCapacity)
+        return VectorErrors::VECTOR_CAPACITY_OUT_OF_RANGE;
+
+    if (vector->size > vector->capacity)
+        return VectorErrors::VECTOR_SIZE_OUT_OF_RANGE;
+
+    return VectorErrors::VECTOR_NO_ERR;
+}
+
+/// @brief Checks if vector is used right
+/// @param [in]vector vector to verify
+/// @return VectorErrors in vector
+template <typename T, size_t InlineCapacity, typename Protection>
+VectorErrors VectorVerify(const VectorType<T, InlineCapacity, Protection>* vector)
+{
+    VectorErrors err = VectorVerifyFields(vector);
+
+    if (err != VectorErrors::VECTOR_NO_ERR)
+        return err;
+
+    return VectorProtectionVerify(vector);
+}
+
+/// @brief Checks done in every call, unlike VectorVerify they don't rehash the elements
+template <typename T, size_t InlineCapacity, typename Protection>
+static inline VectorErrors VectorCheck(const VectorType<T, InlineCapacity, Protection>* vector)
+{
+    VectorErrors err = VectorVerifyFields(vector);
+
+    if (err != VectorErrors::VECTOR_NO_ERR)
+        return err;
+
+    return VectorProtectionCheck(vector);
+}
+
+#ifndef NDEBUG
+
+    #define VECTOR_CHECK(VEC)                                       \
+    do                                                              \
+    {                                                               \
+        VectorErrors vectorErr_ = VectorCheck(VEC);                 \
+                                                                    \
+        if (vectorErr_ != VectorErrors::VECTOR_NO_ERR)              \
+        {                                                           \
+            VectorPrintError(vectorErr_);                           \
+            VECTOR_DUMP(VEC);                                       \
+            return vectorErr_;                                      \
+        }                                                           \
+    } while (0)
 
-#ifdef VECTOR_HASH_PROTECTION
-    /// @brief Constructor
-    /// @param [out]stk vector to fill
-    /// @param [in]capacity size to reserve for the vector
-    /// @param [in]HashFunc hash function for calculating hash
-    /// @return errors that occurred
-    VectorErrors VectorCtor(VectorType* const stk, const size_t capacity = 0, 
-                        const HashFuncType HashFunc = MurmurHash);
 #else
-    /// @brief Constructor
-    /// @param [out]stk vector to fill
-    /// @param [in]capacity size to reserve for the vector
-    /// @return errors that occurred
-    VectorErrors VectorCtor(VectorType* const stk, const size_t capacity = 0);
+
+    #define VECTOR_CHECK(VEC)
+
 #endif
 
+/// @brief Reserves memory for at least capacity elements
+/// @param [out]vector vector to reserve in
+/// @param [in]capacity min capacity after the call
+/// @return errors that occurred
+template <typename T, size_t InlineCapacity, typename Protection>
+VectorErrors VectorReserve(VectorType<T, InlineCapacity, Protection>* vector,
+                           const size_t capacity)
+{
+    assert(vector);
+
+    VECTOR_CHECK(vector);
+
+    if (capacity <= vector->capacity)
+        return VectorErrors::VECTOR_NO_ERR;
+
+    T* newData = nullptr;
+
+    // realloc may extend the block in place, but it can move only trivial elements
+    if (std::is_trivially_copyable<T>::value && !VectorIsInline(vector))
+        newData = VectorDataRealloc(vector, capacity);
+    else
+    {
+        newData = VectorDataAlloc(vector, capacity);
+
+        if (newData != nullptr)
+        {
+            VectorMoveElements(newData, vector->data, vector->size);
+            VectorDataFree(vector);
+        }
+    }
+
+    if (newData == nullptr)
+    {
+        VectorPrintError(VectorErrors::VECTOR_MEMORY_ALLOCATION_ERROR);
+        return VectorErrors::VECTOR_MEMORY_ALLOCATION_ERROR;
+    }
+
+    vector->data     = newData;
+    vector->capacity = capacity;
+
+    VectorUpdateProtection(vector);
+
+    return VectorErrors::VECTOR_NO_ERR;
+}
+
+/// @brief Constructor
+/// @param [out]vector vector to fill
+/// @param [in]capacity size to reserve for the vector, inline storage is used if it is enough
+/// @return errors that occurred
+template <typename T, size_t InlineCapacity, typename Protection>
+VectorErrors VectorCtor(VectorType<T, InlineCapacity, Protection>* vector,
+                        const size_t capacity = 0)
+{
+    assert(vector);
+
+    vector->data     = VectorInlineData(vector);
+    vector->size     = 0;
+    vector->capacity = InlineCapacity;
+
+    VectorUpdateProtection(vector);
+
+    if (capacity <= InlineCapacity)
+        return VectorErrors::VECTOR_NO_ERR;
+
+    return VectorReserve(vector, capacity);
+}
+
 /// @brief Destructor
-/// @param [out]stk vector to destruct
+/// @param [out]vector vector to destruct
 /// @return errors that occurred
-VectorErrors VectorDtor(VectorType* const stk);
+template <typename T, size_t InlineCapacity, typename Protection>
+VectorErrors VectorDtor(VectorType<T, InlineCapacity, Protection>* vector)
+{
+    assert(vector);
+
+    VECTOR_CHECK(vector);
+
+    VectorDestroyElements(vector->data, vector->size);
+    VectorDataFree(vector);
+
+    vector->data     = nullptr;
+    vector->size     = 0;
+    vector->capacity = 0;
+
+    return VectorErrors::VECTOR_NO_ERR;
+}
+
+/// @brief Constructs value at the end of the vector
+/// @param [out]vector vector to push in
+/// @param [in]args arguments of T constructor
+/// @return errors that occurred
+template <typename T, size_t InlineCapacity, typename Protection, typename... Args>
+VectorErrors VectorEmplace(VectorType<T, InlineCapacity, Protection>* vector, Args&&... args)
+{
+    assert(vector);
+
+    VECTOR_CHECK(vector);
+
+    static const size_t MIN_CAPACITY = 16;
+
+    if (vector->size == vector->capacity)
+    {
+        size_t newCapacity = vector->capacity > MIN_CAPACITY / 2 ? 2 * vector->capacity :
+                                                                   MIN_CAPACITY;
+
+        VectorErrors err = VectorReserve(vector, newCapacity);
+
+        if (err != VectorErrors::VECTOR_NO_ERR)
+            return err;
+    }
+
+    new (vector->data + vector->size) T(std::forward<Args>(args)...);
+    vector->size++;
+
+    VectorProtectionPush(vector);
+
+    return VectorErrors::VECTOR_NO_ERR;
+}
 
 /// @brief Pushing value to the vector
-/// @param [out]stk vector to push in
+/// @param [out]vector vector to push in
 /// @param [in]val  value to push
 /// @return errors that occurred
-VectorErrors VectorPush(VectorType* stk, const ElemType val);
+template <typename T, size_t InlineCapacity, typename Protection>
+VectorErrors VectorPush(VectorType<T, InlineCapacity, Protection>* vector, const T& val)
+{
+    return VectorEmplace(vector, val);
+}
 
-/// @brief Popping value to the vector
-/// @param [out]stk vector to pop
-/// @param [out]retVal popped value
+/// @brief Pushing value to the vector
+/// @param [out]vector vector to push in
+/// @param [in]val  value to move in
 /// @return errors that occurred
-VectorErrors VectorPop(VectorType* stk, ElemType* retVal = nullptr);
+template <typename T, size_t InlineCapacity, typename Protection>
+VectorErrors VectorPush(VectorType<T, InlineCapacity, Protection>* vector, T&& val)
+{
+    return VectorEmplace(vector, std::move(val));
+}
 
-/// @brief Verifies if vector is used right
-/// @param [in]stk vector to verify
-/// @return VectorErrors in vector
-VectorErrors VectorVerify(VectorType* stk);
+/// @brief Popping value from the vector
+/// @param [out]vector vector to pop
+/// @param [out]retVal popped value, moved out of the vector
+/// @return errors that occurred
+template <typename T, size_t InlineCapacity, typename Protection>
+VectorErrors VectorPop(VectorType<T, InlineCapacity, Protection>* vector, T* retVal = nullptr)
+{
+    assert(vector);
 
-/// @brief Prints vector to log-file 
-/// @param [in]stk vector to print out
-/// @param [in]fileName __FILE__
-/// @param [in]funcName __func__
-/// @param [in]lineNumber __LINE__
-void VectorDump(const VectorType* stk, const char* const fileName, 
-                                     const char* const funcName,
-                                     const int lineNumber);
+    VECTOR_CHECK(vector);
+
+    if (vector->size == 0)
+    {
+        VectorPrintError(VectorErrors::VECTOR_EMPTY_ERR);
+        return VectorErrors::VECTOR_EMPTY_ERR;
+    }
+
+    VectorProtectionPop(vector);
+
+    vector->size--;
+
+    if (retVal)
+        *retVal = std::move(vector->data[vector->size]);
+
+    vector->data[vector->size].~T();
+
+    return VectorErrors::VECTOR_NO_ERR;
+}
+
+/// @brief Moves elements and memory of src to dst, src becomes empty
+/// @param [out]dst constructed empty vector or destructed one
+/// @param [out]src vector to move from
+/// @return errors that occurred
+template <typename T, size_t InlineCapacity, typename Protection>
+VectorErrors VectorMove(VectorType<T, InlineCapacity, Protection>* dst,
+                        VectorType<T, InlineCapacity, Protection>* src)
+{
+    assert(dst);
+    assert(src);
+    assert(dst != src);
+
+    VECTOR_CHECK(src);
+
+    if (VectorIsInline(src))
+    {
+        dst->data = VectorInlineData(dst);
+        VectorMoveElements(dst->data, src->data, src->size);
+    }
+    else
+        dst->data = src->data;
+
+    dst->size     = src->size;
+    dst->capacity = src->capacity;
+
+    src->data     = VectorInlineData(src);
+    src->size     = 0;
+    src->capacity = InlineCapacity;
+
+    VectorUpdateProtection(dst);
+    VectorUpdateProtection(src);
+
+    return VectorErrors::VECTOR_NO_ERR;
+}
 
 /// @brief Checks if vector is empty
-/// @param [in]stk vector to check 
+/// @param [in]vector vector to check
 /// @return true if vector is empty otherwise false
-static inline bool VectorIsEmpty(const VectorType* stk)
+template <typename T, size_t InlineCapacity, typename Protection>
+static inline bool VectorIsEmpty(const VectorType<T, InlineCapacity, Protection>* vector)
 {
-    assert(stk);
-    assert(stk->data);
-    
-    return stk->size == 0;
+    assert(vector);
+
+    return vector->size == 0;
 }
 
-/// @brief Prints vector error to log file
-/// @param [in]error error to print
-void VectorPrintError(VectorErrors error);
+/// @brief Prints vector to log-file
+/// @param [in]vector vector to print out
+/// @param [in]fileName __FILE__
+/// @param [in]funcName __func__
+/// @param [in]lineNumber __LINE__
+template <typename T, size_t InlineCapacity, typename Protection>
+void VectorDump(const VectorType<T, InlineCapacity, Protection>* vector,
+                const char* const fileName, const char* const funcName, const int lineNumber)
+{
+    assert(vector);
+
+    VectorDump(vector, vector->data, vector->size, vector->capacity,
+               fileName, funcName, lineNumber);
+}
+
+#undef VECTOR_CHECK
 
-#endif // VECTOR_H
\ No newline at end of file
+#endif // VECTOR_H